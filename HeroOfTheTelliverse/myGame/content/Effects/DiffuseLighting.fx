@@ -50,6 +50,13 @@ struct VS_INPUT
 	float3 Normal : NORMAL;
 };
 
+struct VS_COMPRESSED_INPUT
+{
+    float4 ObjectPosition : POSITION;
+    float2 TextureCoordinate : TEXCOORD;
+	float2 Normal : NORMAL;
+};
+
 struct VS_OUTPUT
 {
     float4 Position : SV_Position;
@@ -62,14 +69,50 @@ struct VS_OUTPUT
 
 VS_OUTPUT vertex_shader(VS_INPUT IN)
 {
-//add in the vertex shader code here
+	VS_OUTPUT OUT = (VS_OUTPUT)0;
+
+	OUT.Position = mul(IN.ObjectPosition, WorldViewProjection);
+	OUT.TextureCoordinate = get_corrected_texture_coordinate(IN.TextureCoordinate);
+	OUT.Normal = normalize(mul(float4(IN.Normal, 0), World).xyz);
+	OUT.LightDirection = normalize(-LightDirection);
+
+	return OUT;
+}
+
+// Positions arrive bounds-relative; the dequantization is folded into WorldViewProjection.
+VS_OUTPUT compressed_vertex_shader(VS_COMPRESSED_INPUT IN)
+{
+	VS_INPUT decoded;
+	decoded.ObjectPosition = IN.ObjectPosition;
+	decoded.TextureCoordinate = IN.TextureCoordinate;
+	decoded.Normal = decode_octahedral_normal(IN.Normal);
+
+	return vertex_shader(decoded);
 }
 
 /************* Pixel Shader *************/
 
 float4 pixel_shader(VS_OUTPUT IN) : SV_Target
 {
-	//add in the pixel shader code here
+	float4 OUT = (float4)0;
+
+	float3 normal = normalize(IN.Normal);
+	float3 lightDirection = normalize(IN.LightDirection);
+	float n_dot_l = dot(lightDirection, normal);
+
+	float4 color = ColorTexture.Sample(ColorSampler, IN.TextureCoordinate);
+	float3 ambient = get_vector_color_contribution(AmbientColor, color.rgb);
+
+	float3 diffuse = (float3)0;
+	if (n_dot_l > 0)
+	{
+		diffuse = get_vector_color_contribution(LightColor, n_dot_l * color.rgb);
+	}
+
+	OUT.rgb = ambient + diffuse;
+	OUT.a = color.a;
+
+	return OUT;
 }
 
 /************* Techniques *************/
@@ -82,4 +125,14 @@ technique11 main11
 		SetGeometryShader(NULL);
         SetPixelShader(CompileShader(ps_5_0, pixel_shader()));
     }
+}
+
+technique11 compressed11
+{
+    pass p0
+	{
+        SetVertexShader(CompileShader(vs_5_0, compressed_vertex_shader()));
+		SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, pixel_shader()));
+    }
 }
\ No newline at end of file
@@ -7,6 +7,11 @@ cbuffer CBufferPerObject
 	float4x4 WorldViewProjection : WORLDVIEWPROJECTION < string UIWidget="None"; >;
 }
 
+cbuffer CBufferPerFrameInstanced
+{
+	float4x4 ViewProjection : VIEWPROJECTION < string UIWidget="None"; >;
+}
+
 Texture2D ColorTexture <
     string ResourceName = "default_color.dds";
     string UIName =  "Color Texture";
@@ -28,6 +33,17 @@ struct VS_INPUT
     float2 TextureCoordinate : TEXCOORD;
 };
 
+// The instance's world matrix arrives one row per element from the second vertex buffer
+struct VS_INSTANCED_INPUT
+{
+    float4 ObjectPosition : POSITION;
+    float2 TextureCoordinate : TEXCOORD;
+    float4 World0 : WORLD0;
+    float4 World1 : WORLD1;
+    float4 World2 : WORLD2;
+    float4 World3 : WORLD3;
+};
+
 struct VS_OUTPUT
 {
     float4 Position : SV_Position;
@@ -57,6 +73,17 @@ VS_OUTPUT vertex_shader(VS_INPUT IN)
 	return OUT;
 }
 
+VS_OUTPUT vertex_shader_instanced(VS_INSTANCED_INPUT IN)
+{
+	VS_OUTPUT OUT = (VS_OUTPUT)0;
+
+	float4x4 world = float4x4(IN.World0, IN.World1, IN.World2, IN.World3);
+	OUT.Position = mul(mul(IN.ObjectPosition, world), ViewProjection);
+	OUT.TextureCoordinate = get_corrected_texture_coordinate(IN.TextureCoordinate);
+
+	return OUT;
+}
+
 /************* Pixel Shader *************/
 
 float4 pixel_shader(VS_OUTPUT IN) : SV_Target
@@ -74,4 +101,14 @@ technique11 main11
 		SetGeometryShader(NULL);
         SetPixelShader(CompileShader(ps_5_0, pixel_shader()));
     }
+}
+
+technique11 main11_instanced
+{
+    pass p0
+	{
+        SetVertexShader(CompileShader(vs_5_0, vertex_shader_instanced()));
+		SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, pixel_shader()));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "DependencyScanner.h"
+#include "ContentManifest.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace Library;
+
+namespace ContentCooker
+{
+	namespace
+	{
+		// 3DS chunks that only hold other chunks, down to the texture map filenames.
+		const USHORT ChunkMain = 0x4D4D;
+		const USHORT ChunkEditor = 0x3D3D;
+		const USHORT ChunkMaterial = 0xAFFF;
+		const USHORT ChunkMapFilename = 0xA300;
+		const USHORT MapChunks[] = { 0xA200, 0xA204, 0xA210, 0xA220, 0xA230, 0xA33A, 0xA33C, 0xA33D };
+
+		const char* const MaterialMapKeywords[] = { "map_ka", "map_kd", "map_ks", "map_ke", "map_ns", "map_d", "map_bump", "bump", "disp", "decal", "refl", "norm" };
+
+		std::string ResolvePath(const std::string& directory, std::string path)
+		{
+			std::replace(path.begin(), path.end(), '/', '\\');
+
+			// Effects written as C strings double their separators.
+			for (std::string::size_type doubled = path.find("\\\\"); doubled != std::string::npos; doubled = path.find("\\\\", doubled))
+			{
+				path.erase(doubled, 1);
+			}
+
+			if (path.empty() || path[0] == '\\' || path.find(':') != std::string::npos)
+			{
+				return path;
+			}
+
+			return directory + path;
+		}
+
+		void AddUnique(std::vector<std::string>& paths, const std::string& path)
+		{
+			std::string normalized = ContentManifest::NormalizePath(path);
+			for (const std::string& existing : paths)
+			{
+				if (ContentManifest::NormalizePath(existing) == normalized)
+				{
+					return;
+				}
+			}
+
+			paths.push_back(path);
+		}
+
+		void Walk3dsChunks(const MappedFile& file, UINT begin, UINT end, const std::string& directory, AssetDependencies& dependencies)
+		{
+			const UINT headerSize = sizeof(USHORT) + sizeof(UINT);
+
+			UINT position = begin;
+			while (end - position >= headerSize)
+			{
+				USHORT id;
+				UINT length;
+				memcpy(&id, file.Data() + position, sizeof(id));
+				memcpy(&length, file.Data() + position + sizeof(id), sizeof(length));
+				if (length < headerSize || length > end - position)
+				{
+					break;
+				}
+
+				if (id == ChunkMapFilename)
+				{
+					const char* name = reinterpret_cast<const char*>(file.Data() + position + headerSize);
+					std::string path(name, std::find(name, name + length - headerSize, '\0'));
+					if (path.empty() == false)
+					{
+						AddUnique(dependencies.References, ResolvePath(directory, path));
+					}
+				}
+				else if (id == ChunkMain || id == ChunkEditor || id == ChunkMaterial || std::find(MapChunks, MapChunks + _countof(MapChunks), id) != MapChunks + _countof(MapChunks))
+				{
+					Walk3dsChunks(file, position + headerSize, position + length, directory, dependencies);
+				}
+
+				position += length;
+			}
+		}
+	}
+
+	void DependencyScanner::Scan(const std::string& filename, AssetDependencies& dependencies)
+	{
+		ScanFile(filename, dependencies);
+
+		// Inputs can pull in more inputs (nested includes); Inputs grows as this walks it.
+		for (UINT i = 0; i < dependencies.Inputs.size(); i++)
+		{
+			std::string input = dependencies.Inputs[i];
+			if (GetFileAttributesA(input.c_str()) != INVALID_FILE_ATTRIBUTES)
+			{
+				ScanFile(input, dependencies);
+			}
+		}
+	}
+
+	std::string DependencyScanner::Extension(const std::string& filename)
+	{
+		std::string::size_type lastSlashIndex = filename.find_last_of("\\/");
+		std::string::size_type lastDotIndex = filename.find_last_of('.');
+		if (lastDotIndex == std::string::npos || (lastSlashIndex != std::string::npos && lastDotIndex < lastSlashIndex))
+		{
+			return std::string();
+		}
+
+		std::string extension = filename.substr(lastDotIndex);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+		return extension;
+	}
+
+	std::string DependencyScanner::Directory(const std::string& filename)
+	{
+		std::string::size_type lastSlashIndex = filename.find_last_of("\\/");
+
+		return (lastSlashIndex != std::string::npos ? filename.substr(0, lastSlashIndex + 1) : std::string());
+	}
+
+	void DependencyScanner::ScanFile(const std::string& filename, AssetDependencies& dependencies)
+	{
+		std::string extension = Extension(filename);
+		if (extension == ".obj")
+		{
+			ScanObj(filename, dependencies);
+		}
+		else if (extension == ".mtl")
+		{
+			ScanMtl(filename, dependencies);
+		}
+		else if (extension == ".3ds")
+		{
+			Scan3ds(filename, dependencies);
+		}
+		else if (extension == ".fx" || extension == ".fxh" || extension == ".hlsl")
+		{
+			ScanEffect(filename, dependencies);
+		}
+	}
+
+	void DependencyScanner::ScanObj(const std::string& filename, AssetDependencies& dependencies)
+	{
+		std::ifstream file(filename.c_str());
+		std::string directory = Directory(filename);
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream tokens(line);
+			std::string keyword;
+			if (!(tokens >> keyword) || keyword != "mtllib")
+			{
+				continue;
+			}
+
+			std::string library;
+			while (tokens >> library)
+			{
+				AddUnique(dependencies.Inputs, ResolvePath(directory, library));
+			}
+		}
+	}
+
+	void DependencyScanner::ScanMtl(const std::string& filename, AssetDependencies& dependencies)
+	{
+		std::ifstream file(filename.c_str());
+		std::string directory = Directory(filename);
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream tokens(line);
+			std::string keyword;
+			if (!(tokens >> keyword))
+			{
+				continue;
+			}
+
+			std::transform(keyword.begin(), keyword.end(), keyword.begin(), ::tolower);
+			if (std::find(MaterialMapKeywords, MaterialMapKeywords + _countof(MaterialMapKeywords), keyword) == MaterialMapKeywords + _countof(MaterialMapKeywords))
+			{
+				continue;
+			}
+
+			// Options such as -bm 1.0 come first; the filename is always last.
+			std::string token;
+			std::string path;
+			while (tokens >> token)
+			{
+				path = token;
+			}
+
+			if (path.empty() == false)
+			{
+				AddUnique(dependencies.References, ResolvePath(directory, path));
+			}
+		}
+	}
+
+	void DependencyScanner::Scan3ds(const std::string& filename, AssetDependencies& dependencies)
+	{
+		MappedFile file(filename);
+		Walk3dsChunks(file, 0, file.Size(), Directory(filename), dependencies);
+	}
+
+	void DependencyScanner::ScanEffect(const std::string& filename, AssetDependencies& dependencies)
+	{
+		std::ifstream file(filename.c_str());
+		std::string directory = Directory(filename);
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::string::size_type hash = line.find_first_not_of(" \t");
+			if (hash == std::string::npos || line.compare(hash, 8, "#include") != 0)
+			{
+				continue;
+			}
+
+			std::string::size_type open = line.find_first_of("\"<", hash + 8);
+			if (open == std::string::npos)
+			{
+				continue;
+			}
+
+			std::string::size_type close = line.find_first_of("\">", open + 1);
+			if (close != std::string::npos)
+			{
+				AddUnique(dependencies.Inputs, ResolvePath(directory, line.substr(open + 1, close - open - 1)));
+			}
+		}
+	}
+}
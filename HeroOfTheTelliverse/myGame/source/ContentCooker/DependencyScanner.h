@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Common.h"
+
+namespace ContentCooker
+{
+	struct AssetDependencies
+	{
+		// Files the cooked output is built from (.mtl for .obj, include files for .fx).
+		std::vector<std::string> Inputs;
+
+		// Other assets the runtime loads alongside this one, such as textures. They are cooked
+		// as assets of their own rather than folded into this one.
+		std::vector<std::string> References;
+	};
+
+	// Finds what a source asset pulls in by reading just enough of it: mtllib and map_ lines,
+	// #include directives and 3DS texture map chunks. Paths come back relative to the
+	// referencing file's directory, whether or not they exist; Scan follows inputs recursively.
+	class DependencyScanner
+	{
+	public:
+		static void Scan(const std::string& filename, AssetDependencies& dependencies);
+
+		static std::string Extension(const std::string& filename);
+		static std::string Directory(const std::string& filename);
+
+	private:
+		DependencyScanner();
+		DependencyScanner(const DependencyScanner& rhs);
+		DependencyScanner& operator=(const DependencyScanner& rhs);
+
+		static void ScanFile(const std::string& filename, AssetDependencies& dependencies);
+		static void ScanObj(const std::string& filename, AssetDependencies& dependencies);
+		static void ScanMtl(const std::string& filename, AssetDependencies& dependencies);
+		static void Scan3ds(const std::string& filename, AssetDependencies& dependencies);
+		static void ScanEffect(const std::string& filename, AssetDependencies& dependencies);
+	};
+}
@@ -0,0 +1,1202 @@
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <sstream>
+#include <fstream>
+#include <functional>
+#include <random>
+#include "Common.h"
+#include "Game.h"
+#include "GameException.h"
+#include "Model.h"
+#include "MeshFile.h"
+#include "DdsFile.h"
+#include "TextureCache.h"
+#include "TextureCompressor.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "VertexCompression.h"
+#include "ContentManifest.h"
+#include "OcclusionCuller.h"
+#include "Utility.h"
+#include "DependencyScanner.h"
+#include <d3dcompiler.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+using namespace Library;
+using namespace ContentCooker;
+
+namespace
+{
+	void PrintUsage()
+	{
+		std::cout << "Usage: ContentCooker [--flip-uvs] [--tangents] [--optimize] [--lods] [--texture-format F] [--mip-filter F] [--force] [--threads N] [--benchmark] [--fuzz N] [--occlusion-test] <content directory or file>..." << std::endl;
+		std::cout << "Cooks .3ds/.obj models into .mesh files, .fx effects into .cso files and images into block-compressed" << std::endl;
+		std::cout << ".dds files next to their sources, and" << std::endl;
+		std::cout << "writes ContentManifest.txt into each content directory so the runtime can find them. Only assets whose" << std::endl;
+		std::cout << "source, dependencies (.mtl, #include files) or cook settings changed since the last run are rebuilt." << std::endl;
+		std::cout << "--tangents adds MikkTSpace tangents and binormals to models that have normals and texture coordinates." << std::endl;
+		std::cout << "--optimize reorders triangles and vertices for the post-transform cache and reports ACMR/ATVR." << std::endl;
+		std::cout << "--lods adds simplified detail levels at 1/2, 1/4 and 1/8 of the triangles and reports their error." << std::endl;
+		std::cout << "--texture-format picks bc1, bc3 or bc7 for every image; auto (the default) uses bc1 for opaque images" << std::endl;
+		std::cout << "and bc3 for the rest. Images whose size isn't a multiple of 4 are used as-is." << std::endl;
+		std::cout << "--mip-filter builds the mip levels of cooked images with a kaiser (the default) or box filter." << std::endl;
+		std::cout << "--force recooks everything." << std::endl;
+		std::cout << "--threads cooks on N threads (default: one per hardware thread)." << std::endl;
+		std::cout << "--benchmark reports source import time per model through assimp and at 1..N threads instead of cooking." << std::endl;
+		std::cout << "--fuzz loads N mutated copies of each source model and reports how many loaded, were rejected or failed." << std::endl;
+		std::cout << "--occlusion-test rasterizes fixed scenes in the occlusion culler and compares each depth buffer with the" << std::endl;
+		std::cout << "reference .pgm in the given directory (ContentCooker\\OcclusionTests), with timings. --force rewrites the references." << std::endl;
+	}
+
+	enum AssetKind
+	{
+		AssetKindUnknown = 0,
+		AssetKindModel,
+		AssetKindEffect,
+		AssetKindTexture
+	};
+
+	struct CookSettings
+	{
+		bool FlipUVs;
+		bool GenerateTangents;
+		bool Optimize;
+		bool GenerateLods;
+		DXGI_FORMAT TextureFormat; // DXGI_FORMAT_UNKNOWN picks one per image.
+		MipFilter TextureMipFilter;
+		bool Force;
+	};
+
+	struct CookJob
+	{
+		std::string Source;
+		AssetKind Kind;
+		AssetDependencies Dependencies;
+		ContentManifestEntry Entry;
+		bool Cooked;
+		std::string Log;
+		std::string Error;
+	};
+
+	const UINT EffectCompileFlags = D3DCOMPILE_OPTIMIZATION_LEVEL3;
+
+	AssetKind GetAssetKind(const std::string& filename)
+	{
+		std::string extension = DependencyScanner::Extension(filename);
+		if (extension == ".3ds" || extension == ".obj")
+		{
+			return AssetKindModel;
+		}
+
+		if (extension == ".fx")
+		{
+			return AssetKindEffect;
+		}
+
+		if (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp" || extension == ".tga" || extension == ".dds")
+		{
+			return AssetKindTexture;
+		}
+
+		return AssetKindUnknown;
+	}
+
+	bool FileExists(const std::string& filename)
+	{
+		DWORD attributes = GetFileAttributesA(filename.c_str());
+
+		return (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0);
+	}
+
+	void CollectSources(const std::string& directory, std::vector<std::string>& sources)
+	{
+		WIN32_FIND_DATAA findData;
+		HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &findData);
+		if (find == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		do
+		{
+			std::string name(findData.cFileName);
+			if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+			{
+				if (name != "." && name != "..")
+				{
+					CollectSources(directory + "\\" + name, sources);
+				}
+			}
+			else if (GetAssetKind(name) != AssetKindUnknown)
+			{
+				sources.push_back(directory + "\\" + name);
+			}
+		} while (FindNextFileA(find, &findData));
+
+		FindClose(find);
+	}
+
+	// Runs body over [0, count) on the pool, or inline when there is none.
+	void ForEach(ThreadPool* threadPool, UINT count, const std::function<void(UINT)>& body)
+	{
+		if (threadPool != nullptr)
+		{
+			threadPool->ParallelFor(count, body);
+			return;
+		}
+
+		for (UINT i = 0; i < count; i++)
+		{
+			body(i);
+		}
+	}
+
+	const float LodTriangleRatios[] = { 0.5f, 0.25f, 0.125f };
+
+	std::string ArtifactFilename(const std::string& sourceFilename, AssetKind kind)
+	{
+		switch (kind)
+		{
+		case AssetKindModel:
+			return MeshFile::CookedFilename(sourceFilename);
+
+		case AssetKindEffect:
+			return sourceFilename.substr(0, sourceFilename.find_last_of('.')) + ".cso";
+
+		case AssetKindTexture:
+			// Already block-compressed images are used as-is.
+			return (DdsFile::IsDdsFile(sourceFilename) ? sourceFilename : DdsFile::CookedFilename(sourceFilename));
+
+		default:
+			return sourceFilename;
+		}
+	}
+
+	// Everything besides the files themselves that changes what a cook produces.
+	std::string SettingsKey(AssetKind kind, const CookSettings& settings)
+	{
+		std::ostringstream key;
+		switch (kind)
+		{
+		case AssetKindModel:
+			key << "model " << MeshFile::Version << " flipuvs " << settings.FlipUVs << " tangents " << settings.GenerateTangents << " optimize " << settings.Optimize << " lods " << settings.GenerateLods;
+			if (settings.GenerateLods)
+			{
+				for (float ratio : LodTriangleRatios)
+				{
+					key << " " << ratio;
+				}
+			}
+			break;
+
+		case AssetKindEffect:
+			key << "effect fx_5_0 " << EffectCompileFlags;
+			break;
+
+		default:
+			key << "texture " << settings.TextureFormat << " mips " << settings.TextureMipFilter << " srgb";
+			break;
+		}
+
+		return key.str();
+	}
+
+	std::string TextureFormatName(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+			return "BC1";
+
+		case DXGI_FORMAT_BC3_UNORM:
+			return "BC3";
+
+		case DXGI_FORMAT_BC7_UNORM:
+			return "BC7";
+
+		default:
+			return "auto";
+		}
+	}
+
+	// Returns false, leaving nothing behind, when the image can't be block-compressed and should
+	// be used as-is instead.
+	bool CookTexture(const std::string& sourceFilename, const std::string& cookedFilename, const CookSettings& settings, ThreadPool* threadPool, std::ostream& log)
+	{
+		DecodedImage image;
+		TextureCache::DecodeImage(Utility::ToWideString(sourceFilename), image);
+
+		// Direct3D 11 only creates block-compressed textures whose top level is whole blocks.
+		if (image.Width % 4 != 0 || image.Height % 4 != 0)
+		{
+			log << "  " << image.Width << "x" << image.Height << " isn't a multiple of 4, used as-is" << std::endl;
+			return false;
+		}
+
+		DXGI_FORMAT format = settings.TextureFormat;
+		if (format == DXGI_FORMAT_UNKNOWN)
+		{
+			format = TextureCompressor::ChooseFormat(&image.Pixels[0], image.Width, image.Height);
+		}
+
+		MipGenerator::Generate(&image.Pixels[0], image.Width, image.Height, settings.TextureMipFilter, true, image.MipLevels, threadPool);
+
+		std::vector<std::vector<byte>> levels(image.MipLevels.size() + 1);
+		for (UINT level = 0; level < levels.size(); level++)
+		{
+			const std::vector<byte>& pixels = (level == 0 ? image.Pixels : image.MipLevels[level - 1]);
+			TextureCompressor::Compress(&pixels[0], std::max(image.Width >> level, 1U), std::max(image.Height >> level, 1U), format, levels[level], threadPool);
+		}
+
+		DdsFile::Write(cookedFilename, format, image.Width, image.Height, levels);
+
+		size_t compressedSize = 0;
+		for (const std::vector<byte>& level : levels)
+		{
+			compressedSize += level.size();
+		}
+
+		size_t uncompressedSize = static_cast<size_t>(image.Width) * image.Height * 4;
+		uncompressedSize += uncompressedSize / 3;
+		log << "  " << TextureFormatName(format) << " " << image.Width << "x" << image.Height << ", " << levels.size() << " levels, "
+			<< uncompressedSize / 1024 << " KB -> " << compressedSize / 1024 << " KB (" << std::fixed << std::setprecision(1)
+			<< static_cast<double>(uncompressedSize) / compressedSize << ":1)" << std::endl;
+
+		return true;
+	}
+
+	void CookModel(Game& game, const std::string& sourceFilename, const std::string& cookedFilename, const CookSettings& settings, ThreadPool* threadPool, std::ostream& log)
+	{
+		UINT importFlags = (settings.FlipUVs ? MeshFileImportFlagsFlipUVs : MeshFileImportFlagsNone);
+		std::unique_ptr<Model> model(new Model(game, sourceFilename, settings.FlipUVs, threadPool, false));
+
+		// Cooked meshes carry meshlets for culling; the passes below keep them in step.
+		for (Mesh* mesh : model->Meshes())
+		{
+			mesh->BuildMeshlets();
+		}
+
+		// Before optimizing, which then orders the split vertices along with the rest.
+		if (settings.GenerateTangents)
+		{
+			for (Mesh* mesh : model->Meshes())
+			{
+				size_t vertexCount = mesh->Vertices().size();
+				if (mesh->GenerateTangents(threadPool))
+				{
+					log << "  " << mesh->Name() << ": tangents, " << (mesh->Vertices().size() - vertexCount) << " vertices split on mirrored seams" << std::endl;
+				}
+				else
+				{
+					log << "  " << mesh->Name() << ": no tangents, needs normals and texture coordinates" << std::endl;
+				}
+			}
+		}
+
+		if (settings.Optimize)
+		{
+			for (Mesh* mesh : model->Meshes())
+			{
+				MeshOptimizationReport report;
+				if (mesh->Optimize(&report))
+				{
+					log << "  " << mesh->Name() << std::fixed << std::setprecision(3)
+						<< ": ACMR " << report.Before.ACMR << " -> " << report.After.ACMR
+						<< ", ATVR " << report.Before.ATVR << " -> " << report.After.ATVR
+						<< " (cache size " << report.After.CacheSize << ", " << report.VerticesRemoved << " unused vertices dropped)" << std::endl;
+				}
+				else
+				{
+					log << "  " << mesh->Name() << ": skipped, not a triangle list" << std::endl;
+				}
+			}
+		}
+
+		if (settings.GenerateLods)
+		{
+			std::vector<float> ratios(LodTriangleRatios, LodTriangleRatios + _countof(LodTriangleRatios));
+			for (Mesh* mesh : model->Meshes())
+			{
+				if (mesh->GenerateLods(ratios) == false)
+				{
+					log << "  " << mesh->Name() << ": no LODs, not a triangle list" << std::endl;
+					continue;
+				}
+
+				log << "  " << mesh->Name() << ": LODs";
+				for (const MeshLod& lod : mesh->Lods())
+				{
+					log << " " << lod.IndexCount / 3 << " tris (error " << std::defaultfloat << std::setprecision(4) << lod.Error << ")";
+				}
+
+				log << std::endl;
+			}
+		}
+
+		// Report what the runtime's compressed vertex layouts would lose on this model.
+		for (Mesh* mesh : model->Meshes())
+		{
+			VertexCompressionReport report = VertexCompression::Measure(*mesh);
+			log << "  " << mesh->Name() << std::defaultfloat << std::setprecision(4)
+				<< ": quantization error position " << report.MaxPositionError
+				<< ", normal " << report.MaxNormalError << " deg"
+				<< ", tangent " << report.MaxTangentError << " deg"
+				<< ", uv " << report.MaxTextureCoordinateError << std::endl;
+		}
+
+		MeshFile::Write(*model, cookedFilename, importFlags);
+
+		log << "  " << model->Meshes().size() << " meshes" << std::endl;
+	}
+
+	void CookEffect(const std::string& sourceFilename, const std::string& compiledFilename)
+	{
+		ID3D10Blob* compiledShader = nullptr;
+		ID3D10Blob* errorMessages = nullptr;
+		HRESULT hr = D3DCompileFromFile(Utility::ToWideString(sourceFilename).c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, nullptr, "fx_5_0", EffectCompileFlags, 0, &compiledShader, &errorMessages);
+		if (FAILED(hr))
+		{
+			GameException ex((errorMessages != nullptr ? (char*)errorMessages->GetBufferPointer() : "D3DCompileFromFile() failed."), hr);
+			ReleaseObject(errorMessages);
+
+			throw ex;
+		}
+
+		ReleaseObject(errorMessages);
+
+		std::ofstream file(compiledFilename.c_str(), std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(compiledShader->GetBufferPointer()), compiledShader->GetBufferSize());
+		ReleaseObject(compiledShader);
+		if (!file)
+		{
+			throw GameException("Could not write compiled effect.");
+		}
+	}
+
+	// Hashes the job's source, inputs and settings, then cooks it unless the manifest already
+	// holds an artifact built from exactly that.
+	void RunCookJob(Game& game, ThreadPool* threadPool, const ContentManifest& manifest, const CookSettings& settings, CookJob& job)
+	{
+		std::string artifact = ArtifactFilename(job.Source, job.Kind);
+		std::string settingsKey = SettingsKey(job.Kind, settings);
+
+		unsigned long long hash = ContentManifest::Hash(settingsKey.data(), settingsKey.size());
+		hash = ContentManifest::HashFile(job.Source, hash);
+		for (const std::string& input : job.Dependencies.Inputs)
+		{
+			// Paths are hashed too, so an input appearing or disappearing changes the result.
+			std::string path = ContentManifest::NormalizePath(input);
+			hash = ContentManifest::Hash(path.data(), path.size(), hash);
+			if (FileExists(input))
+			{
+				hash = ContentManifest::HashFile(input, hash);
+			}
+		}
+
+		job.Entry.Source = manifest.RelativePath(job.Source);
+		job.Entry.Artifact = manifest.RelativePath(artifact);
+		job.Entry.Hash = hash;
+		job.Entry.SourceTime = ContentManifest::LastWriteTime(job.Source);
+		job.Entry.Dependencies.clear();
+		for (const std::string& input : job.Dependencies.Inputs)
+		{
+			job.Entry.Dependencies.push_back(manifest.RelativePath(input));
+		}
+
+		// The previous artifact may differ from the expected one when the cook fell back to the source.
+		const ContentManifestEntry* previous = manifest.Find(job.Source);
+		if (settings.Force == false && previous != nullptr && previous->Hash == hash && FileExists(manifest.Root() + previous->Artifact))
+		{
+			job.Entry.Artifact = previous->Artifact;
+			return;
+		}
+
+		std::ostringstream log;
+		switch (job.Kind)
+		{
+		case AssetKindModel:
+			CookModel(game, job.Source, artifact, settings, threadPool, log);
+			break;
+
+		case AssetKindEffect:
+			CookEffect(job.Source, artifact);
+			break;
+
+		case AssetKindTexture:
+			if (artifact != job.Source && CookTexture(job.Source, artifact, settings, threadPool, log) == false)
+			{
+				job.Entry.Artifact = job.Entry.Source;
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		job.Cooked = true;
+		job.Log = log.str();
+	}
+
+	// Cooks every asset under one content directory (or a single file) and updates the manifest
+	// that lives at its root. Returns the number of assets that failed.
+	int CookContent(Game& game, ThreadPool* threadPool, const std::string& input, const CookSettings& settings)
+	{
+		DWORD attributes = GetFileAttributesA(input.c_str());
+		if (attributes == INVALID_FILE_ATTRIBUTES)
+		{
+			throw GameException("Input path does not exist.");
+		}
+
+		bool isDirectory = ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+		std::string path = ContentManifest::CanonicalPath(input);
+		if (path.empty())
+		{
+			path = ".";
+		}
+		std::string root = (isDirectory ? path : DependencyScanner::Directory(path));
+
+		ContentManifest manifest(root);
+		try
+		{
+			manifest.Load();
+		}
+		catch (GameException& ex)
+		{
+			std::cerr << manifest.Root() << ContentManifest::Filename << ": " << ex.what() << ", rebuilding it" << std::endl;
+		}
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		std::vector<std::string> sources;
+		if (isDirectory)
+		{
+			CollectSources(path, sources);
+		}
+		else
+		{
+			sources.push_back(path);
+		}
+
+		std::vector<CookJob> jobs;
+		std::map<std::string, UINT> jobIndices;
+		for (const std::string& source : sources)
+		{
+			AssetKind kind = GetAssetKind(source);
+			if (kind != AssetKindUnknown && jobIndices.find(ContentManifest::NormalizePath(source)) == jobIndices.end())
+			{
+				CookJob job;
+				job.Source = source;
+				job.Kind = kind;
+				job.Cooked = false;
+				jobIndices[ContentManifest::NormalizePath(job.Source)] = static_cast<UINT>(jobs.size());
+				jobs.push_back(job);
+			}
+		}
+
+		// Scan dependencies, then pull in referenced assets (textures named by materials) that
+		// weren't found on their own, until nothing new turns up.
+		for (UINT scanned = 0; scanned < jobs.size();)
+		{
+			UINT first = scanned;
+			ForEach(threadPool, static_cast<UINT>(jobs.size()) - first, [&](UINT i)
+			{
+				CookJob& job = jobs[first + i];
+				try
+				{
+					DependencyScanner::Scan(job.Source, job.Dependencies);
+				}
+				catch (std::exception& ex)
+				{
+					job.Error = ex.what();
+				}
+			});
+
+			scanned = static_cast<UINT>(jobs.size());
+			for (UINT i = first; i < scanned; i++)
+			{
+				for (const std::string& referencePath : jobs[i].Dependencies.References)
+				{
+					std::string reference = ContentManifest::CanonicalPath(referencePath);
+					AssetKind kind = GetAssetKind(reference);
+					if (kind != AssetKindUnknown && FileExists(reference) && jobIndices.find(ContentManifest::NormalizePath(reference)) == jobIndices.end())
+					{
+						CookJob job;
+						job.Source = reference;
+						job.Kind = kind;
+						job.Cooked = false;
+						jobIndices[ContentManifest::NormalizePath(reference)] = static_cast<UINT>(jobs.size());
+						jobs.push_back(job);
+					}
+				}
+			}
+		}
+
+		// .dds files written by an earlier run are artifacts, not sources of their own.
+		std::map<std::string, UINT> cookedTextures;
+		for (UINT i = 0; i < jobs.size(); i++)
+		{
+			if (jobs[i].Kind == AssetKindTexture && DdsFile::IsDdsFile(jobs[i].Source) == false)
+			{
+				cookedTextures[ContentManifest::NormalizePath(ArtifactFilename(jobs[i].Source, jobs[i].Kind))] = i;
+			}
+		}
+
+		for (std::vector<CookJob>::iterator it = jobs.begin(); it != jobs.end();)
+		{
+			if (it->Kind == AssetKindTexture && cookedTextures.find(ContentManifest::NormalizePath(it->Source)) != cookedTextures.end())
+			{
+				manifest.Remove(it->Source);
+				it = jobs.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		ForEach(threadPool, static_cast<UINT>(jobs.size()), [&](UINT i)
+		{
+			CookJob& job = jobs[i];
+			if (job.Error.empty() == false)
+			{
+				return;
+			}
+
+			try
+			{
+				RunCookJob(game, threadPool, manifest, settings, job);
+			}
+			catch (std::exception& ex)
+			{
+				job.Error = ex.what();
+			}
+		});
+
+		int failures = 0;
+		UINT cooked = 0;
+		for (const CookJob& job : jobs)
+		{
+			if (job.Error.empty() == false)
+			{
+				std::cerr << job.Source << ": " << job.Error << std::endl;
+				failures++;
+				continue;
+			}
+
+			if (job.Cooked)
+			{
+				std::cout << "Cooked: " << job.Source << " -> " << manifest.Root() << job.Entry.Artifact << std::endl << job.Log;
+				cooked++;
+			}
+
+			manifest.Add(job.Entry);
+		}
+
+		// Forget assets that have been deleted since the last run.
+		if (isDirectory)
+		{
+			std::vector<std::string> removed;
+			for (const std::pair<std::string, ContentManifestEntry>& entry : manifest.Entries())
+			{
+				if (FileExists(manifest.Root() + entry.second.Source) == false)
+				{
+					removed.push_back(entry.first);
+				}
+			}
+
+			for (const std::string& source : removed)
+			{
+				manifest.Remove(source);
+			}
+		}
+
+		manifest.Save();
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		std::cout << manifest.Root() << ": " << cooked << " cooked, " << (jobs.size() - cooked - failures) << " up to date, " << failures << " failed in "
+			<< std::fixed << std::setprecision(1) << elapsed.count() << " ms" << std::endl;
+
+		return failures;
+	}
+
+	void BenchmarkModel(Game& game, const std::string& sourceFilename, bool flipUVs, UINT maxThreads)
+	{
+		const UINT iterations = 5;
+
+		std::cout << sourceFilename << std::endl;
+
+		// The same file through assimp with Model's import flags, as a baseline for the native readers.
+		UINT flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_FlipWindingOrder;
+		if (flipUVs)
+		{
+			flags |= aiProcess_FlipUVs;
+		}
+
+		double assimpBest = 0.0;
+		UINT assimpMeshCount = 0;
+		for (UINT i = 0; i < iterations; i++)
+		{
+			Assimp::Importer importer;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			const aiScene* scene = importer.ReadFile(sourceFilename, flags);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			if (scene == nullptr)
+			{
+				throw GameException(importer.GetErrorString());
+			}
+
+			assimpMeshCount = scene->mNumMeshes;
+			if (i == 0 || elapsed.count() < assimpBest)
+			{
+				assimpBest = elapsed.count();
+			}
+		}
+
+		std::cout << "      assimp: " << std::fixed << std::setprecision(3) << assimpBest << " ms (best of " << iterations << ", " << assimpMeshCount << " meshes)" << std::endl;
+
+		for (UINT threads = 1; threads <= maxThreads; threads++)
+		{
+			// The calling thread takes part in ParallelFor, so N threads means N - 1 workers.
+			std::unique_ptr<ThreadPool> threadPool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+
+			double best = 0.0;
+			size_t meshCount = 0;
+			for (UINT i = 0; i < iterations; i++)
+			{
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				std::unique_ptr<Model> model(new Model(game, sourceFilename, flipUVs, threadPool.get(), false));
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+				meshCount = model->Meshes().size();
+				if (i == 0 || elapsed.count() < best)
+				{
+					best = elapsed.count();
+				}
+			}
+
+			std::cout << "  " << std::setw(2) << threads << " thread(s): " << std::fixed << std::setprecision(3) << best << " ms (best of " << iterations << ", " << meshCount << " meshes)" << std::endl;
+		}
+	}
+
+	// Loads mutated copies of a source model the way the game would and counts how each ended:
+	// loaded, rejected with a GameException, or failed with anything else. Every mutation is
+	// written to the same temp file first, so one that brings the process down is left behind.
+	bool FuzzModel(Game& game, const std::string& sourceFilename, bool flipUVs, UINT iterations)
+	{
+		std::ifstream sourceFile(sourceFilename.c_str(), std::ios::binary);
+		std::vector<char> source((std::istreambuf_iterator<char>(sourceFile)), std::istreambuf_iterator<char>());
+		if (source.size() < sizeof(UINT))
+		{
+			throw GameException("Model is too small to fuzz.");
+		}
+
+		char tempDirectory[MAX_PATH];
+		if (GetTempPathA(MAX_PATH, tempDirectory) == 0)
+		{
+			throw GameException("GetTempPathA() failed.");
+		}
+
+		std::string fuzzFilename = std::string(tempDirectory) + "ContentCookerFuzz" + sourceFilename.substr(sourceFilename.find_last_of('.'));
+		std::cout << sourceFilename << " (mutations go to " << fuzzFilename << ")" << std::endl;
+
+		UINT loaded = 0;
+		UINT rejected = 0;
+		UINT failed = 0;
+		double totalTime = 0.0;
+		for (UINT iteration = 0; iteration < iterations; iteration++)
+		{
+			// Seeded by iteration so a reported failure can be regenerated.
+			std::mt19937 random(iteration);
+			std::vector<char> mutated(source);
+			switch (random() % 3)
+			{
+			case 0:
+			{
+				UINT flips = 1 + random() % 8;
+				for (UINT i = 0; i < flips; i++)
+				{
+					mutated[random() % mutated.size()] ^= static_cast<char>(1 << (random() % 8));
+				}
+				break;
+			}
+
+			case 1:
+			{
+				// Lengths and counts are what a reader trusts most, so overwrite a word with an extreme.
+				const UINT values[] = { 0, 1, 6, 0xFFFF, 0xFFFFFFFF, static_cast<UINT>(source.size()), static_cast<UINT>(random()) };
+				UINT value = values[random() % _countof(values)];
+				memcpy(&mutated[random() % (mutated.size() - sizeof(UINT) + 1)], &value, sizeof(value));
+				break;
+			}
+
+			default:
+				mutated.resize(random() % mutated.size());
+				break;
+			}
+
+			{
+				std::ofstream fuzzFile(fuzzFilename.c_str(), std::ios::binary | std::ios::trunc);
+				fuzzFile.write(mutated.data(), mutated.size());
+			}
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			try
+			{
+				std::unique_ptr<Model> model(new Model(game, fuzzFilename, flipUVs, nullptr, false));
+				loaded++;
+			}
+			catch (GameException&)
+			{
+				rejected++;
+			}
+			catch (std::exception& ex)
+			{
+				std::cout << "  mutation " << iteration << " failed: " << ex.what() << std::endl;
+				failed++;
+			}
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			totalTime += elapsed.count();
+		}
+
+		DeleteFileA(fuzzFilename.c_str());
+
+		std::cout << "  " << iterations << " mutations: " << loaded << " loaded, " << rejected << " rejected, " << failed << " failed, "
+			<< std::fixed << std::setprecision(3) << (totalTime / iterations) << " ms average" << std::endl;
+
+		return (failed == 0);
+	}
+
+	struct OcclusionTestBox
+	{
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+		bool Visible;
+	};
+
+	struct OcclusionTestOccluder
+	{
+		const OccluderMesh* Mesh;
+		XMFLOAT4X4 WorldMatrix;
+	};
+
+	// A fixed camera, occluders and boxes whose visibility is known by construction.
+	struct OcclusionTestScene
+	{
+		std::string Name;
+		XMFLOAT3 Eye;
+		XMFLOAT3 Target;
+		std::vector<OcclusionTestOccluder> Occluders;
+		std::vector<OcclusionTestBox> Boxes;
+	};
+
+	// A closed cube spanning [-1, 1] on every axis.
+	void BuildTestCube(OccluderMesh& mesh)
+	{
+		for (UINT i = 0; i < 8; i++)
+		{
+			mesh.Vertices.push_back(XMFLOAT3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f));
+		}
+
+		const UINT indices[] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+		mesh.Indices.assign(indices, indices + _countof(indices));
+	}
+
+	// cells x cells quads spanning [-1, 1] on x and z, facing +y.
+	void BuildTestGrid(UINT cells, OccluderMesh& mesh)
+	{
+		for (UINT z = 0; z <= cells; z++)
+		{
+			for (UINT x = 0; x <= cells; x++)
+			{
+				mesh.Vertices.push_back(XMFLOAT3(2.0f * x / cells - 1.0f, 0.0f, 2.0f * z / cells - 1.0f));
+			}
+		}
+
+		for (UINT z = 0; z < cells; z++)
+		{
+			for (UINT x = 0; x < cells; x++)
+			{
+				UINT corner = z * (cells + 1) + x;
+				const UINT quad[] = { corner, corner + cells + 1, corner + 1, corner + 1, corner + cells + 1, corner + cells + 2 };
+				mesh.Indices.insert(mesh.Indices.end(), quad, quad + _countof(quad));
+			}
+		}
+	}
+
+	void AddTestOccluder(OcclusionTestScene& scene, const OccluderMesh& mesh, CXMMATRIX worldMatrix)
+	{
+		OcclusionTestOccluder occluder;
+		occluder.Mesh = &mesh;
+		XMStoreFloat4x4(&occluder.WorldMatrix, worldMatrix);
+		scene.Occluders.push_back(occluder);
+	}
+
+	void AddTestBox(OcclusionTestScene& scene, const XMFLOAT3& center, float extent, bool visible)
+	{
+		OcclusionTestBox box = { center, XMFLOAT3(extent, extent, extent), visible };
+		scene.Boxes.push_back(box);
+	}
+
+	void BuildOcclusionTestScenes(const OccluderMesh& cube, const OccluderMesh& wall, const OccluderMesh& floor, std::vector<OcclusionTestScene>& scenes)
+	{
+		scenes.resize(3);
+
+		// One wall straight ahead: hidden behind it, in front of it, across its edge and beside it
+		OcclusionTestScene& wallScene = scenes[0];
+		wallScene.Name = "wall";
+		wallScene.Eye = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		wallScene.Target = XMFLOAT3(0.0f, 0.0f, -1.0f);
+		AddTestOccluder(wallScene, wall, XMMatrixRotationX(XM_PIDIV2) * XMMatrixScaling(4.0f, 4.0f, 1.0f) * XMMatrixTranslation(0.0f, 0.0f, -10.0f));
+		AddTestBox(wallScene, XMFLOAT3(0.0f, 0.0f, -20.0f), 1.0f, false);
+		AddTestBox(wallScene, XMFLOAT3(0.0f, 3.0f, -12.0f), 0.5f, false);
+		AddTestBox(wallScene, XMFLOAT3(0.0f, 0.0f, -5.0f), 1.0f, true);
+		AddTestBox(wallScene, XMFLOAT3(8.0f, 0.0f, -20.0f), 1.0f, true);
+		AddTestBox(wallScene, XMFLOAT3(12.0f, 0.0f, -20.0f), 1.0f, true);
+
+		// Two cubes with a gap between them and a beam below
+		OcclusionTestScene& cubeScene = scenes[1];
+		cubeScene.Name = "cubes";
+		cubeScene.Eye = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		cubeScene.Target = XMFLOAT3(0.0f, 0.0f, -1.0f);
+		AddTestOccluder(cubeScene, cube, XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(-3.0f, 0.0f, -10.0f));
+		AddTestOccluder(cubeScene, cube, XMMatrixScaling(2.0f, 2.0f, 2.0f) * XMMatrixTranslation(3.0f, 0.0f, -10.0f));
+		AddTestOccluder(cubeScene, cube, XMMatrixScaling(4.0f, 1.0f, 1.0f) * XMMatrixTranslation(0.0f, -3.0f, -12.0f));
+		AddTestBox(cubeScene, XMFLOAT3(-6.0f, 0.0f, -20.0f), 1.0f, false);
+		AddTestBox(cubeScene, XMFLOAT3(6.0f, 0.0f, -20.0f), 1.0f, false);
+		AddTestBox(cubeScene, XMFLOAT3(0.0f, -6.0f, -24.0f), 1.0f, false);
+		AddTestBox(cubeScene, XMFLOAT3(0.0f, 0.0f, -20.0f), 1.0f, true);
+		AddTestBox(cubeScene, XMFLOAT3(3.0f, 0.0f, -6.0f), 0.5f, true);
+
+		// A floor seen at a grazing angle that reaches behind the eye, and a wall standing on it
+		OcclusionTestScene& floorScene = scenes[2];
+		floorScene.Name = "floor";
+		floorScene.Eye = XMFLOAT3(0.0f, 2.0f, 0.0f);
+		floorScene.Target = XMFLOAT3(0.0f, 0.0f, -20.0f);
+		AddTestOccluder(floorScene, floor, XMMatrixScaling(50.0f, 1.0f, 55.0f) * XMMatrixTranslation(0.0f, 0.0f, -45.0f));
+		AddTestOccluder(floorScene, wall, XMMatrixRotationX(XM_PIDIV2) * XMMatrixScaling(10.0f, 3.0f, 1.0f) * XMMatrixTranslation(0.0f, 3.0f, -30.0f));
+		AddTestBox(floorScene, XMFLOAT3(0.0f, -2.0f, -20.0f), 1.0f, false);
+		AddTestBox(floorScene, XMFLOAT3(0.0f, 2.0f, -40.0f), 1.0f, false);
+		AddTestBox(floorScene, XMFLOAT3(0.0f, 1.0f, -20.0f), 1.0f, true);
+		AddTestBox(floorScene, XMFLOAT3(0.0f, 10.0f, -40.0f), 1.0f, true);
+	}
+
+	std::vector<char> ReadWholeFile(const std::string& filename)
+	{
+		std::ifstream file(filename.c_str(), std::ios::binary);
+
+		return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	// Rasterizes each fixed scene, checks every box against its known visibility and compares the
+	// depth buffer with <name>.pgm under referenceDirectory. Pixels may be off by one gray level, and
+	// a few may differ along triangle edges where compilers round differently. A mismatch leaves
+	// <name>.actual.pgm next to the reference; a missing reference (or --force) writes a new one.
+	// Returns the number of scenes that failed.
+	int RunOcclusionTests(const std::string& referenceDirectory, UINT maxThreads, bool updateReferences)
+	{
+		const UINT iterations = 20;
+
+		// Depth images map 1/w to gray on this fixed scale: white at this distance or nearer, black
+		// at infinity. Only the floor comes nearer than this, so no other occluder saturates.
+		const float imageWhiteDistance = 4.0f;
+
+		OccluderMesh cube;
+		OccluderMesh wall;
+		OccluderMesh floor;
+		BuildTestCube(cube);
+		BuildTestGrid(1, wall);
+		BuildTestGrid(10, floor);
+
+		std::vector<OcclusionTestScene> scenes;
+		BuildOcclusionTestScenes(cube, wall, floor, scenes);
+
+		// The calling thread takes part in ParallelFor, so N threads means N - 1 workers.
+		ThreadPool threadPool(maxThreads - 1);
+		OcclusionCuller culler(threadPool);
+
+		int failures = 0;
+		for (const OcclusionTestScene& scene : scenes)
+		{
+			XMMATRIX view = XMMatrixLookAtRH(XMLoadFloat3(&scene.Eye), XMLoadFloat3(&scene.Target), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+			XMMATRIX projection = XMMatrixPerspectiveFovRH(XM_PIDIV4, static_cast<float>(culler.Width()) / culler.Height(), 0.5f, 1000.0f);
+			XMMATRIX viewProjection = XMMatrixMultiply(view, projection);
+
+			double rasterizeBest = 0.0;
+			double testBest = 0.0;
+			UINT wrongBoxes = 0;
+			for (UINT i = 0; i < iterations; i++)
+			{
+				for (const OcclusionTestOccluder& occluder : scene.Occluders)
+				{
+					culler.AddOccluder(*occluder.Mesh, XMLoadFloat4x4(&occluder.WorldMatrix));
+				}
+
+				culler.Rasterize(viewProjection);
+
+				wrongBoxes = 0;
+				for (const OcclusionTestBox& box : scene.Boxes)
+				{
+					if (culler.IsVisible(BoundingBox(box.Center, box.Extents)) != box.Visible)
+					{
+						wrongBoxes++;
+					}
+				}
+
+				const OcclusionCullerStatistics& statistics = culler.Statistics();
+				if (i == 0 || statistics.RasterizeMilliseconds < rasterizeBest)
+				{
+					rasterizeBest = statistics.RasterizeMilliseconds;
+				}
+
+				if (i == 0 || statistics.TestMilliseconds < testBest)
+				{
+					testBest = statistics.TestMilliseconds;
+				}
+			}
+
+			std::string referenceFilename = referenceDirectory + "\\" + scene.Name + ".pgm";
+			std::string actualFilename = referenceDirectory + "\\" + scene.Name + ".actual.pgm";
+			std::ostringstream result;
+			bool failed = (wrongBoxes > 0);
+			if (updateReferences || FileExists(referenceFilename) == false)
+			{
+				culler.WriteDepthImage(referenceFilename, imageWhiteDistance);
+				result << "reference written";
+			}
+			else
+			{
+				culler.WriteDepthImage(actualFilename, imageWhiteDistance);
+				std::vector<char> reference = ReadWholeFile(referenceFilename);
+				std::vector<char> actual = ReadWholeFile(actualFilename);
+
+				size_t pixelCount = culler.Width() * culler.Height();
+				size_t headerSize = actual.size() - pixelCount;
+				UINT differences = 0;
+				if (reference.size() != actual.size() || memcmp(&reference[0], &actual[0], headerSize) != 0)
+				{
+					differences = static_cast<UINT>(pixelCount);
+				}
+				else
+				{
+					for (size_t i = headerSize; i < actual.size(); i++)
+					{
+						if (abs(static_cast<int>(static_cast<unsigned char>(actual[i])) - static_cast<int>(static_cast<unsigned char>(reference[i]))) > 1)
+						{
+							differences++;
+						}
+					}
+				}
+
+				if (differences > pixelCount / 1000)
+				{
+					failed = true;
+				}
+				else
+				{
+					DeleteFileA(actualFilename.c_str());
+				}
+
+				result << differences << " of " << pixelCount << " pixels differ";
+			}
+
+			const OcclusionCullerStatistics& statistics = culler.Statistics();
+			std::cout << (failed ? "FAILED " : "passed ") << scene.Name << ": " << statistics.Occluders << " occluders, " << statistics.Triangles << " triangles, "
+				<< (scene.Boxes.size() - wrongBoxes) << "/" << scene.Boxes.size() << " boxes right, " << result.str() << std::endl;
+			std::cout << "  rasterize " << std::fixed << std::setprecision(3) << rasterizeBest << " ms, " << scene.Boxes.size() << " tests " << std::setprecision(4) << testBest
+				<< " ms (best of " << iterations << ", " << statistics.BatchWidth << " pixels per step)" << std::endl;
+
+			if (failed)
+			{
+				failures++;
+			}
+		}
+
+		return failures;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	bool flipUVs = false;
+	bool generateTangents = false;
+	bool benchmark = false;
+	bool optimize = false;
+	bool generateLods = false;
+	bool force = false;
+	DXGI_FORMAT textureFormat = DXGI_FORMAT_UNKNOWN;
+	MipFilter mipFilter = MipFilterKaiser;
+	bool validArguments = true;
+	UINT fuzzIterations = 0;
+	bool occlusionTest = false;
+	UINT maxThreads = (std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1);
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument(argv[i]);
+		if (argument == "--flip-uvs")
+		{
+			flipUVs = true;
+		}
+		else if (argument == "--tangents")
+		{
+			generateTangents = true;
+		}
+		else if (argument == "--optimize")
+		{
+			optimize = true;
+		}
+		else if (argument == "--lods")
+		{
+			generateLods = true;
+		}
+		else if (argument == "--force")
+		{
+			force = true;
+		}
+		else if (argument == "--texture-format" && i + 1 < argc)
+		{
+			std::string format(argv[++i]);
+			std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+			if (format == "bc1")
+			{
+				textureFormat = DXGI_FORMAT_BC1_UNORM;
+			}
+			else if (format == "bc3")
+			{
+				textureFormat = DXGI_FORMAT_BC3_UNORM;
+			}
+			else if (format == "bc7")
+			{
+				textureFormat = DXGI_FORMAT_BC7_UNORM;
+			}
+			else if (format != "auto")
+			{
+				validArguments = false;
+			}
+		}
+		else if (argument == "--mip-filter" && i + 1 < argc)
+		{
+			std::string filter(argv[++i]);
+			std::transform(filter.begin(), filter.end(), filter.begin(), ::tolower);
+			if (filter == "box")
+			{
+				mipFilter = MipFilterBox;
+			}
+			else if (filter != "kaiser")
+			{
+				validArguments = false;
+			}
+		}
+		else if (argument == "--benchmark")
+		{
+			benchmark = true;
+		}
+		else if (argument == "--fuzz" && i + 1 < argc)
+		{
+			fuzzIterations = static_cast<UINT>(atoi(argv[++i]));
+		}
+		else if (argument == "--occlusion-test")
+		{
+			occlusionTest = true;
+		}
+		else if (argument == "--threads" && i + 1 < argc)
+		{
+			maxThreads = static_cast<UINT>(atoi(argv[++i]));
+		}
+		else
+		{
+			inputs.push_back(argument);
+		}
+	}
+
+	if (inputs.size() == 0 || maxThreads == 0 || validArguments == false)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	CookSettings settings;
+	settings.FlipUVs = flipUVs;
+	settings.GenerateTangents = generateTangents;
+	settings.Optimize = optimize;
+	settings.GenerateLods = generateLods;
+	settings.TextureFormat = textureFormat;
+	settings.TextureMipFilter = mipFilter;
+	settings.Force = force;
+
+	// Model only needs a Game for GPU resource creation, which the cooker never does.
+	Game game(GetModuleHandle(nullptr), L"ContentCooker", L"ContentCooker", SW_HIDE);
+
+	// The calling thread takes part in ParallelFor, so N threads means N - 1 workers.
+	bool cook = (benchmark == false && fuzzIterations == 0 && occlusionTest == false);
+	std::unique_ptr<ThreadPool> threadPool(maxThreads > 1 && cook ? new ThreadPool(maxThreads - 1) : nullptr);
+
+	int failures = 0;
+	for (const std::string& input : inputs)
+	{
+		try
+		{
+			if (occlusionTest)
+			{
+				failures += RunOcclusionTests(input, maxThreads, force);
+			}
+			else if (cook == false)
+			{
+				DWORD attributes = GetFileAttributesA(input.c_str());
+				if (attributes == INVALID_FILE_ATTRIBUTES)
+				{
+					throw GameException("Input path does not exist.");
+				}
+
+				std::vector<std::string> sources;
+				if ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+				{
+					CollectSources(input, sources);
+				}
+				else
+				{
+					sources.push_back(input);
+				}
+
+				for (const std::string& source : sources)
+				{
+					if (GetAssetKind(source) != AssetKindModel)
+					{
+						continue;
+					}
+
+					if (benchmark)
+					{
+						BenchmarkModel(game, source, flipUVs, maxThreads);
+					}
+
+					if (fuzzIterations > 0 && FuzzModel(game, source, flipUVs, fuzzIterations) == false)
+					{
+						failures++;
+					}
+				}
+			}
+			else
+			{
+				failures += CookContent(game, threadPool.get(), input, settings);
+			}
+		}
+		catch (GameException& ex)
+		{
+			std::cerr << input << ": " << ex.what() << std::endl;
+			failures++;
+		}
+	}
+
+	return (failures > 0 ? 1 : 0);
+}
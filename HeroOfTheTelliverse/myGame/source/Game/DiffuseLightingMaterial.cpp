@@ -1,19 +1,26 @@
 #include "DiffuseLightingMaterial.h"
 #include "GameException.h"
 #include "Mesh.h"
+#include "VertexCompression.h"
 
 namespace Rendering
 {
     RTTI_DEFINITIONS(DiffuseLightingMaterial)
 
-    DiffuseLightingMaterial::DiffuseLightingMaterial()
-        : Material("main11"),
+    DiffuseLightingMaterial::DiffuseLightingMaterial(bool compressedVertices)
+        : Material(compressedVertices ? "compressed11" : "main11"),
           MATERIAL_VARIABLE_INITIALIZATION(WorldViewProjection), MATERIAL_VARIABLE_INITIALIZATION(World),
           MATERIAL_VARIABLE_INITIALIZATION(AmbientColor), MATERIAL_VARIABLE_INITIALIZATION(LightColor),
-          MATERIAL_VARIABLE_INITIALIZATION(LightDirection), MATERIAL_VARIABLE_INITIALIZATION(ColorTexture)
+          MATERIAL_VARIABLE_INITIALIZATION(LightDirection), MATERIAL_VARIABLE_INITIALIZATION(ColorTexture),
+          mCompressedVertices(compressedVertices)
     {
     }
 
+    bool DiffuseLightingMaterial::CompressedVertices() const
+    {
+        return mCompressedVertices;
+    }
+
     MATERIAL_VARIABLE_DEFINITION(DiffuseLightingMaterial, WorldViewProjection)
     MATERIAL_VARIABLE_DEFINITION(DiffuseLightingMaterial, World)
     MATERIAL_VARIABLE_DEFINITION(DiffuseLightingMaterial, AmbientColor)
@@ -40,22 +47,47 @@ namespace Rendering
         };
 
         CreateInputLayout("main11", "p0", inputElementDescriptions, ARRAYSIZE(inputElementDescriptions));
+
+        D3D11_INPUT_ELEMENT_DESC compressedInputElementDescriptions[] =
+        {
+            { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+        };
+
+        CreateInputLayout("compressed11", "p0", compressedInputElementDescriptions, ARRAYSIZE(compressedInputElementDescriptions));
     }
 
     void DiffuseLightingMaterial::CreateVertexBuffer(ID3D11Device* device, const Mesh& mesh, ID3D11Buffer** vertexBuffer) const
     {
-        const std::vector<XMFLOAT3>& sourceVertices = mesh.Vertices();
-        std::vector<XMFLOAT3>* textureCoordinates = mesh.TextureCoordinates().at(0);
-        assert(textureCoordinates->size() == sourceVertices.size());
-        const std::vector<XMFLOAT3>& normals = mesh.Normals();
-        assert(textureCoordinates->size() == sourceVertices.size());
+        ArraySpan<const XMFLOAT3> sourceVertices = mesh.Vertices();
+        ArraySpan<const XMFLOAT3> textureCoordinates = mesh.TextureCoordinates().at(0);
+        assert(textureCoordinates.size() == sourceVertices.size());
+        ArraySpan<const XMFLOAT3> normals = mesh.Normals();
+        assert(textureCoordinates.size() == sourceVertices.size());
+
+        if (mCompressedVertices)
+        {
+            VertexQuantization quantization = VertexCompression::ComputeQuantization(mesh);
+
+            std::vector<DiffuseLightingMaterialCompressedVertex> vertices;
+            vertices.reserve(sourceVertices.size());
+            for (UINT i = 0; i < sourceVertices.size(); i++)
+            {
+                vertices.push_back(DiffuseLightingMaterialCompressedVertex(VertexCompression::EncodePosition(sourceVertices.at(i), quantization),
+                    VertexCompression::EncodeTextureCoordinate(textureCoordinates.at(i)), VertexCompression::EncodeDirection(normals.at(i))));
+            }
+
+            CreateVertexBuffer(device, &vertices[0], vertices.size(), vertexBuffer);
+            return;
+        }
 
         std::vector<DiffuseLightingMaterialVertex> vertices;
         vertices.reserve(sourceVertices.size());
         for (UINT i = 0; i < sourceVertices.size(); i++)
         {
             XMFLOAT3 position = sourceVertices.at(i);
-            XMFLOAT3 uv = textureCoordinates->at(i);
+            XMFLOAT3 uv = textureCoordinates.at(i);
             XMFLOAT3 normal = normals.at(i);
             vertices.push_back(DiffuseLightingMaterialVertex(XMFLOAT4(position.x, position.y, position.z, 1.0f), XMFLOAT2(uv.x, uv.y), normal));
         }
@@ -64,6 +96,23 @@ namespace Rendering
     }
 
     void DiffuseLightingMaterial::CreateVertexBuffer(ID3D11Device* device, DiffuseLightingMaterialVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const
+    {
+        assert(mCompressedVertices == false);
+        CreateBuffer(device, vertices, vertexCount, vertexBuffer);
+    }
+
+    void DiffuseLightingMaterial::CreateVertexBuffer(ID3D11Device* device, DiffuseLightingMaterialCompressedVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const
+    {
+        assert(mCompressedVertices);
+        CreateBuffer(device, vertices, vertexCount, vertexBuffer);
+    }
+
+    UINT DiffuseLightingMaterial::VertexSize() const
+    {
+        return (mCompressedVertices ? sizeof(DiffuseLightingMaterialCompressedVertex) : sizeof(DiffuseLightingMaterialVertex));
+    }
+
+    void DiffuseLightingMaterial::CreateBuffer(ID3D11Device* device, const void* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const
     {
         D3D11_BUFFER_DESC vertexBufferDesc;
         ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
@@ -79,9 +128,4 @@ namespace Rendering
             throw GameException("ID3D11Device::CreateBuffer() failed.");
         }
     }
-
-    UINT DiffuseLightingMaterial::VertexSize() const
-    {
-        return sizeof(DiffuseLightingMaterialVertex);
-    }
 }
\ No newline at end of file
@@ -19,6 +19,18 @@ namespace Rendering
             : Position(position), TextureCoordinates(textureCoordinates), Normal(normal) { }
     } DiffuseLightingMaterialVertex;
 
+    typedef struct _DiffuseLightingMaterialCompressedVertex
+    {
+        XMSHORTN4 Position;
+        XMHALF2 TextureCoordinates;
+        XMSHORTN2 Normal;
+
+        _DiffuseLightingMaterialCompressedVertex() { }
+
+        _DiffuseLightingMaterialCompressedVertex(XMSHORTN4 position, XMHALF2 textureCoordinates, XMSHORTN2 normal)
+            : Position(position), TextureCoordinates(textureCoordinates), Normal(normal) { }
+    } DiffuseLightingMaterialCompressedVertex;
+
     class DiffuseLightingMaterial : public Material
     {
         RTTI_DECLARATIONS(DiffuseLightingMaterial, Material)
@@ -31,12 +43,20 @@ namespace Rendering
         MATERIAL_VARIABLE_DECLARATION(ColorTexture)
 
     public:
-        DiffuseLightingMaterial();		
+        DiffuseLightingMaterial(bool compressedVertices = false);
+
+        bool CompressedVertices() const;
 
         virtual void Initialize(Effect* effect) override;
         virtual void CreateVertexBuffer(ID3D11Device* device, const Mesh& mesh, ID3D11Buffer** vertexBuffer) const override;
         void CreateVertexBuffer(ID3D11Device* device, DiffuseLightingMaterialVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const;
+        void CreateVertexBuffer(ID3D11Device* device, DiffuseLightingMaterialCompressedVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const;
         virtual UINT VertexSize() const override;
+
+    private:
+        void CreateBuffer(ID3D11Device* device, const void* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const;
+
+        bool mCompressedVertices;
     };
 }
 
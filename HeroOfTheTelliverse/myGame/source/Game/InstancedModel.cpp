@@ -0,0 +1,336 @@
+#include "InstancedModel.h"
+#include "ModelFromFile.h"
+#include "Game.h"
+#include "GameException.h"
+#include "MatrixHelper.h"
+#include "Camera.h"
+#include "Utility.h"
+#include "Effect.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "ModelCache.h"
+#include "AssetLoader.h"
+#include "VertexCompression.h"
+#include "RenderQueue.h"
+#include "FrustumCuller.h"
+#include "AabbTree.h"
+#include "OcclusionCuller.h"
+#include <algorithm>
+
+namespace Rendering
+{
+	RTTI_DEFINITIONS(InstancedModel)
+
+	namespace
+	{
+		const std::string InstancedTextureMappingPassName = "TextureMapping.fx main11_instanced p0 TextureMappingVertex";
+	}
+
+	InstancedModel::InstancedModel(Game& game, Camera& camera, const std::string& modelFilename, const std::wstring& texturePath)
+		: DrawableGameComponent(game, camera),
+		mEffect(nullptr), mTechnique(nullptr), mPass(nullptr), mColorTextureVariable(nullptr), mInputLayout(nullptr), mRenderQueue(nullptr), mRenderPass(nullptr), mFrustumCuller(nullptr), mCullId(0), mSceneTree(nullptr), mSceneProxy(AabbTree::NullNode), mOcclusionCuller(nullptr),
+		mAssetLoader(nullptr), mModelHandle(), mTextureHandle(), mModelBuffer(), mModelFilename(modelFilename), mTexturePath(texturePath),
+		mWorldMatrices(), mInstanceData(), mDequantizationMatrix(MatrixHelper::Identity), mBoundingBox(), mInstanceBounds(), mBoundsDirty(false), mInstanceBuffer(nullptr), mInstanceCapacity(0), mDirtyFirst(0), mDirtyLast(0)
+	{
+	}
+
+	InstancedModel::InstancedModel(Game& game, Camera& camera, const std::string& modelFilename, const std::wstring& texturePath, const std::vector<XMFLOAT4X4>& worldMatrices)
+		: DrawableGameComponent(game, camera),
+		mEffect(nullptr), mTechnique(nullptr), mPass(nullptr), mColorTextureVariable(nullptr), mInputLayout(nullptr), mRenderQueue(nullptr), mRenderPass(nullptr), mFrustumCuller(nullptr), mCullId(0), mSceneTree(nullptr), mSceneProxy(AabbTree::NullNode), mOcclusionCuller(nullptr),
+		mAssetLoader(nullptr), mModelHandle(), mTextureHandle(), mModelBuffer(), mModelFilename(modelFilename), mTexturePath(texturePath),
+		mWorldMatrices(worldMatrices), mInstanceData(), mDequantizationMatrix(MatrixHelper::Identity), mBoundingBox(), mInstanceBounds(), mBoundsDirty(false), mInstanceBuffer(nullptr), mInstanceCapacity(0),
+		mDirtyFirst(0), mDirtyLast(static_cast<UINT>(worldMatrices.size()))
+	{
+	}
+
+	InstancedModel::~InstancedModel()
+	{
+		if (mFrustumCuller != nullptr)
+		{
+			mFrustumCuller->RemoveObject(mCullId);
+		}
+
+		if (mSceneProxy != AabbTree::NullNode)
+		{
+			mSceneTree->DestroyProxy(mSceneProxy);
+		}
+
+		ReleaseObject(mInstanceBuffer);
+		ReleaseObject(mColorTextureVariable);
+		ReleaseObject(mPass);
+		ReleaseObject(mTechnique);
+		ReleaseObject(mEffect);
+		ReleaseObject(mInputLayout);
+	}
+
+	UINT InstancedModel::InstanceCount() const
+	{
+		return static_cast<UINT>(mWorldMatrices.size());
+	}
+
+	const XMFLOAT4X4& InstancedModel::InstanceWorldMatrix(UINT index) const
+	{
+		return mWorldMatrices.at(index);
+	}
+
+	UINT InstancedModel::AddInstance(CXMMATRIX worldMatrix)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, worldMatrix);
+		mWorldMatrices.push_back(world);
+
+		UINT index = static_cast<UINT>(mWorldMatrices.size() - 1);
+		MarkDirty(index, index + 1);
+
+		return index;
+	}
+
+	void InstancedModel::SetInstanceWorldMatrix(UINT index, CXMMATRIX worldMatrix)
+	{
+		XMStoreFloat4x4(&mWorldMatrices.at(index), worldMatrix);
+		MarkDirty(index, index + 1);
+	}
+
+	void InstancedModel::Initialize()
+	{
+		SetCurrentDirectory(Utility::ExecutableDirectory().c_str());
+
+		mRenderQueue = (RenderQueue*)mGame->Services().GetService(RenderQueue::TypeIdClass());
+		assert(mRenderQueue != nullptr);
+
+		mRenderPass = mRenderQueue->FindPass(InstancedTextureMappingPassName);
+		if (mRenderPass == nullptr)
+		{
+			Effect::LoadEffect(*mGame, &mEffect, L"Content\\Effects\\TextureMapping.fx");
+
+			mTechnique = mEffect->GetTechniqueByName("main11_instanced");
+			if (mTechnique == nullptr)
+			{
+				throw GameException("ID3DX11Effect::GetTechniqueByName() could not find the specified technique.");
+			}
+
+			mPass = mTechnique->GetPassByName("p0");
+			if (mPass == nullptr)
+			{
+				throw GameException("ID3DX11EffectTechnique::GetPassByName() could not find the specified pass.");
+			}
+
+			ID3DX11EffectVariable* variable = mEffect->GetVariableByName("ColorTexture");
+			if (variable == nullptr)
+			{
+				throw GameException("ID3DX11Effect::GetVariableByName() could not find the specified variable.");
+			}
+
+			mColorTextureVariable = variable->AsShaderResource();
+			if (mColorTextureVariable->IsValid() == false)
+			{
+				throw GameException("Invalid effect variable cast.");
+			}
+
+			// Slot 0 holds the shared TextureMappingVertex buffer, slot 1 a world matrix per instance
+			D3DX11_PASS_DESC passDesc;
+			mPass->GetDesc(&passDesc);
+
+			D3D11_INPUT_ELEMENT_DESC inputElementDescriptions[] =
+			{
+				{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+				{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+			};
+
+			HRESULT hr;
+			if (FAILED(hr = mGame->Direct3DDevice()->CreateInputLayout(inputElementDescriptions, ARRAYSIZE(inputElementDescriptions), passDesc.pIAInputSignature, passDesc.IAInputSignatureSize, &mInputLayout)))
+			{
+				throw GameException("ID3D11Device::CreateInputLayout() failed.", hr);
+			}
+
+			RenderPass renderPass;
+			ZeroMemory(&renderPass, sizeof(renderPass));
+			renderPass.Effect = mEffect;
+			renderPass.Pass = mPass;
+			renderPass.InputLayout = mInputLayout;
+			renderPass.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			renderPass.TextureVariable = mColorTextureVariable;
+			mRenderPass = mRenderQueue->AddPass(InstancedTextureMappingPassName, renderPass, "CBufferPerFrameInstanced");
+		}
+
+		// All copies are culled as one object, by the box around every instance
+		mFrustumCuller = (FrustumCuller*)mGame->Services().GetService(FrustumCuller::TypeIdClass());
+		assert(mFrustumCuller != nullptr);
+		mCullId = mFrustumCuller->AddObject();
+
+		mSceneTree = (AabbTree*)mGame->Services().GetService(AabbTree::TypeIdClass());
+		assert(mSceneTree != nullptr);
+
+		mOcclusionCuller = (OcclusionCuller*)mGame->Services().GetService(OcclusionCuller::TypeIdClass());
+		assert(mOcclusionCuller != nullptr);
+
+		mAssetLoader = (AssetLoader*)mGame->Services().GetService(AssetLoader::TypeIdClass());
+		assert(mAssetLoader != nullptr);
+
+		mModelHandle = mAssetLoader->LoadModel(mModelFilename, true, [this](Model& model)
+		{
+			CreateModelBuffers(model);
+		});
+		mTextureHandle = mAssetLoader->LoadTexture(mTexturePath);
+	}
+
+	void InstancedModel::Update(const GameTime& gameTime)
+	{
+		if (mBoundsDirty == false || mModelHandle->State() != AssetStateReady || mWorldMatrices.empty())
+		{
+			return;
+		}
+
+		BoundingBox bounds;
+		mBoundingBox.Transform(bounds, XMLoadFloat4x4(&mWorldMatrices[0]));
+		for (UINT i = 1; i < mWorldMatrices.size(); i++)
+		{
+			BoundingBox instanceBounds;
+			mBoundingBox.Transform(instanceBounds, XMLoadFloat4x4(&mWorldMatrices[i]));
+			BoundingBox::CreateMerged(bounds, bounds, instanceBounds);
+		}
+
+		mInstanceBounds = bounds;
+		mFrustumCuller->SetBounds(mCullId, bounds);
+
+		if (mSceneProxy == AabbTree::NullNode)
+		{
+			mSceneProxy = mSceneTree->CreateProxy(bounds, static_cast<GameComponent*>(this));
+		}
+		else
+		{
+			mSceneTree->MoveProxy(mSceneProxy, bounds);
+		}
+		mBoundsDirty = false;
+	}
+
+	void InstancedModel::Draw(const GameTime& gameTime)
+	{
+		if (mModelHandle->State() != AssetStateReady || mWorldMatrices.empty() || mFrustumCuller->IsVisible(mCullId) == false)
+		{
+			return;
+		}
+
+		// Hidden behind the occluders drawn this frame
+		if (mSceneProxy != AabbTree::NullNode && mOcclusionCuller->IsVisible(mSceneTree->Bounds(mSceneProxy)) == false)
+		{
+			return;
+		}
+
+		UpdateInstanceBuffer();
+
+		DrawPacket packet;
+		packet.Pass = mRenderPass;
+		packet.Buffers = mModelBuffer.get();
+		packet.InstanceBuffer = mInstanceBuffer;
+		packet.InstanceStride = sizeof(XMFLOAT4X4);
+		packet.InstanceCount = static_cast<UINT>(mWorldMatrices.size());
+		packet.Texture = (mTextureHandle->State() == AssetStateReady ? mTextureHandle->ShaderResourceView() : mAssetLoader->PlaceholderTexture());
+		packet.Constants = mRenderQueue->AddConstants(mCamera->ViewMatrix() * mCamera->ProjectionMatrix());
+
+		// The copies are spread over the level, so the centre of their merged bounds stands in for
+		// all of them. The view is right-handed, so points in front of the camera have a negative z.
+		packet.Depth = -XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&mInstanceBounds.Center), mCamera->ViewMatrix()));
+
+		for (const Submesh& submesh : mModelBuffer->Submeshes())
+		{
+			packet.IndexCount = submesh.IndexCount;
+			packet.StartIndex = submesh.StartIndex;
+			packet.BaseVertex = submesh.BaseVertex;
+			mRenderQueue->Submit(packet);
+		}
+	}
+
+	void InstancedModel::CreateModelBuffers(Model& model)
+	{
+		// Same vertices as ModelFromFile, so a prop drawn both ways shares one set of buffers.
+		ModelCache* modelCache = (ModelCache*)mGame->Services().GetService(ModelCache::TypeIdClass());
+		assert(modelCache != nullptr);
+
+		mBoundingBox = model.Bounds().Box;
+		VertexQuantization quantization = VertexCompression::ComputeQuantization(mBoundingBox);
+		mModelBuffer = modelCache->GetModelBuffer(model, "TextureMappingVertex", sizeof(ModelFromFile::TextureMappingVertex), [&](const Mesh& mesh, void* vertices)
+		{
+			ModelFromFile::WriteVertices(mesh, quantization, static_cast<ModelFromFile::TextureMappingVertex*>(vertices));
+		});
+		XMStoreFloat4x4(&mDequantizationMatrix, VertexCompression::DequantizationMatrix(quantization));
+
+		// Every instance matrix has the dequantization folded in
+		MarkDirty(0, static_cast<UINT>(mWorldMatrices.size()));
+	}
+
+	void InstancedModel::CreateInstanceBuffer()
+	{
+		ReleaseObject(mInstanceBuffer);
+
+		// Grows geometrically so adding instances one at a time doesn't recreate it every frame
+		mInstanceCapacity = std::max(static_cast<UINT>(mWorldMatrices.size()), mInstanceCapacity * 2);
+
+		D3D11_BUFFER_DESC instanceBufferDesc;
+		ZeroMemory(&instanceBufferDesc, sizeof(instanceBufferDesc));
+		instanceBufferDesc.ByteWidth = sizeof(XMFLOAT4X4) * mInstanceCapacity;
+		instanceBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+		HRESULT hr;
+		if (FAILED(hr = mGame->Direct3DDevice()->CreateBuffer(&instanceBufferDesc, nullptr, &mInstanceBuffer)))
+		{
+			throw GameException("ID3D11Device::CreateBuffer() failed.", hr);
+		}
+
+		MarkDirty(0, static_cast<UINT>(mWorldMatrices.size()));
+	}
+
+	void InstancedModel::UpdateInstanceBuffer()
+	{
+		if (mInstanceBuffer == nullptr || mWorldMatrices.size() > mInstanceCapacity)
+		{
+			CreateInstanceBuffer();
+		}
+
+		if (mDirtyFirst >= mDirtyLast)
+		{
+			return;
+		}
+
+		XMMATRIX dequantization = XMLoadFloat4x4(&mDequantizationMatrix);
+		mInstanceData.resize(mDirtyLast - mDirtyFirst);
+		for (UINT i = mDirtyFirst; i < mDirtyLast; i++)
+		{
+			XMStoreFloat4x4(&mInstanceData[i - mDirtyFirst], dequantization * XMLoadFloat4x4(&mWorldMatrices[i]));
+		}
+
+		// A dynamic buffer would have to be rewritten whole after a discard, so only the changed
+		// instances go through UpdateSubresource instead.
+		D3D11_BOX box;
+		box.left = mDirtyFirst * sizeof(XMFLOAT4X4);
+		box.right = mDirtyLast * sizeof(XMFLOAT4X4);
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		mGame->Direct3DDeviceContext()->UpdateSubresource(mInstanceBuffer, 0, &box, &mInstanceData[0], 0, 0);
+
+		mDirtyFirst = 0;
+		mDirtyLast = 0;
+	}
+
+	void InstancedModel::MarkDirty(UINT first, UINT last)
+	{
+		mBoundsDirty = true;
+		if (mDirtyFirst >= mDirtyLast)
+		{
+			mDirtyFirst = first;
+			mDirtyLast = last;
+		}
+		else
+		{
+			mDirtyFirst = std::min(mDirtyFirst, first);
+			mDirtyLast = std::max(mDirtyLast, last);
+		}
+	}
+}
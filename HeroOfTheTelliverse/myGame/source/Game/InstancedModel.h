@@ -0,0 +1,93 @@
+#pragma once
+
+#include "DrawableGameComponent.h"
+#include "ModelBuffer.h"
+#include <DirectXCollision.h>
+
+using namespace Library;
+
+namespace Library
+{
+	class Model;
+	class AssetLoader;
+	class ModelHandle;
+	class TextureHandle;
+	class RenderQueue;
+	struct RenderPass;
+	class FrustumCuller;
+	class AabbTree;
+	class OcclusionCuller;
+}
+
+namespace Rendering
+{
+	// Every copy of one static prop, drawn with a single DrawIndexedInstanced() per submesh. World
+	// matrices live in a per-instance vertex buffer; only the range changed since the last frame is
+	// uploaded. Copies are drawn whole at full detail, so props with LODs or meshlets that matter
+	// up close are better off as separate ModelFromFile components.
+	class InstancedModel : public DrawableGameComponent
+	{
+		RTTI_DECLARATIONS(InstancedModel, DrawableGameComponent)
+
+	public:
+		InstancedModel(Game& game, Camera& camera, const std::string& modelFilename, const std::wstring& texturePath);
+		InstancedModel(Game& game, Camera& camera, const std::string& modelFilename, const std::wstring& texturePath, const std::vector<XMFLOAT4X4>& worldMatrices);
+		~InstancedModel();
+
+		UINT InstanceCount() const;
+		const XMFLOAT4X4& InstanceWorldMatrix(UINT index) const;
+
+		// Returns the new instance's index.
+		UINT AddInstance(CXMMATRIX worldMatrix);
+		void SetInstanceWorldMatrix(UINT index, CXMMATRIX worldMatrix);
+
+		virtual void Initialize() override;
+		virtual void Update(const GameTime& gameTime) override;
+		virtual void Draw(const GameTime& gameTime) override;
+
+	private:
+		InstancedModel();
+		InstancedModel(const InstancedModel& rhs);
+		InstancedModel& operator=(const InstancedModel& rhs);
+
+		void CreateModelBuffers(Model& model);
+		void CreateInstanceBuffer();
+		void UpdateInstanceBuffer();
+		void MarkDirty(UINT first, UINT last);
+
+		ID3DX11Effect* mEffect;
+		ID3DX11EffectTechnique* mTechnique;
+		ID3DX11EffectPass* mPass;
+		ID3DX11EffectShaderResourceVariable* mColorTextureVariable;
+		ID3D11InputLayout* mInputLayout;
+		RenderQueue* mRenderQueue;
+		const RenderPass* mRenderPass;
+		FrustumCuller* mFrustumCuller;
+		UINT mCullId;
+		AabbTree* mSceneTree;
+		UINT mSceneProxy;
+		OcclusionCuller* mOcclusionCuller;
+
+		AssetLoader* mAssetLoader;
+		std::shared_ptr<ModelHandle> mModelHandle;
+		std::shared_ptr<TextureHandle> mTextureHandle;
+		std::shared_ptr<ModelBuffer> mModelBuffer;
+
+		const std::string mModelFilename;
+		const std::wstring mTexturePath;
+
+		std::vector<XMFLOAT4X4> mWorldMatrices;
+		std::vector<XMFLOAT4X4> mInstanceData;
+		XMFLOAT4X4 mDequantizationMatrix;
+		BoundingBox mBoundingBox;
+		BoundingBox mInstanceBounds; // Every instance, in world space.
+		bool mBoundsDirty;
+
+		ID3D11Buffer* mInstanceBuffer;
+		UINT mInstanceCapacity;
+
+		// Instances [mDirtyFirst, mDirtyLast) still have to be uploaded.
+		UINT mDirtyFirst;
+		UINT mDirtyLast;
+	};
+}
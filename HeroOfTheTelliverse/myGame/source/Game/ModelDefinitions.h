@@ -23,7 +23,7 @@ prefixed to the beginning of the define
 #define MTELLEVISION "Content\\Models\\TV.3ds"
 #define MPLANE "Content\\Models\\plane.obj"
 
-#define MPLAYER "Content\\Models\\tvAyoub.3ds" //CURRENTLY CRASHES GAME IF RENDERED
+#define MPLAYER "Content\\Models\\tvAyoub.3ds"
 #define TPLAYER
 
 #define MAPPLE "Content\\Models\\apple.3ds"
@@ -4,12 +4,18 @@
 #include "MatrixHelper.h"
 #include "Camera.h"
 #include "Utility.h"
-#include "D3DCompiler.h"
+#include "Effect.h"
 #include "Model.h"
 #include "Mesh.h"
+#include "ModelCache.h"
+#include "AssetLoader.h"
+#include "VertexCompression.h"
 #include "VectorHelper.h"
 #include "Keyboard.h"
-#include <WICTextureLoader.h>
+#include "RenderQueue.h"
+#include "FrustumCuller.h"
+#include "AabbTree.h"
+#include "OcclusionCuller.h"
 #include <SimpleMath.h>
 
 using namespace DirectX;
@@ -18,10 +24,19 @@ namespace Rendering
 {
 	RTTI_DEFINITIONS(ModelFromFile)
 
+	namespace
+	{
+		// Shared with every other component that draws TextureMapping.fx from TextureMappingVertex buffers.
+		const std::string TextureMappingPassName = "TextureMapping.fx main11 p0 TextureMappingVertex";
+
+		// Per convex mesh; the occlusion buffer is coarse enough that more only costs rasterizer time.
+		const UINT MaxOccluderTriangles = 256;
+	}
+
 		ModelFromFile::ModelFromFile(Game& game, Camera& camera, const std::string modelFilename)
 		: DrawableGameComponent(game, camera),
-		mEffect(nullptr), mTechnique(nullptr), mPass(nullptr), mWvpVariable(nullptr), mTextureShaderResourceView(nullptr), mColorTextureVariable(nullptr), mKeyboard(nullptr),
-		mInputLayout(nullptr), mWorldMatrix(MatrixHelper::Identity), mVertexBuffer(nullptr), mIndexBuffer(nullptr), mIndexCount(0), modelFile(modelFilename)
+		mEffect(nullptr), mTechnique(nullptr), mPass(nullptr), mRenderQueue(nullptr), mRenderPass(nullptr), mFrustumCuller(nullptr), mCullId(0), mSceneTree(nullptr), mSceneProxy(AabbTree::NullNode), mOcclusionCuller(nullptr), mIsOccluder(false), mOccluder(), mAssetLoader(nullptr), mColorTextureVariable(nullptr), mKeyboard(nullptr),
+		mInputLayout(nullptr), mWorldMatrix(MatrixHelper::Identity), mDequantizationMatrix(MatrixHelper::Identity), modelFile(modelFilename)
 	{
 		//we don't use the model description and model value for this constructor
 		mModelValue = 0;
@@ -29,23 +44,29 @@ namespace Rendering
 	
 	ModelFromFile::ModelFromFile(Game& game, Camera& camera, const std::string modelFilename, const std::wstring ModelDes, int ModelValue)
 		: DrawableGameComponent(game, camera),
-		mEffect(nullptr), mTechnique(nullptr), mPass(nullptr), mWvpVariable(nullptr), mTextureShaderResourceView(nullptr), mColorTextureVariable(nullptr),
-		mInputLayout(nullptr), mWorldMatrix(MatrixHelper::Identity), mVertexBuffer(nullptr), mIndexBuffer(nullptr), mIndexCount(0), modelFile(modelFilename), modelDes(ModelDes), mModelValue(ModelValue) 
+		mEffect(nullptr), mTechnique(nullptr), mPass(nullptr), mRenderQueue(nullptr), mRenderPass(nullptr), mFrustumCuller(nullptr), mCullId(0), mSceneTree(nullptr), mSceneProxy(AabbTree::NullNode), mOcclusionCuller(nullptr), mIsOccluder(false), mOccluder(), mAssetLoader(nullptr), mColorTextureVariable(nullptr),
+		mInputLayout(nullptr), mWorldMatrix(MatrixHelper::Identity), mDequantizationMatrix(MatrixHelper::Identity), modelFile(modelFilename), modelDes(ModelDes), mModelValue(ModelValue) 
 	{
 
 	}
 
 	ModelFromFile::~ModelFromFile()
 	{
+		if (mFrustumCuller != nullptr)
+		{
+			mFrustumCuller->RemoveObject(mCullId);
+		}
+
+		if (mSceneProxy != AabbTree::NullNode)
+		{
+			mSceneTree->DestroyProxy(mSceneProxy);
+		}
+
 		ReleaseObject(mColorTextureVariable);
-		ReleaseObject(mTextureShaderResourceView);
-		ReleaseObject(mWvpVariable);
 		ReleaseObject(mPass);
 		ReleaseObject(mTechnique);
 		ReleaseObject(mEffect);
 		ReleaseObject(mInputLayout);
-		ReleaseObject(mVertexBuffer);
-		ReleaseObject(mIndexBuffer);
 		mKeyboard = nullptr;
 	}
 
@@ -103,117 +124,98 @@ namespace Rendering
 		this->mTexturePath = L"Content\\Textures\\missing.jpg";
 	}
 
+	void ModelFromFile::setOccluder(bool occluder)
+	{
+		this->mIsOccluder = occluder;
+	}
+
 	void ModelFromFile::Initialize()
 	{
 		mKeyboard = (Keyboard*)mGame->Services().GetService(Keyboard::TypeIdClass());
 		SetCurrentDirectory(Utility::ExecutableDirectory().c_str());
 
-		// Compile the shader
-		UINT shaderFlags = 0;
-
-#if defined( DEBUG ) || defined( _DEBUG )
-		shaderFlags |= D3DCOMPILE_DEBUG;
-		shaderFlags |= D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-
-		ID3D10Blob* compiledShader = nullptr;
-		ID3D10Blob* errorMessages = nullptr;
-		HRESULT hr = D3DCompileFromFile(L"Content\\Effects\\TextureMapping.fx", nullptr, nullptr, nullptr, "fx_5_0", shaderFlags, 0, &compiledShader, &errorMessages);
-
-
-		if (FAILED(hr))
-		{
-			const char* errorMessage = (errorMessages != nullptr ? (char*)errorMessages->GetBufferPointer() : "D3DX11CompileFromFile() failed");
-			GameException ex(errorMessage, hr);
-			ReleaseObject(errorMessages);
-
-			throw ex;
-		}
-
-		// Create an effect object from the compiled shader
-		hr = D3DX11CreateEffectFromMemory(compiledShader->GetBufferPointer(), compiledShader->GetBufferSize(), 0, mGame->Direct3DDevice(), &mEffect);
-		if (FAILED(hr))
-		{
-			throw GameException("D3DX11CreateEffectFromMemory() failed.", hr);
-		}
-
-		ReleaseObject(compiledShader);
-
-		// Look up the technique, pass, and WVP variable from the effect
-		mTechnique = mEffect->GetTechniqueByName("main11");
-		if (mTechnique == nullptr)
-		{
-			throw GameException("ID3DX11Effect::GetTechniqueByName() could not find the specified technique.", hr);
-		}
-
-		mPass = mTechnique->GetPassByName("p0");
-		if (mPass == nullptr)
-		{
-			throw GameException("ID3DX11EffectTechnique::GetPassByName() could not find the specified pass.", hr);
-		}
-
-		ID3DX11EffectVariable* variable = mEffect->GetVariableByName("WorldViewProjection");
-		if (variable == nullptr)
-		{
-			throw GameException("ID3DX11Effect::GetVariableByName() could not find the specified variable.", hr);
-		}
+		// The effect and input layout are created once and shared through the render queue, which
+		// also writes WorldViewProjection into CBufferPerObject for every draw.
+		mRenderQueue = (RenderQueue*)mGame->Services().GetService(RenderQueue::TypeIdClass());
+		assert(mRenderQueue != nullptr);
 
-		mWvpVariable = variable->AsMatrix();
-		if (mWvpVariable->IsValid() == false)
+		mRenderPass = mRenderQueue->FindPass(TextureMappingPassName);
+		if (mRenderPass == nullptr)
 		{
-			throw GameException("Invalid effect variable cast.");
+			// Load the shader, using the cooked effect when the content manifest lists one
+			Effect::LoadEffect(*mGame, &mEffect, L"Content\\Effects\\TextureMapping.fx");
+
+			// Look up the technique, pass, and texture variable from the effect
+			mTechnique = mEffect->GetTechniqueByName("main11");
+			if (mTechnique == nullptr)
+			{
+				throw GameException("ID3DX11Effect::GetTechniqueByName() could not find the specified technique.");
+			}
+
+			mPass = mTechnique->GetPassByName("p0");
+			if (mPass == nullptr)
+			{
+				throw GameException("ID3DX11EffectTechnique::GetPassByName() could not find the specified pass.");
+			}
+
+			ID3DX11EffectVariable* variable = mEffect->GetVariableByName("ColorTexture");
+			if (variable == nullptr)
+			{
+				throw GameException("ID3DX11Effect::GetVariableByName() could not find the specified variable.");
+			}
+
+			mColorTextureVariable = variable->AsShaderResource();
+			if (mColorTextureVariable->IsValid() == false)
+			{
+				throw GameException("Invalid effect variable cast.");
+			}
+
+			// Create the input layout
+			D3DX11_PASS_DESC passDesc;
+			mPass->GetDesc(&passDesc);
+
+			D3D11_INPUT_ELEMENT_DESC inputElementDescriptions[] =
+			{
+				{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+				{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+			};
+
+			HRESULT hr;
+			if (FAILED(hr = mGame->Direct3DDevice()->CreateInputLayout(inputElementDescriptions, ARRAYSIZE(inputElementDescriptions), passDesc.pIAInputSignature, passDesc.IAInputSignatureSize, &mInputLayout)))
+			{
+				throw GameException("ID3D11Device::CreateInputLayout() failed.", hr);
+			}
+
+			RenderPass renderPass;
+			ZeroMemory(&renderPass, sizeof(renderPass));
+			renderPass.Effect = mEffect;
+			renderPass.Pass = mPass;
+			renderPass.InputLayout = mInputLayout;
+			renderPass.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			renderPass.TextureVariable = mColorTextureVariable;
+			mRenderPass = mRenderQueue->AddPass(TextureMappingPassName, renderPass, "CBufferPerObject");
 		}
 
-		variable = mEffect->GetVariableByName("ColorTexture");
-		if (variable == nullptr)
-		{
-			throw GameException("ID3DX11Effect::GetVariableByName() could not find the specified variable.", hr);
-		}
+		// Import the model and decode the texture in the background. Draw skips the model until
+		// its buffers exist and shows the placeholder texture until the real one is ready.
+		mFrustumCuller = (FrustumCuller*)mGame->Services().GetService(FrustumCuller::TypeIdClass());
+		assert(mFrustumCuller != nullptr);
+		mCullId = mFrustumCuller->AddObject();
 
-		mColorTextureVariable = variable->AsShaderResource();
-		if (mColorTextureVariable->IsValid() == false)
-		{
-			throw GameException("Invalid effect variable cast.");
-		}
+		mSceneTree = (AabbTree*)mGame->Services().GetService(AabbTree::TypeIdClass());
+		assert(mSceneTree != nullptr);
 
-		// Create the input layout
-		D3DX11_PASS_DESC passDesc;
-		mPass->GetDesc(&passDesc);
+		mOcclusionCuller = (OcclusionCuller*)mGame->Services().GetService(OcclusionCuller::TypeIdClass());
+		assert(mOcclusionCuller != nullptr);
 
-		D3D11_INPUT_ELEMENT_DESC inputElementDescriptions[] =
-		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-		};
+		mAssetLoader = (AssetLoader*)mGame->Services().GetService(AssetLoader::TypeIdClass());
+		assert(mAssetLoader != nullptr);
 
-		if (FAILED(hr = mGame->Direct3DDevice()->CreateInputLayout(inputElementDescriptions, ARRAYSIZE(inputElementDescriptions), passDesc.pIAInputSignature, passDesc.IAInputSignatureSize, &mInputLayout)))
+		mModelHandle = mAssetLoader->LoadModel(modelFile, true, [this](Model& model)
 		{
-			throw GameException("ID3D11Device::CreateInputLayout() failed.", hr);
-		}
-
-		// Load the model
-		std::unique_ptr<Model> model(new Model(*mGame, modelFile, true));
-
-		// Create the vertex and index buffers
-		Mesh* mesh = model->Meshes().at(0);
-		CreateVertexBuffer(mGame->Direct3DDevice(), *mesh, &mVertexBuffer);
-		mesh->CreateIndexBuffer(&mIndexBuffer);
-		mIndexCount = mesh->Indices().size();
-
-
-		// Load the texture
-	   // std::wstring textureName = L"Content\\Textures\\EarthComposite.jpg";
-
-		std::wstring textureName = mTexturePath; //L"Content\\Textures\\bench.jpg";
-
-
-		if (FAILED(hr = DirectX::CreateWICTextureFromFile(mGame->Direct3DDevice(), mGame->Direct3DDeviceContext(), textureName.c_str(), nullptr, &mTextureShaderResourceView)))
-		{
-			throw GameException("CreateWICTextureFromFile() failed.", hr);
-		}
-
-
-
+			CreateModelBuffers(model);
+		});
+		mTextureHandle = mAssetLoader->LoadTexture(mTexturePath);
 
 		//position model in the world space, the issue here is that models are from different sources need adjustment for scaling, rotation,
 		/*
@@ -312,88 +314,146 @@ namespace Rendering
 
 		////	XMStoreFloat4x4(&mWorldMatrix, worldMatrix);
 		//}
-			
+
+		// Culled against the world matrix as it stands once every component has updated
+		if (mModelHandle->State() == AssetStateReady)
+		{
+			BoundingBox worldBounds;
+			mBoundingBox.Transform(worldBounds, XMLoadFloat4x4(&mWorldMatrix));
+			mFrustumCuller->SetBounds(mCullId, worldBounds);
+
+			if (mSceneProxy == AabbTree::NullNode)
+			{
+				mSceneProxy = mSceneTree->CreateProxy(worldBounds, static_cast<GameComponent*>(this));
+			}
+			else
+			{
+				mSceneTree->MoveProxy(mSceneProxy, worldBounds);
+			}
+
+			if (mIsOccluder)
+			{
+				mOcclusionCuller->AddOccluder(mOccluder, XMLoadFloat4x4(&mWorldMatrix));
+			}
+		}
 	}
 
 
 	void ModelFromFile::Draw(const GameTime& gameTime)
 	{
-		ID3D11DeviceContext* direct3DDeviceContext = mGame->Direct3DDeviceContext();
-		direct3DDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		direct3DDeviceContext->IASetInputLayout(mInputLayout);
+		if (mModelHandle->State() != AssetStateReady || mFrustumCuller->IsVisible(mCullId) == false)
+		{
+			return;
+		}
 
-		UINT stride = sizeof(TextureMappingVertex);
-		UINT offset = 0;
-		direct3DDeviceContext->IASetVertexBuffers(0, 1, &mVertexBuffer, &stride, &offset);
-		direct3DDeviceContext->IASetIndexBuffer(mIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		// Hidden behind the occluders drawn this frame
+		if (mSceneProxy != AabbTree::NullNode && mOcclusionCuller->IsVisible(mSceneTree->Bounds(mSceneProxy)) == false)
+		{
+			return;
+		}
 
 		XMMATRIX worldMatrix = XMLoadFloat4x4(&mWorldMatrix);
-		XMMATRIX wvp = worldMatrix * mCamera->ViewMatrix() * mCamera->ProjectionMatrix();
-		mWvpVariable->SetMatrix(reinterpret_cast<const float*>(&wvp));
-
-
-		mColorTextureVariable->SetResource(mTextureShaderResourceView);
-
-		mPass->Apply(0, direct3DDeviceContext);
-
-		direct3DDeviceContext->DrawIndexed(mIndexCount, 0, 0);
+		XMMATRIX worldView = worldMatrix * mCamera->ViewMatrix();
+		XMMATRIX worldViewProjection = worldView * mCamera->ProjectionMatrix();
+
+		// Submitted rather than drawn: the render queue sorts every component's packets by state
+		// and issues them once all of them are in.
+		DrawPacket packet;
+		packet.Pass = mRenderPass;
+		packet.Buffers = mModelBuffer.get();
+		packet.Texture = (mTextureHandle->State() == AssetStateReady ? mTextureHandle->ShaderResourceView() : mAssetLoader->PlaceholderTexture());
+		packet.Constants = mRenderQueue->AddConstants(XMLoadFloat4x4(&mDequantizationMatrix) * worldViewProjection);
+		packet.InstanceBuffer = nullptr;
+		packet.InstanceStride = 0;
+		packet.InstanceCount = 1;
+		// The view is right-handed, so points in front of the camera have a negative z.
+		packet.Depth = -XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&mBoundingBox.Center), worldView));
+
+		XMFLOAT3 viewerPosition;
+		XMStoreFloat3(&viewerPosition, XMVector3TransformCoord(mCamera->PositionVector(), XMMatrixInverse(nullptr, worldMatrix)));
+
+		const std::vector<Submesh>& submeshes = mModelBuffer->Submeshes();
+		for (UINT i = 0; i < submeshes.size(); i++)
+		{
+			const Submesh& submesh = submeshes[i];
+			packet.BaseVertex = submesh.BaseVertex;
+
+			// Coarser levels are drawn whole; meshlet culling only pays off at full detail
+			UINT lod = mLodSelectors[i].Select(*mCamera, worldMatrix, static_cast<float>(mGame->ScreenHeight()));
+			if (lod > 0)
+			{
+				const MeshLod& level = submesh.Lods[lod];
+				packet.IndexCount = level.IndexCount;
+				packet.StartIndex = level.IndexOffset;
+				mRenderQueue->Submit(packet);
+			}
+			else if (submesh.Meshlets.empty())
+			{
+				// Only cooked meshes have meshlets; anything imported at run time is one draw
+				packet.IndexCount = submesh.IndexCount;
+				packet.StartIndex = submesh.StartIndex;
+				mRenderQueue->Submit(packet);
+			}
+			else
+			{
+				// Only submit the meshlets that are on screen and facing the camera
+				mDrawRanges.clear();
+				MeshletBuilder::Cull(submesh.Meshlets, worldViewProjection, viewerPosition, mDrawRanges);
+				for (const MeshletDrawRange& range : mDrawRanges)
+				{
+					packet.IndexCount = range.IndexCount;
+					packet.StartIndex = range.StartIndex;
+					mRenderQueue->Submit(packet);
+				}
+			}
+		}
 	}
 
-	void ModelFromFile::CreateVertexBuffer(ID3D11Device* device, const Mesh& mesh, ID3D11Buffer** vertexBuffer) const
+	void ModelFromFile::CreateModelBuffers(Model& model)
 	{
-		const std::vector<XMFLOAT3>& sourceVertices = mesh.Vertices();
-
-		std::vector<TextureMappingVertex> vertices;
-		vertices.reserve(sourceVertices.size());
-
-		std::vector<XMFLOAT3>* textureCoordinates = mesh.TextureCoordinates().at(0);
-		assert(textureCoordinates->size() == sourceVertices.size());
-
-		//generate the bounding box
-		float min = -1e38f;
-		float max = 1e38f;
-
-		XMFLOAT3 vMinf3(max, max, max);
-		XMFLOAT3 vMaxf3(min, min, min);
-
-
-		XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-		XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
+		// Identical files share one import and one set of buffers. The meshes are packed into
+		// one vertex buffer, so they share one quantization volume: the model's bounds.
+		ModelCache* modelCache = (ModelCache*)mGame->Services().GetService(ModelCache::TypeIdClass());
+		assert(modelCache != nullptr);
+
+		MeshBounds bounds = model.Bounds();
+		VertexQuantization quantization = VertexCompression::ComputeQuantization(bounds.Box);
+		mModelBuffer = modelCache->GetModelBuffer(model, "TextureMappingVertex", sizeof(TextureMappingVertex), [&](const Mesh& mesh, void* vertices)
+		{
+			WriteVertices(mesh, quantization, static_cast<TextureMappingVertex*>(vertices));
+		});
+		XMStoreFloat4x4(&mDequantizationMatrix, VertexCompression::DequantizationMatrix(quantization));
 
-		//end
+		// Bounds were computed once at import
+		mBoundingBox = bounds.Box;
 
-		for (UINT i = 0; i < sourceVertices.size(); i++)
+		const std::vector<Submesh>& submeshes = mModelBuffer->Submeshes();
+		mLodSelectors.resize(submeshes.size());
+		for (UINT i = 0; i < submeshes.size(); i++)
 		{
-			XMFLOAT3 position = sourceVertices.at(i);
-			XMFLOAT3 uv = textureCoordinates->at(i);
-			vertices.push_back(TextureMappingVertex(XMFLOAT4(position.x, position.y, position.z, 1.0f), XMFLOAT2(uv.x, uv.y)));
-		
-			//create the bounding box from the list of vertices
-			XMVECTOR P = XMLoadFloat3(&position);
-			vMin = XMVectorMin(vMin, P);
-			vMax = XMVectorMax(vMax, P);
-			//the end
+			mLodSelectors[i].SetLods(submeshes[i].Lods, submeshes[i].Sphere);
 		}
 
+		// Built while the model still has its CPU-side meshes
+		if (mIsOccluder)
+		{
+			OcclusionCuller::BuildOccluder(model, MaxOccluderTriangles, mOccluder);
+		}
+	}
 
-		//final step to generate the bounding box
-
-		XMStoreFloat3(const_cast<XMFLOAT3*>(&mBoundingBox.Center), 0.5f*(vMin + vMax));
-		XMStoreFloat3(const_cast<XMFLOAT3*>(&mBoundingBox.Extents), 0.5f*(vMax - vMin));
-
+	void ModelFromFile::WriteVertices(const Mesh& mesh, const VertexQuantization& quantization, TextureMappingVertex* vertices)
+	{
+		ArraySpan<const XMFLOAT3> sourceVertices = mesh.Vertices();
 
-		D3D11_BUFFER_DESC vertexBufferDesc;
-		ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
-		vertexBufferDesc.ByteWidth = sizeof(TextureMappingVertex) * vertices.size();
-		vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-		vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		// Meshes without mapping coordinates (tvAyoub.3ds has none) all sample the texture's corner.
+		const XMFLOAT3 noTextureCoordinate(0.0f, 0.0f, 0.0f);
+		ArraySpan<const XMFLOAT3> textureCoordinates = (mesh.TextureCoordinates().size() > 0 ? mesh.TextureCoordinates()[0] : ArraySpan<const XMFLOAT3>());
+		assert(textureCoordinates.empty() || textureCoordinates.size() == sourceVertices.size());
 
-		D3D11_SUBRESOURCE_DATA vertexSubResourceData;
-		ZeroMemory(&vertexSubResourceData, sizeof(vertexSubResourceData));
-		vertexSubResourceData.pSysMem = &vertices[0];
-		if (FAILED(device->CreateBuffer(&vertexBufferDesc, &vertexSubResourceData, vertexBuffer)))
+		for (UINT i = 0; i < sourceVertices.size(); i++)
 		{
-			throw GameException("ID3D11Device::CreateBuffer() failed.");
+			const XMFLOAT3& textureCoordinate = (textureCoordinates.empty() ? noTextureCoordinate : textureCoordinates[i]);
+			vertices[i] = TextureMappingVertex(VertexCompression::EncodePosition(sourceVertices.at(i), quantization), VertexCompression::EncodeTextureCoordinate(textureCoordinate));
 		}
 	}
 
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "DrawableGameComponent.h"
+#include "MeshletBuilder.h"
+#include "ModelBuffer.h"
+#include "LodSelector.h"
+#include "OcclusionCuller.h"
 #include <DirectXCollision.h>
 
 using namespace Library;
@@ -8,6 +12,15 @@ using namespace Library;
 namespace Library
 {
 	class Mesh;
+	struct VertexQuantization;
+	class Model;
+	class AssetLoader;
+	class ModelHandle;
+	class TextureHandle;
+	class RenderQueue;
+	struct RenderPass;
+	class FrustumCuller;
+	class AabbTree;
 	class Keyboard;
 }
 
@@ -18,6 +31,21 @@ namespace Rendering
 		RTTI_DECLARATIONS(ModelFromFile, DrawableGameComponent)
 
 	public:
+		// Bounds-relative snorm16 position and half2 UV, see VertexCompression.
+		typedef struct _TextureMappingVertex
+		{
+			XMSHORTN4 Position;
+			XMHALF2 TextureCoordinates;
+
+			_TextureMappingVertex() { }
+
+			_TextureMappingVertex(XMSHORTN4 position, XMHALF2 textureCoordinates)
+				: Position(position), TextureCoordinates(textureCoordinates) { }
+		} TextureMappingVertex;
+
+		// Writes the vertices of the model buffer ModelCache shares under "TextureMappingVertex".
+		static void WriteVertices(const Mesh& mesh, const VertexQuantization& quantization, TextureMappingVertex* vertices);
+
 		ModelFromFile(Game& game, Camera& camera, const std::string modelFilename);
 		ModelFromFile(Game& game, Camera& camera, const std::string modelFilename, const std::wstring modelDes, int modelValue);
 		~ModelFromFile();
@@ -28,6 +56,8 @@ namespace Rendering
 		//texture switching functions
 		void setTexture(std::wstring texturePath); //set the texture to the passed texture
 		void clearTexture(); //reset the texture to the missing texture image
+		//draw a simplified copy into the occlusion buffer so the model hides what is behind it; set before Initialize
+		void setOccluder(bool occluder);
 
 		virtual void SetPosition(const float rotateX, const float rotateY, const float rotateZ, const float scaleFactor, const float translateX, const float translateY, const float translateZ);
 		virtual void SetPosition(const float rotateX, const float rotateY, const float rotateZ, const float translateX, const float translateY, const float translateZ);
@@ -44,39 +74,41 @@ namespace Rendering
 		virtual void Initialize() override;
 		virtual void Draw(const GameTime& gameTime) override;
 		Keyboard* mKeyboard;
+		// Leaf in the scene's AabbTree, or AabbTree::NullNode until the model has loaded.
+		UINT SceneProxy() const { return mSceneProxy; }
 		XMFLOAT3 getPosition(); //returns the positoon of the object
 	private:
-		typedef struct _TextureMappingVertex
-		{
-			XMFLOAT4 Position;
-			XMFLOAT2 TextureCoordinates;
-
-			_TextureMappingVertex() { }
-
-			_TextureMappingVertex(XMFLOAT4 position, XMFLOAT2 textureCoordinates)
-				: Position(position), TextureCoordinates(textureCoordinates) { }
-		} TextureMappingVertex;
-
 		ModelFromFile();
 		ModelFromFile(const ModelFromFile& rhs);
 		ModelFromFile& operator=(const ModelFromFile& rhs);
 
-		void CreateVertexBuffer(ID3D11Device* device, const Mesh& mesh, ID3D11Buffer** vertexBuffer) const;
+		void CreateModelBuffers(Model& model);
 
 		ID3DX11Effect* mEffect;
 		ID3DX11EffectTechnique* mTechnique;
 		ID3DX11EffectPass* mPass;
-		ID3DX11EffectMatrixVariable* mWvpVariable;
-
-		ID3D11ShaderResourceView* mTextureShaderResourceView;
+		RenderQueue* mRenderQueue;
+		const RenderPass* mRenderPass;
+		FrustumCuller* mFrustumCuller;
+		UINT mCullId;
+		AabbTree* mSceneTree;
+		UINT mSceneProxy;
+		OcclusionCuller* mOcclusionCuller;
+		bool mIsOccluder;
+		OccluderMesh mOccluder;
+
+		AssetLoader* mAssetLoader;
+		std::shared_ptr<ModelHandle> mModelHandle;
+		std::shared_ptr<TextureHandle> mTextureHandle;
 		ID3DX11EffectShaderResourceVariable* mColorTextureVariable;
 
 		ID3D11InputLayout* mInputLayout;
-		ID3D11Buffer* mVertexBuffer;
-		ID3D11Buffer* mIndexBuffer;
-		UINT mIndexCount;
+		std::shared_ptr<ModelBuffer> mModelBuffer;
 
 		XMFLOAT4X4 mWorldMatrix;
+		XMFLOAT4X4 mDequantizationMatrix;
+		std::vector<MeshletDrawRange> mDrawRanges;
+		std::vector<LodSelector> mLodSelectors;
 		float mAngle;
 
 		const std::string modelFile;
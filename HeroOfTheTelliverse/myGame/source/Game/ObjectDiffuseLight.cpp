@@ -7,10 +7,12 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Mesh.h"
+#include "ModelCache.h"
+#include "VertexCompression.h"
 #include "Utility.h"
 #include "DirectionalLight.h"
 #include "Keyboard.h"
-#include <WICTextureLoader.h>
+#include "TextureCache.h"
 #include "ProxyModel.h"
 #include "RenderStateHelper.h"
 #include <SpriteBatch.h>
@@ -26,9 +28,9 @@ namespace Rendering
 
 	ObjectDiffuseLight::ObjectDiffuseLight(Game& game, Camera& camera)
 		: DrawableGameComponent(game, camera), mEffect(nullptr), mMaterial(nullptr), mTextureShaderResourceView(nullptr),
-		  mVertexBuffer(nullptr), mIndexBuffer(nullptr), mIndexCount(0),
+		  mVertexBuffer(nullptr), mIndexBuffer(nullptr), mIndexCount(0), mIndexFormat(DXGI_FORMAT_R32_UINT),
 		  mKeyboard(nullptr), mAmbientColor(1, 1, 1, 0), mDirectionalLight(nullptr),
-		  mWorldMatrix(MatrixHelper::Identity), mProxyModel(nullptr),
+		  mWorldMatrix(MatrixHelper::Identity), mDequantizationMatrix(MatrixHelper::Identity), mProxyModel(nullptr),
 		  mRenderStateHelper(nullptr), mSpriteBatch(nullptr), mSpriteFont(nullptr), mTextPosition(0.0f, 40.0f)
 	{
 	}
@@ -68,7 +70,10 @@ namespace Rendering
 	{
 		SetCurrentDirectory(Utility::ExecutableDirectory().c_str());
 
-		std::unique_ptr<Model> model(new Model(*mGame, "Content\\Models\\house.3ds", true));
+		ModelCache* modelCache = (ModelCache*)mGame->Services().GetService(ModelCache::TypeIdClass());
+		assert(modelCache != nullptr);
+
+		std::shared_ptr<Model> model = modelCache->GetModel("Content\\Models\\house.3ds", true);
 
 		// Initialize the material
 		mEffect = new Effect(*mGame);
@@ -76,20 +81,20 @@ namespace Rendering
 		
 
 
-		mMaterial = new DiffuseLightingMaterial();
+		mMaterial = new DiffuseLightingMaterial(true);
 		mMaterial->Initialize(mEffect);
 
 		Mesh* mesh = model->Meshes().at(0);
-		mMaterial->CreateVertexBuffer(mGame->Direct3DDevice(), *mesh, &mVertexBuffer);
-		mesh->CreateIndexBuffer(&mIndexBuffer);
+		mVertexBuffer = modelCache->GetVertexBuffer(*mesh, *mMaterial);
+		mIndexBuffer = modelCache->GetIndexBuffer(*mesh);
 		mIndexCount = mesh->Indices().size();
+		mIndexFormat = mesh->IndexFormat();
+		XMStoreFloat4x4(&mDequantizationMatrix, VertexCompression::DequantizationMatrix(VertexCompression::ComputeQuantization(*mesh)));
 
 		std::wstring textureName = L"Content\\Textures\\house.bmp";
-		HRESULT hr = DirectX::CreateWICTextureFromFile(mGame->Direct3DDevice(), mGame->Direct3DDeviceContext(), textureName.c_str(), nullptr, &mTextureShaderResourceView);
-		if (FAILED(hr))
-		{
-			throw GameException("CreateWICTextureFromFile() failed.", hr);
-		}
+		TextureCache* textureCache = (TextureCache*)mGame->Services().GetService(TextureCache::TypeIdClass());
+		assert(textureCache != nullptr);
+		mTextureShaderResourceView = textureCache->GetTexture(textureName);
 
 		mDirectionalLight = new DirectionalLight(*mGame);
 		
@@ -128,10 +133,10 @@ namespace Rendering
 		UINT stride = mMaterial->VertexSize();
 		UINT offset = 0;
 		direct3DDeviceContext->IASetVertexBuffers(0, 1, &mVertexBuffer, &stride, &offset);
-		direct3DDeviceContext->IASetIndexBuffer(mIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		direct3DDeviceContext->IASetIndexBuffer(mIndexBuffer, mIndexFormat, 0);
 
 		XMMATRIX worldMatrix = XMLoadFloat4x4(&mWorldMatrix);
-		XMMATRIX wvp = worldMatrix * mCamera->ViewMatrix() * mCamera->ProjectionMatrix();
+		XMMATRIX wvp = XMLoadFloat4x4(&mDequantizationMatrix) * worldMatrix * mCamera->ViewMatrix() * mCamera->ProjectionMatrix();
 		XMVECTOR ambientColor = XMLoadColor(&mAmbientColor);			
 
 		mMaterial->WorldViewProjection() << wvp;
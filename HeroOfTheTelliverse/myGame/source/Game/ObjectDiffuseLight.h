@@ -55,11 +55,13 @@ namespace Rendering
 		ID3D11Buffer* mVertexBuffer;
 		ID3D11Buffer* mIndexBuffer;
 		UINT mIndexCount;
+		DXGI_FORMAT mIndexFormat;
 		
 		XMCOLOR mAmbientColor;
 		DirectionalLight* mDirectionalLight;
 		Keyboard* mKeyboard;
 		XMFLOAT4X4 mWorldMatrix;
+		XMFLOAT4X4 mDequantizationMatrix;
 
 		ProxyModel* mProxyModel;
 
@@ -1,12 +1,25 @@
 #pragma once
 
 #include "DrawableGameComponent.h"
+#include "MeshletBuilder.h"
+#include "ModelBuffer.h"
+#include "LodSelector.h"
 #include <DirectXCollision.h>
 using namespace Library;
 
 namespace Library
 {
 	class Mesh;
+	struct VertexQuantization;
+	class Model;
+	class AssetLoader;
+	class ModelHandle;
+	class TextureHandle;
+	class RenderQueue;
+	struct RenderPass;
+	class FrustumCuller;
+	class AabbTree;
+	class OcclusionCuller;
 	class Keyboard;
 }
 
@@ -42,16 +55,19 @@ namespace Rendering
 		virtual void Initialize() override;
 		virtual void Draw(const GameTime& gameTime) override;
 		Keyboard* mKeyboard;
+		// Leaf in the scene's AabbTree, or AabbTree::NullNode until the model has loaded.
+		UINT SceneProxy() const { return mSceneProxy; }
 		XMFLOAT3 getPosition(); //returns the position of the object
 	private:
+		// Bounds-relative snorm16 position and half2 UV, see VertexCompression.
 		typedef struct _TextureMappingVertex
 		{
-			XMFLOAT4 Position;
-			XMFLOAT2 TextureCoordinates;
+			XMSHORTN4 Position;
+			XMHALF2 TextureCoordinates;
 
 			_TextureMappingVertex() { }
 
-			_TextureMappingVertex(XMFLOAT4 position, XMFLOAT2 textureCoordinates)
+			_TextureMappingVertex(XMSHORTN4 position, XMHALF2 textureCoordinates)
 				: Position(position), TextureCoordinates(textureCoordinates) { }
 		} TextureMappingVertex;
 
@@ -59,22 +75,32 @@ namespace Rendering
 		Player(const Player& rhs);
 		Player& operator=(const Player& rhs);
 
-		void CreateVertexBuffer(ID3D11Device* device, const Mesh& mesh, ID3D11Buffer** vertexBuffer) const;
+		void CreateModelBuffers(Model& model);
+		void WriteVertices(const Mesh& mesh, const VertexQuantization& quantization, TextureMappingVertex* vertices) const;
 
 		ID3DX11Effect* mEffect;
 		ID3DX11EffectTechnique* mTechnique;
 		ID3DX11EffectPass* mPass;
-		ID3DX11EffectMatrixVariable* mWvpVariable;
-
-		ID3D11ShaderResourceView* mTextureShaderResourceView;
+		RenderQueue* mRenderQueue;
+		const RenderPass* mRenderPass;
+		FrustumCuller* mFrustumCuller;
+		UINT mCullId;
+		AabbTree* mSceneTree;
+		UINT mSceneProxy;
+		OcclusionCuller* mOcclusionCuller;
+
+		AssetLoader* mAssetLoader;
+		std::shared_ptr<ModelHandle> mModelHandle;
+		std::shared_ptr<TextureHandle> mTextureHandle;
 		ID3DX11EffectShaderResourceVariable* mColorTextureVariable;
 
 		ID3D11InputLayout* mInputLayout;
-		ID3D11Buffer* mVertexBuffer;
-		ID3D11Buffer* mIndexBuffer;
-		UINT mIndexCount;
+		std::shared_ptr<ModelBuffer> mModelBuffer;
 
 		XMFLOAT4X4 mWorldMatrix;
+		XMFLOAT4X4 mDequantizationMatrix;
+		std::vector<MeshletDrawRange> mDrawRanges;
+		std::vector<LodSelector> mLodSelectors;
 		float mAngle;
 
 		const std::string modelFile;
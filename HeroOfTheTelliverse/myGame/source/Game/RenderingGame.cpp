@@ -8,6 +8,16 @@
 #include "Player.h"
 #include "FpsComponent.h"
 #include "RenderStateHelper.h"
+#include "ModelCache.h"
+#include "ThreadPool.h"
+#include "AssetLoader.h"
+#include "TextureCache.h"
+#include "RenderQueue.h"
+#include "FrustumCuller.h"
+#include "AabbTree.h"
+#include "OcclusionCuller.h"
+#include "ContentManifest.h"
+#include "Utility.h"
 #include "ModelDefinitions.h" //this is a header file that contains defines for all of the links to models and textures
 #include <iostream>
 using namespace std;
@@ -18,8 +28,8 @@ namespace Rendering
 	const XMFLOAT4 RenderingGame::BackgroundColor = { 0.5f, 0.5f, 0.5f, 1.0f };
 
 	RenderingGame::RenderingGame(HINSTANCE instance, const std::wstring& windowClass, const std::wstring& windowTitle, int showCommand)
-		: Game(instance, windowClass, windowTitle, showCommand), mDirectInput(nullptr), mKeyboard(nullptr), mMouse(nullptr), mModel(nullptr), mPlayer(nullptr),
-		mFpsComponent(nullptr), mRenderStateHelper(nullptr), mDemo(nullptr)
+		: Game(instance, windowClass, windowTitle, showCommand), mDirectInput(nullptr), mKeyboard(nullptr), mMouse(nullptr), mModel(nullptr), mKitchenCounter(nullptr), mPlayer(nullptr),
+		mFpsComponent(nullptr), mRenderStateHelper(nullptr), mDemo(nullptr), mThreadPool(nullptr), mModelCache(nullptr), mTextureCache(nullptr), mRenderQueue(nullptr), mFrustumCuller(nullptr), mSceneTree(nullptr), mOcclusionCuller(nullptr), mAssetLoader(nullptr), mContentManifest(nullptr)
 	{
 		mDepthStencilBufferEnabled = true;
 		mMultiSamplingEnabled = true;
@@ -52,6 +62,51 @@ namespace Rendering
 		mComponents.push_back(mMouse);
 		mServices.AddService(Mouse::TypeIdClass(), mMouse);
 
+		// Cooked artifacts listed by the ContentCooker; without a manifest everything loads from source
+		SetCurrentDirectory(Utility::ExecutableDirectory().c_str());
+		mContentManifest = new ContentManifest("Content");
+		try
+		{
+			mContentManifest->Load();
+		}
+		catch (GameException& ex)
+		{
+			// A damaged or outdated manifest only costs load time, so start from an empty one
+			std::string message = mContentManifest->Root() + ContentManifest::Filename + ": " + ex.what() + " Loading content from source.\n";
+			OutputDebugStringA(message.c_str());
+			DeleteObject(mContentManifest);
+			mContentManifest = new ContentManifest("Content");
+		}
+		mServices.AddService(ContentManifest::TypeIdClass(), mContentManifest);
+
+		mThreadPool = new ThreadPool();
+		mServices.AddService(ThreadPool::TypeIdClass(), mThreadPool);
+
+		mModelCache = new ModelCache(*this);
+		mServices.AddService(ModelCache::TypeIdClass(), mModelCache);
+
+		mTextureCache = new TextureCache(*this);
+		mServices.AddService(TextureCache::TypeIdClass(), mTextureCache);
+
+		mAssetLoader = new AssetLoader(*this, *mThreadPool, *mModelCache, *mTextureCache);
+		mServices.AddService(AssetLoader::TypeIdClass(), mAssetLoader);
+
+		// Models submit their draws here; Draw issues them sorted by state once every component has run
+		mRenderQueue = new RenderQueue(*this);
+		mServices.AddService(RenderQueue::TypeIdClass(), mRenderQueue);
+
+		// Drawables register their world bounds; Draw culls them all against the camera at once
+		mFrustumCuller = new FrustumCuller();
+		mServices.AddService(FrustumCuller::TypeIdClass(), mFrustumCuller);
+
+		// Scene-wide spatial index for collision and picking queries; components keep their bounds in it
+		mSceneTree = new AabbTree();
+		mServices.AddService(AabbTree::TypeIdClass(), mSceneTree);
+
+		// Large props draw themselves into a CPU depth buffer; anything fully behind them is skipped
+		mOcclusionCuller = new OcclusionCuller(*mThreadPool);
+		mServices.AddService(OcclusionCuller::TypeIdClass(), mOcclusionCuller);
+
 		//--------------------------------------DRAWING-------------------------------------------------------------//
 		//(rotx,roty,rotz,scale,posx,posy,posz)
 		//mModel->clearTexture();
@@ -89,6 +144,7 @@ namespace Rendering
 		mKitchenCounter->SetPosition(0.0f, 180, 0.0f, 0.8f, 0.0f, -6.0f, -10.0f);
 		//mModel->setScale(1.0f, 1.0f, 1.0f);
 		mKitchenCounter->setTexture(TKITCHENCOUNTER);
+		mKitchenCounter->setOccluder(true);
 		mComponents.push_back(mKitchenCounter);
 
 		//////////Box on Counter
@@ -123,6 +179,10 @@ namespace Rendering
 
 	void RenderingGame::Shutdown()
 	{
+		// Components unregister from the culling services and the scene tree as they go, so they go first
+		DeleteObject(mModel);
+		DeleteObject(mKitchenCounter);
+		DeleteObject(mPlayer);
 		DeleteObject(mDemo);
 		DeleteObject(mCamera);
 		DeleteObject(mKeyboard);
@@ -130,12 +190,15 @@ namespace Rendering
 		ReleaseObject(mDirectInput);
 		DeleteObject(mFpsComponent);
 		DeleteObject(mRenderStateHelper);
-
-
-		DeleteObject(mModel);
-
-
-
+		DeleteObject(mOcclusionCuller);
+		DeleteObject(mSceneTree);
+		DeleteObject(mFrustumCuller);
+		DeleteObject(mRenderQueue);
+		DeleteObject(mAssetLoader);
+		DeleteObject(mTextureCache);
+		DeleteObject(mModelCache);
+		DeleteObject(mThreadPool);
+		DeleteObject(mContentManifest);
 
 		Game::Shutdown();
 	}
@@ -147,13 +210,33 @@ namespace Rendering
 		mCamera->SetPositionCamera(mPlayer->getPosition());
 		Game::Update(gameTime);
 
+		// Components keep their own references to the buffers and textures they use, so the
+		// CPU-side mesh data can go once every requested model has been uploaded.
+		if (mAssetLoader->PendingCount() == 0 && mModelCache->ModelCount() > 0)
+		{
+			mModelCache->Trim();
+			mTextureCache->Trim();
+		}
+
 		mFpsComponent->Update(gameTime);
 
 		if (mKeyboard->WasKeyPressedThisFrame(DIK_ESCAPE))
 		{
 			Exit();
 		}
-		if (mPlayer->mBoundingBox.Intersects(mModel->mBoundingBox)) {
+		// Anything the player touches, found through the scene tree rather than hand-picked pairs
+		bool colliding = false;
+		UINT playerProxy = mPlayer->SceneProxy();
+		if (playerProxy != AabbTree::NullNode)
+		{
+			mSceneTree->QueryOverlap(mSceneTree->Bounds(playerProxy), [&](UINT proxy)
+			{
+				colliding = (proxy != playerProxy);
+				return (colliding == false);
+			});
+		}
+
+		if (colliding) {
 			cout << "Colliding";
 		}
 		else {
@@ -167,7 +250,10 @@ namespace Rendering
 		mDirect3DDeviceContext->ClearRenderTargetView(mRenderTargetView, reinterpret_cast<const float*>(&BackgroundColor));
 		mDirect3DDeviceContext->ClearDepthStencilView(mDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
+		mFrustumCuller->Cull(*mCamera);
+		mOcclusionCuller->Rasterize(mCamera->ViewProjectionMatrix());
 		Game::Draw(gameTime);
+		mRenderQueue->Flush(mDirect3DDeviceContext);
 
 		mRenderStateHelper->SaveAll();
 		mFpsComponent->Draw(gameTime);
@@ -14,6 +14,15 @@ namespace Library
 	class Mouse;
 
 	class FpsComponent;
+	class ModelCache;
+	class ThreadPool;
+	class TextureCache;
+	class RenderQueue;
+	class FrustumCuller;
+	class AabbTree;
+	class OcclusionCuller;
+	class AssetLoader;
+	class ContentManifest;
 
 }
 
@@ -50,6 +59,15 @@ namespace Rendering
 
 		FpsComponent* mFpsComponent;
 		RenderStateHelper* mRenderStateHelper;
+		ThreadPool* mThreadPool;
+		ModelCache* mModelCache;
+		TextureCache* mTextureCache;
+		RenderQueue* mRenderQueue;
+		FrustumCuller* mFrustumCuller;
+		AabbTree* mSceneTree;
+		OcclusionCuller* mOcclusionCuller;
+		AssetLoader* mAssetLoader;
+		ContentManifest* mContentManifest;
 
 
 
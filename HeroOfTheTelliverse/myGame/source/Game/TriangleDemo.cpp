@@ -6,7 +6,7 @@
 #include "Utility.h"
 #include "D3DCompiler.h"
 #include <iostream>
-#include "WICTextureLoader.h"
+#include "TextureCache.h"
 
 namespace Rendering
 {
@@ -199,10 +199,9 @@ namespace Rendering
 
 		//Loading texture map from file
 		std::wstring textureName = L"Content\\Textures\\tiles.jpg";
-		if (FAILED(hr = DirectX::CreateWICTextureFromFile(mGame->Direct3DDevice(), mGame->Direct3DDeviceContext(), textureName.c_str(), nullptr, &mTextureShaderResourceView)))
-		{
-			throw GameException("CreateWICTextureFromFile() failed.", hr);
-		}
+		TextureCache* textureCache = (TextureCache*)mGame->Services().GetService(TextureCache::TypeIdClass());
+		assert(textureCache != nullptr);
+		mTextureShaderResourceView = textureCache->GetTexture(textureName);
 
 
 
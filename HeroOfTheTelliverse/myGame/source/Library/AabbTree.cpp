@@ -0,0 +1,612 @@
+#include "AabbTree.h"
+#include "FrustumCuller.h"
+#include <algorithm>
+#include <climits>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(AabbTree)
+
+    const UINT AabbTree::NullNode = UINT_MAX;
+
+    namespace
+    {
+        const UINT PlaneCount = 6;
+
+        enum Containment
+        {
+            ContainmentOutside,
+            ContainmentIntersects,
+            ContainmentInside
+        };
+
+        float SurfaceArea(FXMVECTOR min, FXMVECTOR max)
+        {
+            XMVECTOR size = XMVectorSubtract(max, min);
+            return 2.0f * XMVectorGetX(XMVector3Dot(size, XMVectorSwizzle<1, 2, 0, 3>(size)));
+        }
+
+        float UnionArea(FXMVECTOR firstMin, FXMVECTOR firstMax, FXMVECTOR secondMin, CXMVECTOR secondMax)
+        {
+            return SurfaceArea(XMVectorMin(firstMin, secondMin), XMVectorMax(firstMax, secondMax));
+        }
+
+        bool Overlaps(FXMVECTOR firstMin, FXMVECTOR firstMax, FXMVECTOR secondMin, CXMVECTOR secondMax)
+        {
+            return (XMVector3LessOrEqual(firstMin, secondMax) && XMVector3LessOrEqual(secondMin, firstMax));
+        }
+
+        bool Contains(FXMVECTOR outerMin, FXMVECTOR outerMax, FXMVECTOR innerMin, CXMVECTOR innerMax)
+        {
+            return (XMVector3LessOrEqual(outerMin, innerMin) && XMVector3LessOrEqual(innerMax, outerMax));
+        }
+
+        bool OverlapsSphere(FXMVECTOR min, FXMVECTOR max, FXMVECTOR center, float radius)
+        {
+            XMVECTOR closest = XMVectorClamp(center, min, max);
+            return (XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(center, closest))) <= radius * radius);
+        }
+
+        Containment ClassifyBox(const XMVECTOR* planes, const XMVECTOR* absolutePlanes, FXMVECTOR min, FXMVECTOR max)
+        {
+            XMVECTOR center = XMVectorSetW(XMVectorScale(XMVectorAdd(min, max), 0.5f), 1.0f);
+            XMVECTOR extents = XMVectorScale(XMVectorSubtract(max, min), 0.5f);
+
+            Containment containment = ContainmentInside;
+            for (UINT i = 0; i < PlaneCount; i++)
+            {
+                float distance = XMVectorGetX(XMVector4Dot(planes[i], center));
+                float radius = XMVectorGetX(XMVector3Dot(absolutePlanes[i], extents));
+                if (distance + radius < 0.0f)
+                {
+                    return ContainmentOutside;
+                }
+
+                if (distance - radius < 0.0f)
+                {
+                    containment = ContainmentIntersects;
+                }
+            }
+
+            return containment;
+        }
+
+        // Slab test; distance is where the ray enters the box, or zero when it starts inside.
+        bool RayHitsBox(FXMVECTOR origin, FXMVECTOR inverseDirection, FXMVECTOR min, CXMVECTOR max, float maxDistance, float& distance)
+        {
+            XMVECTOR first = XMVectorMultiply(XMVectorSubtract(min, origin), inverseDirection);
+            XMVECTOR second = XMVectorMultiply(XMVectorSubtract(max, origin), inverseDirection);
+            XMVECTOR nearest = XMVectorMin(first, second);
+            XMVECTOR farthest = XMVectorMax(first, second);
+
+            float enter = std::max(std::max(XMVectorGetX(nearest), XMVectorGetY(nearest)), std::max(XMVectorGetZ(nearest), 0.0f));
+            float exit = std::min(std::min(XMVectorGetX(farthest), XMVectorGetY(farthest)), std::min(XMVectorGetZ(farthest), maxDistance));
+            distance = enter;
+
+            return (enter <= exit);
+        }
+    }
+
+    AabbTree::AabbTree(float margin)
+        : mNodes(), mRoot(NullNode), mFreeList(NullNode), mProxyCount(0), mMargin(margin)
+    {
+    }
+
+    UINT AabbTree::CreateProxy(const BoundingBox& bounds, void* userData)
+    {
+        UINT proxy = AllocateNode();
+        Node& node = mNodes[proxy];
+
+        XMVECTOR center = XMLoadFloat3(&bounds.Center);
+        XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+        XMVECTOR margin = XMVectorReplicate(mMargin);
+        XMStoreFloat4(&node.LeafMin, XMVectorSubtract(center, extents));
+        XMStoreFloat4(&node.LeafMax, XMVectorAdd(center, extents));
+        XMStoreFloat4(&node.Min, XMVectorSubtract(XMVectorSubtract(center, extents), margin));
+        XMStoreFloat4(&node.Max, XMVectorAdd(XMVectorAdd(center, extents), margin));
+        node.UserData = userData;
+
+        InsertLeaf(proxy);
+        mProxyCount++;
+
+        return proxy;
+    }
+
+    void AabbTree::DestroyProxy(UINT proxy)
+    {
+        assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf());
+
+        RemoveLeaf(proxy);
+        FreeNode(proxy);
+        mProxyCount--;
+    }
+
+    bool AabbTree::MoveProxy(UINT proxy, const BoundingBox& bounds)
+    {
+        assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf());
+
+        XMVECTOR center = XMLoadFloat3(&bounds.Center);
+        XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+        XMVECTOR min = XMVectorSubtract(center, extents);
+        XMVECTOR max = XMVectorAdd(center, extents);
+        XMStoreFloat4(&mNodes[proxy].LeafMin, min);
+        XMStoreFloat4(&mNodes[proxy].LeafMax, max);
+
+        XMVECTOR fatMin = XMLoadFloat4(&mNodes[proxy].Min);
+        XMVECTOR fatMax = XMLoadFloat4(&mNodes[proxy].Max);
+        if (Contains(fatMin, fatMax, min, max))
+        {
+            return false;
+        }
+
+        XMVECTOR margin = XMVectorReplicate(mMargin);
+        min = XMVectorSubtract(min, margin);
+        max = XMVectorAdd(max, margin);
+
+        // Objects that moved a little stay where they are and grow their ancestors; one that
+        // jumped clear of its old bounds is better off placed anew.
+        if (Overlaps(fatMin, fatMax, min, max))
+        {
+            XMStoreFloat4(&mNodes[proxy].Min, min);
+            XMStoreFloat4(&mNodes[proxy].Max, max);
+            Refit(mNodes[proxy].Parent);
+        }
+        else
+        {
+            RemoveLeaf(proxy);
+            XMStoreFloat4(&mNodes[proxy].Min, min);
+            XMStoreFloat4(&mNodes[proxy].Max, max);
+            InsertLeaf(proxy);
+        }
+
+        return true;
+    }
+
+    void* AabbTree::UserData(UINT proxy) const
+    {
+        assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf());
+
+        return mNodes[proxy].UserData;
+    }
+
+    BoundingBox AabbTree::Bounds(UINT proxy) const
+    {
+        assert(proxy < mNodes.size() && mNodes[proxy].IsLeaf());
+
+        BoundingBox bounds;
+        BoundingBox::CreateFromPoints(bounds, XMLoadFloat4(&mNodes[proxy].LeafMin), XMLoadFloat4(&mNodes[proxy].LeafMax));
+
+        return bounds;
+    }
+
+    UINT AabbTree::ProxyCount() const
+    {
+        return mProxyCount;
+    }
+
+    UINT AabbTree::Height() const
+    {
+        return (mRoot != NullNode ? mNodes[mRoot].Height : 0);
+    }
+
+    void AabbTree::QueryOverlap(const BoundingBox& bounds, const QueryCallback& callback) const
+    {
+        if (mRoot == NullNode)
+        {
+            return;
+        }
+
+        XMVECTOR center = XMLoadFloat3(&bounds.Center);
+        XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+        XMVECTOR min = XMVectorSubtract(center, extents);
+        XMVECTOR max = XMVectorAdd(center, extents);
+
+        std::vector<UINT> stack(1, mRoot);
+        while (stack.empty() == false)
+        {
+            UINT index = stack.back();
+            stack.pop_back();
+            const Node& node = mNodes[index];
+
+            if (Overlaps(XMLoadFloat4(&node.Min), XMLoadFloat4(&node.Max), min, max) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (Overlaps(XMLoadFloat4(&node.LeafMin), XMLoadFloat4(&node.LeafMax), min, max) && callback(index) == false)
+                {
+                    return;
+                }
+            }
+            else
+            {
+                stack.push_back(node.Child1);
+                stack.push_back(node.Child2);
+            }
+        }
+    }
+
+    void AabbTree::QuerySphere(const BoundingSphere& sphere, const QueryCallback& callback) const
+    {
+        if (mRoot == NullNode)
+        {
+            return;
+        }
+
+        XMVECTOR center = XMLoadFloat3(&sphere.Center);
+
+        std::vector<UINT> stack(1, mRoot);
+        while (stack.empty() == false)
+        {
+            UINT index = stack.back();
+            stack.pop_back();
+            const Node& node = mNodes[index];
+
+            if (OverlapsSphere(XMLoadFloat4(&node.Min), XMLoadFloat4(&node.Max), center, sphere.Radius) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (OverlapsSphere(XMLoadFloat4(&node.LeafMin), XMLoadFloat4(&node.LeafMax), center, sphere.Radius) && callback(index) == false)
+                {
+                    return;
+                }
+            }
+            else
+            {
+                stack.push_back(node.Child1);
+                stack.push_back(node.Child2);
+            }
+        }
+    }
+
+    void AabbTree::QueryFrustum(FXMMATRIX viewProjection, const QueryCallback& callback) const
+    {
+        if (mRoot == NullNode)
+        {
+            return;
+        }
+
+        XMFLOAT4 planeValues[PlaneCount];
+        FrustumCuller::ExtractPlanes(viewProjection, planeValues);
+
+        XMVECTOR planes[PlaneCount];
+        XMVECTOR absolutePlanes[PlaneCount];
+        for (UINT i = 0; i < PlaneCount; i++)
+        {
+            planes[i] = XMLoadFloat4(&planeValues[i]);
+            absolutePlanes[i] = XMVectorAbs(planes[i]);
+        }
+
+        // Subtrees entirely inside are reported without testing anything further down.
+        std::vector<UINT> stack(1, mRoot);
+        std::vector<UINT> insideStack;
+        while (stack.empty() == false)
+        {
+            UINT index = stack.back();
+            stack.pop_back();
+            const Node& node = mNodes[index];
+
+            Containment containment = ClassifyBox(planes, absolutePlanes, XMLoadFloat4(&node.Min), XMLoadFloat4(&node.Max));
+            if (containment == ContainmentOutside)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (ClassifyBox(planes, absolutePlanes, XMLoadFloat4(&node.LeafMin), XMLoadFloat4(&node.LeafMax)) != ContainmentOutside && callback(index) == false)
+                {
+                    return;
+                }
+            }
+            else if (containment == ContainmentIntersects)
+            {
+                stack.push_back(node.Child1);
+                stack.push_back(node.Child2);
+            }
+            else
+            {
+                insideStack.assign(1, index);
+                while (insideStack.empty() == false)
+                {
+                    UINT insideIndex = insideStack.back();
+                    insideStack.pop_back();
+                    const Node& insideNode = mNodes[insideIndex];
+
+                    if (insideNode.IsLeaf())
+                    {
+                        if (callback(insideIndex) == false)
+                        {
+                            return;
+                        }
+                    }
+                    else
+                    {
+                        insideStack.push_back(insideNode.Child1);
+                        insideStack.push_back(insideNode.Child2);
+                    }
+                }
+            }
+        }
+    }
+
+    void AabbTree::RayCast(FXMVECTOR origin, FXMVECTOR direction, float maxDistance, const RayCastCallback& callback) const
+    {
+        if (mRoot == NullNode)
+        {
+            return;
+        }
+
+        XMVECTOR inverseDirection = XMVectorReciprocal(direction);
+
+        std::vector<UINT> stack(1, mRoot);
+        while (stack.empty() == false)
+        {
+            UINT index = stack.back();
+            stack.pop_back();
+            const Node& node = mNodes[index];
+
+            float distance;
+            if (RayHitsBox(origin, inverseDirection, XMLoadFloat4(&node.Min), XMLoadFloat4(&node.Max), maxDistance, distance) == false)
+            {
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                if (RayHitsBox(origin, inverseDirection, XMLoadFloat4(&node.LeafMin), XMLoadFloat4(&node.LeafMax), maxDistance, distance))
+                {
+                    float value = callback(index, distance);
+                    if (value <= 0.0f)
+                    {
+                        return;
+                    }
+
+                    maxDistance = std::min(maxDistance, value);
+                }
+            }
+            else
+            {
+                stack.push_back(node.Child1);
+                stack.push_back(node.Child2);
+            }
+        }
+    }
+
+    UINT AabbTree::AllocateNode()
+    {
+        UINT index;
+        if (mFreeList == NullNode)
+        {
+            mNodes.push_back(Node());
+            index = static_cast<UINT>(mNodes.size() - 1);
+        }
+        else
+        {
+            index = mFreeList;
+            mFreeList = mNodes[index].Parent;
+        }
+
+        Node& node = mNodes[index];
+        ZeroMemory(&node, sizeof(node));
+        node.Parent = NullNode;
+        node.Child1 = NullNode;
+        node.Child2 = NullNode;
+
+        return index;
+    }
+
+    void AabbTree::FreeNode(UINT index)
+    {
+        mNodes[index].Parent = mFreeList;
+        mFreeList = index;
+    }
+
+    void AabbTree::InsertLeaf(UINT leaf)
+    {
+        if (mRoot == NullNode)
+        {
+            mRoot = leaf;
+            mNodes[leaf].Parent = NullNode;
+            return;
+        }
+
+        // Walk down towards the sibling whose union with the leaf costs least, counting the area
+        // every ancestor grows by on the way; stop once pairing with the current node is cheaper.
+        XMVECTOR leafMin = XMLoadFloat4(&mNodes[leaf].Min);
+        XMVECTOR leafMax = XMLoadFloat4(&mNodes[leaf].Max);
+
+        UINT index = mRoot;
+        while (mNodes[index].IsLeaf() == false)
+        {
+            const Node& node = mNodes[index];
+            XMVECTOR nodeMin = XMLoadFloat4(&node.Min);
+            XMVECTOR nodeMax = XMLoadFloat4(&node.Max);
+
+            float area = SurfaceArea(nodeMin, nodeMax);
+            float combinedArea = UnionArea(nodeMin, nodeMax, leafMin, leafMax);
+            float cost = 2.0f * combinedArea;
+            float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float childCosts[2];
+            const UINT children[2] = { node.Child1, node.Child2 };
+            for (UINT i = 0; i < 2; i++)
+            {
+                const Node& child = mNodes[children[i]];
+                XMVECTOR childMin = XMLoadFloat4(&child.Min);
+                XMVECTOR childMax = XMLoadFloat4(&child.Max);
+                childCosts[i] = UnionArea(childMin, childMax, leafMin, leafMax) + inheritanceCost;
+                if (child.IsLeaf() == false)
+                {
+                    childCosts[i] -= SurfaceArea(childMin, childMax);
+                }
+            }
+
+            if (cost < childCosts[0] && cost < childCosts[1])
+            {
+                break;
+            }
+
+            index = (childCosts[0] < childCosts[1] ? children[0] : children[1]);
+        }
+
+        UINT sibling = index;
+        UINT oldParent = mNodes[sibling].Parent;
+        UINT newParent = AllocateNode();
+
+        mNodes[newParent].Parent = oldParent;
+        mNodes[newParent].Child1 = sibling;
+        mNodes[newParent].Child2 = leaf;
+        mNodes[sibling].Parent = newParent;
+        mNodes[leaf].Parent = newParent;
+
+        if (oldParent == NullNode)
+        {
+            mRoot = newParent;
+        }
+        else if (mNodes[oldParent].Child1 == sibling)
+        {
+            mNodes[oldParent].Child1 = newParent;
+        }
+        else
+        {
+            mNodes[oldParent].Child2 = newParent;
+        }
+
+        Refit(newParent);
+    }
+
+    void AabbTree::RemoveLeaf(UINT leaf)
+    {
+        if (leaf == mRoot)
+        {
+            mRoot = NullNode;
+            return;
+        }
+
+        UINT parent = mNodes[leaf].Parent;
+        UINT grandParent = mNodes[parent].Parent;
+        UINT sibling = (mNodes[parent].Child1 == leaf ? mNodes[parent].Child2 : mNodes[parent].Child1);
+
+        if (grandParent == NullNode)
+        {
+            mRoot = sibling;
+            mNodes[sibling].Parent = NullNode;
+            FreeNode(parent);
+            return;
+        }
+
+        if (mNodes[grandParent].Child1 == parent)
+        {
+            mNodes[grandParent].Child1 = sibling;
+        }
+        else
+        {
+            mNodes[grandParent].Child2 = sibling;
+        }
+
+        mNodes[sibling].Parent = grandParent;
+        FreeNode(parent);
+        Refit(grandParent);
+    }
+
+    void AabbTree::Refit(UINT index)
+    {
+        while (index != NullNode)
+        {
+            UpdateNode(index);
+            Rotate(index);
+            index = mNodes[index].Parent;
+        }
+    }
+
+    void AabbTree::Rotate(UINT index)
+    {
+        // Swapping one child with a child of the other leaves this node's bounds alone but
+        // changes the other child's; take the swap that shrinks it the most, if any does.
+        const Node& node = mNodes[index];
+        if (node.IsLeaf())
+        {
+            return;
+        }
+
+        float bestGain = 0.0f;
+        UINT bestChild = NullNode;
+        UINT bestGrandChild = NullNode;
+
+        const UINT children[2] = { node.Child1, node.Child2 };
+        for (UINT i = 0; i < 2; i++)
+        {
+            const Node& child = mNodes[children[i]];
+            const Node& other = mNodes[children[1 - i]];
+            if (other.IsLeaf())
+            {
+                continue;
+            }
+
+            float otherArea = SurfaceArea(XMLoadFloat4(&other.Min), XMLoadFloat4(&other.Max));
+            const UINT grandChildren[2] = { other.Child1, other.Child2 };
+            for (UINT j = 0; j < 2; j++)
+            {
+                // The other child would end up holding this child and the grandchild that stays
+                const Node& remaining = mNodes[grandChildren[1 - j]];
+                float gain = otherArea - UnionArea(XMLoadFloat4(&child.Min), XMLoadFloat4(&child.Max), XMLoadFloat4(&remaining.Min), XMLoadFloat4(&remaining.Max));
+                if (gain > bestGain)
+                {
+                    bestGain = gain;
+                    bestChild = children[i];
+                    bestGrandChild = grandChildren[j];
+                }
+            }
+        }
+
+        if (bestChild == NullNode)
+        {
+            return;
+        }
+
+        UINT other = mNodes[bestGrandChild].Parent;
+        Node& parentNode = mNodes[index];
+        Node& otherNode = mNodes[other];
+
+        if (parentNode.Child1 == bestChild)
+        {
+            parentNode.Child1 = bestGrandChild;
+        }
+        else
+        {
+            parentNode.Child2 = bestGrandChild;
+        }
+
+        if (otherNode.Child1 == bestGrandChild)
+        {
+            otherNode.Child1 = bestChild;
+        }
+        else
+        {
+            otherNode.Child2 = bestChild;
+        }
+
+        mNodes[bestGrandChild].Parent = index;
+        mNodes[bestChild].Parent = other;
+
+        UpdateNode(other);
+        UpdateNode(index);
+    }
+
+    void AabbTree::UpdateNode(UINT index)
+    {
+        Node& node = mNodes[index];
+        const Node& first = mNodes[node.Child1];
+        const Node& second = mNodes[node.Child2];
+
+        XMStoreFloat4(&node.Min, XMVectorMin(XMLoadFloat4(&first.Min), XMLoadFloat4(&second.Min)));
+        XMStoreFloat4(&node.Max, XMVectorMax(XMLoadFloat4(&first.Max), XMLoadFloat4(&second.Max)));
+        node.Height = 1 + std::max(first.Height, second.Height);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Common.h"
+#include <DirectXCollision.h>
+#include <functional>
+
+namespace Library
+{
+    // A dynamic bounding volume hierarchy over the scene's objects. Each object is a leaf (a
+    // proxy) holding its bounds and a user pointer; internal nodes hold the union of their
+    // children. Leaves are stored with a margin around them, so small movements don't touch the
+    // tree at all. Larger ones refit the ancestors in place, and every node on the way up is
+    // rotated when swapping a child with a grandchild shrinks the tree's surface area.
+    class AabbTree : public RTTI
+    {
+        RTTI_DECLARATIONS(AabbTree, RTTI)
+
+    public:
+        static const UINT NullNode;
+
+        // Return false to end the query early.
+        typedef std::function<bool(UINT proxy)> QueryCallback;
+
+        // Given the distance at which the ray enters the proxy's bounds, returns how far the ray
+        // should go on: that distance to look only for nearer hits, the current maximum to keep
+        // going, or zero to stop.
+        typedef std::function<float(UINT proxy, float distance)> RayCastCallback;
+
+        AabbTree(float margin = 0.1f);
+
+        UINT CreateProxy(const BoundingBox& bounds, void* userData);
+        void DestroyProxy(UINT proxy);
+
+        // Returns true when the tree had to change, false when the padded bounds still held it.
+        bool MoveProxy(UINT proxy, const BoundingBox& bounds);
+
+        void* UserData(UINT proxy) const;
+        BoundingBox Bounds(UINT proxy) const;
+
+        UINT ProxyCount() const;
+        UINT Height() const;
+
+        // Queries test the exact bounds each proxy was last given, not the padded ones.
+        void QueryOverlap(const BoundingBox& bounds, const QueryCallback& callback) const;
+        void QuerySphere(const BoundingSphere& sphere, const QueryCallback& callback) const;
+        void QueryFrustum(FXMMATRIX viewProjection, const QueryCallback& callback) const;
+        void RayCast(FXMVECTOR origin, FXMVECTOR direction, float maxDistance, const RayCastCallback& callback) const;
+
+    private:
+        struct Node
+        {
+            // Padded for leaves, the children's union for internal nodes.
+            XMFLOAT4 Min;
+            XMFLOAT4 Max;
+
+            // Exact bounds; leaves only.
+            XMFLOAT4 LeafMin;
+            XMFLOAT4 LeafMax;
+
+            UINT Parent; // Next free node while on the free list.
+            UINT Child1;
+            UINT Child2;
+            UINT Height; // Zero for leaves.
+            void* UserData;
+
+            bool IsLeaf() const { return (Child1 == NullNode); }
+        };
+
+        AabbTree(const AabbTree& rhs);
+        AabbTree& operator=(const AabbTree& rhs);
+
+        UINT AllocateNode();
+        void FreeNode(UINT index);
+
+        void InsertLeaf(UINT leaf);
+        void RemoveLeaf(UINT leaf);
+        void Refit(UINT index);
+        void Rotate(UINT index);
+        void UpdateNode(UINT index);
+
+        std::vector<Node> mNodes;
+        UINT mRoot;
+        UINT mFreeList;
+        UINT mProxyCount;
+        float mMargin;
+    };
+}
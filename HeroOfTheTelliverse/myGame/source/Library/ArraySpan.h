@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace Library
+{
+    // Non-owning view over a contiguous run of T. Mirrors the read side of std::vector so code
+    // written against vectors (size(), at(), operator[], range-for) works on it unchanged.
+    template <typename T>
+    class ArraySpan
+    {
+    public:
+        ArraySpan()
+            : mData(nullptr), mSize(0)
+        {
+        }
+
+        ArraySpan(T* data, size_t size)
+            : mData(data), mSize(size)
+        {
+        }
+
+        // Spans of T convert to spans of const T, and vectors convert to either.
+        template <typename U>
+        ArraySpan(const ArraySpan<U>& rhs)
+            : mData(rhs.data()), mSize(rhs.size())
+        {
+        }
+
+        template <typename U>
+        ArraySpan(std::vector<U>& data)
+            : mData(data.data()), mSize(data.size())
+        {
+        }
+
+        template <typename U>
+        ArraySpan(const std::vector<U>& data)
+            : mData(data.data()), mSize(data.size())
+        {
+        }
+
+        T* data() const { return mData; }
+        size_t size() const { return mSize; }
+        bool empty() const { return (mSize == 0); }
+
+        T* begin() const { return mData; }
+        T* end() const { return mData + mSize; }
+
+        T& operator[](size_t index) const { return mData[index]; }
+
+        T& at(size_t index) const
+        {
+            if (index >= mSize)
+            {
+                throw std::out_of_range("ArraySpan index out of range.");
+            }
+
+            return mData[index];
+        }
+
+    private:
+        T* mData;
+        size_t mSize;
+    };
+}
@@ -0,0 +1,429 @@
+#include "AssetLoader.h"
+#include "Game.h"
+#include "GameException.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "ModelCache.h"
+#include "ThreadPool.h"
+#include "TextureCache.h"
+#include "Utility.h"
+
+namespace Library
+{
+    RTTI_DEFINITIONS(AssetLoader)
+
+    const UINT AssetLoader::DefaultUploadBudget = 8 * 1024 * 1024;
+    const std::wstring AssetLoader::PlaceholderTextureFilename = L"Content\\Textures\\missing.jpg";
+
+    namespace
+    {
+        void ReportFailure(const std::string& filename, const std::string& error)
+        {
+            std::string message = "AssetLoader: could not load " + filename + ": " + error + "\n";
+            OutputDebugStringA(message.c_str());
+        }
+
+        // Rough size of what the model's buffers will hand the device.
+        UINT ModelUploadCost(const Model& model)
+        {
+            UINT cost = 0;
+            for (Mesh* mesh : model.Meshes())
+            {
+                cost += static_cast<UINT>(mesh->Vertices().size() * sizeof(XMFLOAT3) * 2);
+                cost += static_cast<UINT>((mesh->Indices().size() + mesh->LodIndices().size()) * mesh->IndexSize());
+            }
+
+            return cost;
+        }
+    }
+
+    TextureHandle::TextureHandle(const std::wstring& filename)
+        : mFilename(filename), mState(AssetStatePending), mError(), mShaderResourceView(nullptr)
+    {
+    }
+
+    TextureHandle::~TextureHandle()
+    {
+        ReleaseObject(mShaderResourceView);
+    }
+
+    AssetState TextureHandle::State() const
+    {
+        return mState;
+    }
+
+    const std::wstring& TextureHandle::Filename() const
+    {
+        return mFilename;
+    }
+
+    const std::string& TextureHandle::Error() const
+    {
+        return mError;
+    }
+
+    ID3D11ShaderResourceView* TextureHandle::ShaderResourceView() const
+    {
+        return mShaderResourceView;
+    }
+
+    ModelHandle::ModelHandle(const std::string& filename, const UploadCallback& upload)
+        : mFilename(filename), mState(AssetStatePending), mError(), mUpload(upload)
+    {
+    }
+
+    AssetState ModelHandle::State() const
+    {
+        return mState;
+    }
+
+    const std::string& ModelHandle::Filename() const
+    {
+        return mFilename;
+    }
+
+    const std::string& ModelHandle::Error() const
+    {
+        return mError;
+    }
+
+    AssetLoader::AssetLoader(Game& game, ThreadPool& threadPool, ModelCache& modelCache, TextureCache& textureCache, UINT uploadBudget)
+        : mGame(game), mThreadPool(threadPool), mModelCache(modelCache), mTextureCache(textureCache), mUploadBudget(uploadBudget), mPendingCount(0), mPlaceholderTexture(nullptr),
+          mPendingTextures(), mUploads(), mUploadsMutex(), mWork()
+    {
+    }
+
+    AssetLoader::~AssetLoader()
+    {
+        // Workers queue into this object, so none may still be running once it is gone.
+        for (std::future<void>& work : mWork)
+        {
+            work.wait();
+        }
+
+        ReleaseObject(mPlaceholderTexture);
+    }
+
+    std::shared_ptr<ModelHandle> AssetLoader::LoadModel(const std::string& filename, bool flipUVs, const ModelHandle::UploadCallback& upload)
+    {
+        std::shared_ptr<ModelHandle> handle(new ModelHandle(filename, upload));
+        std::weak_ptr<ModelHandle> weakHandle(handle);
+
+        std::shared_ptr<Model> cachedModel = mModelCache.FindModel(filename, flipUVs);
+        if (cachedModel != nullptr)
+        {
+            mPendingCount++;
+            QueueUpload(ModelUploadCost(*cachedModel), [this, weakHandle, cachedModel]()
+            {
+                std::shared_ptr<ModelHandle> handle = weakHandle.lock();
+                if (handle != nullptr)
+                {
+                    UploadModel(*handle, *cachedModel);
+                }
+            });
+
+            return handle;
+        }
+
+        // The cache only learns about a model once it is uploaded, so requests that arrive while
+        // the import is still running wait on it instead of starting their own.
+        std::string key = ModelCache::ModelKey(filename, flipUVs);
+        std::vector<std::weak_ptr<ModelHandle>>& waitingHandles = mPendingModels[key];
+        waitingHandles.push_back(handle);
+        if (waitingHandles.size() > 1)
+        {
+            return handle;
+        }
+
+        mPendingCount++;
+        RunInBackground([this, key, filename, flipUVs]()
+        {
+            std::shared_ptr<Model> model;
+            std::string error;
+            try
+            {
+                model.reset(new Model(mGame, filename, flipUVs, &mThreadPool));
+            }
+            catch (std::exception& ex)
+            {
+                error = ex.what();
+            }
+
+            QueueModelUpload(key, filename, flipUVs, model, error);
+        });
+
+        return handle;
+    }
+
+    std::shared_ptr<TextureHandle> AssetLoader::LoadTexture(const std::wstring& filename)
+    {
+        return LoadTextures(std::vector<std::wstring>(1, filename)).front();
+    }
+
+    std::vector<std::shared_ptr<TextureHandle>> AssetLoader::LoadTextures(const std::vector<std::wstring>& filenames)
+    {
+        struct TextureRequest
+        {
+            std::wstring Key;
+            std::wstring Filename;
+            std::wstring DecodeFilename;
+        };
+
+        std::vector<std::shared_ptr<TextureHandle>> handles;
+        std::shared_ptr<std::vector<TextureRequest>> requests(new std::vector<TextureRequest>());
+        for (const std::wstring& filename : filenames)
+        {
+            std::shared_ptr<TextureHandle> handle(new TextureHandle(filename));
+            handles.push_back(handle);
+
+            handle->mShaderResourceView = mTextureCache.FindTexture(filename);
+            if (handle->mShaderResourceView != nullptr)
+            {
+                handle->mState = AssetStateReady;
+                continue;
+            }
+
+            // A file that is already on its way is decoded and uploaded once for every handle waiting on it.
+            std::wstring key = TextureCache::TextureKey(filename);
+            std::vector<std::weak_ptr<TextureHandle>>& waitingHandles = mPendingTextures[key];
+            waitingHandles.push_back(handle);
+            if (waitingHandles.size() > 1)
+            {
+                continue;
+            }
+
+            TextureRequest request;
+            request.Key = key;
+            request.Filename = filename;
+            request.DecodeFilename = mTextureCache.ResolveFilename(filename);
+            requests->push_back(request);
+        }
+
+        if (requests->empty())
+        {
+            return handles;
+        }
+
+        mPendingCount += static_cast<UINT>(requests->size());
+
+        RunInBackground([this, requests]()
+        {
+            mThreadPool.ParallelFor(static_cast<UINT>(requests->size()), [this, requests](UINT i)
+            {
+                const TextureRequest& request = (*requests)[i];
+                std::shared_ptr<DecodedImage> image(new DecodedImage());
+                std::string error;
+                try
+                {
+                    TextureCache::DecodeImage(request.DecodeFilename, *image);
+                    TextureCache::GenerateMips(*image, &mThreadPool);
+                }
+                catch (std::exception& ex)
+                {
+                    error = ex.what();
+                }
+
+                QueueTextureUpload(request.Key, request.Filename, image, error);
+            });
+        });
+
+        return handles;
+    }
+
+    ID3D11ShaderResourceView* AssetLoader::PlaceholderTexture()
+    {
+        if (mPlaceholderTexture == nullptr)
+        {
+            mPlaceholderTexture = mTextureCache.GetTexture(PlaceholderTextureFilename);
+        }
+
+        return mPlaceholderTexture;
+    }
+
+    void AssetLoader::ProcessUploads()
+    {
+        UINT spent = 0;
+        bool first = true;
+        while (first || spent < mUploadBudget)
+        {
+            PendingUpload upload;
+            {
+                std::lock_guard<std::mutex> lock(mUploadsMutex);
+                if (mUploads.empty())
+                {
+                    break;
+                }
+
+                upload = mUploads.front();
+                mUploads.pop_front();
+            }
+
+            mPendingCount--;
+            spent += upload.Cost;
+            first = false;
+
+            upload.Upload();
+        }
+
+        // Forget background work that has already finished.
+        for (std::vector<std::future<void>>::iterator it = mWork.begin(); it != mWork.end();)
+        {
+            if (it->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                it = mWork.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    UINT AssetLoader::PendingCount() const
+    {
+        return mPendingCount;
+    }
+
+    UINT AssetLoader::UploadBudget() const
+    {
+        return mUploadBudget;
+    }
+
+    void AssetLoader::SetUploadBudget(UINT uploadBudget)
+    {
+        mUploadBudget = uploadBudget;
+    }
+
+    void AssetLoader::QueueUpload(UINT cost, const std::function<void()>& upload)
+    {
+        PendingUpload pendingUpload;
+        pendingUpload.Cost = cost;
+        pendingUpload.Upload = upload;
+
+        std::lock_guard<std::mutex> lock(mUploadsMutex);
+        mUploads.push_back(pendingUpload);
+    }
+
+    void AssetLoader::QueueModelUpload(const std::string& key, const std::string& filename, bool flipUVs, const std::shared_ptr<Model>& model, const std::string& error)
+    {
+        QueueUpload((model != nullptr ? ModelUploadCost(*model) : 0), [this, key, filename, flipUVs, model, error]()
+        {
+            std::vector<std::shared_ptr<ModelHandle>> handles;
+            for (const std::weak_ptr<ModelHandle>& weakHandle : mPendingModels[key])
+            {
+                std::shared_ptr<ModelHandle> handle = weakHandle.lock();
+                if (handle != nullptr)
+                {
+                    handles.push_back(handle);
+                }
+            }
+
+            mPendingModels.erase(key);
+            if (error.empty() == false)
+            {
+                ReportFailure(filename, error);
+                for (std::shared_ptr<ModelHandle>& handle : handles)
+                {
+                    handle->mError = error;
+                    handle->mState = AssetStateFailed;
+                }
+
+                return;
+            }
+
+            if (handles.empty())
+            {
+                return;
+            }
+
+            std::shared_ptr<Model> cachedModel = mModelCache.AddModel(filename, flipUVs, model);
+            for (std::shared_ptr<ModelHandle>& handle : handles)
+            {
+                UploadModel(*handle, *cachedModel);
+            }
+        });
+    }
+
+    void AssetLoader::UploadModel(ModelHandle& handle, Model& model)
+    {
+        try
+        {
+            if (handle.mUpload)
+            {
+                handle.mUpload(model);
+            }
+
+            handle.mState = AssetStateReady;
+        }
+        catch (std::exception& ex)
+        {
+            ReportFailure(handle.mFilename, ex.what());
+            handle.mError = ex.what();
+            handle.mState = AssetStateFailed;
+        }
+    }
+
+    void AssetLoader::QueueTextureUpload(const std::wstring& key, const std::wstring& filename, const std::shared_ptr<DecodedImage>& image, const std::string& error)
+    {
+        QueueUpload(static_cast<UINT>(image->TextureSize()), [this, key, filename, image, error]()
+        {
+            std::vector<std::shared_ptr<TextureHandle>> handles;
+            for (const std::weak_ptr<TextureHandle>& weakHandle : mPendingTextures[key])
+            {
+                std::shared_ptr<TextureHandle> handle = weakHandle.lock();
+                if (handle != nullptr)
+                {
+                    handles.push_back(handle);
+                }
+            }
+
+            mPendingTextures.erase(key);
+            if (error.empty() == false)
+            {
+                ReportFailure(Utility::ToString(filename), error);
+            }
+
+            if (handles.empty())
+            {
+                return;
+            }
+
+            std::string failure(error);
+            ID3D11ShaderResourceView* shaderResourceView = nullptr;
+            if (failure.empty())
+            {
+                try
+                {
+                    shaderResourceView = mTextureCache.AddTexture(filename, *image);
+                }
+                catch (GameException& ex)
+                {
+                    failure = ex.what();
+                    ReportFailure(Utility::ToString(filename), failure);
+                }
+            }
+
+            for (std::shared_ptr<TextureHandle>& handle : handles)
+            {
+                if (shaderResourceView != nullptr)
+                {
+                    shaderResourceView->AddRef();
+                    handle->mShaderResourceView = shaderResourceView;
+                    handle->mState = AssetStateReady;
+                }
+                else
+                {
+                    handle->mError = failure;
+                    handle->mState = AssetStateFailed;
+                }
+            }
+
+            ReleaseObject(shaderResourceView);
+        });
+    }
+
+    void AssetLoader::RunInBackground(const std::function<void()>& work)
+    {
+        mWork.push_back(mThreadPool.Enqueue(work));
+    }
+}
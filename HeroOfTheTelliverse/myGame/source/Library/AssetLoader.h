@@ -0,0 +1,144 @@
+#pragma once
+
+#include "Common.h"
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace Library
+{
+    class Game;
+    class Model;
+    class ModelCache;
+    class TextureCache;
+    class ThreadPool;
+    struct DecodedImage;
+
+    enum AssetState
+    {
+        AssetStatePending = 0,
+        AssetStateReady,
+        AssetStateFailed
+    };
+
+    // Handles are only read and written on the render thread, so they need no locking.
+    class TextureHandle
+    {
+        friend class AssetLoader;
+
+    public:
+        ~TextureHandle();
+
+        AssetState State() const;
+        const std::wstring& Filename() const;
+        const std::string& Error() const;
+
+        // Null until State() is AssetStateReady.
+        ID3D11ShaderResourceView* ShaderResourceView() const;
+
+    private:
+        TextureHandle(const std::wstring& filename);
+        TextureHandle(const TextureHandle& rhs);
+        TextureHandle& operator=(const TextureHandle& rhs);
+
+        std::wstring mFilename;
+        AssetState mState;
+        std::string mError;
+        ID3D11ShaderResourceView* mShaderResourceView;
+    };
+
+    class ModelHandle
+    {
+        friend class AssetLoader;
+
+    public:
+        // Runs on the render thread once the model is imported, before State() becomes ready;
+        // this is where components create their GPU buffers. The handle doesn't keep the model,
+        // so ModelCache::Trim can free its CPU-side data afterwards.
+        typedef std::function<void(Model&)> UploadCallback;
+
+        AssetState State() const;
+        const std::string& Filename() const;
+        const std::string& Error() const;
+
+    private:
+        ModelHandle(const std::string& filename, const UploadCallback& upload);
+        ModelHandle(const ModelHandle& rhs);
+        ModelHandle& operator=(const ModelHandle& rhs);
+
+        std::string mFilename;
+        AssetState mState;
+        std::string mError;
+        UploadCallback mUpload;
+    };
+
+    // Imports models and decodes textures on the thread pool, then creates their D3D resources on
+    // the render thread from a queue that Game::Run drains a budget's worth at a time each frame.
+    // Uploads for handles nobody holds any more are dropped. Failures are written to the debugger
+    // output as well as to the handles, so an asset nobody checks on doesn't vanish silently.
+    class AssetLoader : public RTTI
+    {
+        RTTI_DECLARATIONS(AssetLoader, RTTI)
+
+    public:
+        static const UINT DefaultUploadBudget;
+        static const std::wstring PlaceholderTextureFilename;
+
+        AssetLoader(Game& game, ThreadPool& threadPool, ModelCache& modelCache, TextureCache& textureCache, UINT uploadBudget = DefaultUploadBudget);
+        ~AssetLoader();
+
+        // A file that is already being imported is imported once; every handle waiting on it gets
+        // its own upload callback run against the shared model.
+        std::shared_ptr<ModelHandle> LoadModel(const std::string& filename, bool flipUVs, const ModelHandle::UploadCallback& upload);
+
+        // Textures already in the TextureCache are ready straight away.
+        std::shared_ptr<TextureHandle> LoadTexture(const std::wstring& filename);
+
+        // One background task opens every file (mapping cooked .dds files and checking their
+        // headers) across the whole pool, queueing each upload as soon as it is decoded.
+        std::vector<std::shared_ptr<TextureHandle>> LoadTextures(const std::vector<std::wstring>& filenames);
+
+        // Drawn in place of textures that are still loading. Loaded synchronously on first use.
+        ID3D11ShaderResourceView* PlaceholderTexture();
+
+        // Runs queued uploads until roughly UploadBudget() bytes have been handed to the device.
+        // At least one upload runs per call so an oversized asset can't stall the queue.
+        void ProcessUploads();
+
+        UINT PendingCount() const;
+        UINT UploadBudget() const;
+        void SetUploadBudget(UINT uploadBudget);
+
+    private:
+        struct PendingUpload
+        {
+            UINT Cost;
+            std::function<void()> Upload;
+        };
+
+        AssetLoader();
+        AssetLoader(const AssetLoader& rhs);
+        AssetLoader& operator=(const AssetLoader& rhs);
+
+        void QueueUpload(UINT cost, const std::function<void()>& upload);
+        void QueueModelUpload(const std::string& key, const std::string& filename, bool flipUVs, const std::shared_ptr<Model>& model, const std::string& error);
+        void UploadModel(ModelHandle& handle, Model& model);
+        void QueueTextureUpload(const std::wstring& key, const std::wstring& filename, const std::shared_ptr<DecodedImage>& image, const std::string& error);
+        void RunInBackground(const std::function<void()>& work);
+
+        Game& mGame;
+        ThreadPool& mThreadPool;
+        ModelCache& mModelCache;
+        TextureCache& mTextureCache;
+        UINT mUploadBudget;
+        UINT mPendingCount;
+        ID3D11ShaderResourceView* mPlaceholderTexture;
+        std::map<std::string, std::vector<std::weak_ptr<ModelHandle>>> mPendingModels;
+        std::map<std::wstring, std::vector<std::weak_ptr<TextureHandle>>> mPendingTextures;
+
+        std::deque<PendingUpload> mUploads;
+        std::mutex mUploadsMutex;
+        std::vector<std::future<void>> mWork;
+    };
+}
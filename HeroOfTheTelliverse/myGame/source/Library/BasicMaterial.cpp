@@ -1,18 +1,24 @@
 #include "BasicMaterial.h"
 #include "GameException.h"
 #include "Mesh.h"
+#include "VertexCompression.h"
 //#include "ColorHelper.h"
 
 namespace Library
 {
     RTTI_DEFINITIONS(BasicMaterial)	
 
-    BasicMaterial::BasicMaterial()
+    BasicMaterial::BasicMaterial(bool compressedVertices)
         : Material("main11"),
-          MATERIAL_VARIABLE_INITIALIZATION(WorldViewProjection)
+          MATERIAL_VARIABLE_INITIALIZATION(WorldViewProjection), mCompressedVertices(compressedVertices)
     {
     }
 
+    bool BasicMaterial::CompressedVertices() const
+    {
+        return mCompressedVertices;
+    }
+
     MATERIAL_VARIABLE_DEFINITION(BasicMaterial, WorldViewProjection)
 
     void BasicMaterial::Initialize(Effect* effect)
@@ -27,24 +33,59 @@ namespace Library
             { "COLOR",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
         };
 
-        CreateInputLayout("main11", "p0", inputElementDescriptions, ARRAYSIZE(inputElementDescriptions));
+        // Both layouts feed the same shader: snorm and unorm elements arrive as float4.
+        D3D11_INPUT_ELEMENT_DESC compressedInputElementDescriptions[] =
+        {
+            { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "COLOR",    0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+        };
+
+        if (mCompressedVertices)
+        {
+            CreateInputLayout("main11", "p0", compressedInputElementDescriptions, ARRAYSIZE(compressedInputElementDescriptions));
+        }
+        else
+        {
+            CreateInputLayout("main11", "p0", inputElementDescriptions, ARRAYSIZE(inputElementDescriptions));
+        }
     }
 
     void BasicMaterial::CreateVertexBuffer(ID3D11Device* device, const Mesh& mesh, ID3D11Buffer** vertexBuffer) const
     {
-        const std::vector<XMFLOAT3>& sourceVertices = mesh.Vertices();
+        ArraySpan<const XMFLOAT3> sourceVertices = mesh.Vertices();
+
+        if (mCompressedVertices)
+        {
+            VertexQuantization quantization = VertexCompression::ComputeQuantization(mesh);
+            ArraySpan<const XMFLOAT4> vertexColors = (mesh.VertexColors().size() > 0 ? mesh.VertexColors().at(0) : ArraySpan<const XMFLOAT4>());
+            assert(vertexColors.empty() || vertexColors.size() == sourceVertices.size());
+
+            std::vector<BasicMaterialCompressedVertex> vertices;
+            vertices.reserve(sourceVertices.size());
+            for (UINT i = 0; i < sourceVertices.size(); i++)
+            {
+                XMFLOAT4 color = (vertexColors.size() > 0 ? vertexColors.at(i) : XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+                XMUBYTEN4 packedColor;
+                XMStoreUByteN4(&packedColor, XMLoadFloat4(&color));
+
+                vertices.push_back(BasicMaterialCompressedVertex(VertexCompression::EncodePosition(sourceVertices.at(i), quantization), packedColor));
+            }
+
+            CreateVertexBuffer(device, &vertices[0], vertices.size(), vertexBuffer);
+            return;
+        }
 
         std::vector<BasicMaterialVertex> vertices;
         vertices.reserve(sourceVertices.size());
         if (mesh.VertexColors().size() > 0)
         {
-            std::vector<XMFLOAT4>* vertexColors = mesh.VertexColors().at(0);
-            assert(vertexColors->size() == sourceVertices.size());
+            ArraySpan<const XMFLOAT4> vertexColors = mesh.VertexColors().at(0);
+            assert(vertexColors.size() == sourceVertices.size());
             
             for (UINT i = 0; i < sourceVertices.size(); i++)
             {
                 XMFLOAT3 position = sourceVertices.at(i);
-                XMFLOAT4 color = vertexColors->at(i);
+                XMFLOAT4 color = vertexColors.at(i);
                 vertices.push_back(BasicMaterialVertex(XMFLOAT4(position.x, position.y, position.z, 1.0f), color));
             }
         }
@@ -64,6 +105,23 @@ namespace Library
     }
 
     void BasicMaterial::CreateVertexBuffer(ID3D11Device* device, BasicMaterialVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const
+    {
+        assert(mCompressedVertices == false);
+        CreateBuffer(device, vertices, vertexCount, vertexBuffer);
+    }
+
+    void BasicMaterial::CreateVertexBuffer(ID3D11Device* device, BasicMaterialCompressedVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const
+    {
+        assert(mCompressedVertices);
+        CreateBuffer(device, vertices, vertexCount, vertexBuffer);
+    }
+
+    UINT BasicMaterial::VertexSize() const
+    {
+        return (mCompressedVertices ? sizeof(BasicMaterialCompressedVertex) : sizeof(BasicMaterialVertex));
+    }
+
+    void BasicMaterial::CreateBuffer(ID3D11Device* device, const void* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const
     {
         D3D11_BUFFER_DESC vertexBufferDesc;
         ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
@@ -79,9 +137,4 @@ namespace Library
             throw GameException("ID3D11Device::CreateBuffer() failed.");
         }
     }
-
-    UINT BasicMaterial::VertexSize() const
-    {
-        return sizeof(BasicMaterialVertex);
-    }
 }
\ No newline at end of file
@@ -16,6 +16,17 @@ namespace Library
             : Position(position), Color(color) { }
     } BasicMaterialVertex;
 
+    typedef struct _BasicMaterialCompressedVertex
+    {
+        XMSHORTN4 Position;
+        XMUBYTEN4 Color;
+
+        _BasicMaterialCompressedVertex() { }
+
+        _BasicMaterialCompressedVertex(XMSHORTN4 position, XMUBYTEN4 color)
+            : Position(position), Color(color) { }
+    } BasicMaterialCompressedVertex;
+
     class BasicMaterial : public Material
     {
         RTTI_DECLARATIONS(BasicMaterial, Material)
@@ -23,11 +34,19 @@ namespace Library
         MATERIAL_VARIABLE_DECLARATION(WorldViewProjection)
 
     public:
-        BasicMaterial();
+        BasicMaterial(bool compressedVertices = false);
+
+        bool CompressedVertices() const;
 
         virtual void Initialize(Effect* effect) override;		
         virtual void CreateVertexBuffer(ID3D11Device* device, const Mesh& mesh, ID3D11Buffer** vertexBuffer) const override;
         void CreateVertexBuffer(ID3D11Device* device, BasicMaterialVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const;
+        void CreateVertexBuffer(ID3D11Device* device, BasicMaterialCompressedVertex* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const;
         virtual UINT VertexSize() const override;
+
+    private:
+        void CreateBuffer(ID3D11Device* device, const void* vertices, UINT vertexCount, ID3D11Buffer** vertexBuffer) const;
+
+        bool mCompressedVertices;
     };
 }
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include "ContentManifest.h"
+#include "GameException.h"
+#include "MappedFile.h"
+#include "Utility.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(ContentManifest)
+
+    const std::string ContentManifest::Filename = "ContentManifest.txt";
+    const UINT ContentManifest::Version = 2;
+    const unsigned long long ContentManifest::HashSeed = 14695981039346656037ULL;
+
+    namespace
+    {
+        const unsigned long long HashPrime = 1099511628211ULL;
+
+        void Split(const std::string& line, char separator, std::vector<std::string>& fields)
+        {
+            fields.clear();
+
+            std::string::size_type start = 0;
+            for (;;)
+            {
+                std::string::size_type end = line.find(separator, start);
+                fields.push_back(line.substr(start, end - start));
+                if (end == std::string::npos)
+                {
+                    break;
+                }
+
+                start = end + 1;
+            }
+        }
+    }
+
+    ContentManifest::ContentManifest(const std::string& root)
+        : mRoot(root), mEntries(), mArtifacts()
+    {
+        if (mRoot.size() > 0 && mRoot.back() != '\\' && mRoot.back() != '/')
+        {
+            mRoot += '\\';
+        }
+    }
+
+    const std::string& ContentManifest::Root() const
+    {
+        return mRoot;
+    }
+
+    bool ContentManifest::Load()
+    {
+        mEntries.clear();
+        mArtifacts.clear();
+
+        std::ifstream file((mRoot + Filename).c_str());
+        if (!file)
+        {
+            return false;
+        }
+
+        std::string line;
+        std::vector<std::string> fields;
+        if (!std::getline(file, line))
+        {
+            throw GameException("Content manifest is empty.");
+        }
+
+        Split(line, ' ', fields);
+        if (fields.size() != 2 || fields[0] != "ContentManifest" || strtoul(fields[1].c_str(), nullptr, 10) != Version)
+        {
+            throw GameException("Unsupported content manifest version.");
+        }
+
+        while (std::getline(file, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+
+            // hash, source time, source, artifact, then any dependencies
+            Split(line, '\t', fields);
+            if (fields.size() < 4 || fields[2].empty() || fields[3].empty())
+            {
+                throw GameException("Content manifest is corrupt.");
+            }
+
+            ContentManifestEntry entry;
+            entry.Hash = strtoull(fields[0].c_str(), nullptr, 16);
+            entry.SourceTime = strtoull(fields[1].c_str(), nullptr, 16);
+            entry.Source = fields[2];
+            entry.Artifact = fields[3];
+            entry.Dependencies.assign(fields.begin() + 4, fields.end());
+            Add(entry);
+        }
+
+        return true;
+    }
+
+    void ContentManifest::Save() const
+    {
+        std::ofstream file((mRoot + Filename).c_str(), std::ios::trunc);
+        if (!file)
+        {
+            throw GameException("Could not open content manifest for writing.");
+        }
+
+        file << "ContentManifest " << Version << "\n";
+        for (const std::pair<std::string, ContentManifestEntry>& entry : mEntries)
+        {
+            const ContentManifestEntry& record = entry.second;
+            file << std::hex << std::setfill('0') << std::setw(16) << record.Hash << '\t' << std::setw(16) << record.SourceTime << std::dec << '\t' << record.Source << '\t' << record.Artifact;
+            for (const std::string& dependency : record.Dependencies)
+            {
+                file << '\t' << dependency;
+            }
+
+            file << "\n";
+        }
+
+        if (!file)
+        {
+            throw GameException("Could not write content manifest.");
+        }
+    }
+
+    const ContentManifestEntry* ContentManifest::Find(const std::string& path) const
+    {
+        std::map<std::string, ContentManifestEntry>::const_iterator it = mEntries.find(NormalizePath(RelativePath(path)));
+
+        return (it != mEntries.end() ? &it->second : nullptr);
+    }
+
+    void ContentManifest::Add(const ContentManifestEntry& entry)
+    {
+        std::string key = NormalizePath(RelativePath(entry.Source));
+        mEntries[key] = entry;
+        ResolveArtifact(key, entry);
+    }
+
+    void ContentManifest::Remove(const std::string& path)
+    {
+        std::string key = NormalizePath(RelativePath(path));
+        mEntries.erase(key);
+        mArtifacts.erase(key);
+    }
+
+    const std::map<std::string, ContentManifestEntry>& ContentManifest::Entries() const
+    {
+        return mEntries;
+    }
+
+    std::string ContentManifest::ArtifactFilename(const std::string& filename) const
+    {
+        std::map<std::string, std::string>::const_iterator it = mArtifacts.find(NormalizePath(RelativePath(filename)));
+
+        return (it != mArtifacts.end() ? it->second : std::string());
+    }
+
+    std::wstring ContentManifest::ArtifactFilename(const std::wstring& filename) const
+    {
+        return Utility::ToWideString(ArtifactFilename(Utility::ToString(filename)));
+    }
+
+    std::string ContentManifest::CanonicalPath(const std::string& path)
+    {
+        std::string source(path);
+        std::replace(source.begin(), source.end(), '/', '\\');
+
+        std::vector<std::string> segments;
+        Split(source, '\\', segments);
+
+        std::vector<std::string> kept;
+        for (UINT i = 0; i < segments.size(); i++)
+        {
+            const std::string& segment = segments[i];
+            if (segment == "." || (segment.empty() && i > 0))
+            {
+                continue;
+            }
+
+            if (segment == ".." && kept.size() > 0 && kept.back() != ".." && kept.back().empty() == false)
+            {
+                kept.pop_back();
+                continue;
+            }
+
+            kept.push_back(segment);
+        }
+
+        std::string canonical;
+        for (UINT i = 0; i < kept.size(); i++)
+        {
+            canonical += (i > 0 ? "\\" : "") + kept[i];
+        }
+
+        return canonical;
+    }
+
+    std::string ContentManifest::NormalizePath(const std::string& path)
+    {
+        std::string normalized = CanonicalPath(path);
+        std::transform(normalized.begin(), normalized.end(), normalized.begin(), ::tolower);
+
+        return normalized;
+    }
+
+    unsigned long long ContentManifest::Hash(const void* data, size_t size, unsigned long long hash)
+    {
+        // FNV-1a
+        const byte* bytes = reinterpret_cast<const byte*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= HashPrime;
+        }
+
+        return hash;
+    }
+
+    unsigned long long ContentManifest::HashFile(const std::string& filename, unsigned long long hash)
+    {
+        MappedFile file(filename);
+
+        return Hash(file.Data(), file.Size(), hash);
+    }
+
+    unsigned long long ContentManifest::LastWriteTime(const std::string& filename)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes) == FALSE)
+        {
+            return 0;
+        }
+
+        return (static_cast<unsigned long long>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    }
+
+    void ContentManifest::ResolveArtifact(const std::string& key, const ContentManifestEntry& entry)
+    {
+        std::string artifact = mRoot + entry.Artifact;
+        unsigned long long sourceTime = LastWriteTime(mRoot + entry.Source);
+        if ((sourceTime == 0 || sourceTime == entry.SourceTime) && LastWriteTime(artifact) != 0)
+        {
+            mArtifacts[key] = artifact;
+        }
+        else
+        {
+            mArtifacts.erase(key);
+        }
+    }
+
+    std::string ContentManifest::RelativePath(const std::string& path) const
+    {
+        std::string relative = CanonicalPath(path);
+        std::string root = NormalizePath(mRoot);
+        if (root.size() > 0 && root != ".")
+        {
+            root += '\\';
+            std::string prefix = relative.substr(0, root.size());
+            std::transform(prefix.begin(), prefix.end(), prefix.begin(), ::tolower);
+            if (prefix == root)
+            {
+                relative.erase(0, root.size());
+            }
+        }
+
+        return relative;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    struct ContentManifestEntry
+    {
+        // Paths are relative to the manifest's content root.
+        std::string Source;
+        std::string Artifact;
+        std::vector<std::string> Dependencies;
+
+        // Covers the source, every dependency and the settings it was cooked with.
+        unsigned long long Hash;
+
+        // The source's last write time when it was cooked. The runtime stops using the artifact
+        // once the source changes, until the next cook catches up.
+        unsigned long long SourceTime;
+    };
+
+    // Written by the ContentCooker next to the content it cooked. Maps each source asset to the
+    // artifact built from it (the source itself for assets used as-is), so the runtime can find
+    // cooked files without comparing timestamps. Lookups ignore case and slash direction.
+    class ContentManifest : public RTTI
+    {
+        RTTI_DECLARATIONS(ContentManifest, RTTI)
+
+    public:
+        static const std::string Filename;
+        static const UINT Version;
+        static const unsigned long long HashSeed;
+
+        ContentManifest(const std::string& root);
+
+        const std::string& Root() const;
+
+        // Returns false when there is no manifest under Root(); throws if it can't be parsed.
+        bool Load();
+        void Save() const;
+
+        // path may be relative to Root() or start with it.
+        const ContentManifestEntry* Find(const std::string& path) const;
+        void Add(const ContentManifestEntry& entry);
+        void Remove(const std::string& path);
+        const std::map<std::string, ContentManifestEntry>& Entries() const;
+
+        // Full path of the artifact cooked from filename, or an empty string if there isn't one, it
+        // has been deleted or the source has been edited since. A missing source leaves the artifact
+        // in use. Both files are checked once, when the entry is loaded or added, so lookups never
+        // touch the disk.
+        std::string ArtifactFilename(const std::string& filename) const;
+        std::wstring ArtifactFilename(const std::wstring& filename) const;
+
+        // Backslashes only, with "." and ".." segments folded away. NormalizePath also lower-cases.
+        static std::string CanonicalPath(const std::string& path);
+        static std::string NormalizePath(const std::string& path);
+
+        // path relative to Root() when it lies underneath it, otherwise path unchanged.
+        std::string RelativePath(const std::string& path) const;
+
+        static unsigned long long Hash(const void* data, size_t size, unsigned long long hash = HashSeed);
+        static unsigned long long HashFile(const std::string& filename, unsigned long long hash = HashSeed);
+
+        // 0 when the file doesn't exist.
+        static unsigned long long LastWriteTime(const std::string& filename);
+
+    private:
+        ContentManifest();
+        ContentManifest(const ContentManifest& rhs);
+        ContentManifest& operator=(const ContentManifest& rhs);
+
+        void ResolveArtifact(const std::string& key, const ContentManifestEntry& entry);
+
+        std::string mRoot;
+        std::map<std::string, ContentManifestEntry> mEntries;
+        std::map<std::string, std::string> mArtifacts; // Full paths of the artifacts still in use.
+    };
+}
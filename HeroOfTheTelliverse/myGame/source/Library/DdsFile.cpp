@@ -0,0 +1,270 @@
+#include "DdsFile.h"
+#include "GameException.h"
+#include <algorithm>
+#include <fstream>
+
+namespace Library
+{
+    const UINT DdsFile::Magic = 0x20534444; // "DDS "
+    const std::string DdsFile::Extension = ".dds";
+
+    namespace
+    {
+        const UINT HeaderFlagsTexture = 0x1 | 0x2 | 0x4 | 0x1000; // Caps, height, width, pixel format
+        const UINT HeaderFlagsMipMapCount = 0x20000;
+        const UINT HeaderFlagsLinearSize = 0x80000;
+        const UINT PixelFormatFourCC = 0x4;
+        const UINT CapsComplex = 0x8;
+        const UINT CapsTexture = 0x1000;
+        const UINT CapsMipMap = 0x400000;
+        const UINT ResourceDimensionTexture2D = 3;
+        const UINT MiscFlagTextureCube = 0x4;
+        const UINT PixelFormatRGB = 0x40;
+
+        inline UINT MakeFourCC(char first, char second, char third, char fourth)
+        {
+            return static_cast<UINT>(first) | (static_cast<UINT>(second) << 8) | (static_cast<UINT>(third) << 16) | (static_cast<UINT>(fourth) << 24);
+        }
+
+        DXGI_FORMAT LegacyFormat(const DdsPixelFormat& pixelFormat)
+        {
+            if (pixelFormat.Flags & PixelFormatFourCC)
+            {
+                if (pixelFormat.FourCC == MakeFourCC('D', 'X', 'T', '1'))
+                {
+                    return DXGI_FORMAT_BC1_UNORM;
+                }
+
+                if (pixelFormat.FourCC == MakeFourCC('D', 'X', 'T', '3'))
+                {
+                    return DXGI_FORMAT_BC2_UNORM;
+                }
+
+                if (pixelFormat.FourCC == MakeFourCC('D', 'X', 'T', '5'))
+                {
+                    return DXGI_FORMAT_BC3_UNORM;
+                }
+
+                if (pixelFormat.FourCC == MakeFourCC('A', 'T', 'I', '1') || pixelFormat.FourCC == MakeFourCC('B', 'C', '4', 'U'))
+                {
+                    return DXGI_FORMAT_BC4_UNORM;
+                }
+
+                if (pixelFormat.FourCC == MakeFourCC('A', 'T', 'I', '2') || pixelFormat.FourCC == MakeFourCC('B', 'C', '5', 'U'))
+                {
+                    return DXGI_FORMAT_BC5_UNORM;
+                }
+            }
+            else if ((pixelFormat.Flags & PixelFormatRGB) && pixelFormat.RGBBitCount == 32)
+            {
+                if (pixelFormat.RBitMask == 0x000000FF && pixelFormat.GBitMask == 0x0000FF00 && pixelFormat.BBitMask == 0x00FF0000)
+                {
+                    return DXGI_FORMAT_R8G8B8A8_UNORM;
+                }
+
+                if (pixelFormat.RBitMask == 0x00FF0000 && pixelFormat.GBitMask == 0x0000FF00 && pixelFormat.BBitMask == 0x000000FF)
+                {
+                    return DXGI_FORMAT_B8G8R8A8_UNORM;
+                }
+            }
+
+            return DXGI_FORMAT_UNKNOWN;
+        }
+
+        // Bytes in one level, or zero for formats this doesn't know the layout of.
+        size_t SurfaceSize(DXGI_FORMAT format, UINT width, UINT height)
+        {
+            size_t blocksWide = std::max((width + 3) / 4, 1U);
+            size_t blocksHigh = std::max((height + 3) / 4, 1U);
+            switch (format)
+            {
+            case DXGI_FORMAT_BC1_UNORM:
+            case DXGI_FORMAT_BC1_UNORM_SRGB:
+            case DXGI_FORMAT_BC4_UNORM:
+            case DXGI_FORMAT_BC4_SNORM:
+                return blocksWide * blocksHigh * 8;
+
+            case DXGI_FORMAT_BC2_UNORM:
+            case DXGI_FORMAT_BC2_UNORM_SRGB:
+            case DXGI_FORMAT_BC3_UNORM:
+            case DXGI_FORMAT_BC3_UNORM_SRGB:
+            case DXGI_FORMAT_BC5_UNORM:
+            case DXGI_FORMAT_BC5_SNORM:
+            case DXGI_FORMAT_BC6H_UF16:
+            case DXGI_FORMAT_BC6H_SF16:
+            case DXGI_FORMAT_BC7_UNORM:
+            case DXGI_FORMAT_BC7_UNORM_SRGB:
+                return blocksWide * blocksHigh * 16;
+
+            case DXGI_FORMAT_R8G8B8A8_UNORM:
+            case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+                return static_cast<size_t>(width) * height * 4;
+
+            default:
+                return 0;
+            }
+        }
+    }
+
+    bool DdsFile::IsDdsFile(const std::string& filename)
+    {
+        if (filename.size() < Extension.size())
+        {
+            return false;
+        }
+
+        std::string extension = filename.substr(filename.size() - Extension.size());
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+        return (extension == Extension);
+    }
+
+    std::string DdsFile::CookedFilename(const std::string& sourceFilename)
+    {
+        std::string::size_type lastSlashIndex = sourceFilename.find_last_of("\\/");
+        std::string::size_type lastDotIndex = sourceFilename.find_last_of('.');
+
+        if (lastDotIndex == std::string::npos || (lastSlashIndex != std::string::npos && lastDotIndex < lastSlashIndex))
+        {
+            return sourceFilename + Extension;
+        }
+
+        return sourceFilename.substr(0, lastDotIndex) + Extension;
+    }
+
+    void DdsFile::ReadHeader(const byte* data, size_t size, DdsTextureDesc& desc)
+    {
+        if (data == nullptr || size < sizeof(UINT) + sizeof(DdsHeader) || *reinterpret_cast<const UINT*>(data) != Magic)
+        {
+            throw GameException("Invalid DDS file.");
+        }
+
+        const DdsHeader* header = reinterpret_cast<const DdsHeader*>(data + sizeof(UINT));
+        if (header->Size != sizeof(DdsHeader) || header->PixelFormat.Size != sizeof(DdsPixelFormat))
+        {
+            throw GameException("Invalid DDS header.");
+        }
+
+        desc.Width = header->Width;
+        desc.Height = header->Height;
+        desc.MipLevels = std::max(header->MipMapCount, 1U);
+        desc.ArraySize = 1;
+        desc.DataOffset = sizeof(UINT) + sizeof(DdsHeader);
+
+        if ((header->PixelFormat.Flags & PixelFormatFourCC) && header->PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+        {
+            if (size < desc.DataOffset + sizeof(DdsHeaderDX10))
+            {
+                throw GameException("Invalid DDS file.");
+            }
+
+            const DdsHeaderDX10* headerDX10 = reinterpret_cast<const DdsHeaderDX10*>(data + desc.DataOffset);
+            if (headerDX10->ResourceDimension != ResourceDimensionTexture2D || headerDX10->ArraySize == 0 || (headerDX10->MiscFlag & MiscFlagTextureCube))
+            {
+                throw GameException("DDS file is not a 2D texture.");
+            }
+
+            desc.Format = static_cast<DXGI_FORMAT>(headerDX10->DxgiFormat);
+            desc.ArraySize = headerDX10->ArraySize;
+            desc.DataOffset += sizeof(DdsHeaderDX10);
+        }
+        else
+        {
+            if (header->Caps2 != 0)
+            {
+                throw GameException("DDS file is not a 2D texture.");
+            }
+
+            desc.Format = LegacyFormat(header->PixelFormat);
+        }
+
+        if (desc.Width == 0 || desc.Height == 0 || desc.Width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || desc.Height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION
+            || desc.ArraySize > D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION || desc.MipLevels > D3D11_REQ_MIP_LEVELS)
+        {
+            throw GameException("DDS texture dimensions are out of range.");
+        }
+
+        size_t sliceSize = 0;
+        for (UINT level = 0; level < desc.MipLevels; level++)
+        {
+            size_t levelSize = SurfaceSize(desc.Format, std::max(desc.Width >> level, 1U), std::max(desc.Height >> level, 1U));
+            if (levelSize == 0)
+            {
+                // Decoding the rest is left to the loader, which checks it again.
+                return;
+            }
+
+            sliceSize += levelSize;
+        }
+
+        if ((size - desc.DataOffset) / desc.ArraySize < sliceSize)
+        {
+            throw GameException("DDS file is truncated.");
+        }
+    }
+
+    void DdsFile::Write(const std::string& filename, DXGI_FORMAT format, UINT width, UINT height, const std::vector<std::vector<byte>>& levels)
+    {
+        if (levels.empty())
+        {
+            throw GameException("A DDS file needs at least one level.");
+        }
+
+        DdsHeader header;
+        ZeroMemory(&header, sizeof(header));
+        header.Size = sizeof(DdsHeader);
+        header.Flags = HeaderFlagsTexture | HeaderFlagsMipMapCount | HeaderFlagsLinearSize;
+        header.Height = height;
+        header.Width = width;
+        header.PitchOrLinearSize = static_cast<UINT>(levels[0].size());
+        header.MipMapCount = static_cast<UINT>(levels.size());
+        header.PixelFormat.Size = sizeof(DdsPixelFormat);
+        header.PixelFormat.Flags = PixelFormatFourCC;
+        header.Caps = CapsTexture | (levels.size() > 1 ? CapsComplex | CapsMipMap : 0);
+
+        DdsHeaderDX10 headerDX10;
+        ZeroMemory(&headerDX10, sizeof(headerDX10));
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+            header.PixelFormat.FourCC = MakeFourCC('D', 'X', 'T', '1');
+            break;
+
+        case DXGI_FORMAT_BC3_UNORM:
+            header.PixelFormat.FourCC = MakeFourCC('D', 'X', 'T', '5');
+            break;
+
+        default:
+            header.PixelFormat.FourCC = MakeFourCC('D', 'X', '1', '0');
+            headerDX10.DxgiFormat = format;
+            headerDX10.ResourceDimension = ResourceDimensionTexture2D;
+            headerDX10.ArraySize = 1;
+            break;
+        }
+
+        std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            throw GameException("Could not open DDS file for writing.");
+        }
+
+        file.write(reinterpret_cast<const char*>(&Magic), sizeof(Magic));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+        {
+            file.write(reinterpret_cast<const char*>(&headerDX10), sizeof(headerDX10));
+        }
+
+        for (const std::vector<byte>& level : levels)
+        {
+            file.write(reinterpret_cast<const char*>(&level[0]), level.size());
+        }
+
+        if (!file)
+        {
+            throw GameException("Could not write DDS file.");
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    // The parts of the DDS header the cooker writes; see "Programming Guide for DDS" on MSDN.
+    struct DdsPixelFormat
+    {
+        UINT Size;
+        UINT Flags;
+        UINT FourCC;
+        UINT RGBBitCount;
+        UINT RBitMask;
+        UINT GBitMask;
+        UINT BBitMask;
+        UINT ABitMask;
+    };
+
+    struct DdsHeader
+    {
+        UINT Size;
+        UINT Flags;
+        UINT Height;
+        UINT Width;
+        UINT PitchOrLinearSize;
+        UINT Depth;
+        UINT MipMapCount;
+        UINT Reserved1[11];
+        DdsPixelFormat PixelFormat;
+        UINT Caps;
+        UINT Caps2;
+        UINT Caps3;
+        UINT Caps4;
+        UINT Reserved2;
+    };
+
+    struct DdsHeaderDX10
+    {
+        UINT DxgiFormat;
+        UINT ResourceDimension;
+        UINT MiscFlag;
+        UINT ArraySize;
+        UINT MiscFlags2;
+    };
+
+    // What ReadHeader() found; levels and array slices start at DataOffset.
+    struct DdsTextureDesc
+    {
+        DXGI_FORMAT Format; // DXGI_FORMAT_UNKNOWN for legacy formats left to the loader to decode.
+        UINT Width;
+        UINT Height;
+        UINT MipLevels;
+        UINT ArraySize;
+        UINT DataOffset;
+    };
+
+    class DdsFile
+    {
+    public:
+        static const UINT Magic;
+        static const std::string Extension;
+
+        static bool IsDdsFile(const std::string& filename);
+        static std::string CookedFilename(const std::string& sourceFilename);
+
+        // Validates the headers of a 2D texture loaded whole into memory, and that every level
+        // its format describes fits in size, so the data can be handed to
+        // CreateDDSTextureFromMemory() without copying. Throws GameException if it isn't valid.
+        static void ReadHeader(const byte* data, size_t size, DdsTextureDesc& desc);
+
+        // Writes a block-compressed 2D texture, levels largest first, that CreateDDSTextureFromFile
+        // loads as is. BC1 and BC3 get the legacy DXT1/DXT5 header, anything else a DX10 one.
+        static void Write(const std::string& filename, DXGI_FORMAT format, UINT width, UINT height, const std::vector<std::vector<byte>>& levels);
+
+    private:
+        DdsFile();
+        DdsFile(const DdsFile& rhs);
+        DdsFile& operator=(const DdsFile& rhs);
+    };
+}
@@ -2,6 +2,7 @@
 #include "Game.h"
 #include "GameException.h"
 #include "Utility.h"
+#include "ContentManifest.h"
 #include "D3Dcompiler.h"
 
 namespace Library
@@ -70,6 +71,23 @@ namespace Library
         }
     }
 
+    void Effect::LoadEffect(Game& game, ID3DX11Effect** effect, const std::wstring& filename)
+    {
+        ContentManifest* manifest = (ContentManifest*)game.Services().GetService(ContentManifest::TypeIdClass());
+        std::wstring compiledFilename = (manifest != nullptr ? manifest->ArtifactFilename(filename) : std::wstring());
+
+        std::wstring extension;
+        Utility::GetPathExtension(compiledFilename, extension);
+        if (_wcsicmp(extension.c_str(), L".cso") == 0)
+        {
+            LoadCompiledEffect(game.Direct3DDevice(), effect, compiledFilename);
+        }
+        else
+        {
+            CompileEffectFromFile(game.Direct3DDevice(), effect, filename);
+        }
+    }
+
     Game& Effect::GetGame()
     {
         return mGame;
@@ -138,6 +156,12 @@ namespace Library
         Initialize();
     }
 
+    void Effect::LoadEffect(const std::wstring& filename)
+    {
+        LoadEffect(mGame, &mEffect, filename);
+        Initialize();
+    }
+
     void Effect::Initialize()
     {
         HRESULT hr = mEffect->GetDesc(&mEffectDesc);
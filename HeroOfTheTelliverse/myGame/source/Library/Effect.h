@@ -17,6 +17,10 @@ namespace Library
         static void CompileEffectFromFile(ID3D11Device* direct3DDevice, ID3DX11Effect** effect, const std::wstring& filename);
         static void LoadCompiledEffect(ID3D11Device* direct3DDevice, ID3DX11Effect** effect, const std::wstring& filename);
 
+        // Loads the compiled effect the ContentManifest service lists for filename, or compiles
+        // the source when there isn't one.
+        static void LoadEffect(Game& game, ID3DX11Effect** effect, const std::wstring& filename);
+
         Game& GetGame();
         ID3DX11Effect* GetEffect() const;
         void SetEffect(ID3DX11Effect* effect);
@@ -28,6 +32,7 @@ namespace Library
 
         void CompileFromFile(const std::wstring& filename);
         void LoadCompiledEffect(const std::wstring& filename);
+        void LoadEffect(const std::wstring& filename);
 
     private:
         Effect(const Effect& rhs);
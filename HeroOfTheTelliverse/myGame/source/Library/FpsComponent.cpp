@@ -5,6 +5,9 @@
 #include <SpriteFont.h>
 #include "Game.h"
 #include "Utility.h"
+#include "RenderQueue.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
 
 namespace Library
 {
@@ -60,6 +63,37 @@ namespace Library
         fpsLabel << std::setprecision(4) << L"Frame Rate: " << mFrameRate << "    Total Elapsed Time: " << gameTime.TotalGameTime();
         mSpriteFont->DrawString(mSpriteBatch, fpsLabel.str().c_str(), mTextPosition);
 
+        RenderQueue* renderQueue = (RenderQueue*)mGame->Services().GetService(RenderQueue::TypeIdClass());
+        if (renderQueue != nullptr)
+        {
+            const RenderQueueStatistics& statistics = renderQueue->Statistics();
+            std::wostringstream queueLabel;
+            queueLabel << L"Packets: " << statistics.Packets << L"    Draws: " << statistics.DrawsIssued
+                << L"    State changes: " << statistics.StateChanges << L" (" << statistics.StateChangesAvoided << L" avoided)";
+            mSpriteFont->DrawString(mSpriteBatch, queueLabel.str().c_str(), XMFLOAT2(mTextPosition.x, mTextPosition.y + 20.0f));
+        }
+
+        FrustumCuller* frustumCuller = (FrustumCuller*)mGame->Services().GetService(FrustumCuller::TypeIdClass());
+        if (frustumCuller != nullptr)
+        {
+            const FrustumCullerStatistics& statistics = frustumCuller->Statistics();
+            std::wostringstream cullingLabel;
+            cullingLabel << L"Culled: " << statistics.Culled << L" of " << statistics.Tested << L" (" << statistics.BatchWidth << L"-wide)    "
+                << std::setprecision(3) << std::fixed << statistics.Milliseconds << L" ms";
+            mSpriteFont->DrawString(mSpriteBatch, cullingLabel.str().c_str(), XMFLOAT2(mTextPosition.x, mTextPosition.y + 40.0f));
+        }
+
+        OcclusionCuller* occlusionCuller = (OcclusionCuller*)mGame->Services().GetService(OcclusionCuller::TypeIdClass());
+        if (occlusionCuller != nullptr)
+        {
+            const OcclusionCullerStatistics& statistics = occlusionCuller->Statistics();
+            std::wostringstream occlusionLabel;
+            occlusionLabel << L"Occluded: " << statistics.Occluded << L" of " << statistics.Tested << L"    Occluders: " << statistics.Occluders
+                << L" (" << statistics.Triangles << L" triangles, " << statistics.BatchWidth << L"-wide)    "
+                << std::setprecision(3) << std::fixed << statistics.RasterizeMilliseconds << L" + " << statistics.TestMilliseconds << L" ms";
+            mSpriteFont->DrawString(mSpriteBatch, occlusionLabel.str().c_str(), XMFLOAT2(mTextPosition.x, mTextPosition.y + 60.0f));
+        }
+
         mSpriteBatch->End();
     }
 }
\ No newline at end of file
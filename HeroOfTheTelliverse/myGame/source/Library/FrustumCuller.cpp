@@ -0,0 +1,295 @@
+#include "FrustumCuller.h"
+#include "Camera.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(FrustumCuller)
+
+    namespace
+    {
+        // Arrays are padded to whole AVX batches so neither path needs a scalar tail.
+        const UINT PaddedBatch = 8;
+        const UINT PlaneCount = 6;
+        const UINT NoSlot = UINT_MAX;
+
+        bool IsAvxSupported()
+        {
+            int info[4];
+            __cpuid(info, 1);
+
+            // AVX on the CPU, and the OS saving the upper halves of the registers on context switches
+            const int osxsave = 1 << 27;
+            const int avx = 1 << 28;
+            if ((info[2] & osxsave) == 0 || (info[2] & avx) == 0)
+            {
+                return false;
+            }
+
+            return ((_xgetbv(0) & 0x6) == 0x6);
+        }
+
+        UINT CountBits(UINT mask)
+        {
+            UINT count = 0;
+            for (; mask != 0; mask &= mask - 1)
+            {
+                count++;
+            }
+
+            return count;
+        }
+    }
+
+    FrustumCuller::FrustumCuller()
+        : mCount(0), mCenterX(), mCenterY(), mCenterZ(), mExtentX(), mExtentY(), mExtentZ(), mVisible(), mSlots(), mIds(), mFreeIds(), mAvxSupported(IsAvxSupported()), mStatistics()
+    {
+        ZeroMemory(&mStatistics, sizeof(mStatistics));
+    }
+
+    UINT FrustumCuller::AddObject()
+    {
+        if (mCount == mCenterX.size())
+        {
+            size_t size = mCenterX.size() + PaddedBatch;
+            mCenterX.resize(size, 0.0f);
+            mCenterY.resize(size, 0.0f);
+            mCenterZ.resize(size, 0.0f);
+            mExtentX.resize(size, 0.0f);
+            mExtentY.resize(size, 0.0f);
+            mExtentZ.resize(size, 0.0f);
+            mVisible.resize(size, 0);
+            mIds.resize(size, 0);
+        }
+
+        UINT slot = mCount++;
+        UINT id;
+        if (mFreeIds.empty())
+        {
+            id = static_cast<UINT>(mSlots.size());
+            mSlots.push_back(slot);
+        }
+        else
+        {
+            id = mFreeIds.back();
+            mFreeIds.pop_back();
+            mSlots[id] = slot;
+        }
+
+        mIds[slot] = id;
+
+        // Large enough to straddle every plane, yet finite so no test sees infinity times zero
+        mCenterX[slot] = 0.0f;
+        mCenterY[slot] = 0.0f;
+        mCenterZ[slot] = 0.0f;
+        mExtentX[slot] = FLT_MAX;
+        mExtentY[slot] = FLT_MAX;
+        mExtentZ[slot] = FLT_MAX;
+        mVisible[slot] = 1;
+
+        return id;
+    }
+
+    void FrustumCuller::RemoveObject(UINT id)
+    {
+        assert(id < mSlots.size() && mSlots[id] != NoSlot);
+
+        UINT slot = mSlots[id];
+        UINT last = --mCount;
+        if (slot != last)
+        {
+            mCenterX[slot] = mCenterX[last];
+            mCenterY[slot] = mCenterY[last];
+            mCenterZ[slot] = mCenterZ[last];
+            mExtentX[slot] = mExtentX[last];
+            mExtentY[slot] = mExtentY[last];
+            mExtentZ[slot] = mExtentZ[last];
+            mVisible[slot] = mVisible[last];
+            mIds[slot] = mIds[last];
+            mSlots[mIds[slot]] = slot;
+        }
+
+        // The padding past mCount is still loaded by the batch tests, so it has to stay finite.
+        mCenterX[last] = mCenterY[last] = mCenterZ[last] = 0.0f;
+        mExtentX[last] = mExtentY[last] = mExtentZ[last] = 0.0f;
+        mVisible[last] = 0;
+
+        mSlots[id] = NoSlot;
+        mFreeIds.push_back(id);
+    }
+
+    void FrustumCuller::SetBounds(UINT id, const BoundingBox& worldBounds)
+    {
+        assert(id < mSlots.size() && mSlots[id] != NoSlot);
+
+        UINT slot = mSlots[id];
+        mCenterX[slot] = worldBounds.Center.x;
+        mCenterY[slot] = worldBounds.Center.y;
+        mCenterZ[slot] = worldBounds.Center.z;
+        mExtentX[slot] = worldBounds.Extents.x;
+        mExtentY[slot] = worldBounds.Extents.y;
+        mExtentZ[slot] = worldBounds.Extents.z;
+    }
+
+    bool FrustumCuller::IsVisible(UINT id) const
+    {
+        assert(id < mSlots.size() && mSlots[id] != NoSlot);
+
+        return (mVisible[mSlots[id]] != 0);
+    }
+
+    void FrustumCuller::Cull(const Camera& camera)
+    {
+        Cull(camera.ViewProjectionMatrix());
+    }
+
+    void FrustumCuller::Cull(FXMMATRIX viewProjection)
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+        XMFLOAT4 planes[PlaneCount];
+        ExtractPlanes(viewProjection, planes);
+
+        mStatistics.Tested = mCount;
+        mStatistics.Culled = 0;
+        if (mAvxSupported)
+        {
+            mStatistics.BatchWidth = 8;
+            CullAvx(planes);
+        }
+        else
+        {
+            mStatistics.BatchWidth = 4;
+            CullSse(planes);
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        mStatistics.Milliseconds = elapsed.count();
+    }
+
+    const FrustumCullerStatistics& FrustumCuller::Statistics() const
+    {
+        return mStatistics;
+    }
+
+    void FrustumCuller::ExtractPlanes(FXMMATRIX viewProjection, XMFLOAT4* planes)
+    {
+        // Gribb/Hartmann, as in MeshletBuilder::Cull. BoundingFrustum can't be built from our
+        // right-handed projection, so the planes come from the matrix itself.
+        XMMATRIX columns = XMMatrixTranspose(viewProjection);
+        XMVECTOR planeVectors[PlaneCount] =
+        {
+            XMVectorAdd(columns.r[3], columns.r[0]),
+            XMVectorSubtract(columns.r[3], columns.r[0]),
+            XMVectorAdd(columns.r[3], columns.r[1]),
+            XMVectorSubtract(columns.r[3], columns.r[1]),
+            columns.r[2],
+            XMVectorSubtract(columns.r[3], columns.r[2])
+        };
+
+        for (UINT i = 0; i < PlaneCount; i++)
+        {
+            XMStoreFloat4(&planes[i], XMPlaneNormalize(planeVectors[i]));
+        }
+    }
+
+    void FrustumCuller::CullSse(const XMFLOAT4* planes)
+    {
+        __m128 normals[PlaneCount][3];
+        __m128 absoluteNormals[PlaneCount][3];
+        __m128 distances[PlaneCount];
+        for (UINT i = 0; i < PlaneCount; i++)
+        {
+            normals[i][0] = _mm_set1_ps(planes[i].x);
+            normals[i][1] = _mm_set1_ps(planes[i].y);
+            normals[i][2] = _mm_set1_ps(planes[i].z);
+            absoluteNormals[i][0] = _mm_set1_ps(fabsf(planes[i].x));
+            absoluteNormals[i][1] = _mm_set1_ps(fabsf(planes[i].y));
+            absoluteNormals[i][2] = _mm_set1_ps(fabsf(planes[i].z));
+            distances[i] = _mm_set1_ps(planes[i].w);
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+        for (UINT first = 0; first < mCount; first += 4)
+        {
+            __m128 centerX = _mm_loadu_ps(&mCenterX[first]);
+            __m128 centerY = _mm_loadu_ps(&mCenterY[first]);
+            __m128 centerZ = _mm_loadu_ps(&mCenterZ[first]);
+            __m128 extentX = _mm_loadu_ps(&mExtentX[first]);
+            __m128 extentY = _mm_loadu_ps(&mExtentY[first]);
+            __m128 extentZ = _mm_loadu_ps(&mExtentZ[first]);
+
+            // A box is outside when even its corner furthest along a plane's normal is behind it.
+            __m128 outside = zero;
+            for (UINT i = 0; i < PlaneCount; i++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, normals[i][0]), _mm_mul_ps(centerY, normals[i][1])), _mm_add_ps(_mm_mul_ps(centerZ, normals[i][2]), distances[i]));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, absoluteNormals[i][0]), _mm_mul_ps(extentY, absoluteNormals[i][1])), _mm_mul_ps(extentZ, absoluteNormals[i][2]));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+            }
+
+            UINT mask = static_cast<UINT>(_mm_movemask_ps(outside));
+            for (UINT lane = 0; lane < 4; lane++)
+            {
+                mVisible[first + lane] = static_cast<byte>(((mask >> lane) & 1) ^ 1);
+            }
+
+            UINT lanes = std::min(mCount - first, 4U);
+            mStatistics.Culled += CountBits(mask & ((1U << lanes) - 1));
+        }
+    }
+
+    void FrustumCuller::CullAvx(const XMFLOAT4* planes)
+    {
+        __m256 normals[PlaneCount][3];
+        __m256 absoluteNormals[PlaneCount][3];
+        __m256 distances[PlaneCount];
+        for (UINT i = 0; i < PlaneCount; i++)
+        {
+            normals[i][0] = _mm256_set1_ps(planes[i].x);
+            normals[i][1] = _mm256_set1_ps(planes[i].y);
+            normals[i][2] = _mm256_set1_ps(planes[i].z);
+            absoluteNormals[i][0] = _mm256_set1_ps(fabsf(planes[i].x));
+            absoluteNormals[i][1] = _mm256_set1_ps(fabsf(planes[i].y));
+            absoluteNormals[i][2] = _mm256_set1_ps(fabsf(planes[i].z));
+            distances[i] = _mm256_set1_ps(planes[i].w);
+        }
+
+        const __m256 zero = _mm256_setzero_ps();
+        for (UINT first = 0; first < mCount; first += 8)
+        {
+            __m256 centerX = _mm256_loadu_ps(&mCenterX[first]);
+            __m256 centerY = _mm256_loadu_ps(&mCenterY[first]);
+            __m256 centerZ = _mm256_loadu_ps(&mCenterZ[first]);
+            __m256 extentX = _mm256_loadu_ps(&mExtentX[first]);
+            __m256 extentY = _mm256_loadu_ps(&mExtentY[first]);
+            __m256 extentZ = _mm256_loadu_ps(&mExtentZ[first]);
+
+            __m256 outside = zero;
+            for (UINT i = 0; i < PlaneCount; i++)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX, normals[i][0]), _mm256_mul_ps(centerY, normals[i][1])), _mm256_add_ps(_mm256_mul_ps(centerZ, normals[i][2]), distances[i]));
+                __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(extentX, absoluteNormals[i][0]), _mm256_mul_ps(extentY, absoluteNormals[i][1])), _mm256_mul_ps(extentZ, absoluteNormals[i][2]));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+            }
+
+            UINT mask = static_cast<UINT>(_mm256_movemask_ps(outside));
+            for (UINT lane = 0; lane < 8; lane++)
+            {
+                mVisible[first + lane] = static_cast<byte>(((mask >> lane) & 1) ^ 1);
+            }
+
+            UINT lanes = std::min(mCount - first, 8U);
+            mStatistics.Culled += CountBits(mask & ((1U << lanes) - 1));
+        }
+
+        // Avoids the penalty for switching back to the SSE code the rest of the frame runs
+        _mm256_zeroupper();
+    }
+}
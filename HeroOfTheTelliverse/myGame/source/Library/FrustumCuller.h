@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Common.h"
+#include <DirectXCollision.h>
+
+namespace Library
+{
+    class Camera;
+
+    struct FrustumCullerStatistics
+    {
+        UINT Tested;
+        UINT Culled;
+        UINT BatchWidth; // Boxes per plane test: 8 with AVX, 4 otherwise.
+        double Milliseconds;
+    };
+
+    // Tests the world-space bounds of every registered object against the camera frustum once a
+    // frame, before anything draws. Bounds are kept as separate center and extent arrays, so each
+    // plane test covers a batch of boxes at once. Objects read their result with IsVisible().
+    // Removing an object moves the last one into its slot, so the arrays stay packed; ids go
+    // through a slot table and are reused once freed.
+    class FrustumCuller : public RTTI
+    {
+        RTTI_DECLARATIONS(FrustumCuller, RTTI)
+
+    public:
+        FrustumCuller();
+
+        // New objects are visible until they are given bounds.
+        UINT AddObject();
+        void RemoveObject(UINT id);
+        void SetBounds(UINT id, const BoundingBox& worldBounds);
+
+        // Visibility from the last Cull().
+        bool IsVisible(UINT id) const;
+
+        void Cull(const Camera& camera);
+        void Cull(FXMMATRIX viewProjection);
+
+        const FrustumCullerStatistics& Statistics() const;
+
+        // The six frustum planes, normalized and facing inwards, into planes[0..5].
+        static void ExtractPlanes(FXMMATRIX viewProjection, XMFLOAT4* planes);
+
+    private:
+        FrustumCuller(const FrustumCuller& rhs);
+        FrustumCuller& operator=(const FrustumCuller& rhs);
+
+        void CullSse(const XMFLOAT4* planes);
+        void CullAvx(const XMFLOAT4* planes);
+
+        UINT mCount;
+        std::vector<float> mCenterX;
+        std::vector<float> mCenterY;
+        std::vector<float> mCenterZ;
+        std::vector<float> mExtentX;
+        std::vector<float> mExtentY;
+        std::vector<float> mExtentZ;
+        std::vector<byte> mVisible;
+        std::vector<UINT> mSlots; // Array index of each id.
+        std::vector<UINT> mIds; // Id in each array index.
+        std::vector<UINT> mFreeIds;
+        bool mAvxSupported;
+        FrustumCullerStatistics mStatistics;
+    };
+}
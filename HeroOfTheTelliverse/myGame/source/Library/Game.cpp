@@ -1,6 +1,7 @@
 #include "Game.h"
 #include "DrawableGameComponent.h"
 #include "GameException.h"
+#include "AssetLoader.h"
 
 namespace Library
 {
@@ -125,6 +126,14 @@ namespace Library
             else
             {
                 mGameClock.UpdateGameTime(mGameTime);
+
+                // Finish whatever background loads are ready before this frame can use them
+                AssetLoader* assetLoader = (AssetLoader*)mServices.GetService(AssetLoader::TypeIdClass());
+                if (assetLoader != nullptr)
+                {
+                    assetLoader->ProcessUploads();
+                }
+
                 Update(mGameTime);
                 Draw(mGameTime);
             }
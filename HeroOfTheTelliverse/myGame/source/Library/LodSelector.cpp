@@ -0,0 +1,83 @@
+#include "LodSelector.h"
+#include "Camera.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace Library
+{
+    const float LodSelector::DefaultPixelError = 1.0f;
+    const float LodSelector::Hysteresis = 0.75f;
+
+    LodSelector::LodSelector(float pixelError)
+        : mLods(), mBounds(), mPixelError(pixelError), mCurrentLod(0)
+    {
+    }
+
+    void LodSelector::SetLods(const std::vector<MeshLod>& lods, const BoundingSphere& bounds)
+    {
+        mLods = lods;
+        mBounds = bounds;
+        mCurrentLod = 0;
+    }
+
+    const std::vector<MeshLod>& LodSelector::Lods() const
+    {
+        return mLods;
+    }
+
+    UINT LodSelector::CurrentLod() const
+    {
+        return mCurrentLod;
+    }
+
+    float LodSelector::PixelError() const
+    {
+        return mPixelError;
+    }
+
+    void LodSelector::SetPixelError(float pixelError)
+    {
+        mPixelError = pixelError;
+    }
+
+    float LodSelector::PixelsPerUnit(const Camera& camera, CXMMATRIX world, float screenHeight) const
+    {
+        // Errors are in object units, so scale by the largest axis of the world transform.
+        float scale = sqrtf(std::max(XMVectorGetX(XMVector3LengthSq(world.r[0])), std::max(XMVectorGetX(XMVector3LengthSq(world.r[1])), XMVectorGetX(XMVector3LengthSq(world.r[2])))));
+
+        XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&mBounds.Center), world);
+        float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, camera.PositionVector()))) - mBounds.Radius * scale;
+        if (distance <= camera.NearPlaneDistance())
+        {
+            return FLT_MAX;
+        }
+
+        return scale * screenHeight / (2.0f * distance * tanf(camera.FieldOfView() * 0.5f));
+    }
+
+    UINT LodSelector::Select(const Camera& camera, CXMMATRIX world, float screenHeight)
+    {
+        if (mLods.size() < 2)
+        {
+            mCurrentLod = 0;
+            return mCurrentLod;
+        }
+
+        float pixelsPerUnit = PixelsPerUnit(camera, world, screenHeight);
+
+        UINT lod = static_cast<UINT>(mLods.size()) - 1;
+        for (; lod > 0; lod--)
+        {
+            float threshold = (lod > mCurrentLod ? mPixelError * Hysteresis : mPixelError);
+            if (mLods[lod].Error * pixelsPerUnit <= threshold)
+            {
+                break;
+            }
+        }
+
+        mCurrentLod = lod;
+
+        return mCurrentLod;
+    }
+}
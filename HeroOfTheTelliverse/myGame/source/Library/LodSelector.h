@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Common.h"
+#include "MeshSimplifier.h"
+#include <DirectXCollision.h>
+
+namespace Library
+{
+    class Camera;
+
+    // Picks a component's detail level from how many pixels each level's geometric error would
+    // cover on screen. Kept per component so the hysteresis follows each instance separately.
+    class LodSelector
+    {
+    public:
+        static const float DefaultPixelError;
+        static const float Hysteresis;
+
+        LodSelector(float pixelError = DefaultPixelError);
+
+        // Bounds are the mesh's object-space bounding sphere; levels as returned by Mesh::Lods().
+        void SetLods(const std::vector<MeshLod>& lods, const BoundingSphere& bounds);
+
+        const std::vector<MeshLod>& Lods() const;
+        UINT CurrentLod() const;
+
+        float PixelError() const;
+        void SetPixelError(float pixelError);
+
+        // Screen pixels per object-space unit at the nearest point of the bounds.
+        float PixelsPerUnit(const Camera& camera, CXMMATRIX world, float screenHeight) const;
+
+        // Returns the coarsest level whose error projects to at most PixelError() pixels. Moving to a
+        // coarser level requires the error to fall below PixelError() * Hysteresis, so an object near
+        // the threshold doesn't flicker between two levels.
+        UINT Select(const Camera& camera, CXMMATRIX world, float screenHeight);
+
+    private:
+        std::vector<MeshLod> mLods;
+        BoundingSphere mBounds;
+        float mPixelError;
+        UINT mCurrentLod;
+    };
+}
@@ -0,0 +1,74 @@
+#include "MappedFile.h"
+#include "GameException.h"
+
+namespace Library
+{
+    MappedFile::MappedFile(const std::string& filename)
+        : mFile(INVALID_HANDLE_VALUE), mMapping(nullptr), mData(nullptr), mSize(0)
+    {
+        mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (mFile == INVALID_HANDLE_VALUE)
+        {
+            throw GameException("CreateFile() failed.", HRESULT_FROM_WIN32(GetLastError()));
+        }
+
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(mFile, &fileSize) == FALSE || fileSize.HighPart != 0)
+        {
+            CloseHandle(mFile);
+            throw GameException("GetFileSizeEx() failed or file is too large to map.");
+        }
+
+        mSize = fileSize.LowPart;
+        if (mSize == 0)
+        {
+            // Empty files cannot be mapped; leave Data() null.
+            return;
+        }
+
+        mMapping = CreateFileMapping(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping == nullptr)
+        {
+            HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            CloseHandle(mFile);
+            throw GameException("CreateFileMapping() failed.", hr);
+        }
+
+        mData = reinterpret_cast<const byte*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        if (mData == nullptr)
+        {
+            HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            CloseHandle(mMapping);
+            CloseHandle(mFile);
+            throw GameException("MapViewOfFile() failed.", hr);
+        }
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (mData != nullptr)
+        {
+            UnmapViewOfFile(mData);
+        }
+
+        if (mMapping != nullptr)
+        {
+            CloseHandle(mMapping);
+        }
+
+        if (mFile != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(mFile);
+        }
+    }
+
+    const byte* MappedFile::Data() const
+    {
+        return mData;
+    }
+
+    UINT MappedFile::Size() const
+    {
+        return mSize;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class MappedFile
+    {
+    public:
+        MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        const byte* Data() const;
+        UINT Size() const;
+
+    private:
+        MappedFile(const MappedFile& rhs);
+        MappedFile& operator=(const MappedFile& rhs);
+
+        HANDLE mFile;
+        HANDLE mMapping;
+        const byte* mData;
+        UINT mSize;
+    };
+}
@@ -2,101 +2,201 @@
 #include "Model.h"
 #include "Game.h"
 #include "GameException.h"
+#include "MeshOptimizer.h"
+#include "TangentGenerator.h"
 #include <assimp/scene.h>
+#include <climits>
 
 namespace Library
 {
-    Mesh::Mesh(Model& model, aiMesh& mesh)
-        : mModel(model), mMaterial(nullptr), mName(mesh.mName.C_Str()), mVertices(), mNormals(), mTangents(), mBiNormals(), mTextureCoordinates(), mVertexColors(), mFaceCount(0), mIndices()
+    namespace
     {
-		mMaterial = mModel.Materials().at(mesh.mMaterialIndex);
+        template <typename T>
+        void RemapStream(ArraySpan<const T> source, ArraySpan<T> destination, const std::vector<UINT>& remap)
+        {
+            if (source.empty())
+            {
+                return;
+            }
+
+            for (UINT i = 0; i < remap.size(); i++)
+            {
+                if (remap[i] != UINT_MAX)
+                {
+                    destination[remap[i]] = source[i];
+                }
+            }
+        }
 
-        // Vertices
-        mVertices.reserve(mesh.mNumVertices);
-        for (UINT i = 0; i < mesh.mNumVertices; i++)
+        template <typename T>
+        void GatherStream(ArraySpan<const T> source, ArraySpan<T> destination, const std::vector<UINT>& sourceIndices)
         {
-            mVertices.push_back(XMFLOAT3(reinterpret_cast<const float*>(&mesh.mVertices[i])));			
+            if (source.empty())
+            {
+                return;
+            }
+
+            for (UINT i = 0; i < sourceIndices.size(); i++)
+            {
+                destination[i] = source[sourceIndices[i]];
+            }
         }
+    }
 
-        // Normals
-        if (mesh.HasNormals())
+    void MeshBounds::Compute(ArraySpan<const XMFLOAT3> positions, MeshBounds& bounds)
+    {
+        bounds.Box = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+        bounds.Sphere = BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f);
+        bounds.OrientedBox = BoundingOrientedBox();
+        bounds.OrientedBox.Extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+        UINT count = static_cast<UINT>(positions.size());
+        if (count == 0)
+        {
+            return;
+        }
+
+        // Two accumulator pairs keep consecutive min/max operations independent.
+        const XMFLOAT3* position = positions.data();
+        XMVECTOR minimum0 = XMLoadFloat3(position);
+        XMVECTOR maximum0 = minimum0;
+        XMVECTOR minimum1 = minimum0;
+        XMVECTOR maximum1 = minimum0;
+
+        UINT i = 0;
+        for (; i + 1 < count; i += 2)
+        {
+            XMVECTOR first = XMLoadFloat3(&position[i]);
+            XMVECTOR second = XMLoadFloat3(&position[i + 1]);
+            minimum0 = XMVectorMin(minimum0, first);
+            maximum0 = XMVectorMax(maximum0, first);
+            minimum1 = XMVectorMin(minimum1, second);
+            maximum1 = XMVectorMax(maximum1, second);
+        }
+
+        if (i < count)
+        {
+            XMVECTOR last = XMLoadFloat3(&position[i]);
+            minimum0 = XMVectorMin(minimum0, last);
+            maximum0 = XMVectorMax(maximum0, last);
+        }
+
+        XMVECTOR minimum = XMVectorMin(minimum0, minimum1);
+        XMVECTOR maximum = XMVectorMax(maximum0, maximum1);
+        BoundingBox::CreateFromPoints(bounds.Box, minimum, maximum);
+
+        XMVECTOR center = XMLoadFloat3(&bounds.Box.Center);
+        XMVECTOR radiusSquared = XMVectorZero();
+        for (i = 0; i < count; i++)
+        {
+            radiusSquared = XMVectorMax(radiusSquared, XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&position[i]), center)));
+        }
+
+        bounds.Sphere.Center = bounds.Box.Center;
+        bounds.Sphere.Radius = XMVectorGetX(XMVectorSqrt(radiusSquared));
+
+        BoundingOrientedBox::CreateFromBoundingBox(bounds.OrientedBox, bounds.Box);
+        if (count >= 3)
         {
-            mNormals.reserve(mesh.mNumVertices);
-            for (UINT i = 0; i < mesh.mNumVertices; i++)
+            BoundingOrientedBox fitted;
+            BoundingOrientedBox::CreateFromPoints(fitted, count, position, sizeof(XMFLOAT3));
+
+            float fittedVolume = fitted.Extents.x * fitted.Extents.y * fitted.Extents.z;
+            float boxVolume = bounds.Box.Extents.x * bounds.Box.Extents.y * bounds.Box.Extents.z;
+            if (fittedVolume < boxVolume)
             {
-                mNormals.push_back(XMFLOAT3(reinterpret_cast<const float*>(&mesh.mNormals[i])));
+                bounds.OrientedBox = fitted;
             }
         }
+    }
+
+    void MeshBounds::Merge(const MeshBounds& first, const MeshBounds& second, MeshBounds& merged)
+    {
+        BoundingBox box;
+        BoundingBox::CreateMerged(box, first.Box, second.Box);
+
+        BoundingSphere sphere;
+        BoundingSphere::CreateMerged(sphere, first.Sphere, second.Sphere);
+
+        // Fitting an oriented box to both would need the vertices again, so merges keep it axis-aligned.
+        merged.Box = box;
+        merged.Sphere = sphere;
+        BoundingOrientedBox::CreateFromBoundingBox(merged.OrientedBox, box);
+    }
+
+    static_assert(sizeof(aiVector3D) == sizeof(XMFLOAT3), "aiVector3D must be layout compatible with XMFLOAT3.");
+    static_assert(sizeof(aiColor4D) == sizeof(XMFLOAT4), "aiColor4D must be layout compatible with XMFLOAT4.");
+
+    Mesh::Mesh(Model& model, ModelMaterial* material)
+        : mModel(model), mMaterial(material), mName(), mStreams(), mFaceCount(0), mIndices()
+    {
+    }
+
+    Mesh::Mesh(Model& model, aiMesh& mesh)
+        : mModel(model), mMaterial(nullptr), mName(mesh.mName.C_Str()), mStreams(), mFaceCount(0), mIndices()
+    {
+		mMaterial = mModel.Materials().at(mesh.mMaterialIndex);
+
+        // Every stream shares one allocation, and aiVector3D and aiColor4D match XMFLOAT3 and
+        // XMFLOAT4 member for member, so each stream is a straight block copy into it.
+        UINT vertexCount = mesh.mNumVertices;
+        UINT uvChannelCount = mesh.GetNumUVChannels();
+        UINT colorChannelCount = mesh.GetNumColorChannels();
+        mStreams.Allocate(vertexCount, mesh.HasNormals(), mesh.HasTangentsAndBitangents(), uvChannelCount, colorChannelCount);
+
+        memcpy(mStreams.Positions().data(), mesh.mVertices, sizeof(XMFLOAT3) * vertexCount);
+
+        // Normals
+        if (mesh.HasNormals())
+        {
+            memcpy(mStreams.Normals().data(), mesh.mNormals, sizeof(XMFLOAT3) * vertexCount);
+        }
 
         // Tangents and Binormals
         if (mesh.HasTangentsAndBitangents())
         {
-            mTangents.reserve(mesh.mNumVertices);
-            mBiNormals.reserve(mesh.mNumVertices);
-            for (UINT i = 0; i < mesh.mNumVertices; i++)
-            {
-                mTangents.push_back(XMFLOAT3(reinterpret_cast<const float*>(&mesh.mTangents[i])));
-                mBiNormals.push_back(XMFLOAT3(reinterpret_cast<const float*>(&mesh.mBitangents[i])));
-            }
+            memcpy(mStreams.Tangents().data(), mesh.mTangents, sizeof(XMFLOAT3) * vertexCount);
+            memcpy(mStreams.BiNormals().data(), mesh.mBitangents, sizeof(XMFLOAT3) * vertexCount);
         }
 
         // Texture Coordinates
-        UINT uvChannelCount = mesh.GetNumUVChannels();
         for (UINT i = 0; i < uvChannelCount; i++)
         {
-            std::vector<XMFLOAT3>* textureCoordinates = new std::vector<XMFLOAT3>();
-            textureCoordinates->reserve(mesh.mNumVertices);
-            mTextureCoordinates.push_back(textureCoordinates);
-
-            aiVector3D* aiTextureCoordinates = mesh.mTextureCoords[i];
-            for (UINT j = 0; j < mesh.mNumVertices; j++)
-            {
-                textureCoordinates->push_back(XMFLOAT3(reinterpret_cast<const float*>(&aiTextureCoordinates[j])));
-            }
+            memcpy(mStreams.TextureCoordinates(i).data(), mesh.mTextureCoords[i], sizeof(XMFLOAT3) * vertexCount);
         }
 
         // Vertex Colors
-        UINT colorChannelCount = mesh.GetNumColorChannels();
         for (UINT i = 0; i < colorChannelCount; i++)
         {
-            std::vector<XMFLOAT4>* vertexColors = new std::vector<XMFLOAT4>();
-            vertexColors->reserve(mesh.mNumVertices);
-            mVertexColors.push_back(vertexColors);
-
-            aiColor4D* aiVertexColors = mesh.mColors[i];
-            for (UINT j = 0; j < mesh.mNumVertices; j++)
-            {
-                vertexColors->push_back(XMFLOAT4(reinterpret_cast<const float*>(&aiVertexColors[j])));
-            }
+            memcpy(mStreams.VertexColors(i).data(), mesh.mColors[i], sizeof(XMFLOAT4) * vertexCount);
         }
 
-        // Faces (note: could pre-reserve if we limit primitive types)
+        // Faces
         if (mesh.HasFaces())
         {
             mFaceCount = mesh.mNumFaces;
+
+            UINT indexCount = 0;
             for (UINT i = 0; i < mFaceCount; i++)
             {
-                aiFace* face = &mesh.mFaces[i];
-            
-                for (UINT j = 0; j < face->mNumIndices; j++)
-                {		
-                    mIndices.push_back(face->mIndices[j]);
-                }
+                indexCount += mesh.mFaces[i].mNumIndices;
+            }
+
+            mIndices.resize(indexCount);
+            UINT* indices = mIndices.data();
+            for (UINT i = 0; i < mFaceCount; i++)
+            {
+                const aiFace& face = mesh.mFaces[i];
+                memcpy(indices, face.mIndices, sizeof(UINT) * face.mNumIndices);
+                indices += face.mNumIndices;
             }
         }
+
+        MeshBounds::Compute(mStreams.Positions(), mBounds);
     }
 
     Mesh::~Mesh()
     {
-        for (std::vector<XMFLOAT3>* textureCoordinates : mTextureCoordinates)
-        {
-            delete textureCoordinates;
-        }
-
-        for (std::vector<XMFLOAT4>* vertexColors : mVertexColors)
-        {
-            delete vertexColors;
-        }
     }
 
     Model& Mesh::GetModel()
@@ -114,34 +214,34 @@ namespace Library
         return mName;
     }
 
-    const std::vector<XMFLOAT3>& Mesh::Vertices() const
+    ArraySpan<const XMFLOAT3> Mesh::Vertices() const
     {
-        return mVertices;
+        return mStreams.Positions();
     }
 
-    const std::vector<XMFLOAT3>& Mesh::Normals() const
+    ArraySpan<const XMFLOAT3> Mesh::Normals() const
     {
-        return mNormals;
+        return mStreams.Normals();
     }
 
-    const std::vector<XMFLOAT3>& Mesh::Tangents() const
+    ArraySpan<const XMFLOAT3> Mesh::Tangents() const
     {
-        return mTangents;
+        return mStreams.Tangents();
     }
 
-    const std::vector<XMFLOAT3>& Mesh::BiNormals() const
+    ArraySpan<const XMFLOAT3> Mesh::BiNormals() const
     {
-        return mBiNormals;
+        return mStreams.BiNormals();
     }
 
-    const std::vector<std::vector<XMFLOAT3>*>& Mesh::TextureCoordinates() const
+    const std::vector<ArraySpan<const XMFLOAT3>>& Mesh::TextureCoordinates() const
     {
-        return mTextureCoordinates;
+        return mStreams.TextureCoordinates();
     }
 
-    const std::vector<std::vector<XMFLOAT4>*>& Mesh::VertexColors() const
+    const std::vector<ArraySpan<const XMFLOAT4>>& Mesh::VertexColors() const
     {
-        return mVertexColors;
+        return mStreams.VertexColors();
     }
 
     UINT Mesh::FaceCount() const
@@ -154,22 +254,238 @@ namespace Library
         return mIndices;
     }
 
+    const std::vector<Meshlet>& Mesh::Meshlets() const
+    {
+        return mMeshlets;
+    }
+
+    const MeshBounds& Mesh::Bounds() const
+    {
+        return mBounds;
+    }
+
+    const std::vector<MeshLod>& Mesh::Lods() const
+    {
+        return mLods;
+    }
+
+    const std::vector<UINT>& Mesh::LodIndices() const
+    {
+        return mLodIndices;
+    }
+
+    DXGI_FORMAT Mesh::IndexFormat() const
+    {
+        return (mStreams.VertexCount() <= USHRT_MAX ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT);
+    }
+
+    UINT Mesh::IndexSize() const
+    {
+        return (IndexFormat() == DXGI_FORMAT_R16_UINT ? sizeof(USHORT) : sizeof(UINT));
+    }
+
     void Mesh::CreateIndexBuffer(ID3D11Buffer** indexBuffer)
     {
         assert(indexBuffer != nullptr);
 
+        std::vector<UINT> allIndices;
+        const std::vector<UINT>* indices = &mIndices;
+        if (mLodIndices.size() > 0)
+        {
+            allIndices.reserve(mIndices.size() + mLodIndices.size());
+            allIndices.assign(mIndices.begin(), mIndices.end());
+            allIndices.insert(allIndices.end(), mLodIndices.begin(), mLodIndices.end());
+            indices = &allIndices;
+        }
+
+        std::vector<USHORT> shortIndices;
+        const void* indexData = &(*indices)[0];
+        if (IndexFormat() == DXGI_FORMAT_R16_UINT)
+        {
+            shortIndices.assign(indices->begin(), indices->end());
+            indexData = &shortIndices[0];
+        }
+
         D3D11_BUFFER_DESC indexBufferDesc;
         ZeroMemory(&indexBufferDesc, sizeof(indexBufferDesc));
-        indexBufferDesc.ByteWidth = sizeof(UINT) * mIndices.size();
+        indexBufferDesc.ByteWidth = IndexSize() * indices->size();
         indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;		
         indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 
         D3D11_SUBRESOURCE_DATA indexSubResourceData;
         ZeroMemory(&indexSubResourceData, sizeof(indexSubResourceData));
-        indexSubResourceData.pSysMem = &mIndices[0];
+        indexSubResourceData.pSysMem = indexData;
         if (FAILED(mModel.GetGame().Direct3DDevice()->CreateBuffer(&indexBufferDesc, &indexSubResourceData, indexBuffer)))
         {
             throw GameException("ID3D11Device::CreateBuffer() failed.");
         }
     }
+
+    bool Mesh::Optimize(MeshOptimizationReport* report)
+    {
+        UINT vertexCount = mStreams.VertexCount();
+        if (mIndices.size() == 0 || mIndices.size() != mFaceCount * 3)
+        {
+            return false;
+        }
+
+        VertexCacheStatistics before = MeshOptimizer::AnalyzeVertexCache(mIndices, vertexCount);
+
+        MeshOptimizer::OptimizeVertexCache(mIndices, vertexCount);
+
+        // Meshlets only regroup triangles, so rebuild them before the fetch pass renumbers vertices.
+        if (mMeshlets.empty() == false)
+        {
+            BuildMeshlets();
+        }
+
+        std::vector<UINT> remap;
+        UINT optimizedVertexCount = MeshOptimizer::OptimizeVertexFetch(mIndices, vertexCount, remap);
+
+        // Coarser levels only reference vertices level 0 uses, so the same remap covers them.
+        for (UINT& index : mLodIndices)
+        {
+            index = remap[index];
+        }
+
+        const MeshStreams& streams = mStreams;
+        MeshStreams optimized;
+        optimized.Allocate(optimizedVertexCount, streams.Normals().empty() == false, streams.Tangents().empty() == false, static_cast<UINT>(streams.TextureCoordinates().size()), static_cast<UINT>(streams.VertexColors().size()));
+
+        RemapStream(streams.Positions(), optimized.Positions(), remap);
+        RemapStream(streams.Normals(), optimized.Normals(), remap);
+        RemapStream(streams.Tangents(), optimized.Tangents(), remap);
+        RemapStream(streams.BiNormals(), optimized.BiNormals(), remap);
+
+        for (UINT i = 0; i < streams.TextureCoordinates().size(); i++)
+        {
+            RemapStream(streams.TextureCoordinates()[i], optimized.TextureCoordinates(i), remap);
+        }
+
+        for (UINT i = 0; i < streams.VertexColors().size(); i++)
+        {
+            RemapStream(streams.VertexColors()[i], optimized.VertexColors(i), remap);
+        }
+
+        mStreams = std::move(optimized);
+
+        // Dropping unreferenced vertices can shrink the bounds.
+        if (optimizedVertexCount < vertexCount)
+        {
+            MeshBounds::Compute(mStreams.Positions(), mBounds);
+        }
+
+        if (report != nullptr)
+        {
+            report->Before = before;
+            report->After = MeshOptimizer::AnalyzeVertexCache(mIndices, optimizedVertexCount);
+            report->VerticesRemoved = vertexCount - optimizedVertexCount;
+        }
+
+        return true;
+    }
+
+    bool Mesh::BuildMeshlets(UINT maxVertices, UINT maxTriangles)
+    {
+        if (mIndices.size() == 0 || mIndices.size() != mFaceCount * 3)
+        {
+            mMeshlets.clear();
+            return false;
+        }
+
+        MeshletBuilder::Build(mIndices, mStreams.Positions(), mMeshlets, maxVertices, maxTriangles);
+
+        return true;
+    }
+
+    bool Mesh::GenerateTangents(ThreadPool* threadPool)
+    {
+        if (mStreams.Tangents().empty() == false)
+        {
+            return true;
+        }
+
+        if (mIndices.size() == 0 || mIndices.size() != mFaceCount * 3 || mStreams.Normals().empty() || mStreams.TextureCoordinates().empty())
+        {
+            return false;
+        }
+
+        UINT vertexCount = mStreams.VertexCount();
+        std::vector<UINT> sourceVertices;
+        std::vector<XMFLOAT3> tangents;
+        std::vector<XMFLOAT3> biNormals;
+        TangentGenerator::Generate(mStreams.Positions(), mStreams.Normals(), mStreams.TextureCoordinates()[0], mIndices, sourceVertices, tangents, biNormals, threadPool);
+
+        UINT generatedVertexCount = static_cast<UINT>(sourceVertices.size());
+        const MeshStreams& streams = mStreams;
+        MeshStreams generated;
+        generated.Allocate(generatedVertexCount, true, true, static_cast<UINT>(streams.TextureCoordinates().size()), static_cast<UINT>(streams.VertexColors().size()));
+
+        GatherStream(streams.Positions(), generated.Positions(), sourceVertices);
+        GatherStream(streams.Normals(), generated.Normals(), sourceVertices);
+        memcpy(generated.Tangents().data(), &tangents[0], sizeof(XMFLOAT3) * generatedVertexCount);
+        memcpy(generated.BiNormals().data(), &biNormals[0], sizeof(XMFLOAT3) * generatedVertexCount);
+
+        for (UINT i = 0; i < streams.TextureCoordinates().size(); i++)
+        {
+            GatherStream(streams.TextureCoordinates()[i], generated.TextureCoordinates(i), sourceVertices);
+        }
+
+        for (UINT i = 0; i < streams.VertexColors().size(); i++)
+        {
+            GatherStream(streams.VertexColors()[i], generated.VertexColors(i), sourceVertices);
+        }
+
+        mStreams = std::move(generated);
+
+        // Coarser levels keep pointing at the original vertices, which are still in place.
+        if (generatedVertexCount > vertexCount && mMeshlets.empty() == false)
+        {
+            BuildMeshlets();
+        }
+
+        return true;
+    }
+
+    bool Mesh::GenerateLods(const std::vector<float>& triangleRatios, float maxError)
+    {
+        mLods.clear();
+        mLodIndices.clear();
+
+        if (mIndices.size() == 0 || mIndices.size() != mFaceCount * 3)
+        {
+            return false;
+        }
+
+        UINT vertexCount = mStreams.VertexCount();
+        MeshLod fullDetail = { 0, static_cast<UINT>(mIndices.size()), 0.0f };
+        mLods.push_back(fullDetail);
+
+        // Every level simplifies the full-detail mesh so errors are measured against the original
+        // surface rather than compounding level over level.
+        std::vector<UINT> simplified;
+        for (float ratio : triangleRatios)
+        {
+            UINT targetIndexCount = static_cast<UINT>(mFaceCount * ratio) * 3;
+            float error = MeshSimplifier::Simplify(mIndices, mStreams.Positions(), targetIndexCount, maxError, simplified);
+
+            const MeshLod& previous = mLods.back();
+            if (simplified.size() == 0 || simplified.size() >= previous.IndexCount)
+            {
+                break;
+            }
+
+            MeshOptimizer::OptimizeVertexCache(simplified, vertexCount);
+
+            MeshLod lod;
+            lod.IndexOffset = static_cast<UINT>(mIndices.size() + mLodIndices.size());
+            lod.IndexCount = static_cast<UINT>(simplified.size());
+            lod.Error = (error > previous.Error ? error : previous.Error);
+            mLods.push_back(lod);
+
+            mLodIndices.insert(mLodIndices.end(), simplified.begin(), simplified.end());
+        }
+
+        return true;
+    }
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "Common.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "MeshStreams.h"
+#include <DirectXCollision.h>
+#include <cfloat>
 
 struct aiMesh;
 
@@ -8,10 +13,27 @@ namespace Library
 {
     class Material;
     class ModelMaterial;
+    class ThreadPool;
+    struct MeshOptimizationReport;
+
+    // Object-space bounds of a position stream. Sphere is centred on the box so the two always
+    // agree; OrientedBox falls back to the axis-aligned box when that is the tighter fit.
+    struct MeshBounds
+    {
+        BoundingBox Box;
+        BoundingSphere Sphere;
+        BoundingOrientedBox OrientedBox;
+
+        static void Compute(ArraySpan<const XMFLOAT3> positions, MeshBounds& bounds);
+        static void Merge(const MeshBounds& first, const MeshBounds& second, MeshBounds& merged);
+    };
 
     class Mesh
     {
         friend class Model;
+        friend class MeshFile;
+        friend class ObjFile;
+        friend class ThreeDSFile;
 
     public:
         Mesh(Model& model, ModelMaterial* material);
@@ -21,17 +43,55 @@ namespace Library
         ModelMaterial* GetMaterial();
         const std::string& Name() const;
 
-        const std::vector<XMFLOAT3>& Vertices() const;
-        const std::vector<XMFLOAT3>& Normals() const;
-        const std::vector<XMFLOAT3>& Tangents() const;
-        const std::vector<XMFLOAT3>& BiNormals() const;
-        const std::vector<std::vector<XMFLOAT3>*>& TextureCoordinates() const;
-        const std::vector<std::vector<XMFLOAT4>*>& VertexColors() const;
+        // Views into one block owned by the mesh; they stay valid until Optimize() or
+        // GenerateTangents() rebuilds the streams.
+        ArraySpan<const XMFLOAT3> Vertices() const;
+        ArraySpan<const XMFLOAT3> Normals() const;
+        ArraySpan<const XMFLOAT3> Tangents() const;
+        ArraySpan<const XMFLOAT3> BiNormals() const;
+        const std::vector<ArraySpan<const XMFLOAT3>>& TextureCoordinates() const;
+        const std::vector<ArraySpan<const XMFLOAT4>>& VertexColors() const;
         UINT FaceCount() const;
         const std::vector<UINT>& Indices() const;
+        const std::vector<Meshlet>& Meshlets() const;
+
+        // Computed once when the mesh is imported or read back from a cooked file.
+        const MeshBounds& Bounds() const;
+
+        // Level 0 followed by each coarser level, or empty until GenerateLods() has run. The index
+        // buffer holds Indices() followed by LodIndices(), and each level's range points into it.
+        const std::vector<MeshLod>& Lods() const;
+        const std::vector<UINT>& LodIndices() const;
+
+        // Index buffers are 16-bit whenever every index fits, 32-bit otherwise.
+        DXGI_FORMAT IndexFormat() const;
+        UINT IndexSize() const;
 
         void CreateIndexBuffer(ID3D11Buffer** indexBuffer);
 
+        // Reorders triangles for vertex cache reuse, then vertices for fetch locality, remapping
+        // every attribute stream; meshlets, if built, are rebuilt along the way. Returns false (and
+        // leaves the mesh untouched) for anything other than a triangle list.
+        bool Optimize(MeshOptimizationReport* report = nullptr);
+
+        // Regroups the triangles into meshlets with culling bounds. Indices() keeps the same
+        // triangles, now ordered meshlet by meshlet. Only the content cooker builds them: imports at
+        // run time skip the reorder and are drawn one submesh at a time. Returns false for anything
+        // but a triangle list.
+        bool BuildMeshlets(UINT maxVertices = MeshletBuilder::MaxVertices, UINT maxTriangles = MeshletBuilder::MaxTriangles);
+
+        // Adds tangents and binormals from the normals and the first texture coordinate channel
+        // (see TangentGenerator), splitting vertices on mirrored UV seams. Meant to run at cook
+        // time or on first use by a normal-mapped material: returns true straight away when the
+        // mesh already has tangents, and false for meshes without a triangle list, normals or
+        // texture coordinates. Level 0's triangles may be renumbered, so any meshlets are rebuilt.
+        bool GenerateTangents(ThreadPool* threadPool = nullptr);
+
+        // Simplifies the full-detail triangles down to each ratio of the original triangle count,
+        // stopping early once a level can't get any coarser or would exceed maxError. Returns false
+        // for anything but a triangle list.
+        bool GenerateLods(const std::vector<float>& triangleRatios, float maxError = FLT_MAX);
+
     private:
         Mesh(Model& model, aiMesh& mesh);
         Mesh(const Mesh& rhs);
@@ -40,13 +100,12 @@ namespace Library
         Model& mModel;
         ModelMaterial* mMaterial;
         std::string mName;
-        std::vector<XMFLOAT3> mVertices;
-        std::vector<XMFLOAT3> mNormals;
-        std::vector<XMFLOAT3> mTangents;
-        std::vector<XMFLOAT3> mBiNormals;
-        std::vector<std::vector<XMFLOAT3>*> mTextureCoordinates;
-        std::vector<std::vector<XMFLOAT4>*> mVertexColors;
+        MeshStreams mStreams;
         UINT mFaceCount;
         std::vector<UINT> mIndices;
+        std::vector<Meshlet> mMeshlets;
+        MeshBounds mBounds;
+        std::vector<MeshLod> mLods;
+        std::vector<UINT> mLodIndices;
     };
 }
\ No newline at end of file
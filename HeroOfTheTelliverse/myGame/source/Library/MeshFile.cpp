@@ -0,0 +1,406 @@
+#include "MeshFile.h"
+#include "MappedFile.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "ModelMaterial.h"
+#include "GameException.h"
+#include <algorithm>
+#include <climits>
+#include <fstream>
+
+namespace Library
+{
+    const UINT MeshFile::Magic = 0x4853454D; // "MESH"
+    const UINT MeshFile::Version = 5;
+    const UINT MeshFile::Alignment = 16;
+    const std::string MeshFile::Extension = ".mesh";
+
+    namespace
+    {
+        UINT AppendData(std::vector<byte>& buffer, const void* data, UINT size)
+        {
+            UINT offset = static_cast<UINT>((buffer.size() + MeshFile::Alignment - 1) & ~(MeshFile::Alignment - 1));
+            buffer.resize(offset + size);
+            if (size > 0)
+            {
+                memcpy(&buffer[offset], data, size);
+            }
+
+            return offset;
+        }
+
+        template <typename T>
+        UINT AppendVector(std::vector<byte>& buffer, const std::vector<T>& data)
+        {
+            return AppendData(buffer, (data.size() > 0 ? &data[0] : nullptr), static_cast<UINT>(sizeof(T) * data.size()));
+        }
+
+        template <typename T>
+        UINT AppendSpan(std::vector<byte>& buffer, ArraySpan<const T> data)
+        {
+            return AppendData(buffer, data.data(), static_cast<UINT>(sizeof(T) * data.size()));
+        }
+
+        template <typename T>
+        const T* GetArray(const MappedFile& file, UINT offset, UINT count)
+        {
+            unsigned long long end = static_cast<unsigned long long>(offset) + static_cast<unsigned long long>(count) * sizeof(T);
+            if (end > file.Size() || (offset % __alignof(T)) != 0)
+            {
+                throw GameException("Mesh file is corrupt.");
+            }
+
+            return reinterpret_cast<const T*>(file.Data() + offset);
+        }
+
+        bool GetLastWriteTime(const std::string& filename, FILETIME& lastWriteTime)
+        {
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            if (GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes) == FALSE)
+            {
+                return false;
+            }
+
+            lastWriteTime = attributes.ftLastWriteTime;
+            return true;
+        }
+    }
+
+    bool MeshFile::IsMeshFile(const std::string& filename)
+    {
+        if (filename.size() < Extension.size())
+        {
+            return false;
+        }
+
+        std::string extension = filename.substr(filename.size() - Extension.size());
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+        return (extension == Extension);
+    }
+
+    std::string MeshFile::CookedFilename(const std::string& sourceFilename)
+    {
+        std::string::size_type lastSlashIndex = sourceFilename.find_last_of("\\/");
+        std::string::size_type lastDotIndex = sourceFilename.find_last_of('.');
+
+        if (lastDotIndex == std::string::npos || (lastSlashIndex != std::string::npos && lastDotIndex < lastSlashIndex))
+        {
+            return sourceFilename + Extension;
+        }
+
+        return sourceFilename.substr(0, lastDotIndex) + Extension;
+    }
+
+    bool MeshFile::IsCookedFileCurrent(const std::string& sourceFilename, const std::string& cookedFilename, UINT importFlags)
+    {
+        FILETIME sourceTime;
+        FILETIME cookedTime;
+        if (GetLastWriteTime(cookedFilename, cookedTime) == false)
+        {
+            return false;
+        }
+
+        if (GetLastWriteTime(sourceFilename, sourceTime) && CompareFileTime(&cookedTime, &sourceTime) < 0)
+        {
+            return false;
+        }
+
+        return IsCookedFileCompatible(cookedFilename, importFlags);
+    }
+
+    bool MeshFile::IsCookedFileCompatible(const std::string& cookedFilename, UINT importFlags)
+    {
+        std::ifstream file(cookedFilename.c_str(), std::ios::binary);
+        MeshFileHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        {
+            return false;
+        }
+
+        return (header.Magic == Magic && header.Version == Version && header.ImportFlags == importFlags);
+    }
+
+    void MeshFile::Write(const Model& model, const std::string& filename, UINT importFlags)
+    {
+        std::vector<byte> buffer(sizeof(MeshFileHeader));
+
+        // Materials
+        const std::vector<ModelMaterial*>& materials = model.Materials();
+        std::vector<MeshFileMaterial> materialRecords;
+        materialRecords.reserve(materials.size());
+        for (ModelMaterial* material : materials)
+        {
+            MeshFileMaterial materialRecord;
+            materialRecord.NameLength = static_cast<UINT>(material->mName.size());
+            materialRecord.NameOffset = AppendData(buffer, material->mName.c_str(), materialRecord.NameLength);
+
+            std::vector<MeshFileTexture> textureRecords;
+            for (const std::pair<TextureType, std::vector<std::wstring>*>& textures : material->mTextures)
+            {
+                for (const std::wstring& path : *textures.second)
+                {
+                    MeshFileTexture textureRecord;
+                    textureRecord.TextureType = textures.first;
+                    textureRecord.PathLength = static_cast<UINT>(path.size());
+                    textureRecord.PathOffset = AppendData(buffer, path.c_str(), static_cast<UINT>(sizeof(wchar_t) * path.size()));
+                    textureRecords.push_back(textureRecord);
+                }
+            }
+
+            materialRecord.TextureCount = static_cast<UINT>(textureRecords.size());
+            materialRecord.TexturesOffset = AppendVector(buffer, textureRecords);
+            materialRecords.push_back(materialRecord);
+        }
+
+        // Meshes
+        const std::vector<Mesh*>& meshes = model.Meshes();
+        std::vector<MeshFileMesh> meshRecords;
+        meshRecords.reserve(meshes.size());
+        for (Mesh* mesh : meshes)
+        {
+            MeshFileMesh meshRecord;
+            ZeroMemory(&meshRecord, sizeof(meshRecord));
+
+            meshRecord.NameLength = static_cast<UINT>(mesh->mName.size());
+            meshRecord.NameOffset = AppendData(buffer, mesh->mName.c_str(), meshRecord.NameLength);
+
+            std::vector<ModelMaterial*>::const_iterator material = std::find(materials.begin(), materials.end(), mesh->mMaterial);
+            meshRecord.MaterialIndex = (material != materials.end() ? static_cast<UINT>(material - materials.begin()) : UINT_MAX);
+
+            const MeshStreams& streams = mesh->mStreams;
+            meshRecord.VertexCount = streams.VertexCount();
+            // Point and line meshes are stored without their faces, since the reader only takes triangle lists.
+            bool isTriangleList = (mesh->mIndices.size() == static_cast<size_t>(mesh->mFaceCount) * 3);
+            meshRecord.IndexCount = (isTriangleList ? static_cast<UINT>(mesh->mIndices.size()) : 0);
+            meshRecord.FaceCount = (isTriangleList ? mesh->mFaceCount : 0);
+            meshRecord.TextureCoordinateChannelCount = static_cast<UINT>(streams.TextureCoordinates().size());
+            meshRecord.VertexColorChannelCount = static_cast<UINT>(streams.VertexColors().size());
+
+            meshRecord.PositionsOffset = AppendSpan(buffer, streams.Positions());
+            meshRecord.NormalsOffset = (streams.Normals().size() > 0 ? AppendSpan(buffer, streams.Normals()) : 0);
+            meshRecord.TangentsOffset = (streams.Tangents().size() > 0 ? AppendSpan(buffer, streams.Tangents()) : 0);
+            meshRecord.BiNormalsOffset = (streams.BiNormals().size() > 0 ? AppendSpan(buffer, streams.BiNormals()) : 0);
+
+            // Channels are stored back to back so each one is VertexCount elements long.
+            for (UINT i = 0; i < meshRecord.TextureCoordinateChannelCount; i++)
+            {
+                UINT offset = AppendSpan(buffer, streams.TextureCoordinates()[i]);
+                if (i == 0)
+                {
+                    meshRecord.TextureCoordinatesOffset = offset;
+                }
+            }
+
+            for (UINT i = 0; i < meshRecord.VertexColorChannelCount; i++)
+            {
+                UINT offset = AppendSpan(buffer, streams.VertexColors()[i]);
+                if (i == 0)
+                {
+                    meshRecord.VertexColorsOffset = offset;
+                }
+            }
+
+            meshRecord.IndicesOffset = AppendVector(buffer, (isTriangleList ? mesh->mIndices : std::vector<UINT>()));
+            meshRecord.MeshletCount = static_cast<UINT>(mesh->mMeshlets.size());
+            meshRecord.MeshletsOffset = AppendVector(buffer, mesh->mMeshlets);
+            meshRecord.LodCount = static_cast<UINT>(mesh->mLods.size());
+            meshRecord.LodsOffset = AppendVector(buffer, mesh->mLods);
+            meshRecord.LodIndexCount = static_cast<UINT>(mesh->mLodIndices.size());
+            meshRecord.LodIndicesOffset = AppendVector(buffer, mesh->mLodIndices);
+
+            // The sphere shares the box's centre, so only its radius is stored.
+            const MeshBounds& bounds = mesh->mBounds;
+            XMStoreFloat3(&meshRecord.BoundsMin, XMVectorSubtract(XMLoadFloat3(&bounds.Box.Center), XMLoadFloat3(&bounds.Box.Extents)));
+            XMStoreFloat3(&meshRecord.BoundsMax, XMVectorAdd(XMLoadFloat3(&bounds.Box.Center), XMLoadFloat3(&bounds.Box.Extents)));
+            meshRecord.BoundingSphereRadius = bounds.Sphere.Radius;
+            meshRecord.OrientedBoxCenter = bounds.OrientedBox.Center;
+            meshRecord.OrientedBoxExtents = bounds.OrientedBox.Extents;
+            meshRecord.OrientedBoxOrientation = bounds.OrientedBox.Orientation;
+
+            meshRecords.push_back(meshRecord);
+        }
+
+        MeshFileHeader header;
+        header.Magic = Magic;
+        header.Version = Version;
+        header.ImportFlags = importFlags;
+        header.MeshCount = static_cast<UINT>(meshRecords.size());
+        header.MaterialCount = static_cast<UINT>(materialRecords.size());
+        header.MaterialTableOffset = AppendVector(buffer, materialRecords);
+        header.MeshTableOffset = AppendVector(buffer, meshRecords);
+
+        buffer.resize((buffer.size() + Alignment - 1) & ~(Alignment - 1));
+        header.FileSize = static_cast<UINT>(buffer.size());
+        memcpy(&buffer[0], &header, sizeof(header));
+
+        std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            throw GameException("Could not open mesh file for writing.");
+        }
+
+        file.write(reinterpret_cast<const char*>(&buffer[0]), buffer.size());
+        if (!file)
+        {
+            throw GameException("Could not write mesh file.");
+        }
+    }
+
+    void MeshFile::Read(Model& model, const MappedFile& file, UINT importFlags)
+    {
+        const MeshFileHeader* header = GetArray<MeshFileHeader>(file, 0, 1);
+        if (header->Magic != Magic || header->Version != Version || header->FileSize != file.Size())
+        {
+            throw GameException("Unsupported or truncated mesh file.");
+        }
+
+        if (header->ImportFlags != importFlags)
+        {
+            throw GameException("Mesh file was cooked with different import flags.");
+        }
+
+        const MeshFileMaterial* materialRecords = GetArray<MeshFileMaterial>(file, header->MaterialTableOffset, header->MaterialCount);
+        model.mMaterials.reserve(header->MaterialCount);
+        for (UINT i = 0; i < header->MaterialCount; i++)
+        {
+            const MeshFileMaterial& materialRecord = materialRecords[i];
+
+            ModelMaterial* material = new ModelMaterial(model);
+            model.mMaterials.push_back(material);
+
+            const char* name = GetArray<char>(file, materialRecord.NameOffset, materialRecord.NameLength);
+            material->mName.assign(name, materialRecord.NameLength);
+
+            const MeshFileTexture* textureRecords = GetArray<MeshFileTexture>(file, materialRecord.TexturesOffset, materialRecord.TextureCount);
+            for (UINT j = 0; j < materialRecord.TextureCount; j++)
+            {
+                const MeshFileTexture& textureRecord = textureRecords[j];
+                if (textureRecord.TextureType >= TextureTypeEnd)
+                {
+                    throw GameException("Mesh file is corrupt.");
+                }
+
+                TextureType textureType = static_cast<TextureType>(textureRecord.TextureType);
+                std::vector<std::wstring>*& textures = material->mTextures[textureType];
+                if (textures == nullptr)
+                {
+                    textures = new std::vector<std::wstring>();
+                }
+
+                const wchar_t* path = GetArray<wchar_t>(file, textureRecord.PathOffset, textureRecord.PathLength);
+                textures->push_back(std::wstring(path, textureRecord.PathLength));
+            }
+        }
+
+        const MeshFileMesh* meshRecords = GetArray<MeshFileMesh>(file, header->MeshTableOffset, header->MeshCount);
+        model.mMeshes.reserve(header->MeshCount);
+        for (UINT i = 0; i < header->MeshCount; i++)
+        {
+            const MeshFileMesh& meshRecord = meshRecords[i];
+            ModelMaterial* material = (meshRecord.MaterialIndex < model.mMaterials.size() ? model.mMaterials[meshRecord.MaterialIndex] : nullptr);
+
+            Mesh* mesh = new Mesh(model, material);
+            model.mMeshes.push_back(mesh);
+
+            const char* name = GetArray<char>(file, meshRecord.NameOffset, meshRecord.NameLength);
+            mesh->mName.assign(name, meshRecord.NameLength);
+            mesh->mFaceCount = meshRecord.FaceCount;
+
+            UINT vertexCount = meshRecord.VertexCount;
+            bool hasTangents = (meshRecord.TangentsOffset != 0 && meshRecord.BiNormalsOffset != 0);
+            MeshStreams& streams = mesh->mStreams;
+            streams.Allocate(vertexCount, meshRecord.NormalsOffset != 0, hasTangents, meshRecord.TextureCoordinateChannelCount, meshRecord.VertexColorChannelCount);
+
+            const XMFLOAT3* vertices = GetArray<XMFLOAT3>(file, meshRecord.PositionsOffset, vertexCount);
+            memcpy(streams.Positions().data(), vertices, sizeof(XMFLOAT3) * vertexCount);
+
+            if (meshRecord.NormalsOffset != 0)
+            {
+                const XMFLOAT3* normals = GetArray<XMFLOAT3>(file, meshRecord.NormalsOffset, vertexCount);
+                memcpy(streams.Normals().data(), normals, sizeof(XMFLOAT3) * vertexCount);
+            }
+
+            if (hasTangents)
+            {
+                const XMFLOAT3* tangents = GetArray<XMFLOAT3>(file, meshRecord.TangentsOffset, vertexCount);
+                const XMFLOAT3* biNormals = GetArray<XMFLOAT3>(file, meshRecord.BiNormalsOffset, vertexCount);
+                memcpy(streams.Tangents().data(), tangents, sizeof(XMFLOAT3) * vertexCount);
+                memcpy(streams.BiNormals().data(), biNormals, sizeof(XMFLOAT3) * vertexCount);
+            }
+
+            // Channels are padded to the stream alignment, so step by the padded size.
+            UINT textureCoordinateStride = static_cast<UINT>((sizeof(XMFLOAT3) * vertexCount + Alignment - 1) & ~(Alignment - 1));
+            for (UINT j = 0; j < meshRecord.TextureCoordinateChannelCount; j++)
+            {
+                const XMFLOAT3* textureCoordinates = GetArray<XMFLOAT3>(file, meshRecord.TextureCoordinatesOffset + j * textureCoordinateStride, vertexCount);
+                memcpy(streams.TextureCoordinates(j).data(), textureCoordinates, sizeof(XMFLOAT3) * vertexCount);
+            }
+
+            UINT vertexColorStride = static_cast<UINT>((sizeof(XMFLOAT4) * vertexCount + Alignment - 1) & ~(Alignment - 1));
+            for (UINT j = 0; j < meshRecord.VertexColorChannelCount; j++)
+            {
+                const XMFLOAT4* vertexColors = GetArray<XMFLOAT4>(file, meshRecord.VertexColorsOffset + j * vertexColorStride, vertexCount);
+                memcpy(streams.VertexColors(j).data(), vertexColors, sizeof(XMFLOAT4) * vertexCount);
+            }
+
+            if (meshRecord.IndexCount != static_cast<unsigned long long>(meshRecord.FaceCount) * 3)
+            {
+                throw GameException("Mesh file is corrupt.");
+            }
+
+            const UINT* indices = GetArray<UINT>(file, meshRecord.IndicesOffset, meshRecord.IndexCount);
+            for (UINT j = 0; j < meshRecord.IndexCount; j++)
+            {
+                if (indices[j] >= vertexCount)
+                {
+                    throw GameException("Mesh file is corrupt.");
+                }
+            }
+
+            mesh->mIndices.assign(indices, indices + meshRecord.IndexCount);
+
+            const Meshlet* meshlets = GetArray<Meshlet>(file, meshRecord.MeshletsOffset, meshRecord.MeshletCount);
+            for (UINT j = 0; j < meshRecord.MeshletCount; j++)
+            {
+                if (meshlets[j].IndexOffset > meshRecord.IndexCount || meshlets[j].TriangleCount > (meshRecord.IndexCount - meshlets[j].IndexOffset) / 3)
+                {
+                    throw GameException("Mesh file is corrupt.");
+                }
+            }
+
+            mesh->mMeshlets.assign(meshlets, meshlets + meshRecord.MeshletCount);
+
+            const UINT* lodIndices = GetArray<UINT>(file, meshRecord.LodIndicesOffset, meshRecord.LodIndexCount);
+            for (UINT j = 0; j < meshRecord.LodIndexCount; j++)
+            {
+                if (lodIndices[j] >= vertexCount)
+                {
+                    throw GameException("Mesh file is corrupt.");
+                }
+            }
+
+            mesh->mLodIndices.assign(lodIndices, lodIndices + meshRecord.LodIndexCount);
+
+            unsigned long long totalIndexCount = static_cast<unsigned long long>(meshRecord.IndexCount) + meshRecord.LodIndexCount;
+            const MeshLod* lods = GetArray<MeshLod>(file, meshRecord.LodsOffset, meshRecord.LodCount);
+            for (UINT j = 0; j < meshRecord.LodCount; j++)
+            {
+                if (static_cast<unsigned long long>(lods[j].IndexOffset) + lods[j].IndexCount > totalIndexCount)
+                {
+                    throw GameException("Mesh file is corrupt.");
+                }
+            }
+
+            mesh->mLods.assign(lods, lods + meshRecord.LodCount);
+
+            MeshBounds& bounds = mesh->mBounds;
+            BoundingBox::CreateFromPoints(bounds.Box, XMLoadFloat3(&meshRecord.BoundsMin), XMLoadFloat3(&meshRecord.BoundsMax));
+            bounds.Sphere.Center = bounds.Box.Center;
+            bounds.Sphere.Radius = meshRecord.BoundingSphereRadius;
+            bounds.OrientedBox.Center = meshRecord.OrientedBoxCenter;
+            bounds.OrientedBox.Extents = meshRecord.OrientedBoxExtents;
+            bounds.OrientedBox.Orientation = meshRecord.OrientedBoxOrientation;
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class Model;
+    class MappedFile;
+
+    // Cooked mesh container. All offsets are relative to the start of the file and
+    // every stream starts on a MeshFile::Alignment boundary so it can be read
+    // straight out of a mapped view.
+    struct MeshFileHeader
+    {
+        UINT Magic;
+        UINT Version;
+        UINT ImportFlags;
+        UINT MeshCount;
+        UINT MaterialCount;
+        UINT MeshTableOffset;
+        UINT MaterialTableOffset;
+        UINT FileSize;
+    };
+
+    struct MeshFileMesh
+    {
+        UINT NameOffset;
+        UINT NameLength;
+        UINT MaterialIndex;
+        UINT VertexCount;
+        UINT IndexCount;
+        UINT FaceCount;
+        UINT TextureCoordinateChannelCount;
+        UINT VertexColorChannelCount;
+        UINT PositionsOffset;
+        UINT NormalsOffset;
+        UINT TangentsOffset;
+        UINT BiNormalsOffset;
+        UINT TextureCoordinatesOffset;
+        UINT VertexColorsOffset;
+        UINT IndicesOffset;
+        XMFLOAT3 BoundsMin;
+        XMFLOAT3 BoundsMax;
+        float BoundingSphereRadius;
+        XMFLOAT3 OrientedBoxCenter;
+        XMFLOAT3 OrientedBoxExtents;
+        XMFLOAT4 OrientedBoxOrientation;
+        UINT MeshletCount;
+        UINT MeshletsOffset;
+        UINT LodCount;
+        UINT LodsOffset;
+        UINT LodIndexCount;
+        UINT LodIndicesOffset;
+    };
+
+    struct MeshFileMaterial
+    {
+        UINT NameOffset;
+        UINT NameLength;
+        UINT TextureCount;
+        UINT TexturesOffset;
+    };
+
+    struct MeshFileTexture
+    {
+        UINT TextureType;
+        UINT PathOffset;
+        UINT PathLength;
+    };
+
+    enum MeshFileImportFlags
+    {
+        MeshFileImportFlagsNone = 0,
+        MeshFileImportFlagsFlipUVs = 1
+    };
+
+    class MeshFile
+    {
+    public:
+        static const UINT Magic;
+        static const UINT Version;
+        static const UINT Alignment;
+        static const std::string Extension;
+
+        static bool IsMeshFile(const std::string& filename);
+        static std::string CookedFilename(const std::string& sourceFilename);
+        static bool IsCookedFileCurrent(const std::string& sourceFilename, const std::string& cookedFilename, UINT importFlags);
+
+        // Checks the header only: right format, version and import flags.
+        static bool IsCookedFileCompatible(const std::string& cookedFilename, UINT importFlags);
+
+        static void Write(const Model& model, const std::string& filename, UINT importFlags);
+        static void Read(Model& model, const MappedFile& file, UINT importFlags);
+
+    private:
+        MeshFile();
+        MeshFile(const MeshFile& rhs);
+        MeshFile& operator=(const MeshFile& rhs);
+    };
+}
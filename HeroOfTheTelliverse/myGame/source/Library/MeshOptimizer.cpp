@@ -0,0 +1,267 @@
+#include "MeshOptimizer.h"
+#include <climits>
+#include <cmath>
+
+namespace Library
+{
+    const UINT MeshOptimizer::DefaultCacheSize = 16;
+
+    namespace
+    {
+        const UINT ScoringCacheSize = 32;
+        const float CacheDecayPower = 1.5f;
+        const float LastTriangleScore = 0.75f;
+        const float ValenceBoostScale = 2.0f;
+        const float ValenceBoostPower = 0.5f;
+
+        float VertexScore(int cachePosition, UINT activeTriangleCount)
+        {
+            if (activeTriangleCount == 0)
+            {
+                return -1.0f;
+            }
+
+            float score = 0.0f;
+            if (cachePosition >= 0)
+            {
+                if (cachePosition < 3)
+                {
+                    // The three vertices of the last triangle get a fixed score so that strips
+                    // don't keep reusing the most recent edge.
+                    score = LastTriangleScore;
+                }
+                else
+                {
+                    const float scaler = 1.0f / (ScoringCacheSize - 3);
+                    score = powf(1.0f - (cachePosition - 3) * scaler, CacheDecayPower);
+                }
+            }
+
+            // Favour vertices with few remaining triangles so they are finished off quickly.
+            score += ValenceBoostScale * powf(static_cast<float>(activeTriangleCount), -ValenceBoostPower);
+
+            return score;
+        }
+    }
+
+    VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const std::vector<UINT>& indices, UINT vertexCount, UINT cacheSize)
+    {
+        VertexCacheStatistics statistics;
+        statistics.CacheSize = cacheSize;
+        statistics.ACMR = 0.0f;
+        statistics.ATVR = 0.0f;
+
+        if (indices.size() < 3 || vertexCount == 0)
+        {
+            return statistics;
+        }
+
+        // A vertex is in the FIFO if it was inserted within the last cacheSize misses.
+        std::vector<UINT> timestamps(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        UINT time = cacheSize + 1;
+        UINT misses = 0;
+        UINT referencedCount = 0;
+
+        for (UINT index : indices)
+        {
+            if (time - timestamps[index] > cacheSize)
+            {
+                timestamps[index] = time++;
+                misses++;
+            }
+
+            if (referenced[index] == false)
+            {
+                referenced[index] = true;
+                referencedCount++;
+            }
+        }
+
+        statistics.ACMR = static_cast<float>(misses) / (indices.size() / 3);
+        statistics.ATVR = static_cast<float>(misses) / referencedCount;
+
+        return statistics;
+    }
+
+    void MeshOptimizer::OptimizeVertexCache(std::vector<UINT>& indices, UINT vertexCount)
+    {
+        UINT triangleCount = static_cast<UINT>(indices.size() / 3);
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        // Vertex to triangle adjacency, with the active (unemitted) triangles kept at the front of
+        // each vertex's range.
+        std::vector<UINT> activeTriangleCounts(vertexCount, 0);
+        for (UINT index : indices)
+        {
+            activeTriangleCounts[index]++;
+        }
+
+        std::vector<UINT> adjacencyOffsets(vertexCount + 1, 0);
+        for (UINT i = 0; i < vertexCount; i++)
+        {
+            adjacencyOffsets[i + 1] = adjacencyOffsets[i] + activeTriangleCounts[i];
+        }
+
+        std::vector<UINT> adjacency(indices.size());
+        {
+            std::vector<UINT> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (UINT i = 0; i < indices.size(); i++)
+            {
+                adjacency[cursors[indices[i]]++] = i / 3;
+            }
+        }
+
+        std::vector<int> cachePositions(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (UINT i = 0; i < vertexCount; i++)
+        {
+            vertexScores[i] = VertexScore(-1, activeTriangleCounts[i]);
+        }
+
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        UINT bestTriangle = 0;
+        for (UINT i = 0; i < triangleCount; i++)
+        {
+            const UINT* triangle = &indices[i * 3];
+            triangleScores[i] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+            if (triangleScores[i] > triangleScores[bestTriangle])
+            {
+                bestTriangle = i;
+            }
+        }
+
+        std::vector<UINT> output;
+        output.reserve(indices.size());
+
+        std::vector<UINT> cache;
+        std::vector<UINT> newCache;
+        cache.reserve(ScoringCacheSize + 3);
+        newCache.reserve(ScoringCacheSize + 3);
+
+        UINT scanCursor = 0;
+        for (UINT emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            if (bestTriangle == UINT_MAX)
+            {
+                // Dead end: nothing in the cache has triangles left, so restart from the next
+                // unemitted triangle in input order.
+                while (emitted[scanCursor])
+                {
+                    scanCursor++;
+                }
+
+                bestTriangle = scanCursor;
+            }
+
+            const UINT* triangle = &indices[bestTriangle * 3];
+            emitted[bestTriangle] = true;
+
+            newCache.clear();
+            for (UINT i = 0; i < 3; i++)
+            {
+                UINT vertex = triangle[i];
+                output.push_back(vertex);
+                newCache.push_back(vertex);
+
+                // Remove the triangle from this vertex's active range.
+                UINT* begin = &adjacency[adjacencyOffsets[vertex]];
+                UINT* end = begin + activeTriangleCounts[vertex];
+                for (UINT* it = begin; it != end; ++it)
+                {
+                    if (*it == bestTriangle)
+                    {
+                        *it = *(end - 1);
+                        *(end - 1) = bestTriangle;
+                        break;
+                    }
+                }
+
+                activeTriangleCounts[vertex]--;
+            }
+
+            for (UINT vertex : cache)
+            {
+                if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                {
+                    newCache.push_back(vertex);
+                }
+            }
+
+            // Vertices pushed past the end of the cache lose their cache score.
+            for (UINT i = ScoringCacheSize; i < newCache.size(); i++)
+            {
+                cachePositions[newCache[i]] = -1;
+            }
+
+            if (newCache.size() > ScoringCacheSize)
+            {
+                // Evicted vertices still need their triangle scores refreshed below.
+                for (UINT i = ScoringCacheSize; i < newCache.size(); i++)
+                {
+                    UINT vertex = newCache[i];
+                    vertexScores[vertex] = VertexScore(-1, activeTriangleCounts[vertex]);
+                }
+            }
+
+            for (UINT i = 0; i < newCache.size() && i < ScoringCacheSize; i++)
+            {
+                UINT vertex = newCache[i];
+                cachePositions[vertex] = static_cast<int>(i);
+                vertexScores[vertex] = VertexScore(static_cast<int>(i), activeTriangleCounts[vertex]);
+            }
+
+            // Rescore every active triangle touching the cache and pick the best of them.
+            bestTriangle = UINT_MAX;
+            float bestScore = -1.0f;
+            for (UINT vertex : newCache)
+            {
+                UINT begin = adjacencyOffsets[vertex];
+                UINT end = begin + activeTriangleCounts[vertex];
+                for (UINT j = begin; j < end; j++)
+                {
+                    UINT candidate = adjacency[j];
+                    const UINT* candidateTriangle = &indices[candidate * 3];
+                    float score = vertexScores[candidateTriangle[0]] + vertexScores[candidateTriangle[1]] + vertexScores[candidateTriangle[2]];
+
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        bestTriangle = candidate;
+                    }
+                }
+            }
+
+            if (newCache.size() > ScoringCacheSize)
+            {
+                newCache.resize(ScoringCacheSize);
+            }
+
+            cache.swap(newCache);
+        }
+
+        indices.swap(output);
+    }
+
+    UINT MeshOptimizer::OptimizeVertexFetch(std::vector<UINT>& indices, UINT vertexCount, std::vector<UINT>& remap)
+    {
+        remap.assign(vertexCount, UINT_MAX);
+
+        UINT nextVertex = 0;
+        for (UINT& index : indices)
+        {
+            if (remap[index] == UINT_MAX)
+            {
+                remap[index] = nextVertex++;
+            }
+
+            index = remap[index];
+        }
+
+        return nextVertex;
+    }
+}
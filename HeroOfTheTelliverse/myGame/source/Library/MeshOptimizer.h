@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    struct VertexCacheStatistics
+    {
+        UINT CacheSize;
+        float ACMR; // Cache misses per triangle; 0.5 is ideal for regular grids, 3.0 is worst case.
+        float ATVR; // Cache misses per referenced vertex; 1.0 is ideal.
+    };
+
+    struct MeshOptimizationReport
+    {
+        VertexCacheStatistics Before;
+        VertexCacheStatistics After;
+        UINT VerticesRemoved;
+    };
+
+    class MeshOptimizer
+    {
+    public:
+        static const UINT DefaultCacheSize;
+
+        // Simulates a FIFO post-transform cache over a triangle list.
+        static VertexCacheStatistics AnalyzeVertexCache(const std::vector<UINT>& indices, UINT vertexCount, UINT cacheSize = DefaultCacheSize);
+
+        // Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm).
+        static void OptimizeVertexCache(std::vector<UINT>& indices, UINT vertexCount);
+
+        // Renumbers vertices in first-use order and rewrites indices to match. remap[oldIndex] is the
+        // new index, or UINT_MAX for vertices no triangle references. Returns the new vertex count.
+        static UINT OptimizeVertexFetch(std::vector<UINT>& indices, UINT vertexCount, std::vector<UINT>& remap);
+
+    private:
+        MeshOptimizer();
+        MeshOptimizer(const MeshOptimizer& rhs);
+        MeshOptimizer& operator=(const MeshOptimizer& rhs);
+    };
+}
@@ -0,0 +1,394 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace Library
+{
+    namespace
+    {
+        // Symmetric 4x4 quadric stored as its upper triangle, with the accumulated area as weight.
+        struct Quadric
+        {
+            float A00, A01, A02, A11, A12, A22;
+            float B0, B1, B2;
+            float C;
+            float Weight;
+
+            void Add(const Quadric& other)
+            {
+                A00 += other.A00; A01 += other.A01; A02 += other.A02;
+                A11 += other.A11; A12 += other.A12; A22 += other.A22;
+                B0 += other.B0; B1 += other.B1; B2 += other.B2;
+                C += other.C;
+                Weight += other.Weight;
+            }
+
+            // Area-weighted mean squared distance from p to the accumulated planes.
+            float Evaluate(const XMFLOAT3& p) const
+            {
+                float error = A00 * p.x * p.x + 2.0f * A01 * p.x * p.y + 2.0f * A02 * p.x * p.z
+                            + A11 * p.y * p.y + 2.0f * A12 * p.y * p.z + A22 * p.z * p.z
+                            + 2.0f * (B0 * p.x + B1 * p.y + B2 * p.z) + C;
+
+                return (Weight > 0.0f ? fabsf(error) / Weight : 0.0f);
+            }
+        };
+
+        struct Collapse
+        {
+            UINT From;
+            UINT To;
+            float Error;
+
+            bool operator<(const Collapse& rhs) const
+            {
+                return Error < rhs.Error;
+            }
+        };
+
+        XMVECTOR TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+        {
+            XMVECTOR v0 = XMLoadFloat3(&p0);
+            return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&p1), v0), XMVectorSubtract(XMLoadFloat3(&p2), v0));
+        }
+
+        unsigned long long EdgeKey(UINT a, UINT b)
+        {
+            return (static_cast<unsigned long long>(a) << 32) | b;
+        }
+
+        // Vertices that must stay put: any vertex sharing its position with another (a UV or normal
+        // seam), and any vertex on an open or non-manifold edge. positionIds maps every vertex to the
+        // first vertex at the same position.
+        void FindLockedVertices(const std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices, std::vector<bool>& locked, std::vector<UINT>& positionIds)
+        {
+            UINT vertexCount = static_cast<UINT>(vertices.size());
+            locked.assign(vertexCount, false);
+
+            struct PositionHash
+            {
+                size_t operator()(const XMFLOAT3& p) const
+                {
+                    const UINT* bits = reinterpret_cast<const UINT*>(&p);
+                    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+                }
+            };
+
+            struct PositionEqual
+            {
+                bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const
+                {
+                    return (a.x == b.x && a.y == b.y && a.z == b.z);
+                }
+            };
+
+            std::unordered_map<XMFLOAT3, UINT, PositionHash, PositionEqual> firstVertex;
+            firstVertex.reserve(vertexCount);
+
+            positionIds.resize(vertexCount);
+            for (UINT i = 0; i < vertexCount; i++)
+            {
+                std::pair<std::unordered_map<XMFLOAT3, UINT, PositionHash, PositionEqual>::iterator, bool> inserted = firstVertex.insert(std::make_pair(vertices[i], i));
+                positionIds[i] = inserted.first->second;
+                if (inserted.second == false)
+                {
+                    locked[i] = true;
+                    locked[inserted.first->second] = true;
+                }
+            }
+
+            std::unordered_map<unsigned long long, UINT> edgeCounts;
+            edgeCounts.reserve(indices.size());
+            for (UINT i = 0; i < indices.size(); i += 3)
+            {
+                for (UINT k = 0; k < 3; k++)
+                {
+                    edgeCounts[EdgeKey(positionIds[indices[i + k]], positionIds[indices[i + (k + 1) % 3]])]++;
+                }
+            }
+
+            for (UINT i = 0; i < indices.size(); i += 3)
+            {
+                for (UINT k = 0; k < 3; k++)
+                {
+                    UINT a = indices[i + k];
+                    UINT b = indices[i + (k + 1) % 3];
+
+                    std::unordered_map<unsigned long long, UINT>::const_iterator opposite = edgeCounts.find(EdgeKey(positionIds[b], positionIds[a]));
+                    if (opposite == edgeCounts.end() || opposite->second != 1 || edgeCounts[EdgeKey(positionIds[a], positionIds[b])] != 1)
+                    {
+                        locked[a] = true;
+                        locked[b] = true;
+                    }
+                }
+            }
+        }
+
+        void ComputeQuadrics(const std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices, std::vector<Quadric>& quadrics)
+        {
+            Quadric zero;
+            ZeroMemory(&zero, sizeof(zero));
+            quadrics.assign(vertices.size(), zero);
+
+            for (UINT i = 0; i < indices.size(); i += 3)
+            {
+                const XMFLOAT3& p0 = vertices[indices[i]];
+                XMVECTOR normal = TriangleNormal(p0, vertices[indices[i + 1]], vertices[indices[i + 2]]);
+
+                float doubleArea = XMVectorGetX(XMVector3Length(normal));
+                if (doubleArea <= 0.0f)
+                {
+                    continue;
+                }
+
+                XMFLOAT3 n;
+                XMStoreFloat3(&n, XMVectorScale(normal, 1.0f / doubleArea));
+                float d = -(n.x * p0.x + n.y * p0.y + n.z * p0.z);
+                float w = doubleArea * 0.5f;
+
+                Quadric plane;
+                plane.A00 = w * n.x * n.x; plane.A01 = w * n.x * n.y; plane.A02 = w * n.x * n.z;
+                plane.A11 = w * n.y * n.y; plane.A12 = w * n.y * n.z; plane.A22 = w * n.z * n.z;
+                plane.B0 = w * d * n.x; plane.B1 = w * d * n.y; plane.B2 = w * d * n.z;
+                plane.C = w * d * d;
+                plane.Weight = w;
+
+                for (UINT k = 0; k < 3; k++)
+                {
+                    quadrics[indices[i + k]].Add(plane);
+                }
+            }
+        }
+
+        // Below this cosine between a triangle's normal before and after a collapse, the triangle
+        // has folded over or been stood on its edge.
+        const float MinimumNormalCosine = 0.2f;
+
+        // Neighbours are gathered by position so a vertex and its seam twin count as one.
+        void GatherNeighbours(UINT vertex, const std::vector<UINT>& indices, const std::vector<UINT>& positionIds,
+                              const std::vector<UINT>& adjacencyOffsets, const std::vector<UINT>& adjacency, std::vector<UINT>& neighbours)
+        {
+            neighbours.clear();
+            for (UINT j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; j++)
+            {
+                const UINT* triangle = &indices[adjacency[j] * 3];
+                for (UINT k = 0; k < 3; k++)
+                {
+                    if (triangle[k] != vertex)
+                    {
+                        neighbours.push_back(positionIds[triangle[k]]);
+                    }
+                }
+            }
+
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        }
+
+        // A collapse must keep the surface manifold (the two one-rings may only share the vertices
+        // opposite the collapsed edge) and must not fold any surviving triangle around 'from'.
+        bool IsCollapseValid(const Collapse& collapse, const std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices,
+                             const std::vector<UINT>& positionIds, const std::vector<UINT>& adjacencyOffsets, const std::vector<UINT>& adjacency,
+                             std::vector<UINT>& fromNeighbours, std::vector<UINT>& toNeighbours)
+        {
+            // Comparing against the ring's average as well as each triangle's own normal stops a
+            // triangle from turning over a little at a time across passes.
+            XMVECTOR ringNormal = XMVectorZero();
+            for (UINT j = adjacencyOffsets[collapse.From]; j < adjacencyOffsets[collapse.From + 1]; j++)
+            {
+                const UINT* triangle = &indices[adjacency[j] * 3];
+                ringNormal = XMVectorAdd(ringNormal, XMVector3Normalize(TriangleNormal(vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]])));
+            }
+
+            ringNormal = XMVector3Normalize(ringNormal);
+
+            UINT sharedTriangles = 0;
+            for (UINT j = adjacencyOffsets[collapse.From]; j < adjacencyOffsets[collapse.From + 1]; j++)
+            {
+                const UINT* triangle = &indices[adjacency[j] * 3];
+                if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To)
+                {
+                    sharedTriangles++;
+                    continue;
+                }
+
+                XMFLOAT3 moved[3];
+                for (UINT k = 0; k < 3; k++)
+                {
+                    moved[k] = vertices[triangle[k] == collapse.From ? collapse.To : triangle[k]];
+                }
+
+                XMVECTOR before = TriangleNormal(vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]]);
+                XMVECTOR after = TriangleNormal(moved[0], moved[1], moved[2]);
+                float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+                float afterLength = XMVectorGetX(XMVector3Length(after));
+                if (XMVectorGetX(XMVector3Dot(before, after)) <= MinimumNormalCosine * lengths ||
+                    XMVectorGetX(XMVector3Dot(ringNormal, after)) <= MinimumNormalCosine * afterLength)
+                {
+                    return false;
+                }
+            }
+
+            GatherNeighbours(collapse.From, indices, positionIds, adjacencyOffsets, adjacency, fromNeighbours);
+            GatherNeighbours(collapse.To, indices, positionIds, adjacencyOffsets, adjacency, toNeighbours);
+
+            // 'to' itself is in the first ring and 'from' in the second; neither counts as shared.
+            UINT sharedNeighbours = 0;
+            std::vector<UINT>::const_iterator a = fromNeighbours.begin();
+            std::vector<UINT>::const_iterator b = toNeighbours.begin();
+            while (a != fromNeighbours.end() && b != toNeighbours.end())
+            {
+                if (*a < *b)
+                {
+                    ++a;
+                }
+                else if (*b < *a)
+                {
+                    ++b;
+                }
+                else
+                {
+                    sharedNeighbours++;
+                    ++a;
+                    ++b;
+                }
+            }
+
+            return (sharedNeighbours <= sharedTriangles);
+        }
+    }
+
+    float MeshSimplifier::Simplify(const std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices, UINT targetIndexCount, float maxError, std::vector<UINT>& result)
+    {
+        assert(indices.size() % 3 == 0);
+
+        UINT vertexCount = static_cast<UINT>(vertices.size());
+        result = indices;
+
+        std::vector<bool> locked;
+        std::vector<UINT> positionIds;
+        FindLockedVertices(indices, vertices, locked, positionIds);
+
+        std::vector<Quadric> quadrics;
+        ComputeQuadrics(indices, vertices, quadrics);
+
+        std::vector<UINT> adjacencyOffsets;
+        std::vector<UINT> adjacency;
+        std::vector<Collapse> collapses;
+        std::vector<UINT> remap(vertexCount);
+        std::vector<bool> touched(vertexCount);
+        std::vector<UINT> fromNeighbours;
+        std::vector<UINT> toNeighbours;
+        float resultError = 0.0f;
+
+        while (result.size() > targetIndexCount)
+        {
+            // Vertex to triangle adjacency for this pass
+            adjacencyOffsets.assign(vertexCount + 1, 0);
+            for (UINT index : result)
+            {
+                adjacencyOffsets[index + 1]++;
+            }
+
+            for (UINT i = 0; i < vertexCount; i++)
+            {
+                adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+            }
+
+            adjacency.resize(result.size());
+            std::vector<UINT> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (UINT i = 0; i < result.size(); i++)
+            {
+                adjacency[fill[result[i]]++] = i / 3;
+            }
+
+            // Every edge direction whose source may move, cheapest first
+            collapses.clear();
+            for (UINT i = 0; i < result.size(); i += 3)
+            {
+                for (UINT k = 0; k < 3; k++)
+                {
+                    UINT a = result[i + k];
+                    UINT b = result[i + (k + 1) % 3];
+
+                    Quadric combined = quadrics[a];
+                    combined.Add(quadrics[b]);
+
+                    if (locked[a] == false)
+                    {
+                        Collapse collapse = { a, b, sqrtf(combined.Evaluate(vertices[b])) };
+                        collapses.push_back(collapse);
+                    }
+
+                    if (locked[b] == false)
+                    {
+                        Collapse collapse = { b, a, sqrtf(combined.Evaluate(vertices[a])) };
+                        collapses.push_back(collapse);
+                    }
+                }
+            }
+
+            std::sort(collapses.begin(), collapses.end());
+
+            for (UINT i = 0; i < vertexCount; i++)
+            {
+                remap[i] = i;
+            }
+
+            touched.assign(vertexCount, false);
+
+            // Each interior collapse removes two triangles; stop once the target would be reached.
+            UINT trianglesToRemove = static_cast<UINT>((result.size() - targetIndexCount + 2) / 3);
+            UINT trianglesRemoved = 0;
+            for (const Collapse& collapse : collapses)
+            {
+                if (collapse.Error > maxError || trianglesRemoved >= trianglesToRemove)
+                {
+                    break;
+                }
+
+                if (touched[collapse.From] || touched[collapse.To] || IsCollapseValid(collapse, result, vertices, positionIds, adjacencyOffsets, adjacency, fromNeighbours, toNeighbours) == false)
+                {
+                    continue;
+                }
+
+                remap[collapse.From] = collapse.To;
+                quadrics[collapse.To].Add(quadrics[collapse.From]);
+                resultError = std::max(resultError, collapse.Error);
+
+                // Freeze the whole one-ring so later checks in this pass see unmodified triangles.
+                for (UINT j = adjacencyOffsets[collapse.From]; j < adjacencyOffsets[collapse.From + 1]; j++)
+                {
+                    const UINT* triangle = &result[adjacency[j] * 3];
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+                }
+
+                trianglesRemoved += 2;
+            }
+
+            if (trianglesRemoved == 0)
+            {
+                break;
+            }
+
+            UINT writeIndex = 0;
+            for (UINT i = 0; i < result.size(); i += 3)
+            {
+                UINT a = remap[result[i]];
+                UINT b = remap[result[i + 1]];
+                UINT c = remap[result[i + 2]];
+                if (a != b && b != c && a != c)
+                {
+                    result[writeIndex++] = a;
+                    result[writeIndex++] = b;
+                    result[writeIndex++] = c;
+                }
+            }
+
+            result.resize(writeIndex);
+        }
+
+        return resultError;
+    }
+}
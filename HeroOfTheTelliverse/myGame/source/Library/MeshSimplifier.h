@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Common.h"
+#include "ArraySpan.h"
+
+namespace Library
+{
+    // One detail level of a mesh. Every level shares the mesh's vertices; the ranges index the
+    // mesh's index buffer, which holds level 0 followed by the coarser levels.
+    struct MeshLod
+    {
+        UINT IndexOffset;
+        UINT IndexCount;
+        float Error; // Object-space distance from the full-detail surface.
+    };
+
+    class MeshSimplifier
+    {
+    public:
+        // Quadric error edge collapse onto existing vertices, so the result indexes the same vertex
+        // buffer. Vertices on open borders (which is where one material's mesh meets the next) and on
+        // UV/normal seams never move. Stops at targetIndexCount or when the next collapse would exceed
+        // maxError; returns the error of the result.
+        static float Simplify(const std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices, UINT targetIndexCount, float maxError, std::vector<UINT>& result);
+
+    private:
+        MeshSimplifier();
+        MeshSimplifier(const MeshSimplifier& rhs);
+        MeshSimplifier& operator=(const MeshSimplifier& rhs);
+    };
+}
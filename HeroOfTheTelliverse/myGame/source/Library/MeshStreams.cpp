@@ -0,0 +1,181 @@
+#include "MeshStreams.h"
+#include <malloc.h>
+#include <new>
+
+namespace Library
+{
+    const UINT MeshStreams::Alignment = 16;
+
+    namespace
+    {
+        size_t AlignedSize(size_t size)
+        {
+            return (size + MeshStreams::Alignment - 1) & ~static_cast<size_t>(MeshStreams::Alignment - 1);
+        }
+
+        template <typename T>
+        ArraySpan<const T> Carve(byte* storage, size_t& offset, UINT count)
+        {
+            ArraySpan<const T> stream(reinterpret_cast<const T*>(storage + offset), count);
+            offset += AlignedSize(sizeof(T) * count);
+
+            return stream;
+        }
+    }
+
+    MeshStreams::MeshStreams()
+        : mStorage(), mByteSize(0), mVertexCount(0), mPositions(), mNormals(), mTangents(), mBiNormals(), mTextureCoordinates(), mVertexColors()
+    {
+    }
+
+    MeshStreams::MeshStreams(MeshStreams&& rhs)
+        : mStorage(), mByteSize(0), mVertexCount(0), mPositions(), mNormals(), mTangents(), mBiNormals(), mTextureCoordinates(), mVertexColors()
+    {
+        *this = std::move(rhs);
+    }
+
+    MeshStreams& MeshStreams::operator=(MeshStreams&& rhs)
+    {
+        if (this != &rhs)
+        {
+            // The spans point into the block, which moves with them untouched.
+            mStorage = std::move(rhs.mStorage);
+            mByteSize = rhs.mByteSize;
+            mVertexCount = rhs.mVertexCount;
+            mPositions = rhs.mPositions;
+            mNormals = rhs.mNormals;
+            mTangents = rhs.mTangents;
+            mBiNormals = rhs.mBiNormals;
+            mTextureCoordinates = std::move(rhs.mTextureCoordinates);
+            mVertexColors = std::move(rhs.mVertexColors);
+
+            rhs.mByteSize = 0;
+            rhs.mVertexCount = 0;
+            rhs.mPositions = rhs.mNormals = rhs.mTangents = rhs.mBiNormals = ArraySpan<const XMFLOAT3>();
+            rhs.mTextureCoordinates.clear();
+            rhs.mVertexColors.clear();
+        }
+
+        return *this;
+    }
+
+    void MeshStreams::Allocate(UINT vertexCount, bool hasNormals, bool hasTangents, UINT textureCoordinateChannelCount, UINT vertexColorChannelCount)
+    {
+        size_t float3Stream = AlignedSize(sizeof(XMFLOAT3) * vertexCount);
+        size_t float4Stream = AlignedSize(sizeof(XMFLOAT4) * vertexCount);
+        UINT float3StreamCount = 1 + (hasNormals ? 1 : 0) + (hasTangents ? 2 : 0) + textureCoordinateChannelCount;
+
+        // Aligned so the streams can be read with aligned SIMD loads.
+        size_t byteSize = float3Stream * float3StreamCount + float4Stream * vertexColorChannelCount;
+        byte* block = (byteSize > 0 ? static_cast<byte*>(_aligned_malloc(byteSize, Alignment)) : nullptr);
+        if (byteSize > 0 && block == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        mStorage.reset(block);
+        mByteSize = byteSize;
+        mVertexCount = vertexCount;
+
+        byte* storage = mStorage.get();
+        size_t offset = 0;
+        mPositions = Carve<XMFLOAT3>(storage, offset, vertexCount);
+        mNormals = (hasNormals ? Carve<XMFLOAT3>(storage, offset, vertexCount) : ArraySpan<const XMFLOAT3>());
+        mTangents = (hasTangents ? Carve<XMFLOAT3>(storage, offset, vertexCount) : ArraySpan<const XMFLOAT3>());
+        mBiNormals = (hasTangents ? Carve<XMFLOAT3>(storage, offset, vertexCount) : ArraySpan<const XMFLOAT3>());
+
+        mTextureCoordinates.resize(textureCoordinateChannelCount);
+        for (ArraySpan<const XMFLOAT3>& textureCoordinates : mTextureCoordinates)
+        {
+            textureCoordinates = Carve<XMFLOAT3>(storage, offset, vertexCount);
+        }
+
+        mVertexColors.resize(vertexColorChannelCount);
+        for (ArraySpan<const XMFLOAT4>& vertexColors : mVertexColors)
+        {
+            vertexColors = Carve<XMFLOAT4>(storage, offset, vertexCount);
+        }
+    }
+
+    void MeshStreams::AlignedDeleter::operator()(byte* storage) const
+    {
+        _aligned_free(storage);
+    }
+
+    UINT MeshStreams::VertexCount() const
+    {
+        return mVertexCount;
+    }
+
+    size_t MeshStreams::ByteSize() const
+    {
+        return mByteSize;
+    }
+
+    ArraySpan<const XMFLOAT3> MeshStreams::Positions() const
+    {
+        return mPositions;
+    }
+
+    ArraySpan<const XMFLOAT3> MeshStreams::Normals() const
+    {
+        return mNormals;
+    }
+
+    ArraySpan<const XMFLOAT3> MeshStreams::Tangents() const
+    {
+        return mTangents;
+    }
+
+    ArraySpan<const XMFLOAT3> MeshStreams::BiNormals() const
+    {
+        return mBiNormals;
+    }
+
+    const std::vector<ArraySpan<const XMFLOAT3>>& MeshStreams::TextureCoordinates() const
+    {
+        return mTextureCoordinates;
+    }
+
+    const std::vector<ArraySpan<const XMFLOAT4>>& MeshStreams::VertexColors() const
+    {
+        return mVertexColors;
+    }
+
+    ArraySpan<XMFLOAT3> MeshStreams::Positions()
+    {
+        return Mutable(mPositions);
+    }
+
+    ArraySpan<XMFLOAT3> MeshStreams::Normals()
+    {
+        return Mutable(mNormals);
+    }
+
+    ArraySpan<XMFLOAT3> MeshStreams::Tangents()
+    {
+        return Mutable(mTangents);
+    }
+
+    ArraySpan<XMFLOAT3> MeshStreams::BiNormals()
+    {
+        return Mutable(mBiNormals);
+    }
+
+    ArraySpan<XMFLOAT3> MeshStreams::TextureCoordinates(UINT channel)
+    {
+        return Mutable(mTextureCoordinates.at(channel));
+    }
+
+    ArraySpan<XMFLOAT4> MeshStreams::VertexColors(UINT channel)
+    {
+        return Mutable(mVertexColors.at(channel));
+    }
+
+    template <typename T>
+    ArraySpan<T> MeshStreams::Mutable(const ArraySpan<const T>& stream)
+    {
+        // The streams are stored as read-only views of memory this object owns and may write.
+        return ArraySpan<T>(const_cast<T*>(stream.data()), stream.size());
+    }
+}
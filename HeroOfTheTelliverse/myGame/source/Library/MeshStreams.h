@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Common.h"
+#include "ArraySpan.h"
+
+namespace Library
+{
+    // Every per-vertex attribute stream of a mesh in one allocation: positions, then normals,
+    // tangents, binormals, each texture coordinate channel and each vertex color channel, at
+    // offsets that are multiples of MeshStreams::Alignment. Moving hands the block over without copying.
+    class MeshStreams
+    {
+    public:
+        static const UINT Alignment;
+
+        MeshStreams();
+        MeshStreams(MeshStreams&& rhs);
+        MeshStreams& operator=(MeshStreams&& rhs);
+
+        // Replaces any previous contents; every stream is left uninitialized.
+        void Allocate(UINT vertexCount, bool hasNormals, bool hasTangents, UINT textureCoordinateChannelCount, UINT vertexColorChannelCount);
+
+        UINT VertexCount() const;
+        size_t ByteSize() const;
+
+        ArraySpan<const XMFLOAT3> Positions() const;
+        ArraySpan<const XMFLOAT3> Normals() const;
+        ArraySpan<const XMFLOAT3> Tangents() const;
+        ArraySpan<const XMFLOAT3> BiNormals() const;
+        const std::vector<ArraySpan<const XMFLOAT3>>& TextureCoordinates() const;
+        const std::vector<ArraySpan<const XMFLOAT4>>& VertexColors() const;
+
+        ArraySpan<XMFLOAT3> Positions();
+        ArraySpan<XMFLOAT3> Normals();
+        ArraySpan<XMFLOAT3> Tangents();
+        ArraySpan<XMFLOAT3> BiNormals();
+        ArraySpan<XMFLOAT3> TextureCoordinates(UINT channel);
+        ArraySpan<XMFLOAT4> VertexColors(UINT channel);
+
+    private:
+        struct AlignedDeleter
+        {
+            void operator()(byte* storage) const;
+        };
+
+        MeshStreams(const MeshStreams& rhs);
+        MeshStreams& operator=(const MeshStreams& rhs);
+
+        template <typename T>
+        ArraySpan<T> Mutable(const ArraySpan<const T>& stream);
+
+        std::unique_ptr<byte, AlignedDeleter> mStorage;
+        size_t mByteSize;
+        UINT mVertexCount;
+        ArraySpan<const XMFLOAT3> mPositions;
+        ArraySpan<const XMFLOAT3> mNormals;
+        ArraySpan<const XMFLOAT3> mTangents;
+        ArraySpan<const XMFLOAT3> mBiNormals;
+        std::vector<ArraySpan<const XMFLOAT3>> mTextureCoordinates;
+        std::vector<ArraySpan<const XMFLOAT4>> mVertexColors;
+    };
+}
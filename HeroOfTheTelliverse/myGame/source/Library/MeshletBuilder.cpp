@@ -0,0 +1,314 @@
+#include "MeshletBuilder.h"
+#include <climits>
+#include <cmath>
+
+namespace Library
+{
+    const UINT MeshletBuilder::MaxVertices = 64;
+    const UINT MeshletBuilder::MaxTriangles = 124;
+
+    namespace
+    {
+        // Below this the cone would cover more than a hemisphere's worth of directions and never cull.
+        const float MinimumConeSpread = 0.1f;
+
+        // Front faces are clockwise on screen, which with the right-handed camera makes the
+        // outward normal (p2 - p0) x (p1 - p0).
+        XMVECTOR FaceNormal(const UINT* triangle, ArraySpan<const XMFLOAT3> vertices)
+        {
+            XMVECTOR p0 = XMLoadFloat3(&vertices[triangle[0]]);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[triangle[1]]);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[triangle[2]]);
+
+            return XMVector3Cross(XMVectorSubtract(p2, p0), XMVectorSubtract(p1, p0));
+        }
+
+        void ComputeBounds(Meshlet& meshlet, const std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices)
+        {
+            UINT indexCount = meshlet.TriangleCount * 3;
+
+            std::vector<XMFLOAT3> points;
+            points.reserve(indexCount);
+            for (UINT i = 0; i < indexCount; i++)
+            {
+                points.push_back(vertices[indices[meshlet.IndexOffset + i]]);
+            }
+
+            BoundingSphere::CreateFromPoints(meshlet.Sphere, points.size(), &points[0], sizeof(XMFLOAT3));
+            BoundingBox::CreateFromPoints(meshlet.Box, points.size(), &points[0], sizeof(XMFLOAT3));
+
+            meshlet.ConeApex = meshlet.Sphere.Center;
+            meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+            meshlet.ConeCutoff = 1.0f;
+
+            // Degenerate triangles are never rasterized, so they don't constrain the cone.
+            std::vector<UINT> triangles;
+            std::vector<XMFLOAT3> normals;
+            triangles.reserve(meshlet.TriangleCount);
+            normals.reserve(meshlet.TriangleCount);
+
+            XMVECTOR axis = XMVectorZero();
+            for (UINT i = 0; i < meshlet.TriangleCount; i++)
+            {
+                XMVECTOR normal = FaceNormal(&indices[meshlet.IndexOffset + i * 3], vertices);
+                if (XMVectorGetX(XMVector3LengthSq(normal)) <= 0.0f)
+                {
+                    continue;
+                }
+
+                normal = XMVector3Normalize(normal);
+                axis = XMVectorAdd(axis, normal);
+
+                XMFLOAT3 storedNormal;
+                XMStoreFloat3(&storedNormal, normal);
+                normals.push_back(storedNormal);
+                triangles.push_back(meshlet.IndexOffset + i * 3);
+            }
+
+            if (normals.empty() || XMVectorGetX(XMVector3LengthSq(axis)) <= 0.0f)
+            {
+                return;
+            }
+
+            axis = XMVector3Normalize(axis);
+            XMStoreFloat3(&meshlet.ConeAxis, axis);
+
+            float minimumDot = 1.0f;
+            for (const XMFLOAT3& normal : normals)
+            {
+                float dot = XMVectorGetX(XMVector3Dot(axis, XMLoadFloat3(&normal)));
+                minimumDot = (dot < minimumDot ? dot : minimumDot);
+            }
+
+            if (minimumDot <= MinimumConeSpread)
+            {
+                return;
+            }
+
+            // Slide the apex back along the axis until it sits behind every triangle plane.
+            XMVECTOR center = XMLoadFloat3(&meshlet.Sphere.Center);
+            float maximumDistance = 0.0f;
+            for (UINT i = 0; i < triangles.size(); i++)
+            {
+                XMVECTOR p0 = XMLoadFloat3(&vertices[indices[triangles[i]]]);
+                XMVECTOR normal = XMLoadFloat3(&normals[i]);
+
+                float distance = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, p0), normal)) / XMVectorGetX(XMVector3Dot(axis, normal));
+                maximumDistance = (distance > maximumDistance ? distance : maximumDistance);
+            }
+
+            XMStoreFloat3(&meshlet.ConeApex, XMVectorSubtract(center, XMVectorScale(axis, maximumDistance)));
+            meshlet.ConeCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+        }
+    }
+
+    void MeshletBuilder::Build(std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices, std::vector<Meshlet>& meshlets, UINT maxVertices, UINT maxTriangles)
+    {
+        assert(maxVertices >= 3 && maxTriangles >= 1);
+
+        meshlets.clear();
+
+        UINT vertexCount = static_cast<UINT>(vertices.size());
+        UINT triangleCount = static_cast<UINT>(indices.size() / 3);
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        // Vertex to triangle adjacency, stored as one flat list with per-vertex offsets.
+        std::vector<UINT> adjacencyOffsets(vertexCount + 1, 0);
+        for (UINT index : indices)
+        {
+            adjacencyOffsets[index + 1]++;
+        }
+
+        for (UINT i = 0; i < vertexCount; i++)
+        {
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        }
+
+        std::vector<UINT> adjacency(indices.size());
+        std::vector<UINT> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (UINT i = 0; i < indices.size(); i++)
+        {
+            adjacency[adjacencyFill[indices[i]]++] = i / 3;
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<UINT> vertexStamps(vertexCount, UINT_MAX);
+        std::vector<UINT> meshletVertices;
+        meshletVertices.reserve(maxVertices);
+
+        std::vector<UINT> ordered;
+        ordered.reserve(indices.size());
+
+        Meshlet current;
+        ZeroMemory(&current, sizeof(current));
+        UINT stamp = 0;
+        UINT nextSeed = 0;
+
+        auto newVertexCount = [&](UINT triangle)
+        {
+            UINT count = 0;
+            for (UINT k = 0; k < 3; k++)
+            {
+                count += (vertexStamps[indices[triangle * 3 + k]] != stamp ? 1 : 0);
+            }
+
+            return count;
+        };
+
+        auto finishMeshlet = [&]()
+        {
+            if (current.TriangleCount > 0)
+            {
+                current.VertexCount = static_cast<UINT>(meshletVertices.size());
+                meshlets.push_back(current);
+            }
+
+            ZeroMemory(&current, sizeof(current));
+            current.IndexOffset = static_cast<UINT>(ordered.size());
+            meshletVertices.clear();
+            stamp++;
+        };
+
+        for (UINT emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+        {
+            // Prefer the unemitted neighbour that adds the fewest new vertices to the meshlet.
+            UINT best = UINT_MAX;
+            UINT bestNewVertices = 4;
+            for (UINT i = 0; i < meshletVertices.size() && bestNewVertices > 0; i++)
+            {
+                UINT vertex = meshletVertices[i];
+                for (UINT j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; j++)
+                {
+                    UINT triangle = adjacency[j];
+                    if (emitted[triangle])
+                    {
+                        continue;
+                    }
+
+                    UINT newVertices = newVertexCount(triangle);
+                    if (newVertices < bestNewVertices && meshletVertices.size() + newVertices <= maxVertices)
+                    {
+                        best = triangle;
+                        bestNewVertices = newVertices;
+                        if (newVertices == 0)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (best == UINT_MAX)
+            {
+                // Nothing connected fits; continue with the next triangle in the existing order,
+                // which the vertex cache optimiser has already made spatially coherent.
+                while (emitted[nextSeed])
+                {
+                    nextSeed++;
+                }
+
+                best = nextSeed;
+                if (meshletVertices.size() + newVertexCount(best) > maxVertices)
+                {
+                    finishMeshlet();
+                }
+            }
+
+            for (UINT k = 0; k < 3; k++)
+            {
+                UINT vertex = indices[best * 3 + k];
+                if (vertexStamps[vertex] != stamp)
+                {
+                    vertexStamps[vertex] = stamp;
+                    meshletVertices.push_back(vertex);
+                }
+
+                ordered.push_back(vertex);
+            }
+
+            emitted[best] = true;
+            current.TriangleCount++;
+
+            if (current.TriangleCount == maxTriangles)
+            {
+                finishMeshlet();
+            }
+        }
+
+        finishMeshlet();
+
+        indices.swap(ordered);
+
+        // Bounds need the final index order, so compute them once every meshlet is placed.
+        for (Meshlet& meshlet : meshlets)
+        {
+            ComputeBounds(meshlet, indices, vertices);
+        }
+    }
+
+    void MeshletBuilder::Cull(const std::vector<Meshlet>& meshlets, FXMMATRIX worldViewProjection, const XMFLOAT3& viewerPosition, std::vector<MeshletDrawRange>& drawRanges)
+    {
+        // Gribb/Hartmann plane extraction; with D3D's 0..w depth range the near plane is the z column alone.
+        XMMATRIX columns = XMMatrixTranspose(worldViewProjection);
+        XMVECTOR planes[6] =
+        {
+            XMVectorAdd(columns.r[3], columns.r[0]),
+            XMVectorSubtract(columns.r[3], columns.r[0]),
+            XMVectorAdd(columns.r[3], columns.r[1]),
+            XMVectorSubtract(columns.r[3], columns.r[1]),
+            columns.r[2],
+            XMVectorSubtract(columns.r[3], columns.r[2])
+        };
+
+        for (XMVECTOR& plane : planes)
+        {
+            plane = XMPlaneNormalize(plane);
+        }
+
+        for (const Meshlet& meshlet : meshlets)
+        {
+            XMVECTOR center = XMLoadFloat3(&meshlet.Sphere.Center);
+            center = XMVectorSetW(center, 1.0f);
+
+            bool visible = true;
+            for (const XMVECTOR& plane : planes)
+            {
+                if (XMVectorGetX(XMVector4Dot(plane, center)) < -meshlet.Sphere.Radius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+
+            if (visible == false || IsBackFacing(meshlet, viewerPosition))
+            {
+                continue;
+            }
+
+            UINT indexCount = meshlet.TriangleCount * 3;
+            if (drawRanges.size() > 0 && drawRanges.back().StartIndex + drawRanges.back().IndexCount == meshlet.IndexOffset)
+            {
+                drawRanges.back().IndexCount += indexCount;
+            }
+            else
+            {
+                MeshletDrawRange range = { meshlet.IndexOffset, indexCount };
+                drawRanges.push_back(range);
+            }
+        }
+    }
+
+    bool MeshletBuilder::IsBackFacing(const Meshlet& meshlet, const XMFLOAT3& viewerPosition)
+    {
+        if (meshlet.ConeCutoff >= 1.0f)
+        {
+            return false;
+        }
+
+        XMVECTOR direction = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&meshlet.ConeApex), XMLoadFloat3(&viewerPosition)));
+        return (XMVectorGetX(XMVector3Dot(direction, XMLoadFloat3(&meshlet.ConeAxis))) >= meshlet.ConeCutoff);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Common.h"
+#include "ArraySpan.h"
+#include <DirectXCollision.h>
+
+namespace Library
+{
+    // A cluster of neighbouring triangles occupying a contiguous range of Mesh::Indices().
+    struct Meshlet
+    {
+        UINT IndexOffset;
+        UINT TriangleCount;
+        UINT VertexCount;
+        BoundingSphere Sphere;
+        BoundingBox Box;
+
+        // Every triangle faces away from any viewer inside the cone
+        // dot(normalize(ConeApex - viewer), ConeAxis) >= ConeCutoff. A cutoff of 1 disables the test.
+        XMFLOAT3 ConeApex;
+        XMFLOAT3 ConeAxis;
+        float ConeCutoff;
+    };
+
+    struct MeshletDrawRange
+    {
+        UINT StartIndex;
+        UINT IndexCount;
+    };
+
+    class MeshletBuilder
+    {
+    public:
+        static const UINT MaxVertices;
+        static const UINT MaxTriangles;
+
+        // Reorders the triangles of a triangle list so that each meshlet is contiguous.
+        static void Build(std::vector<UINT>& indices, ArraySpan<const XMFLOAT3> vertices, std::vector<Meshlet>& meshlets, UINT maxVertices = MaxVertices, UINT maxTriangles = MaxTriangles);
+
+        // Tests the meshlets against the frustum and viewer, both in the mesh's object space, and
+        // appends the surviving index ranges with adjacent ranges merged into one draw.
+        static void Cull(const std::vector<Meshlet>& meshlets, FXMMATRIX worldViewProjection, const XMFLOAT3& viewerPosition, std::vector<MeshletDrawRange>& drawRanges);
+
+        static bool IsBackFacing(const Meshlet& meshlet, const XMFLOAT3& viewerPosition);
+
+    private:
+        MeshletBuilder();
+        MeshletBuilder(const MeshletBuilder& rhs);
+        MeshletBuilder& operator=(const MeshletBuilder& rhs);
+    };
+}
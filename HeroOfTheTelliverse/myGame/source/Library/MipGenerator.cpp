@@ -0,0 +1,235 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Library
+{
+    namespace
+    {
+        // Filter radius in destination pixels and window shape, as commonly used for mipmapping.
+        const float KaiserSupport = 3.0f;
+        const float KaiserAlpha = 4.0f;
+
+        // 8-bit values to linear and back. Encoding searches the midpoints between neighbouring
+        // decoded values, which rounds to the nearest code exactly.
+        struct ColorTables
+        {
+            ColorTables()
+            {
+                for (UINT i = 0; i < 256; i++)
+                {
+                    float value = i / 255.0f;
+                    Linear[i] = value;
+                    Srgb[i] = (value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f));
+                }
+
+                for (UINT i = 0; i < 255; i++)
+                {
+                    SrgbMidpoints[i] = (Srgb[i] + Srgb[i + 1]) * 0.5f;
+                }
+            }
+
+            float Linear[256];
+            float Srgb[256];
+            float SrgbMidpoints[255];
+        };
+
+        const ColorTables Tables;
+
+        // The contiguous source pixels one destination pixel reads and how much of each.
+        struct FilterTaps
+        {
+            UINT First;
+            std::vector<float> Weights;
+        };
+
+        float BesselI0(float x)
+        {
+            float sum = 1.0f;
+            float term = 1.0f;
+            float halfX = x * 0.5f;
+            for (UINT k = 1; k < 32 && term > sum * 1e-7f; k++)
+            {
+                term *= (halfX / k) * (halfX / k);
+                sum += term;
+            }
+
+            return sum;
+        }
+
+        float KaiserWeight(float x)
+        {
+            if (fabsf(x) >= KaiserSupport)
+            {
+                return 0.0f;
+            }
+
+            float sinc = (x == 0.0f ? 1.0f : sinf(XM_PI * x) / (XM_PI * x));
+            float t = x / KaiserSupport;
+
+            return sinc * BesselI0(KaiserAlpha * sqrtf(1.0f - t * t)) / BesselI0(KaiserAlpha);
+        }
+
+        // Weights for resampling one axis from sourceSize to destinationSize pixels. Taps that
+        // fall off the edge are folded into the edge pixel, which clamps the image.
+        void BuildTaps(UINT sourceSize, UINT destinationSize, MipFilter filter, std::vector<FilterTaps>& taps)
+        {
+            float scale = static_cast<float>(sourceSize) / destinationSize;
+            float support = (filter == MipFilterBox ? 0.5f : KaiserSupport) * scale;
+
+            taps.resize(destinationSize);
+            for (UINT destination = 0; destination < destinationSize; destination++)
+            {
+                float center = (destination + 0.5f) * scale;
+                int first = static_cast<int>(floorf(center - support));
+                int last = static_cast<int>(ceilf(center + support));
+
+                FilterTaps& filterTaps = taps[destination];
+                filterTaps.First = static_cast<UINT>(std::max(first, 0));
+                filterTaps.Weights.assign(std::min(last, static_cast<int>(sourceSize)) - filterTaps.First, 0.0f);
+
+                float total = 0.0f;
+                for (int i = first; i < last; i++)
+                {
+                    float weight;
+                    if (filter == MipFilterBox)
+                    {
+                        weight = std::max(std::min(i + 1.0f, center + support) - std::max(static_cast<float>(i), center - support), 0.0f);
+                    }
+                    else
+                    {
+                        weight = KaiserWeight((i + 0.5f - center) / scale);
+                    }
+
+                    int source = std::min(std::max(i, 0), static_cast<int>(sourceSize) - 1);
+                    filterTaps.Weights[source - filterTaps.First] += weight;
+                    total += weight;
+                }
+
+                for (float& weight : filterTaps.Weights)
+                {
+                    weight /= total;
+                }
+            }
+        }
+
+        // Filters rows first into a buffer destinationWidth wide, then columns out of that.
+        void Resample(const std::vector<XMFLOAT4>& source, UINT width, UINT height, MipFilter filter, UINT destinationWidth, UINT destinationHeight, std::vector<XMFLOAT4>& destination)
+        {
+            std::vector<FilterTaps> horizontalTaps;
+            std::vector<FilterTaps> verticalTaps;
+            BuildTaps(width, destinationWidth, filter, horizontalTaps);
+            BuildTaps(height, destinationHeight, filter, verticalTaps);
+
+            std::vector<XMFLOAT4> rows(static_cast<size_t>(destinationWidth) * height);
+            for (UINT y = 0; y < height; y++)
+            {
+                const XMFLOAT4* sourceRow = &source[static_cast<size_t>(y) * width];
+                XMFLOAT4* row = &rows[static_cast<size_t>(y) * destinationWidth];
+                for (UINT x = 0; x < destinationWidth; x++)
+                {
+                    const FilterTaps& taps = horizontalTaps[x];
+                    XMVECTOR sum = XMVectorZero();
+                    for (UINT i = 0; i < taps.Weights.size(); i++)
+                    {
+                        sum = XMVectorMultiplyAdd(XMVectorReplicate(taps.Weights[i]), XMLoadFloat4(&sourceRow[taps.First + i]), sum);
+                    }
+
+                    XMStoreFloat4(&row[x], sum);
+                }
+            }
+
+            destination.resize(static_cast<size_t>(destinationWidth) * destinationHeight);
+            for (UINT y = 0; y < destinationHeight; y++)
+            {
+                const FilterTaps& taps = verticalTaps[y];
+                XMFLOAT4* destinationRow = &destination[static_cast<size_t>(y) * destinationWidth];
+                for (UINT x = 0; x < destinationWidth; x++)
+                {
+                    XMVECTOR sum = XMVectorZero();
+                    for (UINT i = 0; i < taps.Weights.size(); i++)
+                    {
+                        sum = XMVectorMultiplyAdd(XMVectorReplicate(taps.Weights[i]), XMLoadFloat4(&rows[static_cast<size_t>(taps.First + i) * destinationWidth + x]), sum);
+                    }
+
+                    XMStoreFloat4(&destinationRow[x], sum);
+                }
+            }
+        }
+
+        void Encode(const std::vector<XMFLOAT4>& pixels, bool srgb, std::vector<byte>& rgba)
+        {
+            rgba.resize(pixels.size() * 4);
+            for (size_t i = 0; i < pixels.size(); i++)
+            {
+                XMFLOAT4 pixel;
+                XMStoreFloat4(&pixel, XMVectorSaturate(XMLoadFloat4(&pixels[i])));
+
+                const float channels[4] = { pixel.x, pixel.y, pixel.z, pixel.w };
+                for (UINT channel = 0; channel < 4; channel++)
+                {
+                    if (srgb && channel < 3)
+                    {
+                        rgba[i * 4 + channel] = static_cast<byte>(std::upper_bound(Tables.SrgbMidpoints, Tables.SrgbMidpoints + 255, channels[channel]) - Tables.SrgbMidpoints);
+                    }
+                    else
+                    {
+                        rgba[i * 4 + channel] = static_cast<byte>(channels[channel] * 255.0f + 0.5f);
+                    }
+                }
+            }
+        }
+    }
+
+    UINT MipGenerator::LevelCount(UINT width, UINT height)
+    {
+        UINT count = 1;
+        for (UINT size = std::max(width, height); size > 1; size /= 2)
+        {
+            count++;
+        }
+
+        return count;
+    }
+
+    void MipGenerator::Generate(const byte* rgba, UINT width, UINT height, MipFilter filter, bool srgb, std::vector<std::vector<byte>>& levels, ThreadPool* threadPool)
+    {
+        UINT levelCount = LevelCount(width, height);
+        levels.resize(levelCount - 1);
+        if (levels.empty())
+        {
+            return;
+        }
+
+        const float* colorTable = (srgb ? Tables.Srgb : Tables.Linear);
+        std::vector<XMFLOAT4> source(static_cast<size_t>(width) * height);
+        for (size_t i = 0; i < source.size(); i++)
+        {
+            const byte* pixel = &rgba[i * 4];
+            source[i] = XMFLOAT4(colorTable[pixel[0]], colorTable[pixel[1]], colorTable[pixel[2]], Tables.Linear[pixel[3]]);
+        }
+
+        // Every level reads the top one, so they don't wait on each other. With a filter that
+        // widens along with the level, each costs about the same.
+        auto generateLevel = [&](UINT index)
+        {
+            UINT level = index + 1;
+            std::vector<XMFLOAT4> pixels;
+            Resample(source, width, height, filter, std::max(width >> level, 1U), std::max(height >> level, 1U), pixels);
+            Encode(pixels, srgb, levels[index]);
+        };
+
+        if (threadPool != nullptr)
+        {
+            threadPool->ParallelFor(static_cast<UINT>(levels.size()), generateLevel);
+        }
+        else
+        {
+            for (UINT index = 0; index < levels.size(); index++)
+            {
+                generateLevel(index);
+            }
+        }
+    }
+}
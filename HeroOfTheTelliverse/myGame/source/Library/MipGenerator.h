@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class ThreadPool;
+
+    enum MipFilter
+    {
+        MipFilterBox = 0,
+        MipFilterKaiser // Windowed sinc; sharper than the box, at several times the cost.
+    };
+
+    // Builds mip chains for RGBA8 images on the CPU, so textures can be created with every level
+    // as initial data instead of running GenerateMips() on the device context. Colors are filtered
+    // in linear space (decoded from sRGB unless told otherwise; alpha is always linear), and every
+    // level is resampled straight from the top one rather than from the level above it.
+    class MipGenerator
+    {
+    public:
+        // Levels in a full chain down to 1x1, the top one included.
+        static UINT LevelCount(UINT width, UINT height);
+
+        // Fills levels with every level below the top one, largest first, as tightly packed rows.
+        // Levels are resampled in parallel on threadPool when one is given.
+        static void Generate(const byte* rgba, UINT width, UINT height, MipFilter filter, bool srgb, std::vector<std::vector<byte>>& levels, ThreadPool* threadPool = nullptr);
+
+    private:
+        MipGenerator();
+        MipGenerator(const MipGenerator& rhs);
+        MipGenerator& operator=(const MipGenerator& rhs);
+    };
+}
@@ -1,47 +1,42 @@
 #include "Model.h"
 #include "Game.h"
+#include "ContentManifest.h"
 #include "GameException.h"
 #include "Mesh.h"
 #include "ModelMaterial.h"
+#include "MeshFile.h"
+#include "MappedFile.h"
+#include "ObjFile.h"
+#include "ThreeDSFile.h"
+#include "ThreadPool.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 namespace Library
 {
-    Model::Model(Game& game, const std::string& filename, bool flipUVs)
+    Model::Model(Game& game, const std::string& filename, bool flipUVs, ThreadPool* threadPool, bool preferCookedFile)
         : mGame(game), mMeshes(), mMaterials()
     {
-        Assimp::Importer importer;
-
-        UINT flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_FlipWindingOrder;
-        if (flipUVs)
-        {
-            flags |= aiProcess_FlipUVs;
-        }
-
-        const aiScene* scene = importer.ReadFile(filename, flags);
-        if (scene == nullptr)
+        if (MeshFile::IsMeshFile(filename))
         {
-            throw GameException(importer.GetErrorString());
+            LoadMeshFile(filename, flipUVs);
         }
-
-        if (scene->HasMaterials())
+        else
         {
-            for (UINT i = 0; i < scene->mNumMaterials; i++)
+            std::string cookedFilename = (preferCookedFile ? FindCookedFile(filename, flipUVs) : std::string());
+            if (cookedFilename.empty() == false)
             {
-                mMaterials.push_back(new ModelMaterial(*this, scene->mMaterials[i]));
+                LoadMeshFile(cookedFilename, flipUVs);
             }
-        }
-
-        if (scene->HasMeshes())
-        {
-            for (UINT i = 0; i < scene->mNumMeshes; i++)
+            else
             {
-                ModelMaterial* material = (mMaterials.size() > i ? mMaterials.at(i) : nullptr);
+                if (threadPool == nullptr)
+                {
+                    threadPool = (ThreadPool*)mGame.Services().GetService(ThreadPool::TypeIdClass());
+                }
 
-                Mesh* mesh = new Mesh(*this, *(scene->mMeshes[i]));
-                mMeshes.push_back(mesh);
+                LoadSourceFile(filename, flipUVs, threadPool);
             }
         }
     }
@@ -83,4 +78,108 @@ namespace Library
     {
         return mMaterials;
     }
+
+    MeshBounds Model::Bounds() const
+    {
+        MeshBounds bounds;
+        MeshBounds::Compute(ArraySpan<const XMFLOAT3>(), bounds);
+        for (UINT i = 0; i < mMeshes.size(); i++)
+        {
+            if (i == 0)
+            {
+                bounds = mMeshes[i]->Bounds();
+            }
+            else
+            {
+                MeshBounds::Merge(bounds, mMeshes[i]->Bounds(), bounds);
+            }
+        }
+
+        return bounds;
+    }
+
+    std::string Model::FindCookedFile(const std::string& filename, bool flipUVs) const
+    {
+        // Prefer the artifact the content manifest lists, as long as the source hasn't changed since
+        // it was cooked, then an up-to-date cooked copy sitting next to the source asset.
+        UINT importFlags = (flipUVs ? MeshFileImportFlagsFlipUVs : MeshFileImportFlagsNone);
+        ContentManifest* manifest = (ContentManifest*)mGame.Services().GetService(ContentManifest::TypeIdClass());
+        if (manifest != nullptr)
+        {
+            std::string cookedFilename = manifest->ArtifactFilename(filename);
+            if (MeshFile::IsMeshFile(cookedFilename) && MeshFile::IsCookedFileCompatible(cookedFilename, importFlags))
+            {
+                return cookedFilename;
+            }
+        }
+
+        std::string cookedFilename = MeshFile::CookedFilename(filename);
+
+        return (MeshFile::IsCookedFileCurrent(filename, cookedFilename, importFlags) ? cookedFilename : std::string());
+    }
+
+    void Model::LoadSourceFile(const std::string& filename, bool flipUVs, ThreadPool* threadPool)
+    {
+        // OBJ has a native reader; the few files it declines still go through assimp.
+        if (ObjFile::IsObjFile(filename) && ObjFile::Read(*this, filename, flipUVs, threadPool))
+        {
+            return;
+        }
+
+        if (ThreeDSFile::IsThreeDSFile(filename))
+        {
+            ThreeDSFile::Read(*this, filename, flipUVs, threadPool);
+            return;
+        }
+
+        Assimp::Importer importer;
+
+        UINT flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_FlipWindingOrder;
+        if (flipUVs)
+        {
+            flags |= aiProcess_FlipUVs;
+        }
+
+        const aiScene* scene = importer.ReadFile(filename, flags);
+        if (scene == nullptr)
+        {
+            throw GameException(importer.GetErrorString());
+        }
+
+        if (scene->HasMaterials())
+        {
+            for (UINT i = 0; i < scene->mNumMaterials; i++)
+            {
+                mMaterials.push_back(new ModelMaterial(*this, scene->mMaterials[i]));
+            }
+        }
+
+        if (scene->HasMeshes())
+        {
+            // Each mesh only reads its own aiMesh and the finished material list, so they can
+            // be converted independently; results land in scene order either way.
+            mMeshes.resize(scene->mNumMeshes, nullptr);
+
+            if (threadPool != nullptr && scene->mNumMeshes > 1)
+            {
+                threadPool->ParallelFor(scene->mNumMeshes, [&](UINT i)
+                {
+                    mMeshes[i] = new Mesh(*this, *(scene->mMeshes[i]));
+                });
+            }
+            else
+            {
+                for (UINT i = 0; i < scene->mNumMeshes; i++)
+                {
+                    mMeshes[i] = new Mesh(*this, *(scene->mMeshes[i]));
+                }
+            }
+        }
+    }
+
+    void Model::LoadMeshFile(const std::string& filename, bool flipUVs)
+    {
+        MappedFile file(filename);
+        MeshFile::Read(*this, file, (flipUVs ? MeshFileImportFlagsFlipUVs : MeshFileImportFlagsNone));
+    }
 }
@@ -7,11 +7,19 @@ namespace Library
     class Game;
     class Mesh;
     class ModelMaterial;
+    class ThreadPool;
+    struct MeshBounds;
 
     class Model
     {
+        friend class MeshFile;
+        friend class ObjFile;
+        friend class ThreeDSFile;
+
     public:
-        Model(Game& game, const std::string& filename, bool flipUVs = false);
+        // Meshes are converted on threadPool, or on the game's ThreadPool service when none is
+        // given. Pass preferCookedFile = false to always import the source asset.
+        Model(Game& game, const std::string& filename, bool flipUVs = false, ThreadPool* threadPool = nullptr, bool preferCookedFile = true);
         ~Model();
 
         Game& GetGame();
@@ -21,10 +29,17 @@ namespace Library
         const std::vector<Mesh*>& Meshes() const;
         const std::vector<ModelMaterial*>& Materials() const;
 
+        // Union of every mesh's bounds. The oriented box is axis-aligned once there is more than one mesh.
+        MeshBounds Bounds() const;
+
     private:
         Model(const Model& rhs);
         Model& operator=(const Model& rhs);
 
+        std::string FindCookedFile(const std::string& filename, bool flipUVs) const;
+        void LoadSourceFile(const std::string& filename, bool flipUVs, ThreadPool* threadPool);
+        void LoadMeshFile(const std::string& filename, bool flipUVs);
+
         Game& mGame;
         std::vector<Mesh*> mMeshes;
         std::vector<ModelMaterial*> mMaterials;
@@ -0,0 +1,152 @@
+#include "ModelBuffer.h"
+#include "GameException.h"
+#include "Model.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <climits>
+
+namespace Library
+{
+    const UINT Submesh::NoMaterial = UINT_MAX;
+
+    namespace
+    {
+        void CreateBuffer(ID3D11Device* device, UINT bindFlags, const void* data, UINT byteWidth, ID3D11Buffer** buffer)
+        {
+            D3D11_BUFFER_DESC bufferDesc;
+            ZeroMemory(&bufferDesc, sizeof(bufferDesc));
+            bufferDesc.ByteWidth = byteWidth;
+            bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+            bufferDesc.BindFlags = bindFlags;
+
+            D3D11_SUBRESOURCE_DATA subResourceData;
+            ZeroMemory(&subResourceData, sizeof(subResourceData));
+            subResourceData.pSysMem = data;
+            if (FAILED(device->CreateBuffer(&bufferDesc, &subResourceData, buffer)))
+            {
+                throw GameException("ID3D11Device::CreateBuffer() failed.");
+            }
+        }
+    }
+
+    ModelBuffer::ModelBuffer(ID3D11Device* device, Model& model, UINT vertexSize, const VertexWriter& writeVertices)
+        : mVertexBuffer(nullptr), mIndexBuffer(nullptr), mVertexSize(vertexSize), mIndexFormat(DXGI_FORMAT_R16_UINT), mSubmeshes()
+    {
+        // Lay the meshes out first: vertices back to back, and each mesh's indices followed by its levels.
+        std::vector<Mesh*> meshes;
+        UINT vertexCount = 0;
+        UINT indexCount = 0;
+        for (Mesh* mesh : model.Meshes())
+        {
+            if (mesh->Indices().empty())
+            {
+                continue;
+            }
+
+            Submesh submesh;
+            submesh.BaseVertex = vertexCount;
+            submesh.VertexCount = static_cast<UINT>(mesh->Vertices().size());
+            submesh.StartIndex = indexCount;
+            submesh.IndexCount = static_cast<UINT>(mesh->Indices().size());
+            std::vector<ModelMaterial*>::const_iterator material = std::find(model.Materials().begin(), model.Materials().end(), mesh->GetMaterial());
+            submesh.MaterialIndex = (material != model.Materials().end() ? static_cast<UINT>(material - model.Materials().begin()) : Submesh::NoMaterial);
+            submesh.Sphere = mesh->Bounds().Sphere;
+
+            submesh.Lods = mesh->Lods();
+            for (MeshLod& level : submesh.Lods)
+            {
+                level.IndexOffset += submesh.StartIndex;
+            }
+
+            submesh.Meshlets = mesh->Meshlets();
+            for (Meshlet& meshlet : submesh.Meshlets)
+            {
+                meshlet.IndexOffset += submesh.StartIndex;
+            }
+
+            if (mesh->IndexFormat() == DXGI_FORMAT_R32_UINT)
+            {
+                mIndexFormat = DXGI_FORMAT_R32_UINT;
+            }
+
+            vertexCount += submesh.VertexCount;
+            indexCount += submesh.IndexCount + static_cast<UINT>(mesh->LodIndices().size());
+            mSubmeshes.push_back(submesh);
+            meshes.push_back(mesh);
+        }
+
+        if (mSubmeshes.empty())
+        {
+            throw GameException("The model has no meshes to draw.");
+        }
+
+        std::vector<BYTE> vertices(static_cast<size_t>(vertexCount) * vertexSize);
+        std::vector<UINT> indices;
+        indices.reserve(indexCount);
+        for (UINT i = 0; i < meshes.size(); i++)
+        {
+            writeVertices(*meshes[i], &vertices[static_cast<size_t>(mSubmeshes[i].BaseVertex) * vertexSize]);
+            indices.insert(indices.end(), meshes[i]->Indices().begin(), meshes[i]->Indices().end());
+            indices.insert(indices.end(), meshes[i]->LodIndices().begin(), meshes[i]->LodIndices().end());
+        }
+
+        CreateBuffer(device, D3D11_BIND_VERTEX_BUFFER, &vertices[0], static_cast<UINT>(vertices.size()), &mVertexBuffer);
+
+        try
+        {
+            if (mIndexFormat == DXGI_FORMAT_R16_UINT)
+            {
+                std::vector<USHORT> shortIndices(indices.begin(), indices.end());
+                CreateBuffer(device, D3D11_BIND_INDEX_BUFFER, &shortIndices[0], static_cast<UINT>(shortIndices.size() * sizeof(USHORT)), &mIndexBuffer);
+            }
+            else
+            {
+                CreateBuffer(device, D3D11_BIND_INDEX_BUFFER, &indices[0], static_cast<UINT>(indices.size() * sizeof(UINT)), &mIndexBuffer);
+            }
+        }
+        catch (...)
+        {
+            ReleaseObject(mVertexBuffer);
+            throw;
+        }
+    }
+
+    ModelBuffer::~ModelBuffer()
+    {
+        ReleaseObject(mIndexBuffer);
+        ReleaseObject(mVertexBuffer);
+    }
+
+    ID3D11Buffer* ModelBuffer::VertexBuffer() const
+    {
+        return mVertexBuffer;
+    }
+
+    ID3D11Buffer* ModelBuffer::IndexBuffer() const
+    {
+        return mIndexBuffer;
+    }
+
+    UINT ModelBuffer::VertexSize() const
+    {
+        return mVertexSize;
+    }
+
+    DXGI_FORMAT ModelBuffer::IndexFormat() const
+    {
+        return mIndexFormat;
+    }
+
+    const std::vector<Submesh>& ModelBuffer::Submeshes() const
+    {
+        return mSubmeshes;
+    }
+
+    void ModelBuffer::Bind(ID3D11DeviceContext* context) const
+    {
+        UINT stride = mVertexSize;
+        UINT offset = 0;
+        context->IASetVertexBuffers(0, 1, &mVertexBuffer, &stride, &offset);
+        context->IASetIndexBuffer(mIndexBuffer, mIndexFormat, 0);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Common.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include <DirectXCollision.h>
+#include <functional>
+
+namespace Library
+{
+    class Model;
+    class Mesh;
+
+    // One mesh of a merged model. Indices stay relative to the mesh, so every draw passes
+    // BaseVertex; StartIndex, the level ranges and the meshlet offsets already point into the
+    // merged index buffer.
+    struct Submesh
+    {
+        static const UINT NoMaterial;
+
+        UINT BaseVertex;
+        UINT VertexCount;
+        UINT StartIndex;
+        UINT IndexCount;
+        UINT MaterialIndex; // Into the model's Materials(); an index, since the cache may free the model first.
+        BoundingSphere Sphere;
+        std::vector<MeshLod> Lods;
+        std::vector<Meshlet> Meshlets;
+    };
+
+    // Every mesh of a model in one vertex buffer and one index buffer, so a component binds the
+    // input assembler once and draws each submesh with DrawIndexed(IndexCount, StartIndex, BaseVertex).
+    class ModelBuffer
+    {
+    public:
+        // Fills mesh.Vertices().size() vertices of the buffer's vertex size at vertices.
+        typedef std::function<void(const Mesh& mesh, void* vertices)> VertexWriter;
+
+        // Meshes without indices are skipped. Throws GameException when nothing is left to draw.
+        ModelBuffer(ID3D11Device* device, Model& model, UINT vertexSize, const VertexWriter& writeVertices);
+        ~ModelBuffer();
+
+        ID3D11Buffer* VertexBuffer() const;
+        ID3D11Buffer* IndexBuffer() const;
+        UINT VertexSize() const;
+
+        // 16-bit whenever every mesh has few enough vertices, since indices are mesh-relative.
+        DXGI_FORMAT IndexFormat() const;
+
+        const std::vector<Submesh>& Submeshes() const;
+
+        void Bind(ID3D11DeviceContext* context) const;
+
+    private:
+        ModelBuffer();
+        ModelBuffer(const ModelBuffer& rhs);
+        ModelBuffer& operator=(const ModelBuffer& rhs);
+
+        ID3D11Buffer* mVertexBuffer;
+        ID3D11Buffer* mIndexBuffer;
+        UINT mVertexSize;
+        DXGI_FORMAT mIndexFormat;
+        std::vector<Submesh> mSubmeshes;
+    };
+}
@@ -0,0 +1,219 @@
+#include "ModelCache.h"
+#include "Game.h"
+#include "GameException.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "Material.h"
+#include <algorithm>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(ModelCache)
+
+    ModelCache::ModelCache(Game& game)
+        : mGame(game), mModels(), mModelKeys(), mBuffers(), mModelBuffers()
+    {
+    }
+
+    ModelCache::~ModelCache()
+    {
+        Clear();
+    }
+
+    std::shared_ptr<Model> ModelCache::GetModel(const std::string& filename, bool flipUVs)
+    {
+        std::shared_ptr<Model> model = FindModel(filename, flipUVs);
+        if (model != nullptr)
+        {
+            return model;
+        }
+
+        return AddModel(filename, flipUVs, std::shared_ptr<Model>(new Model(mGame, filename, flipUVs)));
+    }
+
+    std::shared_ptr<Model> ModelCache::FindModel(const std::string& filename, bool flipUVs) const
+    {
+        std::map<std::string, std::shared_ptr<Model>>::const_iterator it = mModels.find(ModelKey(filename, flipUVs));
+
+        return (it != mModels.end() ? it->second : std::shared_ptr<Model>());
+    }
+
+    std::shared_ptr<Model> ModelCache::AddModel(const std::string& filename, bool flipUVs, const std::shared_ptr<Model>& model)
+    {
+        std::string key = ModelKey(filename, flipUVs);
+
+        std::map<std::string, std::shared_ptr<Model>>::iterator it = mModels.find(key);
+        if (it != mModels.end())
+        {
+            return it->second;
+        }
+
+        mModels.insert(std::pair<std::string, std::shared_ptr<Model>>(key, model));
+        mModelKeys.insert(std::pair<const Model*, std::string>(model.get(), key));
+
+        return model;
+    }
+
+    ID3D11Buffer* ModelCache::GetVertexBuffer(Mesh& mesh, const std::string& vertexFormat, const VertexBufferFactory& createVertexBuffer)
+    {
+        ID3D11Device* device = mGame.Direct3DDevice();
+
+        return AcquireBuffer(MeshKey(mesh) + "|vb|" + vertexFormat, [&](ID3D11Buffer** buffer)
+        {
+            createVertexBuffer(device, mesh, buffer);
+        });
+    }
+
+    ID3D11Buffer* ModelCache::GetVertexBuffer(Mesh& mesh, const Material& material)
+    {
+        // The stride tells compressed and full-precision layouts of the same material apart.
+        std::string vertexFormat = std::to_string(material.TypeIdInstance()) + "|" + std::to_string(material.VertexSize());
+
+        return GetVertexBuffer(mesh, vertexFormat, [&](ID3D11Device* device, const Mesh& sourceMesh, ID3D11Buffer** buffer)
+        {
+            material.CreateVertexBuffer(device, sourceMesh, buffer);
+        });
+    }
+
+    ID3D11Buffer* ModelCache::GetIndexBuffer(Mesh& mesh)
+    {
+        return AcquireBuffer(MeshKey(mesh) + "|ib", [&](ID3D11Buffer** buffer)
+        {
+            mesh.CreateIndexBuffer(buffer);
+        });
+    }
+
+    std::shared_ptr<ModelBuffer> ModelCache::GetModelBuffer(Model& model, const std::string& vertexFormat, UINT vertexSize, const ModelBuffer::VertexWriter& writeVertices)
+    {
+        std::string key = CachedModelKey(model) + "|model|" + vertexFormat;
+
+        std::map<std::string, std::shared_ptr<ModelBuffer>>::iterator it = mModelBuffers.find(key);
+        if (it != mModelBuffers.end())
+        {
+            return it->second;
+        }
+
+        std::shared_ptr<ModelBuffer> modelBuffer(new ModelBuffer(mGame.Direct3DDevice(), model, vertexSize, writeVertices));
+        mModelBuffers.insert(std::pair<std::string, std::shared_ptr<ModelBuffer>>(key, modelBuffer));
+
+        return modelBuffer;
+    }
+
+    void ModelCache::Trim()
+    {
+        // Merged buffers keep material indices rather than pointers into their model, so a
+        // model can be dropped while its merged buffer is still drawn.
+        for (std::map<std::string, std::shared_ptr<ModelBuffer>>::iterator it = mModelBuffers.begin(); it != mModelBuffers.end();)
+        {
+            if (it->second.use_count() == 1)
+            {
+                it = mModelBuffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (std::map<std::string, std::shared_ptr<Model>>::iterator it = mModels.begin(); it != mModels.end();)
+        {
+            if (it->second.use_count() == 1)
+            {
+                mModelKeys.erase(it->second.get());
+                it = mModels.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (std::map<std::string, ID3D11Buffer*>::iterator it = mBuffers.begin(); it != mBuffers.end();)
+        {
+            ID3D11Buffer* buffer = it->second;
+            buffer->AddRef();
+            if (buffer->Release() == 1)
+            {
+                buffer->Release();
+                it = mBuffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void ModelCache::Clear()
+    {
+        for (std::pair<const std::string, ID3D11Buffer*>& buffer : mBuffers)
+        {
+            ReleaseObject(buffer.second);
+        }
+
+        mBuffers.clear();
+        mModelBuffers.clear();
+        mModelKeys.clear();
+        mModels.clear();
+    }
+
+    UINT ModelCache::ModelCount() const
+    {
+        return static_cast<UINT>(mModels.size());
+    }
+
+    UINT ModelCache::BufferCount() const
+    {
+        return static_cast<UINT>(mBuffers.size() + mModelBuffers.size());
+    }
+
+    std::string ModelCache::ModelKey(const std::string& filename, bool flipUVs)
+    {
+        std::string key(filename);
+        std::replace(key.begin(), key.end(), '/', '\\');
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+        return key + (flipUVs ? "|flipuvs" : "");
+    }
+
+    const std::string& ModelCache::CachedModelKey(const Model& model) const
+    {
+        std::map<const Model*, std::string>::const_iterator it = mModelKeys.find(&model);
+        if (it == mModelKeys.end())
+        {
+            throw GameException("Model is not owned by the ModelCache.");
+        }
+
+        return it->second;
+    }
+
+    std::string ModelCache::MeshKey(Mesh& mesh) const
+    {
+        Model& model = mesh.GetModel();
+        const std::string& modelKey = CachedModelKey(model);
+
+        const std::vector<Mesh*>& meshes = model.Meshes();
+        UINT meshIndex = static_cast<UINT>(std::find(meshes.begin(), meshes.end(), &mesh) - meshes.begin());
+
+        return modelKey + "|" + std::to_string(meshIndex);
+    }
+
+    ID3D11Buffer* ModelCache::AcquireBuffer(const std::string& key, const std::function<void(ID3D11Buffer**)>& createBuffer)
+    {
+        ID3D11Buffer* buffer = nullptr;
+
+        std::map<std::string, ID3D11Buffer*>::iterator it = mBuffers.find(key);
+        if (it != mBuffers.end())
+        {
+            buffer = it->second;
+        }
+        else
+        {
+            createBuffer(&buffer);
+            mBuffers.insert(std::pair<std::string, ID3D11Buffer*>(key, buffer));
+        }
+
+        buffer->AddRef();
+        return buffer;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Common.h"
+#include "ModelBuffer.h"
+#include <functional>
+
+namespace Library
+{
+    class Game;
+    class Model;
+    class Mesh;
+    class Material;
+
+    class ModelCache : public RTTI
+    {
+        RTTI_DECLARATIONS(ModelCache, RTTI)
+
+    public:
+        typedef std::function<void(ID3D11Device*, const Mesh&, ID3D11Buffer**)> VertexBufferFactory;
+
+        ModelCache(Game& game);
+        ~ModelCache();
+
+        std::shared_ptr<Model> GetModel(const std::string& filename, bool flipUVs = false);
+
+        // For models imported elsewhere (e.g. on a loader thread). FindModel returns null for a
+        // model that isn't cached; AddModel returns the model already cached under that name, if any.
+        std::shared_ptr<Model> FindModel(const std::string& filename, bool flipUVs = false) const;
+        std::shared_ptr<Model> AddModel(const std::string& filename, bool flipUVs, const std::shared_ptr<Model>& model);
+
+        static std::string ModelKey(const std::string& filename, bool flipUVs);
+
+        // Buffers are shared per mesh and vertex format. The returned buffer has already
+        // been AddRef'd, so callers release it exactly as if they had created it.
+        ID3D11Buffer* GetVertexBuffer(Mesh& mesh, const std::string& vertexFormat, const VertexBufferFactory& createVertexBuffer);
+        ID3D11Buffer* GetVertexBuffer(Mesh& mesh, const Material& material);
+        ID3D11Buffer* GetIndexBuffer(Mesh& mesh);
+
+        // All of a model's meshes merged into one vertex and one index buffer, shared per vertex format.
+        std::shared_ptr<ModelBuffer> GetModelBuffer(Model& model, const std::string& vertexFormat, UINT vertexSize, const ModelBuffer::VertexWriter& writeVertices);
+
+        // Drops models and buffers that nobody outside the cache is holding on to.
+        void Trim();
+        void Clear();
+
+        UINT ModelCount() const;
+        UINT BufferCount() const;
+
+    private:
+        ModelCache();
+        ModelCache(const ModelCache& rhs);
+        ModelCache& operator=(const ModelCache& rhs);
+
+        const std::string& CachedModelKey(const Model& model) const;
+        std::string MeshKey(Mesh& mesh) const;
+        ID3D11Buffer* AcquireBuffer(const std::string& key, const std::function<void(ID3D11Buffer**)>& createBuffer);
+
+        Game& mGame;
+        std::map<std::string, std::shared_ptr<Model>> mModels;
+        std::map<const Model*, std::string> mModelKeys;
+        std::map<std::string, ID3D11Buffer*> mBuffers;
+        std::map<std::string, std::shared_ptr<ModelBuffer>> mModelBuffers;
+    };
+}
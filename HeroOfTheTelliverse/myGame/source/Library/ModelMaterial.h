@@ -23,6 +23,9 @@ namespace Library
     class ModelMaterial
     {
         friend class Model;
+        friend class MeshFile;
+        friend class ObjFile;
+        friend class ThreeDSFile;
 
     public:
         ModelMaterial(Model& model);
@@ -0,0 +1,1329 @@
+#include "ObjFile.h"
+#include "GameException.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "ModelMaterial.h"
+#include "ThreadPool.h"
+#include "Utility.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <unordered_map>
+
+namespace Library
+{
+    const std::string ObjFile::Extension = ".obj";
+    const std::string ObjFile::DefaultMaterialName = "DefaultMaterial";
+
+    namespace
+    {
+        const UINT MinimumChunkSize = 256 * 1024;
+        const UINT ChunksPerThread = 4;
+        const int MissingIndex = -1;
+
+        // assimp's fast_atof keeps at most 15 fractional digits and scales them in double precision.
+        const UINT MaxFractionDigits = 15;
+        const double FractionScales[] = { 0.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001, 0.00000001, 0.000000001,
+            0.0000000001, 0.00000000001, 0.000000000001, 0.0000000000001, 0.00000000000001, 0.000000000000001 };
+
+        // The constants assimp's triangulation uses, so polygons split the same way.
+        const float Pi = 3.1415926538f;
+        const double MinimumTriangleArea = 1e-5;
+
+        // JoinIdenticalVertices treats normals and texture coordinates this close as equal.
+        const float JoinSquareEpsilon = 1e-5f * 1e-5f;
+        const UINT NoVertex = UINT_MAX;
+
+        enum ObjKeyword
+        {
+            ObjKeywordNone = 0,
+            ObjKeywordPosition,
+            ObjKeywordTextureCoordinate,
+            ObjKeywordNormal,
+            ObjKeywordFace,
+            ObjKeywordGroup,
+            ObjKeywordObject,
+            ObjKeywordUseMaterial,
+            ObjKeywordMaterialLibrary,
+            ObjKeywordPoint,
+            ObjKeywordLine
+        };
+
+        struct ObjKeywordName
+        {
+            const char* Name;
+            ObjKeyword Keyword;
+        };
+
+        const ObjKeywordName KeywordNames[] =
+        {
+            { "v", ObjKeywordPosition },
+            { "vt", ObjKeywordTextureCoordinate },
+            { "vn", ObjKeywordNormal },
+            { "f", ObjKeywordFace },
+            { "g", ObjKeywordGroup },
+            { "o", ObjKeywordObject },
+            { "usemtl", ObjKeywordUseMaterial },
+            { "mtllib", ObjKeywordMaterialLibrary },
+            { "p", ObjKeywordPoint },
+            { "l", ObjKeywordLine }
+        };
+
+        // MTL maps with a ModelMaterial slot; the rest never reach one through assimp either.
+        struct ObjTextureKeyword
+        {
+            const char* Name;
+            TextureType Type;
+        };
+
+        const ObjTextureKeyword TextureKeywords[] =
+        {
+            { "map_kd", TextureTypeDifffuse },
+            { "map_ka", TextureTypeAmbient },
+            { "map_ks", TextureTypeSpecularMap },
+            { "map_ns", TextureTypeSpecularPowerMap },
+            { "map_bump", TextureTypeHeightmap },
+            { "bump", TextureTypeHeightmap },
+            { "map_kn", TextureTypeNormalMap },
+            { "norm", TextureTypeNormalMap },
+            { "disp", TextureTypeDisplacementMap }
+        };
+
+        // Texture options and how many arguments each takes; -o, -s and -t take up to three.
+        struct ObjTextureOption
+        {
+            const char* Name;
+            UINT ArgumentCount;
+        };
+
+        const ObjTextureOption TextureOptions[] =
+        {
+            { "-blendu", 1 }, { "-blendv", 1 }, { "-boost", 1 }, { "-mm", 2 }, { "-o", 3 }, { "-s", 3 }, { "-t", 3 },
+            { "-texres", 1 }, { "-clamp", 1 }, { "-bm", 1 }, { "-imfchan", 1 }, { "-type", 1 }, { "-cc", 1 }
+        };
+
+        // Face corners index the file-wide arrays, zero-based; MissingIndex when absent.
+        struct ObjCorner
+        {
+            int Position;
+            int TextureCoordinate;
+            int Normal;
+        };
+
+        struct ObjFace
+        {
+            UINT FirstCorner;
+            UINT CornerCount;
+        };
+
+        struct ObjCommand
+        {
+            ObjKeyword Keyword;
+            UINT FaceIndex; // Faces of the same chunk that precede it.
+            std::string Name;
+        };
+
+        struct ObjChunk
+        {
+            const char* Begin;
+            const char* End;
+            UINT PositionBase;
+            UINT TextureCoordinateBase;
+            UINT NormalBase;
+            UINT PositionCount;
+            UINT TextureCoordinateCount;
+            UINT NormalCount;
+            std::vector<ObjCorner> Corners;
+            std::vector<ObjFace> Faces;
+            std::vector<ObjCommand> Commands;
+            bool Unsupported;
+        };
+
+        struct ObjMaterial
+        {
+            std::string Name;
+            std::map<TextureType, std::wstring> Textures;
+        };
+
+        struct ObjFaceReference
+        {
+            const ObjCorner* Corners;
+            UINT CornerCount;
+        };
+
+        struct ObjMeshDraft
+        {
+            std::string Name;
+            UINT MaterialIndex;
+            std::vector<ObjFaceReference> Faces;
+            UINT CornerCount;
+            bool HasTextureCoordinates;
+            bool HasNormals;
+        };
+
+        struct ObjStream
+        {
+            std::vector<XMFLOAT3> Values;
+
+            // Canonical[i] is the first index holding the same value as Values[i]. Only filled in
+            // for positions.
+            std::vector<UINT> Canonical;
+        };
+
+        struct ObjValueKey
+        {
+            XMFLOAT3 Value;
+
+            bool operator==(const ObjValueKey& rhs) const
+            {
+                return (Value.x == rhs.Value.x && Value.y == rhs.Value.y && Value.z == rhs.Value.z);
+            }
+        };
+
+        struct ObjValueKeyHash
+        {
+            size_t operator()(const ObjValueKey& key) const
+            {
+                // Adding zero folds -0 into +0, which compare equal.
+                float components[3] = { key.Value.x + 0.0f, key.Value.y + 0.0f, key.Value.z + 0.0f };
+                UINT bits[3];
+                memcpy(bits, components, sizeof(bits));
+
+                unsigned long long hash = bits[0] * 0x9E3779B97F4A7C15ULL;
+                hash ^= bits[1] * 0xBF58476D1CE4E5B9ULL;
+                hash ^= bits[2] * 0x94D049BB133111EBULL;
+
+                return static_cast<size_t>(hash ^ (hash >> 29));
+            }
+        };
+
+        struct ObjTriangulationScratch
+        {
+            std::vector<UINT> Polygon;
+            std::vector<XMFLOAT3> Points3D;
+            std::vector<XMFLOAT2> Points;
+            std::vector<bool> Done;
+            std::vector<int> Triangles;
+        };
+
+        void ForEach(ThreadPool* threadPool, UINT count, const std::function<void(UINT)>& body)
+        {
+            if (threadPool != nullptr && count > 1)
+            {
+                threadPool->ParallelFor(count, body);
+            }
+            else
+            {
+                for (UINT i = 0; i < count; i++)
+                {
+                    body(i);
+                }
+            }
+        }
+
+        inline bool IsSpace(char c)
+        {
+            return (c == ' ' || c == '\t' || c == '\r');
+        }
+
+        inline bool IsDigit(char c)
+        {
+            return (c >= '0' && c <= '9');
+        }
+
+        const char* SkipSpaces(const char* cursor, const char* end)
+        {
+            while (cursor < end && IsSpace(*cursor))
+            {
+                ++cursor;
+            }
+
+            return cursor;
+        }
+
+        const char* SkipToken(const char* cursor, const char* end)
+        {
+            while (cursor < end && IsSpace(*cursor) == false)
+            {
+                ++cursor;
+            }
+
+            return cursor;
+        }
+
+        const char* TrimEnd(const char* begin, const char* end)
+        {
+            while (end > begin && IsSpace(end[-1]))
+            {
+                --end;
+            }
+
+            return end;
+        }
+
+        const char* LineEnd(const char* cursor, const char* end)
+        {
+            const char* newLine = reinterpret_cast<const char*>(memchr(cursor, '\n', end - cursor));
+
+            return (newLine != nullptr ? newLine : end);
+        }
+
+        bool TokenEquals(const char* begin, const char* end, const char* name, bool ignoreCase)
+        {
+            size_t length = strlen(name);
+            if (static_cast<size_t>(end - begin) != length)
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < length; i++)
+            {
+                char c = (ignoreCase ? static_cast<char>(tolower(static_cast<unsigned char>(begin[i]))) : begin[i]);
+                if (c != name[i])
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // Leaves cursor at the first argument.
+        ObjKeyword ReadKeyword(const char*& cursor, const char* end)
+        {
+            const char* begin = SkipSpaces(cursor, end);
+            const char* tokenEnd = SkipToken(begin, end);
+            cursor = SkipSpaces(tokenEnd, end);
+
+            if (begin == tokenEnd || *begin == '#')
+            {
+                return ObjKeywordNone;
+            }
+
+            for (const ObjKeywordName& keyword : KeywordNames)
+            {
+                if (TokenEquals(begin, tokenEnd, keyword.Name, false))
+                {
+                    return keyword.Keyword;
+                }
+            }
+
+            return ObjKeywordNone;
+        }
+
+        inline bool AreEightDigits(unsigned long long word)
+        {
+            return (((word & 0xF0F0F0F0F0F0F0F0ULL) | (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
+        }
+
+        // Converts eight ASCII digits at once, first digit in the lowest byte.
+        inline UINT ParseEightDigits(unsigned long long word)
+        {
+            word -= 0x3030303030303030ULL;
+            word = (word * 10) + (word >> 8);
+            word = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) + (((word >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+
+            return static_cast<UINT>(word);
+        }
+
+        // Accumulates up to maxDigits digits, eight per step where the line has room, and skips any beyond.
+        unsigned long long ReadDigits(const char*& cursor, const char* end, UINT maxDigits, UINT& digitCount)
+        {
+            unsigned long long value = 0;
+            digitCount = 0;
+
+            unsigned long long word;
+            while (end - cursor >= 8 && maxDigits - digitCount >= 8)
+            {
+                memcpy(&word, cursor, sizeof(word));
+                if (AreEightDigits(word) == false)
+                {
+                    break;
+                }
+
+                value = value * 100000000ULL + ParseEightDigits(word);
+                cursor += 8;
+                digitCount += 8;
+            }
+
+            while (cursor < end && digitCount < maxDigits && IsDigit(*cursor))
+            {
+                value = value * 10 + (*cursor - '0');
+                ++cursor;
+                ++digitCount;
+            }
+
+            while (cursor < end && IsDigit(*cursor))
+            {
+                ++cursor;
+            }
+
+            return value;
+        }
+
+        // Locale-independent, and rounds exactly the way assimp's fast_atof does so both paths
+        // read the same bits: integer part in float, fraction added from double, then the exponent.
+        float ParseFloat(const char*& cursor, const char* end)
+        {
+            bool negative = (cursor < end && *cursor == '-');
+            if (cursor < end && (*cursor == '-' || *cursor == '+'))
+            {
+                ++cursor;
+            }
+
+            bool startsWithDigit = (cursor < end && IsDigit(*cursor));
+            bool startsWithFraction = (end - cursor >= 2 && cursor[0] == '.' && IsDigit(cursor[1]));
+            if (startsWithDigit == false && startsWithFraction == false)
+            {
+                throw GameException("Invalid number in OBJ file.");
+            }
+
+            UINT digitCount;
+            float value = 0.0f;
+            if (startsWithDigit)
+            {
+                value = static_cast<float>(ReadDigits(cursor, end, UINT_MAX, digitCount));
+            }
+
+            if (cursor < end && *cursor == '.')
+            {
+                ++cursor;
+                double fraction = static_cast<double>(ReadDigits(cursor, end, MaxFractionDigits, digitCount));
+                value += static_cast<float>(fraction * FractionScales[digitCount]);
+            }
+
+            if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+            {
+                ++cursor;
+                bool negativeExponent = (cursor < end && *cursor == '-');
+                if (cursor < end && (*cursor == '-' || *cursor == '+'))
+                {
+                    ++cursor;
+                }
+
+                float exponent = static_cast<float>(ReadDigits(cursor, end, UINT_MAX, digitCount));
+                value *= powf(10.0f, (negativeExponent ? -exponent : exponent));
+            }
+
+            return (negative ? -value : value);
+        }
+
+        int ParseInteger(const char*& cursor, const char* end)
+        {
+            bool negative = (cursor < end && *cursor == '-');
+            if (cursor < end && (*cursor == '-' || *cursor == '+'))
+            {
+                ++cursor;
+            }
+
+            if (cursor == end || IsDigit(*cursor) == false)
+            {
+                throw GameException("Invalid face in OBJ file.");
+            }
+
+            UINT digitCount;
+            int value = static_cast<int>(ReadDigits(cursor, end, 9, digitCount));
+
+            return (negative ? -value : value);
+        }
+
+        // Missing components stay zero; fewer than minimumCount is an error.
+        XMFLOAT3 ParseVector(const char* cursor, const char* end, UINT minimumCount)
+        {
+            float components[3] = { 0.0f, 0.0f, 0.0f };
+
+            UINT count = 0;
+            for (cursor = SkipSpaces(cursor, end); cursor < end && count < 3; cursor = SkipSpaces(cursor, end))
+            {
+                components[count++] = ParseFloat(cursor, end);
+                cursor = SkipToken(cursor, end);
+            }
+
+            if (count < minimumCount)
+            {
+                throw GameException("Invalid vertex in OBJ file.");
+            }
+
+            return XMFLOAT3(components[0], components[1], components[2]);
+        }
+
+        // OBJ indices are one-based, or relative to the end of the list so far when negative.
+        int ResolveIndex(int index, UINT count)
+        {
+            if (index == 0)
+            {
+                throw GameException("Invalid face index in OBJ file.");
+            }
+
+            return (index > 0 ? index - 1 : static_cast<int>(count) + index);
+        }
+
+        void SplitChunks(const char* data, UINT size, UINT chunkCount, std::vector<ObjChunk>& chunks)
+        {
+            chunks.resize(chunkCount);
+
+            const char* end = data + size;
+            const char* begin = data;
+            for (UINT i = 0; i < chunkCount; i++)
+            {
+                const char* chunkEnd = end;
+                if (i + 1 < chunkCount)
+                {
+                    chunkEnd = std::max(begin, data + static_cast<size_t>(size) * (i + 1) / chunkCount);
+                    chunkEnd = LineEnd(chunkEnd, end);
+                    if (chunkEnd < end)
+                    {
+                        ++chunkEnd;
+                    }
+                }
+
+                ObjChunk& chunk = chunks[i];
+                chunk.Begin = begin;
+                chunk.End = chunkEnd;
+                chunk.PositionCount = chunk.TextureCoordinateCount = chunk.NormalCount = 0;
+                chunk.Unsupported = false;
+
+                begin = chunkEnd;
+            }
+        }
+
+        // First pass: how many of each vertex element the chunk defines, so every chunk knows
+        // where its elements land in the file-wide arrays before parsing.
+        void CountChunk(ObjChunk& chunk)
+        {
+            for (const char* line = chunk.Begin; line < chunk.End; )
+            {
+                const char* lineEnd = LineEnd(line, chunk.End);
+                switch (ReadKeyword(line, lineEnd))
+                {
+                case ObjKeywordPosition:
+                    chunk.PositionCount++;
+                    break;
+
+                case ObjKeywordTextureCoordinate:
+                    chunk.TextureCoordinateCount++;
+                    break;
+
+                case ObjKeywordNormal:
+                    chunk.NormalCount++;
+                    break;
+
+                default:
+                    break;
+                }
+
+                line = lineEnd + 1;
+            }
+        }
+
+        void ParseFace(ObjChunk& chunk, const char* cursor, const char* end, UINT positionCount, UINT textureCoordinateCount, UINT normalCount)
+        {
+            ObjFace face;
+            face.FirstCorner = static_cast<UINT>(chunk.Corners.size());
+
+            for (cursor = SkipSpaces(cursor, end); cursor < end; cursor = SkipSpaces(cursor, end))
+            {
+                ObjCorner corner = { MissingIndex, MissingIndex, MissingIndex };
+                corner.Position = ResolveIndex(ParseInteger(cursor, end), positionCount);
+
+                if (cursor < end && *cursor == '/')
+                {
+                    ++cursor;
+                    if (cursor < end && *cursor != '/' && IsSpace(*cursor) == false)
+                    {
+                        corner.TextureCoordinate = ResolveIndex(ParseInteger(cursor, end), textureCoordinateCount);
+                    }
+
+                    if (cursor < end && *cursor == '/')
+                    {
+                        ++cursor;
+                        if (cursor < end && IsSpace(*cursor) == false)
+                        {
+                            corner.Normal = ResolveIndex(ParseInteger(cursor, end), normalCount);
+                        }
+                    }
+                }
+
+                if (cursor < end && IsSpace(*cursor) == false)
+                {
+                    throw GameException("Invalid face in OBJ file.");
+                }
+
+                chunk.Corners.push_back(corner);
+            }
+
+            face.CornerCount = static_cast<UINT>(chunk.Corners.size()) - face.FirstCorner;
+            if (face.CornerCount < 3)
+            {
+                // assimp keeps these as points or lines in meshes of their own.
+                chunk.Unsupported = true;
+            }
+
+            chunk.Faces.push_back(face);
+        }
+
+        // Second pass: vertex elements go straight to their slots in the shared arrays, while
+        // faces and the statements that group them are kept per chunk for the in-order merge.
+        void ParseChunk(ObjChunk& chunk, XMFLOAT3* positions, XMFLOAT3* textureCoordinates, XMFLOAT3* normals, bool flipUVs)
+        {
+            UINT positionCount = chunk.PositionBase;
+            UINT textureCoordinateCount = chunk.TextureCoordinateBase;
+            UINT normalCount = chunk.NormalBase;
+
+            for (const char* line = chunk.Begin; line < chunk.End && chunk.Unsupported == false; )
+            {
+                const char* lineEnd = LineEnd(line, chunk.End);
+                const char* cursor = line;
+                ObjKeyword keyword = ReadKeyword(cursor, lineEnd);
+                const char* argumentsEnd = TrimEnd(cursor, lineEnd);
+
+                switch (keyword)
+                {
+                case ObjKeywordPosition:
+                    positions[positionCount++] = ParseVector(cursor, argumentsEnd, 3);
+                    break;
+
+                case ObjKeywordTextureCoordinate:
+                {
+                    XMFLOAT3 textureCoordinate = ParseVector(cursor, argumentsEnd, 1);
+                    if (flipUVs)
+                    {
+                        textureCoordinate.y = 1.0f - textureCoordinate.y;
+                    }
+
+                    textureCoordinates[textureCoordinateCount++] = textureCoordinate;
+                    break;
+                }
+
+                case ObjKeywordNormal:
+                    normals[normalCount++] = ParseVector(cursor, argumentsEnd, 3);
+                    break;
+
+                case ObjKeywordFace:
+                    ParseFace(chunk, cursor, argumentsEnd, positionCount, textureCoordinateCount, normalCount);
+                    break;
+
+                case ObjKeywordGroup:
+                case ObjKeywordObject:
+                case ObjKeywordMaterialLibrary:
+                case ObjKeywordUseMaterial:
+                {
+                    // usemtl takes one name; the others take the rest of the line.
+                    const char* nameEnd = (keyword == ObjKeywordUseMaterial ? SkipToken(cursor, argumentsEnd) : argumentsEnd);
+
+                    ObjCommand command;
+                    command.Keyword = keyword;
+                    command.FaceIndex = static_cast<UINT>(chunk.Faces.size());
+                    command.Name.assign(cursor, nameEnd);
+                    chunk.Commands.push_back(command);
+                    break;
+                }
+
+                case ObjKeywordPoint:
+                case ObjKeywordLine:
+                    chunk.Unsupported = true;
+                    break;
+
+                default:
+                    break;
+                }
+
+                line = lineEnd + 1;
+            }
+        }
+
+        // Strips leading texture options such as "-bm 0.5" and returns the filename that follows.
+        std::string TextureFilename(const char* cursor, const char* end)
+        {
+            for (cursor = SkipSpaces(cursor, end); cursor < end && *cursor == '-'; cursor = SkipSpaces(cursor, end))
+            {
+                const char* optionEnd = SkipToken(cursor, end);
+                const ObjTextureOption* option = nullptr;
+                for (const ObjTextureOption& textureOption : TextureOptions)
+                {
+                    if (TokenEquals(cursor, optionEnd, textureOption.Name, true))
+                    {
+                        option = &textureOption;
+                        break;
+                    }
+                }
+
+                if (option == nullptr)
+                {
+                    break;
+                }
+
+                cursor = SkipSpaces(optionEnd, end);
+                for (UINT i = 0; i < option->ArgumentCount && cursor < end; i++)
+                {
+                    // Optional trailing arguments of -o, -s and -t are numbers.
+                    if (i > 0 && option->ArgumentCount == 3 && IsDigit(*cursor) == false && *cursor != '-' && *cursor != '.')
+                    {
+                        break;
+                    }
+
+                    cursor = SkipSpaces(SkipToken(cursor, end), end);
+                }
+            }
+
+            return std::string(cursor, end);
+        }
+
+        void ReadMaterialLibrary(const std::string& filename, std::vector<ObjMaterial>& materials, std::map<std::string, UINT>& materialIndices)
+        {
+            // Like assimp, a missing library only leaves its materials undefined.
+            std::ifstream file(filename.c_str(), std::ios::binary);
+            if (!file)
+            {
+                return;
+            }
+
+            ObjMaterial* material = nullptr;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                const char* begin = line.c_str();
+                const char* end = TrimEnd(begin, begin + line.size());
+                const char* keyword = SkipSpaces(begin, end);
+                const char* keywordEnd = SkipToken(keyword, end);
+                const char* cursor = SkipSpaces(keywordEnd, end);
+
+                if (TokenEquals(keyword, keywordEnd, "newmtl", true))
+                {
+                    std::string name(cursor, SkipToken(cursor, end));
+                    if (name.empty())
+                    {
+                        name = ObjFile::DefaultMaterialName;
+                    }
+
+                    std::map<std::string, UINT>::iterator existing = materialIndices.find(name);
+                    if (existing != materialIndices.end())
+                    {
+                        material = &materials[existing->second];
+                    }
+                    else
+                    {
+                        materialIndices[name] = static_cast<UINT>(materials.size());
+                        materials.push_back(ObjMaterial());
+                        material = &materials.back();
+                        material->Name = name;
+                    }
+
+                    continue;
+                }
+
+                if (material == nullptr)
+                {
+                    continue;
+                }
+
+                for (const ObjTextureKeyword& textureKeyword : TextureKeywords)
+                {
+                    if (TokenEquals(keyword, keywordEnd, textureKeyword.Name, true))
+                    {
+                        std::string textureFilename = TextureFilename(cursor, end);
+                        if (textureFilename.empty() == false)
+                        {
+                            material->Textures[textureKeyword.Type] = Utility::ToWideString(textureFilename);
+                        }
+
+                        break;
+                    }
+                }
+            }
+        }
+
+        void CanonicalizeStream(ObjStream& stream)
+        {
+            UINT count = static_cast<UINT>(stream.Values.size());
+            stream.Canonical.resize(count);
+
+            std::unordered_map<ObjValueKey, UINT, ObjValueKeyHash> firstIndices;
+            firstIndices.reserve(count);
+            for (UINT i = 0; i < count; i++)
+            {
+                ObjValueKey key = { stream.Values[i] };
+                stream.Canonical[i] = firstIndices.insert(std::make_pair(key, i)).first->second;
+            }
+        }
+
+        void CheckIndex(const ObjStream& stream, int index)
+        {
+            if (index != MissingIndex && (index < 0 || static_cast<UINT>(index) >= stream.Values.size()))
+            {
+                throw GameException("OBJ face index out of range.");
+            }
+        }
+
+        const XMFLOAT3& StreamValue(const ObjStream& stream, int index, const XMFLOAT3& missingValue)
+        {
+            return (index != MissingIndex ? stream.Values[index] : missingValue);
+        }
+
+        bool IsJoinable(const XMFLOAT3& lhs, const XMFLOAT3& rhs)
+        {
+            float x = lhs.x - rhs.x;
+            float y = lhs.y - rhs.y;
+            float z = lhs.z - rhs.z;
+
+            return (x * x + y * y + z * z <= JoinSquareEpsilon);
+        }
+
+        // The signed area is negated relative to the usual convention, as in assimp's PolyTools.
+        double Area2D(const XMFLOAT2& first, const XMFLOAT2& second, const XMFLOAT2& third)
+        {
+            return 0.5 * (first.x * (static_cast<double>(third.y) - second.y) + second.x * (static_cast<double>(first.y) - third.y) + third.x * (static_cast<double>(second.y) - first.y));
+        }
+
+        bool PointInTriangle2D(const XMFLOAT2& p0, const XMFLOAT2& p1, const XMFLOAT2& p2, const XMFLOAT2& point)
+        {
+            XMFLOAT2 v0(p1.x - p0.x, p1.y - p0.y);
+            XMFLOAT2 v1(p2.x - p0.x, p2.y - p0.y);
+            XMFLOAT2 v2(point.x - p0.x, point.y - p0.y);
+
+            double dot00 = v0.x * v0.x + v0.y * v0.y;
+            double dot01 = v0.x * v1.x + v0.y * v1.y;
+            double dot02 = v0.x * v2.x + v0.y * v2.y;
+            double dot11 = v1.x * v1.x + v1.y * v1.y;
+            double dot12 = v1.x * v2.x + v1.y * v2.y;
+
+            double inverseDenominator = 1.0 / (dot00 * dot11 - dot01 * dot01);
+            double u = (dot11 * dot02 - dot01 * dot12) * inverseDenominator;
+            double v = (dot00 * dot12 - dot01 * dot02) * inverseDenominator;
+
+            return (u > 0 && v > 0 && u + v < 1);
+        }
+
+        inline bool Equals(const XMFLOAT2& first, const XMFLOAT2& second)
+        {
+            return (first.x == second.x && first.y == second.y);
+        }
+
+        XMFLOAT3 Normalized(const XMFLOAT3& from, const XMFLOAT3& to)
+        {
+            XMFLOAT3 direction(to.x - from.x, to.y - from.y, to.z - from.z);
+            float length = sqrtf(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+
+            return XMFLOAT3(direction.x / length, direction.y / length, direction.z / length);
+        }
+
+        inline float Dot(const XMFLOAT3& first, const XMFLOAT3& second)
+        {
+            return first.x * second.x + first.y * second.y + first.z * second.z;
+        }
+
+        // Appends the triangles of one face, given its vertices in file order. The winding is
+        // flipped first, then quads are fanned from their concave corner (if any) and larger
+        // polygons ear-clipped in the plane of their Newell normal, all exactly as assimp's
+        // FlipWindingOrder and Triangulate steps do it.
+        void Triangulate(const UINT* face, UINT cornerCount, ArraySpan<const XMFLOAT3> positions, ObjTriangulationScratch& scratch, std::vector<UINT>& indices)
+        {
+            std::vector<UINT>& polygon = scratch.Polygon;
+            polygon.assign(face, face + cornerCount);
+            std::reverse(polygon.begin(), polygon.end());
+
+            if (cornerCount == 3)
+            {
+                indices.insert(indices.end(), polygon.begin(), polygon.end());
+                return;
+            }
+
+            if (cornerCount == 4)
+            {
+                UINT start = 0;
+                for (UINT i = 0; i < 4; i++)
+                {
+                    const XMFLOAT3& corner = positions[polygon[i]];
+                    XMFLOAT3 left = Normalized(corner, positions[polygon[(i + 3) % 4]]);
+                    XMFLOAT3 diagonal = Normalized(corner, positions[polygon[(i + 2) % 4]]);
+                    XMFLOAT3 right = Normalized(corner, positions[polygon[(i + 1) % 4]]);
+
+                    float angle = acosf(Dot(left, diagonal)) + acosf(Dot(right, diagonal));
+                    if (angle > Pi)
+                    {
+                        start = i;
+                        break;
+                    }
+                }
+
+                UINT triangles[] = { start, start + 1, start + 2, start, start + 2, start + 3 };
+                for (UINT corner : triangles)
+                {
+                    indices.push_back(polygon[corner % 4]);
+                }
+
+                return;
+            }
+
+            int max = static_cast<int>(cornerCount);
+
+            // Newell normal, with the first two points repeated at the end.
+            std::vector<XMFLOAT3>& points3D = scratch.Points3D;
+            points3D.resize(max + 2);
+            for (int i = 0; i < max; i++)
+            {
+                points3D[i] = positions[polygon[i]];
+            }
+
+            points3D[max] = points3D[0];
+            points3D[max + 1] = points3D[1];
+
+            float sumXY = 0.0f;
+            float sumYZ = 0.0f;
+            float sumZX = 0.0f;
+            for (int i = 0; i < max; i++)
+            {
+                const XMFLOAT3& low = points3D[i];
+                const XMFLOAT3& point = points3D[i + 1];
+                const XMFLOAT3& high = points3D[i + 2];
+                sumXY += point.x * (high.y - low.y);
+                sumYZ += point.y * (high.z - low.z);
+                sumZX += point.z * (high.x - low.x);
+            }
+
+            XMFLOAT3 normal(sumYZ, sumZX, sumXY);
+
+            // Drop the dominant normal axis, keeping the projection's orientation.
+            float ax = fabsf(normal.x);
+            float ay = fabsf(normal.y);
+            float az = fabsf(normal.z);
+
+            UINT ac = 0;
+            UINT bc = 1;
+            float inverse = normal.z;
+            if (ax > ay)
+            {
+                if (ax > az)
+                {
+                    ac = 1;
+                    bc = 2;
+                    inverse = normal.x;
+                }
+            }
+            else if (ay > az)
+            {
+                ac = 2;
+                bc = 0;
+                inverse = normal.y;
+            }
+
+            if (inverse < 0.0f)
+            {
+                std::swap(ac, bc);
+            }
+
+            std::vector<XMFLOAT2>& points = scratch.Points;
+            std::vector<bool>& done = scratch.Done;
+            points.resize(max);
+            done.assign(max, false);
+            for (int i = 0; i < max; i++)
+            {
+                const float* point = &points3D[i].x;
+                points[i] = XMFLOAT2(point[ac], point[bc]);
+            }
+
+            std::vector<int>& triangles = scratch.Triangles;
+            triangles.clear();
+
+            int remaining = max;
+            int ear = 0;
+            int previous = max - 1;
+            int next = 0;
+            while (remaining > 3)
+            {
+                int wrapCount = 0;
+                for (ear = next; ; previous = ear, ear = next)
+                {
+                    for (next = ear + 1; done[(next >= max ? next = 0 : next)]; ++next);
+                    if (next < ear && ++wrapCount == 2)
+                    {
+                        break;
+                    }
+
+                    const XMFLOAT2& p0 = points[previous];
+                    const XMFLOAT2& p1 = points[ear];
+                    const XMFLOAT2& p2 = points[next];
+
+                    // Must be a convex corner...
+                    if (Area2D(p0, p1, p2) > 0)
+                    {
+                        continue;
+                    }
+
+                    // ...with no other point inside the ear.
+                    int i = 0;
+                    for (; i < max; i++)
+                    {
+                        const XMFLOAT2& point = points[i];
+                        if (Equals(point, p1) == false && Equals(point, p2) == false && Equals(point, p0) == false && PointInTriangle2D(p0, p1, p2, point))
+                        {
+                            break;
+                        }
+                    }
+
+                    if (i == max)
+                    {
+                        break;
+                    }
+                }
+
+                if (wrapCount == 2)
+                {
+                    // Not a simple polygon; assimp keeps what it has clipped so far.
+                    remaining = 0;
+                    break;
+                }
+
+                triangles.push_back(previous);
+                triangles.push_back(ear);
+                triangles.push_back(next);
+
+                done[ear] = true;
+                --remaining;
+            }
+
+            if (remaining > 0)
+            {
+                for (int i = 0; i < max; i++)
+                {
+                    if (done[i] == false)
+                    {
+                        triangles.push_back(i);
+                    }
+                }
+            }
+
+            for (UINT i = 0; i + 2 < triangles.size(); i += 3)
+            {
+                if (fabs(Area2D(points[triangles[i]], points[triangles[i + 1]], points[triangles[i + 2]])) < MinimumTriangleArea)
+                {
+                    continue;
+                }
+
+                indices.push_back(polygon[triangles[i]]);
+                indices.push_back(polygon[triangles[i + 1]]);
+                indices.push_back(polygon[triangles[i + 2]]);
+            }
+        }
+    }
+
+    bool ObjFile::IsObjFile(const std::string& filename)
+    {
+        if (filename.size() < Extension.size())
+        {
+            return false;
+        }
+
+        std::string extension = filename.substr(filename.size() - Extension.size());
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+        return (extension == Extension);
+    }
+
+    bool ObjFile::Read(Model& model, const std::string& filename, bool flipUVs, ThreadPool* threadPool)
+    {
+        MappedFile file(filename);
+        const char* data = reinterpret_cast<const char*>(file.Data());
+        UINT size = file.Size();
+
+        UINT maxChunkCount = (threadPool != nullptr ? (threadPool->ThreadCount() + 1) * ChunksPerThread : 1);
+        UINT chunkCount = std::max(1U, std::min(size / MinimumChunkSize, maxChunkCount));
+
+        std::vector<ObjChunk> chunks;
+        SplitChunks(data, size, chunkCount, chunks);
+        ForEach(threadPool, chunkCount, [&](UINT i)
+        {
+            CountChunk(chunks[i]);
+        });
+
+        ObjStream positions;
+        ObjStream textureCoordinates;
+        ObjStream normals;
+        UINT positionCount = 0;
+        UINT textureCoordinateCount = 0;
+        UINT normalCount = 0;
+        for (ObjChunk& chunk : chunks)
+        {
+            chunk.PositionBase = positionCount;
+            chunk.TextureCoordinateBase = textureCoordinateCount;
+            chunk.NormalBase = normalCount;
+            positionCount += chunk.PositionCount;
+            textureCoordinateCount += chunk.TextureCoordinateCount;
+            normalCount += chunk.NormalCount;
+        }
+
+        positions.Values.resize(positionCount);
+        textureCoordinates.Values.resize(textureCoordinateCount);
+        normals.Values.resize(normalCount);
+        ForEach(threadPool, chunkCount, [&](UINT i)
+        {
+            ParseChunk(chunks[i], positions.Values.data(), textureCoordinates.Values.data(), normals.Values.data(), flipUVs);
+        });
+
+        for (const ObjChunk& chunk : chunks)
+        {
+            if (chunk.Unsupported)
+            {
+                return false;
+            }
+        }
+
+        // Replay the grouping statements in file order. A mesh starts at each new group or
+        // object name and wherever the material changes after faces have been added.
+        std::string directory;
+        Utility::GetDirectory(filename, directory);
+        if (directory.empty() == false)
+        {
+            directory += '/';
+        }
+
+        std::vector<ObjMaterial> materials(1);
+        materials[0].Name = DefaultMaterialName;
+        std::map<std::string, UINT> materialIndices;
+        materialIndices[DefaultMaterialName] = 0;
+
+        std::vector<ObjMeshDraft> drafts;
+        std::set<std::string> objectNames;
+        std::string activeGroup;
+        UINT currentMaterial = 0;
+
+        auto startMesh = [&](const std::string& name)
+        {
+            ObjMeshDraft draft;
+            draft.Name = name;
+            draft.MaterialIndex = currentMaterial;
+            draft.CornerCount = 0;
+            draft.HasTextureCoordinates = false;
+            draft.HasNormals = false;
+            drafts.push_back(draft);
+        };
+
+        for (const ObjChunk& chunk : chunks)
+        {
+            std::vector<ObjCommand>::const_iterator command = chunk.Commands.begin();
+            for (UINT faceIndex = 0; faceIndex <= chunk.Faces.size(); faceIndex++)
+            {
+                for (; command != chunk.Commands.end() && command->FaceIndex == faceIndex; ++command)
+                {
+                    switch (command->Keyword)
+                    {
+                    case ObjKeywordGroup:
+                        if (command->Name != activeGroup)
+                        {
+                            activeGroup = command->Name;
+                            startMesh(command->Name);
+                        }
+                        break;
+
+                    case ObjKeywordObject:
+                        if (objectNames.insert(command->Name).second == false)
+                        {
+                            // assimp appends to the object's last mesh; leave that to it.
+                            return false;
+                        }
+
+                        startMesh(command->Name);
+                        break;
+
+                    case ObjKeywordUseMaterial:
+                    {
+                        std::map<std::string, UINT>::const_iterator material = materialIndices.find(command->Name);
+                        if (material == materialIndices.end())
+                        {
+                            currentMaterial = 0;
+                            break;
+                        }
+
+                        currentMaterial = material->second;
+                        if (drafts.size() > 0 && drafts.back().Faces.size() > 0)
+                        {
+                            startMesh(drafts.back().Name);
+                        }
+                        else if (drafts.size() > 0)
+                        {
+                            drafts.back().MaterialIndex = currentMaterial;
+                        }
+                        break;
+                    }
+
+                    case ObjKeywordMaterialLibrary:
+                        ReadMaterialLibrary(directory + command->Name, materials, materialIndices);
+                        break;
+
+                    default:
+                        break;
+                    }
+                }
+
+                if (faceIndex == chunk.Faces.size())
+                {
+                    break;
+                }
+
+                if (drafts.empty())
+                {
+                    startMesh("defaultobject");
+                }
+
+                const ObjFace& face = chunk.Faces[faceIndex];
+                ObjFaceReference reference = { &chunk.Corners[face.FirstCorner], face.CornerCount };
+
+                ObjMeshDraft& draft = drafts.back();
+                draft.Faces.push_back(reference);
+                draft.CornerCount += face.CornerCount;
+                for (UINT i = 0; i < face.CornerCount; i++)
+                {
+                    draft.HasTextureCoordinates |= (reference.Corners[i].TextureCoordinate != MissingIndex);
+                    draft.HasNormals |= (reference.Corners[i].Normal != MissingIndex);
+                }
+            }
+        }
+
+        // Each position is replaced by the first one equal to it, so vertices can be joined per
+        // position below.
+        XMFLOAT3 missingTextureCoordinate(0.0f, (flipUVs ? 1.0f : 0.0f), 0.0f);
+        XMFLOAT3 missingNormal(0.0f, 0.0f, 0.0f);
+        CanonicalizeStream(positions);
+
+        std::vector<std::unique_ptr<ModelMaterial>> modelMaterials;
+        for (const ObjMaterial& material : materials)
+        {
+            ModelMaterial* modelMaterial = new ModelMaterial(model);
+            modelMaterials.push_back(std::unique_ptr<ModelMaterial>(modelMaterial));
+            modelMaterial->mName = material.Name;
+
+            for (const std::pair<TextureType, std::wstring>& texture : material.Textures)
+            {
+                modelMaterial->mTextures[texture.first] = new std::vector<std::wstring>(1, texture.second);
+            }
+        }
+
+        std::vector<std::unique_ptr<Mesh>> meshes(drafts.size());
+        ForEach(threadPool, static_cast<UINT>(drafts.size()), [&](UINT meshIndex)
+        {
+            const ObjMeshDraft& draft = drafts[meshIndex];
+            if (draft.Faces.empty())
+            {
+                return;
+            }
+
+            Mesh* mesh = new Mesh(model, modelMaterials[draft.MaterialIndex].get());
+            meshes[meshIndex].reset(mesh);
+            mesh->mName = draft.Name;
+
+            // Joined as JoinIdenticalVertices joins them: a corner reuses the first vertex at an
+            // identical position whose normal and texture coordinate both lie within 1e-5 of its
+            // own, and otherwise becomes a new vertex. Vertices are numbered in order of first use.
+            std::unordered_map<UINT, std::pair<UINT, UINT>> positionVertices; // First and last vertex at each position.
+            positionVertices.reserve(draft.CornerCount);
+            std::vector<UINT> nextVertices; // The next vertex at the same position.
+            std::vector<UINT> cornerVertices;
+            cornerVertices.reserve(draft.CornerCount);
+            std::vector<const ObjCorner*> vertexCorners;
+            for (const ObjFaceReference& face : draft.Faces)
+            {
+                for (UINT i = 0; i < face.CornerCount; i++)
+                {
+                    const ObjCorner& corner = face.Corners[i];
+                    CheckIndex(positions, corner.Position);
+                    CheckIndex(textureCoordinates, corner.TextureCoordinate);
+                    CheckIndex(normals, corner.Normal);
+
+                    const XMFLOAT3& textureCoordinate = StreamValue(textureCoordinates, corner.TextureCoordinate, missingTextureCoordinate);
+                    const XMFLOAT3& normal = StreamValue(normals, corner.Normal, missingNormal);
+                    UINT newVertex = static_cast<UINT>(vertexCorners.size());
+
+                    std::pair<std::unordered_map<UINT, std::pair<UINT, UINT>>::iterator, bool> chain = positionVertices.insert(std::make_pair(positions.Canonical[corner.Position], std::make_pair(newVertex, newVertex)));
+                    UINT vertex = (chain.second ? NoVertex : chain.first->second.first);
+                    while (vertex != NoVertex)
+                    {
+                        const ObjCorner& candidate = *vertexCorners[vertex];
+                        if (IsJoinable(normal, StreamValue(normals, candidate.Normal, missingNormal)) &&
+                            IsJoinable(textureCoordinate, StreamValue(textureCoordinates, candidate.TextureCoordinate, missingTextureCoordinate)))
+                        {
+                            break;
+                        }
+
+                        vertex = nextVertices[vertex];
+                    }
+
+                    if (vertex == NoVertex)
+                    {
+                        vertex = newVertex;
+                        if (chain.second == false)
+                        {
+                            nextVertices[chain.first->second.second] = newVertex;
+                            chain.first->second.second = newVertex;
+                        }
+
+                        vertexCorners.push_back(&corner);
+                        nextVertices.push_back(NoVertex);
+                    }
+
+                    cornerVertices.push_back(vertex);
+                }
+            }
+
+            UINT vertexCount = static_cast<UINT>(vertexCorners.size());
+            MeshStreams& meshStreams = mesh->mStreams;
+            meshStreams.Allocate(vertexCount, draft.HasNormals, false, (draft.HasTextureCoordinates ? 1 : 0), 0);
+
+            ArraySpan<XMFLOAT3> meshPositions = meshStreams.Positions();
+            for (UINT i = 0; i < vertexCount; i++)
+            {
+                meshPositions[i] = positions.Values[vertexCorners[i]->Position];
+            }
+
+            if (draft.HasNormals)
+            {
+                ArraySpan<XMFLOAT3> meshNormals = meshStreams.Normals();
+                for (UINT i = 0; i < vertexCount; i++)
+                {
+                    int normal = vertexCorners[i]->Normal;
+                    meshNormals[i] = (normal != MissingIndex ? normals.Values[normal] : missingNormal);
+                }
+            }
+
+            if (draft.HasTextureCoordinates)
+            {
+                ArraySpan<XMFLOAT3> meshTextureCoordinates = meshStreams.TextureCoordinates(0);
+                for (UINT i = 0; i < vertexCount; i++)
+                {
+                    int textureCoordinate = vertexCorners[i]->TextureCoordinate;
+                    meshTextureCoordinates[i] = (textureCoordinate != MissingIndex ? textureCoordinates.Values[textureCoordinate] : missingTextureCoordinate);
+                }
+            }
+
+            ObjTriangulationScratch scratch;
+            mesh->mIndices.reserve((draft.CornerCount - 2 * draft.Faces.size()) * 3);
+
+            const UINT* faceVertices = cornerVertices.data();
+            for (const ObjFaceReference& face : draft.Faces)
+            {
+                Triangulate(faceVertices, face.CornerCount, meshPositions, scratch, mesh->mIndices);
+                faceVertices += face.CornerCount;
+            }
+
+            mesh->mFaceCount = static_cast<UINT>(mesh->mIndices.size() / 3);
+            MeshBounds::Compute(meshStreams.Positions(), mesh->mBounds);
+        });
+
+        for (std::unique_ptr<ModelMaterial>& material : modelMaterials)
+        {
+            model.mMaterials.push_back(material.release());
+        }
+
+        for (std::unique_ptr<Mesh>& mesh : meshes)
+        {
+            if (mesh != nullptr)
+            {
+                model.mMeshes.push_back(mesh.release());
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class Model;
+    class ThreadPool;
+
+    // Reads Wavefront OBJ files and their MTL libraries straight into a Model. The result matches
+    // what Model gets from assimp with its import flags: one material per MTL entry after a
+    // default one, polygons triangulated with the winding flipped, and identical vertices joined.
+    class ObjFile
+    {
+    public:
+        static const std::string Extension;
+        static const std::string DefaultMaterialName;
+
+        static bool IsObjFile(const std::string& filename);
+
+        // The file is mapped once and split at line boundaries into chunks parsed on threadPool,
+        // when one is given. Returns false, leaving the model untouched, for files that use
+        // something only the assimp importer handles: point or line elements, or an object
+        // reopened by name.
+        static bool Read(Model& model, const std::string& filename, bool flipUVs, ThreadPool* threadPool = nullptr);
+
+    private:
+        ObjFile();
+        ObjFile(const ObjFile& rhs);
+        ObjFile& operator=(const ObjFile& rhs);
+    };
+}
@@ -0,0 +1,604 @@
+#include "OcclusionCuller.h"
+#include "GameException.h"
+#include "Model.h"
+#include "Mesh.h"
+#include "MeshSimplifier.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <intrin.h>
+#include <immintrin.h>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(OcclusionCuller)
+
+    const UINT OcclusionCuller::TileWidth = 32;
+    const UINT OcclusionCuller::TileHeight = 8;
+
+    namespace
+    {
+        // Vertices this close to the eye or behind it would project to infinity. Occluder triangles
+        // that have one are dropped, which only ever hides less.
+        const float MinimumW = 1e-4f;
+
+        // An occluder whose surface lies on its own bounds, like the top of a box, must not hide
+        // itself through rounding in the interpolated depth.
+        const float DepthTolerance = 1.0f + 1e-4f;
+
+        bool IsAvxSupported()
+        {
+            int info[4];
+            __cpuid(info, 1);
+
+            const int osxsave = 1 << 27;
+            const int avx = 1 << 28;
+            if ((info[2] & osxsave) == 0 || (info[2] & avx) == 0)
+            {
+                return false;
+            }
+
+            return ((_xgetbv(0) & 0x6) == 0x6);
+        }
+
+        // Clamped while still a float, as vertices close to the eye can project far off screen.
+        // First pixels clamp to [0, size] and last ones to [-1, size - 1], so a range that misses
+        // the screen stays empty.
+        int FirstPixel(float pixel, UINT size)
+        {
+            return static_cast<int>(std::min(std::max(pixel, 0.0f), static_cast<float>(size)));
+        }
+
+        int LastPixel(float pixel, UINT size)
+        {
+            return static_cast<int>(std::min(std::max(pixel, -1.0f), static_cast<float>(size) - 1.0f));
+        }
+
+        struct PositionLess
+        {
+            bool operator()(const XMFLOAT3& lhs, const XMFLOAT3& rhs) const
+            {
+                if (lhs.x != rhs.x)
+                {
+                    return (lhs.x < rhs.x);
+                }
+
+                return (lhs.y != rhs.y ? lhs.y < rhs.y : lhs.z < rhs.z);
+            }
+        };
+
+        // Closed, with every position on or to one side of each triangle's plane. Only then does any
+        // surface spanned by the mesh's own vertices stay inside it. Vertices split on seams count
+        // as one.
+        bool IsConvexSolid(ArraySpan<const XMFLOAT3> vertices, const std::vector<UINT>& indices)
+        {
+            if (indices.empty() || (indices.size() % 3) != 0)
+            {
+                return false;
+            }
+
+            std::map<XMFLOAT3, UINT, PositionLess> positionIds;
+            std::vector<UINT> welded(vertices.size());
+            std::vector<XMFLOAT3> positions;
+            XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+            XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+            for (UINT i = 0; i < vertices.size(); i++)
+            {
+                std::pair<std::map<XMFLOAT3, UINT, PositionLess>::iterator, bool> position = positionIds.insert(std::make_pair(vertices[i], static_cast<UINT>(positions.size())));
+                if (position.second)
+                {
+                    positions.push_back(vertices[i]);
+                    XMVECTOR point = XMLoadFloat3(&vertices[i]);
+                    minimum = XMVectorMin(minimum, point);
+                    maximum = XMVectorMax(maximum, point);
+                }
+
+                welded[i] = position.first->second;
+            }
+
+            // Closed when every edge is shared by exactly two triangles
+            std::map<std::pair<UINT, UINT>, UINT> edgeUses;
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                for (UINT k = 0; k < 3; k++)
+                {
+                    UINT first = welded[indices[i + k]];
+                    UINT second = welded[indices[i + (k + 1) % 3]];
+                    edgeUses[std::make_pair(std::min(first, second), std::max(first, second))]++;
+                }
+            }
+
+            for (const std::pair<std::pair<UINT, UINT>, UINT>& edge : edgeUses)
+            {
+                if (edge.second != 2)
+                {
+                    return false;
+                }
+            }
+
+            float tolerance = XMVectorGetX(XMVector3Length(XMVectorSubtract(maximum, minimum))) * 1e-4f;
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                XMVECTOR first = XMLoadFloat3(&vertices[indices[i]]);
+                XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&vertices[indices[i + 1]]), first), XMVectorSubtract(XMLoadFloat3(&vertices[indices[i + 2]]), first));
+                float length = XMVectorGetX(XMVector3Length(normal));
+                if (length == 0.0f)
+                {
+                    continue;
+                }
+
+                normal = XMVectorScale(normal, 1.0f / length);
+                float offset = XMVectorGetX(XMVector3Dot(normal, first));
+                bool inFront = false;
+                bool behind = false;
+                for (const XMFLOAT3& position : positions)
+                {
+                    float distance = XMVectorGetX(XMVector3Dot(normal, XMLoadFloat3(&position))) - offset;
+                    inFront |= (distance > tolerance);
+                    behind |= (distance < -tolerance);
+                    if (inFront && behind)
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+    }
+
+    OcclusionCuller::OcclusionCuller(ThreadPool& threadPool, UINT width, UINT height)
+        : mThreadPool(&threadPool), mWidth(0), mHeight(0), mTilesX((width + TileWidth - 1) / TileWidth), mTilesY((height + TileHeight - 1) / TileHeight),
+          mDepth(), mTileDepth(), mOccluders(), mClipVertices(), mTriangles(), mTileRows(), mViewProjection(), mAvxSupported(IsAvxSupported()), mStatistics()
+    {
+        if (mTilesX == 0 || mTilesY == 0)
+        {
+            throw GameException("The occlusion buffer needs at least one tile.");
+        }
+
+        mWidth = mTilesX * TileWidth;
+        mHeight = mTilesY * TileHeight;
+        mDepth.resize(mWidth * mHeight, 0.0f);
+        mTileDepth.resize(mTilesX * mTilesY, 0.0f);
+        mTileRows.resize(mTilesY);
+
+        ZeroMemory(&mStatistics, sizeof(mStatistics));
+        mStatistics.BatchWidth = (mAvxSupported ? 8 : 4);
+    }
+
+    void OcclusionCuller::BuildOccluder(const Model& model, UINT maxTriangles, OccluderMesh& occluder)
+    {
+        occluder.Vertices.clear();
+        occluder.Indices.clear();
+
+        std::vector<UINT> indices;
+        std::vector<UINT> simplified;
+        for (Mesh* mesh : model.Meshes())
+        {
+            ArraySpan<const XMFLOAT3> vertices = mesh->Vertices();
+            const std::vector<UINT>& meshIndices = mesh->Indices();
+            const std::vector<MeshLod>& lods = mesh->Lods();
+
+            // Coarser levels and simplification only ever move the surface inwards on a convex
+            // solid. Anything else is used at full detail, since a reduced copy could hide what
+            // the real surface leaves visible.
+            bool convex = IsConvexSolid(vertices, meshIndices);
+            if (lods.empty() || convex == false)
+            {
+                indices = meshIndices;
+            }
+            else
+            {
+                // Level ranges index Indices() followed by LodIndices()
+                const MeshLod& level = lods.back();
+                const std::vector<UINT>& lodIndices = mesh->LodIndices();
+                indices.resize(level.IndexCount);
+                for (UINT i = 0; i < level.IndexCount; i++)
+                {
+                    UINT index = level.IndexOffset + i;
+                    indices[i] = (index < meshIndices.size() ? meshIndices[index] : lodIndices[index - meshIndices.size()]);
+                }
+            }
+
+            if (convex && indices.size() > maxTriangles * 3)
+            {
+                MeshSimplifier::Simplify(indices, vertices, maxTriangles * 3, FLT_MAX, simplified);
+                indices.swap(simplified);
+            }
+
+            UINT baseVertex = static_cast<UINT>(occluder.Vertices.size());
+            occluder.Vertices.insert(occluder.Vertices.end(), vertices.begin(), vertices.end());
+            for (UINT index : indices)
+            {
+                occluder.Indices.push_back(baseVertex + index);
+            }
+        }
+    }
+
+    void OcclusionCuller::AddOccluder(const OccluderMesh& occluder, CXMMATRIX worldMatrix)
+    {
+        if (occluder.Indices.empty())
+        {
+            return;
+        }
+
+        Occluder entry;
+        entry.Mesh = &occluder;
+        XMStoreFloat4x4(&entry.WorldMatrix, worldMatrix);
+        mOccluders.push_back(entry);
+    }
+
+    void OcclusionCuller::Rasterize(FXMMATRIX viewProjection)
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+        XMStoreFloat4x4(&mViewProjection, viewProjection);
+        SetupTriangles(viewProjection);
+
+        // Each task clears, fills and summarizes its own row of tiles
+        mThreadPool->ParallelFor(mTilesY, [this](UINT row)
+        {
+            RasterizeTileRow(row);
+        });
+
+        mStatistics.Occluders = static_cast<UINT>(mOccluders.size());
+        mStatistics.Triangles = static_cast<UINT>(mTriangles.size());
+        mStatistics.Tested = 0;
+        mStatistics.Occluded = 0;
+        mStatistics.TestMilliseconds = 0.0;
+        mOccluders.clear();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        mStatistics.RasterizeMilliseconds = elapsed.count();
+    }
+
+    bool OcclusionCuller::IsVisible(const BoundingBox& worldBounds)
+    {
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        mStatistics.Tested++;
+
+        // The box's screen rectangle, and the 1/w of its nearest corner
+        XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+        worldBounds.GetCorners(corners);
+
+        XMMATRIX viewProjection = XMLoadFloat4x4(&mViewProjection);
+        float minX = FLT_MAX;
+        float maxX = -FLT_MAX;
+        float minY = FLT_MAX;
+        float maxY = -FLT_MAX;
+        float nearest = 0.0f;
+        bool visible = false;
+        for (UINT i = 0; i < BoundingBox::CORNER_COUNT; i++)
+        {
+            XMFLOAT4 clip;
+            XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corners[i]), viewProjection));
+            if (clip.w < MinimumW)
+            {
+                visible = true;
+                break;
+            }
+
+            float inverseW = 1.0f / clip.w;
+            float x = (clip.x * inverseW * 0.5f + 0.5f) * mWidth;
+            float y = (0.5f - clip.y * inverseW * 0.5f) * mHeight;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::max(nearest, inverseW);
+        }
+
+        if (visible == false)
+        {
+            visible = IsRectangleVisible(minX, maxX, minY, maxY, nearest * DepthTolerance);
+        }
+
+        if (visible == false)
+        {
+            mStatistics.Occluded++;
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        mStatistics.TestMilliseconds += elapsed.count();
+
+        return visible;
+    }
+
+    bool OcclusionCuller::IsRectangleVisible(float minX, float maxX, float minY, float maxY, float nearest) const
+    {
+        // Every pixel the rectangle touches
+        int pixelMinX = FirstPixel(floorf(minX), mWidth);
+        int pixelMaxX = LastPixel(floorf(maxX), mWidth);
+        int pixelMinY = FirstPixel(floorf(minY), mHeight);
+        int pixelMaxY = LastPixel(floorf(maxY), mHeight);
+        if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY)
+        {
+            return true;
+        }
+
+        for (int tileY = pixelMinY / static_cast<int>(TileHeight); tileY <= pixelMaxY / static_cast<int>(TileHeight); tileY++)
+        {
+            for (int tileX = pixelMinX / static_cast<int>(TileWidth); tileX <= pixelMaxX / static_cast<int>(TileWidth); tileX++)
+            {
+                // Behind even the farthest pixel of the tile
+                if (nearest < mTileDepth[tileY * mTilesX + tileX])
+                {
+                    continue;
+                }
+
+                int firstX = std::max(pixelMinX, tileX * static_cast<int>(TileWidth));
+                int lastX = std::min(pixelMaxX, (tileX + 1) * static_cast<int>(TileWidth) - 1);
+                int firstY = std::max(pixelMinY, tileY * static_cast<int>(TileHeight));
+                int lastY = std::min(pixelMaxY, (tileY + 1) * static_cast<int>(TileHeight) - 1);
+                for (int y = firstY; y <= lastY; y++)
+                {
+                    const float* row = &mDepth[y * mWidth];
+                    for (int x = firstX; x <= lastX; x++)
+                    {
+                        if (nearest >= row[x])
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+
+    UINT OcclusionCuller::Width() const
+    {
+        return mWidth;
+    }
+
+    UINT OcclusionCuller::Height() const
+    {
+        return mHeight;
+    }
+
+    const std::vector<float>& OcclusionCuller::Depth() const
+    {
+        return mDepth;
+    }
+
+    void OcclusionCuller::WriteDepthImage(const std::string& filename, float whiteDistance) const
+    {
+        std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if (file.bad() || file.is_open() == false)
+        {
+            throw GameException("Could not open the occlusion depth image for writing.");
+        }
+
+        std::vector<unsigned char> pixels(mDepth.size());
+        for (size_t i = 0; i < mDepth.size(); i++)
+        {
+            float value = std::min(std::max(mDepth[i] * whiteDistance, 0.0f), 1.0f);
+            pixels[i] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+        }
+
+        file << "P5\n" << mWidth << " " << mHeight << "\n255\n";
+        file.write(reinterpret_cast<const char*>(&pixels[0]), pixels.size());
+        if (file.fail())
+        {
+            throw GameException("Could not write the occlusion depth image.");
+        }
+    }
+
+    const OcclusionCullerStatistics& OcclusionCuller::Statistics() const
+    {
+        return mStatistics;
+    }
+
+    void OcclusionCuller::SetupTriangles(FXMMATRIX viewProjection)
+    {
+        mTriangles.clear();
+        for (std::vector<UINT>& row : mTileRows)
+        {
+            row.clear();
+        }
+
+        for (const Occluder& occluder : mOccluders)
+        {
+            const OccluderMesh& mesh = *occluder.Mesh;
+            XMMATRIX transform = XMLoadFloat4x4(&occluder.WorldMatrix) * viewProjection;
+
+            // To screen space in place: x and y in pixels, z unused, w holding 1/w
+            mClipVertices.resize(mesh.Vertices.size());
+            for (size_t i = 0; i < mesh.Vertices.size(); i++)
+            {
+                XMFLOAT4 clip;
+                XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&mesh.Vertices[i]), transform));
+                if (clip.w < MinimumW)
+                {
+                    mClipVertices[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, -1.0f);
+                    continue;
+                }
+
+                float inverseW = 1.0f / clip.w;
+                mClipVertices[i] = XMFLOAT4((clip.x * inverseW * 0.5f + 0.5f) * mWidth, (0.5f - clip.y * inverseW * 0.5f) * mHeight, 0.0f, inverseW);
+            }
+
+            for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+            {
+                const XMFLOAT4* vertices[3] = { &mClipVertices[mesh.Indices[i]], &mClipVertices[mesh.Indices[i + 1]], &mClipVertices[mesh.Indices[i + 2]] };
+                if (vertices[0]->w < 0.0f || vertices[1]->w < 0.0f || vertices[2]->w < 0.0f)
+                {
+                    continue;
+                }
+
+                // Pixels whose centers fall inside the triangle's bounds
+                float minX = std::min(std::min(vertices[0]->x, vertices[1]->x), vertices[2]->x);
+                float maxX = std::max(std::max(vertices[0]->x, vertices[1]->x), vertices[2]->x);
+                float minY = std::min(std::min(vertices[0]->y, vertices[1]->y), vertices[2]->y);
+                float maxY = std::max(std::max(vertices[0]->y, vertices[1]->y), vertices[2]->y);
+
+                Triangle triangle;
+                triangle.MinX = FirstPixel(ceilf(minX - 0.5f), mWidth);
+                triangle.MaxX = LastPixel(floorf(maxX - 0.5f), mWidth);
+                triangle.MinY = FirstPixel(ceilf(minY - 0.5f), mHeight);
+                triangle.MaxY = LastPixel(floorf(maxY - 0.5f), mHeight);
+                if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+                {
+                    continue;
+                }
+
+                // Edge i runs between the two vertices other than i, and is zero on that side
+                for (UINT edge = 0; edge < 3; edge++)
+                {
+                    const XMFLOAT4& from = *vertices[(edge + 1) % 3];
+                    const XMFLOAT4& to = *vertices[(edge + 2) % 3];
+                    triangle.EdgeA[edge] = from.y - to.y;
+                    triangle.EdgeB[edge] = to.x - from.x;
+                    triangle.EdgeC[edge] = from.x * to.y - from.y * to.x;
+                }
+
+                float area = triangle.EdgeA[0] * vertices[0]->x + triangle.EdgeB[0] * vertices[0]->y + triangle.EdgeC[0];
+                if (area == 0.0f)
+                {
+                    continue;
+                }
+
+                // Either winding; occluders are solid from both sides
+                if (area < 0.0f)
+                {
+                    area = -area;
+                    for (UINT edge = 0; edge < 3; edge++)
+                    {
+                        triangle.EdgeA[edge] = -triangle.EdgeA[edge];
+                        triangle.EdgeB[edge] = -triangle.EdgeB[edge];
+                        triangle.EdgeC[edge] = -triangle.EdgeC[edge];
+                    }
+                }
+
+                // Each edge function over the area is the barycentric weight of the opposite vertex
+                triangle.DepthA = (triangle.EdgeA[0] * vertices[0]->w + triangle.EdgeA[1] * vertices[1]->w + triangle.EdgeA[2] * vertices[2]->w) / area;
+                triangle.DepthB = (triangle.EdgeB[0] * vertices[0]->w + triangle.EdgeB[1] * vertices[1]->w + triangle.EdgeB[2] * vertices[2]->w) / area;
+                triangle.DepthC = (triangle.EdgeC[0] * vertices[0]->w + triangle.EdgeC[1] * vertices[1]->w + triangle.EdgeC[2] * vertices[2]->w) / area;
+
+                UINT index = static_cast<UINT>(mTriangles.size());
+                mTriangles.push_back(triangle);
+                for (int row = triangle.MinY / static_cast<int>(TileHeight); row <= triangle.MaxY / static_cast<int>(TileHeight); row++)
+                {
+                    mTileRows[row].push_back(index);
+                }
+            }
+        }
+    }
+
+    void OcclusionCuller::RasterizeTileRow(UINT row)
+    {
+        int minY = static_cast<int>(row * TileHeight);
+        int maxY = minY + static_cast<int>(TileHeight) - 1;
+        std::fill(mDepth.begin() + minY * mWidth, mDepth.begin() + (maxY + 1) * mWidth, 0.0f);
+
+        for (UINT index : mTileRows[row])
+        {
+            const Triangle& triangle = mTriangles[index];
+            if (mAvxSupported)
+            {
+                RasterizeAvx(triangle, std::max(triangle.MinY, minY), std::min(triangle.MaxY, maxY));
+            }
+            else
+            {
+                RasterizeSse(triangle, std::max(triangle.MinY, minY), std::min(triangle.MaxY, maxY));
+            }
+        }
+
+        if (mAvxSupported)
+        {
+            _mm256_zeroupper();
+        }
+
+        // The farthest pixel of each tile
+        for (UINT tileX = 0; tileX < mTilesX; tileX++)
+        {
+            __m128 farthest = _mm_set1_ps(FLT_MAX);
+            for (int y = minY; y <= maxY; y++)
+            {
+                const float* pixels = &mDepth[y * mWidth + tileX * TileWidth];
+                for (UINT x = 0; x < TileWidth; x += 4)
+                {
+                    farthest = _mm_min_ps(farthest, _mm_loadu_ps(pixels + x));
+                }
+            }
+
+            farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+            farthest = _mm_min_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+            mTileDepth[row * mTilesX + tileX] = _mm_cvtss_f32(farthest);
+        }
+    }
+
+    void OcclusionCuller::RasterizeSse(const Triangle& triangle, int minY, int maxY)
+    {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 edgeA0 = _mm_set1_ps(triangle.EdgeA[0]);
+        const __m128 edgeA1 = _mm_set1_ps(triangle.EdgeA[1]);
+        const __m128 edgeA2 = _mm_set1_ps(triangle.EdgeA[2]);
+        const __m128 depthA = _mm_set1_ps(triangle.DepthA);
+
+        // Batches start on a multiple of four; the width is whole tiles, so none runs past a row
+        int firstX = triangle.MinX & ~3;
+        for (int y = minY; y <= maxY; y++)
+        {
+            float centerY = y + 0.5f;
+            __m128 row0 = _mm_set1_ps(triangle.EdgeB[0] * centerY + triangle.EdgeC[0]);
+            __m128 row1 = _mm_set1_ps(triangle.EdgeB[1] * centerY + triangle.EdgeC[1]);
+            __m128 row2 = _mm_set1_ps(triangle.EdgeB[2] * centerY + triangle.EdgeC[2]);
+            __m128 rowDepth = _mm_set1_ps(triangle.DepthB * centerY + triangle.DepthC);
+
+            float* pixels = &mDepth[y * mWidth];
+            for (int x = firstX; x <= triangle.MaxX; x += 4)
+            {
+                __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+                __m128 inside = _mm_and_ps(_mm_and_ps(
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, centerX), row0), zero),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, centerX), row1), zero)),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, centerX), row2), zero));
+
+                // Keep the nearer of the stored and the new depth where the pixel is covered
+                __m128 current = _mm_loadu_ps(pixels + x);
+                __m128 depth = _mm_max_ps(current, _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth));
+                _mm_storeu_ps(pixels + x, _mm_or_ps(_mm_and_ps(inside, depth), _mm_andnot_ps(inside, current)));
+            }
+        }
+    }
+
+    void OcclusionCuller::RasterizeAvx(const Triangle& triangle, int minY, int maxY)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 edgeA0 = _mm256_set1_ps(triangle.EdgeA[0]);
+        const __m256 edgeA1 = _mm256_set1_ps(triangle.EdgeA[1]);
+        const __m256 edgeA2 = _mm256_set1_ps(triangle.EdgeA[2]);
+        const __m256 depthA = _mm256_set1_ps(triangle.DepthA);
+
+        int firstX = triangle.MinX & ~7;
+        for (int y = minY; y <= maxY; y++)
+        {
+            float centerY = y + 0.5f;
+            __m256 row0 = _mm256_set1_ps(triangle.EdgeB[0] * centerY + triangle.EdgeC[0]);
+            __m256 row1 = _mm256_set1_ps(triangle.EdgeB[1] * centerY + triangle.EdgeC[1]);
+            __m256 row2 = _mm256_set1_ps(triangle.EdgeB[2] * centerY + triangle.EdgeC[2]);
+            __m256 rowDepth = _mm256_set1_ps(triangle.DepthB * centerY + triangle.DepthC);
+
+            float* pixels = &mDepth[y * mWidth];
+            for (int x = firstX; x <= triangle.MaxX; x += 8)
+            {
+                __m256 centerX = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), offsets);
+                __m256 inside = _mm256_and_ps(_mm256_and_ps(
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA0, centerX), row0), zero, _CMP_GE_OQ),
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA1, centerX), row1), zero, _CMP_GE_OQ)),
+                    _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA2, centerX), row2), zero, _CMP_GE_OQ));
+
+                __m256 current = _mm256_loadu_ps(pixels + x);
+                __m256 depth = _mm256_max_ps(current, _mm256_add_ps(_mm256_mul_ps(depthA, centerX), rowDepth));
+                _mm256_storeu_ps(pixels + x, _mm256_blendv_ps(current, depth, inside));
+            }
+        }
+    }
+}
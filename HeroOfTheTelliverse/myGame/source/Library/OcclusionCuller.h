@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Common.h"
+#include <DirectXCollision.h>
+
+namespace Library
+{
+    class Model;
+    class ThreadPool;
+
+    // A copy of a model's surface, in object space, for the occlusion buffer. It must never
+    // extend past the real surface.
+    struct OccluderMesh
+    {
+        std::vector<XMFLOAT3> Vertices;
+        std::vector<UINT> Indices;
+    };
+
+    struct OcclusionCullerStatistics
+    {
+        UINT Occluders;
+        UINT Triangles; // Occluder triangles that reached the depth buffer.
+        UINT Tested;
+        UINT Occluded;
+        UINT BatchWidth; // Pixels per rasterizer step: 8 with AVX, 4 otherwise.
+        double RasterizeMilliseconds;
+        double TestMilliseconds;
+    };
+
+    // Renders the frame's occluders into a small depth buffer on the CPU, then rejects objects
+    // whose bounds lie entirely behind them before they are submitted. The buffer holds 1/w, so
+    // larger is nearer and values interpolate linearly across the screen. Each tile also keeps its
+    // farthest value, which settles most tests without looking at single pixels. Each row of tiles is
+    // a separate task on the thread pool, so no two threads ever write the same pixel.
+    class OcclusionCuller : public RTTI
+    {
+        RTTI_DECLARATIONS(OcclusionCuller, RTTI)
+
+    public:
+        static const UINT TileWidth;
+        static const UINT TileHeight;
+
+        // The size is rounded up to whole tiles.
+        OcclusionCuller(ThreadPool& threadPool, UINT width = 256, UINT height = 144);
+
+        // Occluders must lie inside the geometry they stand for; one that sticks out hides objects
+        // that are really visible. Meshes that are closed and convex are reduced to their coarsest
+        // detail level, then simplified down to maxTriangles, which only pulls their surface inwards.
+        // Every other mesh is used at full detail. Reads the model's CPU data, so call it before
+        // the model cache trims it.
+        static void BuildOccluder(const Model& model, UINT maxTriangles, OccluderMesh& occluder);
+
+        // Queues an occluder for the next Rasterize(). The mesh has to live until then.
+        void AddOccluder(const OccluderMesh& occluder, CXMMATRIX worldMatrix);
+
+        // Clears the buffer and draws every queued occluder into it.
+        void Rasterize(FXMMATRIX viewProjection);
+
+        // False when the box is hidden behind the occluders of the last Rasterize(). Boxes that
+        // reach the near plane or leave the screen are always visible.
+        bool IsVisible(const BoundingBox& worldBounds);
+
+        UINT Width() const;
+        UINT Height() const;
+        const std::vector<float>& Depth() const;
+
+        // An 8-bit binary PGM of the buffer, for comparing runs by eye or by diff. Pixels are
+        // whiteDistance / w clamped to [0, 1]; the scale is fixed, so images compare depth for depth.
+        void WriteDepthImage(const std::string& filename, float whiteDistance) const;
+
+        const OcclusionCullerStatistics& Statistics() const;
+
+    private:
+        struct Occluder
+        {
+            const OccluderMesh* Mesh;
+            XMFLOAT4X4 WorldMatrix;
+        };
+
+        // Edge functions and the 1/w plane, all as a*x + b*y + c over pixel coordinates.
+        struct Triangle
+        {
+            float EdgeA[3];
+            float EdgeB[3];
+            float EdgeC[3];
+            float DepthA;
+            float DepthB;
+            float DepthC;
+            int MinX;
+            int MaxX;
+            int MinY;
+            int MaxY;
+        };
+
+        OcclusionCuller(const OcclusionCuller& rhs);
+        OcclusionCuller& operator=(const OcclusionCuller& rhs);
+
+        bool IsRectangleVisible(float minX, float maxX, float minY, float maxY, float nearest) const;
+        void SetupTriangles(FXMMATRIX viewProjection);
+        void RasterizeTileRow(UINT row);
+        void RasterizeSse(const Triangle& triangle, int minY, int maxY);
+        void RasterizeAvx(const Triangle& triangle, int minY, int maxY);
+
+        ThreadPool* mThreadPool;
+        UINT mWidth;
+        UINT mHeight;
+        UINT mTilesX;
+        UINT mTilesY;
+        std::vector<float> mDepth;
+        std::vector<float> mTileDepth; // Farthest 1/w in each tile.
+        std::vector<Occluder> mOccluders;
+        std::vector<XMFLOAT4> mClipVertices;
+        std::vector<Triangle> mTriangles;
+        std::vector<std::vector<UINT>> mTileRows; // Triangles touching each row of tiles.
+        XMFLOAT4X4 mViewProjection;
+        bool mAvxSupported;
+        OcclusionCullerStatistics mStatistics;
+    };
+}
@@ -7,8 +7,10 @@
 #include "VectorHelper.h"
 #include "Model.h"
 #include "Mesh.h"
+#include "ModelCache.h"
 #include "Utility.h"
 #include "RasterizerStates.h"
+#include "VertexCompression.h"
 
 namespace Library
 {
@@ -17,8 +19,8 @@ namespace Library
 	ProxyModel::ProxyModel(Game& game, Camera& camera, const std::string& modelFileName, float scale)
 		: DrawableGameComponent(game, camera),
 		  mModelFileName(modelFileName), mEffect(nullptr), mMaterial(nullptr),
-		  mVertexBuffer(nullptr), mIndexBuffer(nullptr), mIndexCount(0),
-		  mWorldMatrix(MatrixHelper::Identity), mScaleMatrix(MatrixHelper::Identity), mDisplayWireframe(false),
+		  mVertexBuffer(nullptr), mIndexBuffer(nullptr), mIndexCount(0), mIndexFormat(DXGI_FORMAT_R32_UINT),
+		  mWorldMatrix(MatrixHelper::Identity), mScaleMatrix(MatrixHelper::Identity), mDequantizationMatrix(MatrixHelper::Identity), mDisplayWireframe(false),
 		  mPosition(Vector3Helper::Zero), mDirection(Vector3Helper::Forward), mUp(Vector3Helper::Up), mRight(Vector3Helper::Right)
 	{
 		XMStoreFloat4x4(&mScaleMatrix, XMMatrixScaling(scale, scale, scale));
@@ -122,7 +124,10 @@ namespace Library
 	{
 		SetCurrentDirectory(Utility::ExecutableDirectory().c_str());
 
-		std::unique_ptr<Model> model(new Model(*mGame, mModelFileName, true));
+		ModelCache* modelCache = (ModelCache*)mGame->Services().GetService(ModelCache::TypeIdClass());
+		assert(modelCache != nullptr);
+
+		std::shared_ptr<Model> model = modelCache->GetModel(mModelFileName, true);
 
 		mEffect = new Effect(*mGame);
 		//mEffect->LoadCompiledEffect(L"Content\\Effects\\BasicEffect.cso");
@@ -130,13 +135,15 @@ namespace Library
 
 
 
-		mMaterial = new BasicMaterial();
+		mMaterial = new BasicMaterial(true);
 		mMaterial->Initialize(mEffect);
 
 		Mesh* mesh = model->Meshes().at(0);
-		mMaterial->CreateVertexBuffer(mGame->Direct3DDevice(), *mesh, &mVertexBuffer);
-		mesh->CreateIndexBuffer(&mIndexBuffer);
+		mVertexBuffer = modelCache->GetVertexBuffer(*mesh, *mMaterial);
+		mIndexBuffer = modelCache->GetIndexBuffer(*mesh);
 		mIndexCount = mesh->Indices().size();
+		mIndexFormat = mesh->IndexFormat();
+		XMStoreFloat4x4(&mDequantizationMatrix, VertexCompression::DequantizationMatrix(VertexCompression::ComputeQuantization(*mesh)));
 	}
 
 	void ProxyModel::Update(const GameTime& gameTime)
@@ -162,9 +169,9 @@ namespace Library
 		UINT stride = mMaterial->VertexSize();
 		UINT offset = 0;
 		direct3DDeviceContext->IASetVertexBuffers(0, 1, &mVertexBuffer, &stride, &offset);
-		direct3DDeviceContext->IASetIndexBuffer(mIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+		direct3DDeviceContext->IASetIndexBuffer(mIndexBuffer, mIndexFormat, 0);
 
-		XMMATRIX wvp = XMLoadFloat4x4(&mWorldMatrix) * mCamera->ViewMatrix() * mCamera->ProjectionMatrix();		
+		XMMATRIX wvp = XMLoadFloat4x4(&mDequantizationMatrix) * XMLoadFloat4x4(&mWorldMatrix) * mCamera->ViewMatrix() * mCamera->ProjectionMatrix();		
 		mMaterial->WorldViewProjection() << wvp;
 		
 		pass->Apply(0, direct3DDeviceContext);
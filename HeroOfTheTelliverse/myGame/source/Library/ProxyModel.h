@@ -50,9 +50,11 @@ namespace Library
 		ID3D11Buffer* mVertexBuffer;
 		ID3D11Buffer* mIndexBuffer;
 		UINT mIndexCount;
+		DXGI_FORMAT mIndexFormat;
         
 		XMFLOAT4X4 mWorldMatrix;
 		XMFLOAT4X4 mScaleMatrix;
+		XMFLOAT4X4 mDequantizationMatrix;
 
 		bool mDisplayWireframe;
 		XMFLOAT3 mPosition;
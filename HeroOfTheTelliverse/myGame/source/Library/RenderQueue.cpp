@@ -0,0 +1,268 @@
+#include "RenderQueue.h"
+#include "Game.h"
+#include "GameException.h"
+#include "ModelBuffer.h"
+#include <climits>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(RenderQueue)
+
+    namespace
+    {
+        const UINT PassBits = 8;
+        const UINT BufferBits = 16;
+        const UINT TextureBits = 16;
+        const UINT DepthBits = 24;
+        const UINT RadixBits = 8;
+        const UINT RadixSize = 1 << RadixBits;
+    }
+
+    RenderQueue::RenderQueue(Game& game)
+        : mGame(game), mPasses(), mPackets(), mConstants(), mKeys(), mScratch(), mBufferIds(), mTextureIds(), mStatistics()
+    {
+        ZeroMemory(&mStatistics, sizeof(mStatistics));
+    }
+
+    RenderQueue::~RenderQueue()
+    {
+        for (std::pair<const std::string, RenderPass*>& pass : mPasses)
+        {
+            ReleaseObject(pass.second->ObjectConstants);
+            ReleaseObject(pass.second->InputLayout);
+            ReleaseObject(pass.second->Effect);
+            delete pass.second;
+        }
+    }
+
+    const RenderPass* RenderQueue::FindPass(const std::string& name) const
+    {
+        std::map<std::string, RenderPass*>::const_iterator it = mPasses.find(name);
+
+        return (it != mPasses.end() ? it->second : nullptr);
+    }
+
+    const RenderPass* RenderQueue::AddPass(const std::string& name, const RenderPass& pass, const std::string& objectConstantsName)
+    {
+        if (mPasses.find(name) != mPasses.end())
+        {
+            throw GameException("A render pass with this name already exists.");
+        }
+
+        if (mPasses.size() >= (1U << PassBits))
+        {
+            throw GameException("Too many render passes.");
+        }
+
+        ID3DX11EffectConstantBuffer* constantBuffer = pass.Effect->GetConstantBufferByName(objectConstantsName.c_str());
+        if (constantBuffer == nullptr || constantBuffer->IsValid() == false)
+        {
+            throw GameException("ID3DX11Effect::GetConstantBufferByName() could not find the specified constant buffer.");
+        }
+
+        std::unique_ptr<RenderPass> renderPass(new RenderPass(pass));
+        renderPass->Id = static_cast<UINT>(mPasses.size());
+        renderPass->ObjectConstants = nullptr;
+
+        HRESULT hr;
+        if (FAILED(hr = constantBuffer->GetConstantBuffer(&renderPass->ObjectConstants)))
+        {
+            throw GameException("ID3DX11EffectConstantBuffer::GetConstantBuffer() failed.", hr);
+        }
+
+        D3D11_BUFFER_DESC bufferDesc;
+        renderPass->ObjectConstants->GetDesc(&bufferDesc);
+        if (bufferDesc.ByteWidth < sizeof(XMFLOAT4X4) || bufferDesc.Usage != D3D11_USAGE_DEFAULT)
+        {
+            ReleaseObject(renderPass->ObjectConstants);
+            throw GameException("The object constant buffer can't hold a world-view-projection matrix.");
+        }
+
+        renderPass->Effect->AddRef();
+        renderPass->InputLayout->AddRef();
+
+        RenderPass* result = renderPass.release();
+        mPasses[name] = result;
+
+        return result;
+    }
+
+    UINT RenderQueue::AddConstants(CXMMATRIX worldViewProjection)
+    {
+        // Stored the way the effect would store the variable: column major.
+        XMFLOAT4X4 constants;
+        XMStoreFloat4x4(&constants, XMMatrixTranspose(worldViewProjection));
+        mConstants.push_back(constants);
+
+        return static_cast<UINT>(mConstants.size() - 1);
+    }
+
+    void RenderQueue::Submit(const DrawPacket& packet)
+    {
+        assert(packet.Pass != nullptr && packet.Buffers != nullptr && packet.Constants < mConstants.size());
+
+        UINT buffers = FrameId(mBufferIds, packet.Buffers);
+        UINT texture = FrameId(mTextureIds, packet.Texture);
+        mKeys.push_back(std::make_pair(MakeKey(packet.Pass->Id, buffers, texture, packet.Depth), static_cast<UINT>(mPackets.size())));
+        mPackets.push_back(packet);
+    }
+
+    void RenderQueue::Flush(ID3D11DeviceContext* context)
+    {
+        ZeroMemory(&mStatistics, sizeof(mStatistics));
+        mStatistics.Packets = static_cast<UINT>(mPackets.size());
+
+        SortKeys(mKeys, mScratch);
+
+        const RenderPass* pass = nullptr;
+        ID3D11InputLayout* inputLayout = nullptr;
+        D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+        const ModelBuffer* buffers = nullptr;
+        ID3D11Buffer* instanceBuffer = nullptr;
+        ID3D11ShaderResourceView* texture = nullptr;
+        UINT constants = UINT_MAX;
+
+        for (const std::pair<unsigned long long, UINT>& key : mKeys)
+        {
+            const DrawPacket& packet = mPackets[key.second];
+            UINT stateChanges = 0;
+
+            if (packet.Pass->InputLayout != inputLayout)
+            {
+                inputLayout = packet.Pass->InputLayout;
+                context->IASetInputLayout(inputLayout);
+                stateChanges++;
+            }
+
+            if (packet.Pass->Topology != topology)
+            {
+                topology = packet.Pass->Topology;
+                context->IASetPrimitiveTopology(topology);
+                stateChanges++;
+            }
+
+            if (packet.Buffers != buffers || (packet.InstanceBuffer != nullptr && packet.InstanceBuffer != instanceBuffer))
+            {
+                buffers = packet.Buffers;
+                buffers->Bind(context);
+                if (packet.InstanceBuffer != nullptr)
+                {
+                    UINT offset = 0;
+                    instanceBuffer = packet.InstanceBuffer;
+                    context->IASetVertexBuffers(1, 1, &instanceBuffer, &packet.InstanceStride, &offset);
+                }
+
+                stateChanges++;
+            }
+
+            // Apply() binds the pass's shaders and resources, and may rewrite the constants.
+            if (packet.Pass != pass || packet.Texture != texture)
+            {
+                pass = packet.Pass;
+                texture = packet.Texture;
+                pass->TextureVariable->SetResource(texture);
+                pass->Pass->Apply(0, context);
+                stateChanges += 2;
+                constants = UINT_MAX;
+            }
+
+            if (packet.Constants != constants)
+            {
+                constants = packet.Constants;
+                context->UpdateSubresource(pass->ObjectConstants, 0, nullptr, &mConstants[constants], 0, 0);
+                stateChanges++;
+            }
+
+            // Six binds could have changed for every draw: layout, topology, buffers, texture, pass and constants.
+            mStatistics.StateChanges += stateChanges;
+            mStatistics.StateChangesAvoided += 6 - stateChanges;
+
+            if (packet.InstanceBuffer != nullptr)
+            {
+                context->DrawIndexedInstanced(packet.IndexCount, packet.InstanceCount, packet.StartIndex, packet.BaseVertex, 0);
+            }
+            else
+            {
+                context->DrawIndexed(packet.IndexCount, packet.StartIndex, packet.BaseVertex);
+            }
+
+            mStatistics.DrawsIssued++;
+        }
+
+        mPackets.clear();
+        mConstants.clear();
+        mKeys.clear();
+        mBufferIds.clear();
+        mTextureIds.clear();
+    }
+
+    const RenderQueueStatistics& RenderQueue::Statistics() const
+    {
+        return mStatistics;
+    }
+
+    unsigned long long RenderQueue::MakeKey(UINT pass, UINT buffers, UINT texture, float depth)
+    {
+        // Depth is a positive distance from the camera. Non-negative floats order the same as
+        // their bit patterns, so the top bits of the depth sort like the depth itself; anything
+        // behind the camera is clamped to the front.
+        float clampedDepth = (depth > 0.0f ? depth : 0.0f);
+        UINT depthBits;
+        memcpy(&depthBits, &clampedDepth, sizeof(depthBits));
+        depthBits >>= (32 - DepthBits);
+
+        unsigned long long key = pass & ((1U << PassBits) - 1);
+        key = (key << BufferBits) | (buffers & ((1U << BufferBits) - 1));
+        key = (key << TextureBits) | (texture & ((1U << TextureBits) - 1));
+        key = (key << DepthBits) | depthBits;
+
+        return key;
+    }
+
+    void RenderQueue::SortKeys(std::vector<std::pair<unsigned long long, UINT>>& keys, std::vector<std::pair<unsigned long long, UINT>>& scratch)
+    {
+        // Least significant digit first; stable, so equal keys keep their submission order.
+        // Digits every key shares are skipped, which is most of them in a typical frame.
+        scratch.resize(keys.size());
+        for (UINT shift = 0; shift < 64; shift += RadixBits)
+        {
+            UINT counts[RadixSize] = { 0 };
+            for (const std::pair<unsigned long long, UINT>& key : keys)
+            {
+                counts[(key.first >> shift) & (RadixSize - 1)]++;
+            }
+
+            if (keys.empty() || counts[(keys[0].first >> shift) & (RadixSize - 1)] == keys.size())
+            {
+                continue;
+            }
+
+            UINT offset = 0;
+            for (UINT digit = 0; digit < RadixSize; digit++)
+            {
+                UINT count = counts[digit];
+                counts[digit] = offset;
+                offset += count;
+            }
+
+            for (const std::pair<unsigned long long, UINT>& key : keys)
+            {
+                scratch[counts[(key.first >> shift) & (RadixSize - 1)]++] = key;
+            }
+
+            keys.swap(scratch);
+        }
+    }
+
+    UINT RenderQueue::FrameId(std::map<const void*, UINT>& ids, const void* object)
+    {
+        // Only used to group packets, so ids past what the key holds may share a value.
+        std::map<const void*, UINT>::iterator it = ids.find(object);
+        if (it == ids.end())
+        {
+            it = ids.insert(std::make_pair(object, static_cast<UINT>(ids.size()))).first;
+        }
+
+        return it->second;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class Game;
+    class ModelBuffer;
+
+    // An effect pass with the vertex layout drawn through it, shared by name between components.
+    // Per-object constants go straight into ObjectConstants, a constant buffer whose first member
+    // is the world-view-projection matrix, so packets that only differ in their object don't need
+    // another Apply().
+    struct RenderPass
+    {
+        UINT Id;
+        ID3DX11Effect* Effect;
+        ID3DX11EffectPass* Pass;
+        ID3D11InputLayout* InputLayout;
+        D3D11_PRIMITIVE_TOPOLOGY Topology;
+        ID3D11Buffer* ObjectConstants;
+        ID3DX11EffectShaderResourceVariable* TextureVariable;
+    };
+
+    // One indexed draw; Constants is an index returned by RenderQueue::AddConstants this frame.
+    // With an InstanceBuffer, it is bound to the second input slot and InstanceCount copies are
+    // drawn in one DrawIndexedInstanced().
+    struct DrawPacket
+    {
+        const RenderPass* Pass;
+        const ModelBuffer* Buffers;
+        ID3D11Buffer* InstanceBuffer;
+        UINT InstanceStride;
+        UINT InstanceCount;
+        ID3D11ShaderResourceView* Texture;
+        UINT Constants;
+        float Depth; // Positive distance in front of the camera; packets in the same state are drawn nearest first.
+        UINT IndexCount;
+        UINT StartIndex;
+        INT BaseVertex;
+    };
+
+    struct RenderQueueStatistics
+    {
+        UINT Packets;
+        UINT DrawsIssued;
+        UINT StateChanges; // Input layout, topology, buffer, constant and texture binds plus pass applies.
+        UINT StateChangesAvoided;
+    };
+
+    // Collects the frame's draws instead of issuing them as each component draws. Flush() sorts
+    // them by a 64-bit key (pass, vertex layout and buffers, texture, depth from most to least
+    // significant) and issues them, binding only the state that differs from the previous draw.
+    class RenderQueue : public RTTI
+    {
+        RTTI_DECLARATIONS(RenderQueue, RTTI)
+
+    public:
+        RenderQueue(Game& game);
+        ~RenderQueue();
+
+        // Null when no pass has been added under name yet.
+        const RenderPass* FindPass(const std::string& name) const;
+
+        // Looks up the named constant buffer in pass.Effect and takes its own references, so the
+        // caller keeps (and releases) the ones it passed in.
+        const RenderPass* AddPass(const std::string& name, const RenderPass& pass, const std::string& objectConstantsName);
+
+        UINT AddConstants(CXMMATRIX worldViewProjection);
+        void Submit(const DrawPacket& packet);
+
+        // Issues and clears everything submitted since the last flush.
+        void Flush(ID3D11DeviceContext* context);
+
+        // Counted over the last flush.
+        const RenderQueueStatistics& Statistics() const;
+
+        static unsigned long long MakeKey(UINT pass, UINT buffers, UINT texture, float depth);
+        static void SortKeys(std::vector<std::pair<unsigned long long, UINT>>& keys, std::vector<std::pair<unsigned long long, UINT>>& scratch);
+
+    private:
+        RenderQueue();
+        RenderQueue(const RenderQueue& rhs);
+        RenderQueue& operator=(const RenderQueue& rhs);
+
+        UINT FrameId(std::map<const void*, UINT>& ids, const void* object);
+
+        Game& mGame;
+        std::map<std::string, RenderPass*> mPasses;
+        std::vector<DrawPacket> mPackets;
+        std::vector<XMFLOAT4X4> mConstants;
+        std::vector<std::pair<unsigned long long, UINT>> mKeys;
+        std::vector<std::pair<unsigned long long, UINT>> mScratch;
+        std::map<const void*, UINT> mBufferIds;
+        std::map<const void*, UINT> mTextureIds;
+        RenderQueueStatistics mStatistics;
+    };
+}
@@ -0,0 +1,244 @@
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+namespace Library
+{
+    namespace
+    {
+        const UINT BatchSize = 4096;
+
+        // Indices into the two orientation groups a vertex can belong to.
+        const UINT Preserving = 0;
+        const UINT Mirroring = 1;
+        const UINT NoGroup = 2;
+
+        struct TriangleFrame
+        {
+            XMFLOAT3 Tangent;
+            UINT Group; // NoGroup when the triangle has no area in position or texture space.
+        };
+
+        struct VertexFrame
+        {
+            XMFLOAT3 Tangents[2];
+            UINT PrimaryGroup;
+            bool Split;
+        };
+
+        void ForEachBatch(ThreadPool* threadPool, UINT count, const std::function<void(UINT, UINT)>& body)
+        {
+            UINT batchCount = (count + BatchSize - 1) / BatchSize;
+            auto runBatch = [&](UINT batch)
+            {
+                UINT begin = batch * BatchSize;
+                body(begin, std::min(count, begin + BatchSize));
+            };
+
+            if (threadPool != nullptr && batchCount > 1)
+            {
+                threadPool->ParallelFor(batchCount, runBatch);
+            }
+            else
+            {
+                for (UINT batch = 0; batch < batchCount; batch++)
+                {
+                    runBatch(batch);
+                }
+            }
+        }
+
+        inline bool IsZero(FXMVECTOR vector)
+        {
+            return (XMVectorGetX(XMVector3LengthSq(vector)) <= FLT_MIN);
+        }
+
+        // The component of vector in the plane of normal, normalized (or zero).
+        inline XMVECTOR ProjectOntoPlane(FXMVECTOR vector, FXMVECTOR normal)
+        {
+            return XMVector3Normalize(XMVectorSubtract(vector, XMVectorMultiply(XMVector3Dot(normal, vector), normal)));
+        }
+
+        void ComputeTriangleFrame(const XMFLOAT3* positions[3], const XMFLOAT3* textureCoordinates[3], TriangleFrame& frame)
+        {
+            XMVECTOR first = XMLoadFloat3(positions[0]);
+            XMVECTOR firstEdge = XMVectorSubtract(XMLoadFloat3(positions[1]), first);
+            XMVECTOR secondEdge = XMVectorSubtract(XMLoadFloat3(positions[2]), first);
+
+            float s1 = textureCoordinates[1]->x - textureCoordinates[0]->x;
+            float t1 = textureCoordinates[1]->y - textureCoordinates[0]->y;
+            float s2 = textureCoordinates[2]->x - textureCoordinates[0]->x;
+            float t2 = textureCoordinates[2]->y - textureCoordinates[0]->y;
+            float signedTextureArea = s1 * t2 - t1 * s2;
+
+            // The direction of increasing s; mirrored triangles flip it so the sign carries the orientation.
+            XMVECTOR tangent = XMVectorSubtract(XMVectorScale(firstEdge, t2), XMVectorScale(secondEdge, t1));
+            if (signedTextureArea < 0.0f)
+            {
+                tangent = XMVectorNegate(tangent);
+            }
+
+            XMStoreFloat3(&frame.Tangent, XMVector3Normalize(tangent));
+
+            if (signedTextureArea == 0.0f || IsZero(XMVector3Cross(firstEdge, secondEdge)))
+            {
+                frame.Group = NoGroup;
+            }
+            else
+            {
+                frame.Group = (signedTextureArea > 0.0f ? Preserving : Mirroring);
+            }
+        }
+
+        // The angle at corner between its two edges, both projected onto the plane of normal.
+        float CornerAngle(FXMVECTOR normal, FXMVECTOR corner, FXMVECTOR previous, GXMVECTOR next)
+        {
+            XMVECTOR toPrevious = ProjectOntoPlane(XMVectorSubtract(previous, corner), normal);
+            XMVECTOR toNext = ProjectOntoPlane(XMVectorSubtract(next, corner), normal);
+            float cosine = XMVectorGetX(XMVector3Dot(toPrevious, toNext));
+
+            return acosf(std::max(-1.0f, std::min(1.0f, cosine)));
+        }
+
+        // Normalizes an accumulated tangent, falling back to any direction in the normal's plane
+        // when nothing contributed, and derives the binormal from the orientation sign.
+        void FinishFrame(const XMFLOAT3& tangentSum, const XMFLOAT3& normal, float sign, XMFLOAT3& tangent, XMFLOAT3& biNormal)
+        {
+            XMVECTOR vertexNormal = XMLoadFloat3(&normal);
+            XMVECTOR vertexTangent = XMVector3Normalize(XMLoadFloat3(&tangentSum));
+            if (IsZero(vertexTangent))
+            {
+                vertexTangent = (IsZero(vertexNormal) ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVector3Normalize(XMVector3Orthogonal(vertexNormal)));
+            }
+
+            XMStoreFloat3(&tangent, vertexTangent);
+            XMStoreFloat3(&biNormal, XMVectorScale(XMVector3Cross(vertexNormal, vertexTangent), sign));
+        }
+    }
+
+    void TangentGenerator::Generate(ArraySpan<const XMFLOAT3> positions, ArraySpan<const XMFLOAT3> normals, ArraySpan<const XMFLOAT3> textureCoordinates,
+        std::vector<UINT>& indices, std::vector<UINT>& sourceVertices, std::vector<XMFLOAT3>& tangents, std::vector<XMFLOAT3>& biNormals, ThreadPool* threadPool)
+    {
+        UINT vertexCount = static_cast<UINT>(positions.size());
+        UINT triangleCount = static_cast<UINT>(indices.size() / 3);
+        assert(normals.size() == vertexCount && textureCoordinates.size() == vertexCount);
+
+        std::vector<TriangleFrame> triangleFrames(triangleCount);
+        ForEachBatch(threadPool, triangleCount, [&](UINT begin, UINT end)
+        {
+            for (UINT triangle = begin; triangle < end; triangle++)
+            {
+                const UINT* corners = &indices[triangle * 3];
+                const XMFLOAT3* cornerPositions[3] = { &positions[corners[0]], &positions[corners[1]], &positions[corners[2]] };
+                const XMFLOAT3* cornerTextureCoordinates[3] = { &textureCoordinates[corners[0]], &textureCoordinates[corners[1]], &textureCoordinates[corners[2]] };
+                ComputeTriangleFrame(cornerPositions, cornerTextureCoordinates, triangleFrames[triangle]);
+            }
+        });
+
+        // The corners around each vertex, stored contiguously in triangle order.
+        std::vector<UINT> firstCorners(vertexCount + 1, 0);
+        for (UINT index : indices)
+        {
+            firstCorners[index + 1]++;
+        }
+
+        for (UINT i = 1; i <= vertexCount; i++)
+        {
+            firstCorners[i] += firstCorners[i - 1];
+        }
+
+        std::vector<UINT> vertexCorners(triangleCount * 3);
+        std::vector<UINT> nextCorners(firstCorners.begin(), firstCorners.end() - 1);
+        for (UINT corner = 0; corner < triangleCount * 3; corner++)
+        {
+            vertexCorners[nextCorners[indices[corner]]++] = corner;
+        }
+
+        // Each vertex keeps the group of the first triangle that uses it; triangles without a
+        // group contribute nothing and follow it.
+        std::vector<VertexFrame> vertexFrames(vertexCount);
+        ForEachBatch(threadPool, vertexCount, [&](UINT begin, UINT end)
+        {
+            for (UINT vertex = begin; vertex < end; vertex++)
+            {
+                XMVECTOR normal = XMLoadFloat3(&normals[vertex]);
+                XMVECTOR corner = XMLoadFloat3(&positions[vertex]);
+                XMVECTOR sums[2] = { XMVectorZero(), XMVectorZero() };
+                bool used[2] = { false, false };
+                UINT primaryGroup = NoGroup;
+
+                for (UINT i = firstCorners[vertex]; i < firstCorners[vertex + 1]; i++)
+                {
+                    UINT triangle = vertexCorners[i] / 3;
+                    const TriangleFrame& triangleFrame = triangleFrames[triangle];
+                    if (triangleFrame.Group == NoGroup)
+                    {
+                        continue;
+                    }
+
+                    UINT cornerInTriangle = vertexCorners[i] % 3;
+                    XMVECTOR previous = XMLoadFloat3(&positions[indices[triangle * 3 + (cornerInTriangle + 2) % 3]]);
+                    XMVECTOR next = XMLoadFloat3(&positions[indices[triangle * 3 + (cornerInTriangle + 1) % 3]]);
+                    float angle = CornerAngle(normal, corner, previous, next);
+
+                    XMVECTOR tangent = ProjectOntoPlane(XMLoadFloat3(&triangleFrame.Tangent), normal);
+                    sums[triangleFrame.Group] = XMVectorMultiplyAdd(tangent, XMVectorReplicate(angle), sums[triangleFrame.Group]);
+                    used[triangleFrame.Group] = true;
+
+                    if (primaryGroup == NoGroup)
+                    {
+                        primaryGroup = triangleFrame.Group;
+                    }
+                }
+
+                // MikkTSpace treats a vertex no triangle orients as mirrored.
+                VertexFrame& vertexFrame = vertexFrames[vertex];
+                vertexFrame.PrimaryGroup = (primaryGroup == NoGroup ? Mirroring : primaryGroup);
+                vertexFrame.Split = (used[Preserving] && used[Mirroring]);
+                XMStoreFloat3(&vertexFrame.Tangents[Preserving], sums[Preserving]);
+                XMStoreFloat3(&vertexFrame.Tangents[Mirroring], sums[Mirroring]);
+            }
+        });
+
+        // Split vertices get their copy after the originals, in vertex order.
+        sourceVertices.resize(vertexCount);
+        std::vector<UINT> copies(vertexCount, UINT_MAX);
+        for (UINT vertex = 0; vertex < vertexCount; vertex++)
+        {
+            sourceVertices[vertex] = vertex;
+            if (vertexFrames[vertex].Split)
+            {
+                copies[vertex] = static_cast<UINT>(sourceVertices.size());
+                sourceVertices.push_back(vertex);
+            }
+        }
+
+        for (UINT corner = 0; corner < triangleCount * 3; corner++)
+        {
+            UINT vertex = indices[corner];
+            UINT group = triangleFrames[corner / 3].Group;
+            if (copies[vertex] != UINT_MAX && group != NoGroup && group != vertexFrames[vertex].PrimaryGroup)
+            {
+                indices[corner] = copies[vertex];
+            }
+        }
+
+        UINT outputVertexCount = static_cast<UINT>(sourceVertices.size());
+        tangents.resize(outputVertexCount);
+        biNormals.resize(outputVertexCount);
+        ForEachBatch(threadPool, outputVertexCount, [&](UINT begin, UINT end)
+        {
+            for (UINT vertex = begin; vertex < end; vertex++)
+            {
+                UINT source = sourceVertices[vertex];
+                const VertexFrame& vertexFrame = vertexFrames[source];
+                UINT group = (vertex < vertexCount ? vertexFrame.PrimaryGroup : 1 - vertexFrame.PrimaryGroup);
+
+                FinishFrame(vertexFrame.Tangents[group], normals[source], (group == Preserving ? 1.0f : -1.0f), tangents[vertex], biNormals[vertex]);
+            }
+        });
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Common.h"
+#include "ArraySpan.h"
+
+namespace Library
+{
+    class ThreadPool;
+
+    class TangentGenerator
+    {
+    public:
+        // MikkTSpace tangent frames for an indexed triangle list: each triangle's texture-space
+        // tangent is projected onto the vertex normal's plane and summed weighted by the corner
+        // angle, separately for triangles that preserve and that mirror the texture orientation.
+        // A vertex used by both (a mirrored UV seam) is split: indices is rewritten to point at
+        // the copies, and sourceVertices gives the input vertex of every output vertex.
+        // biNormals are cross(normal, tangent) times the orientation sign. Triangles and vertices
+        // are processed in batches on threadPool, when one is given.
+        static void Generate(ArraySpan<const XMFLOAT3> positions, ArraySpan<const XMFLOAT3> normals, ArraySpan<const XMFLOAT3> textureCoordinates,
+            std::vector<UINT>& indices, std::vector<UINT>& sourceVertices, std::vector<XMFLOAT3>& tangents, std::vector<XMFLOAT3>& biNormals, ThreadPool* threadPool = nullptr);
+
+    private:
+        TangentGenerator();
+        TangentGenerator(const TangentGenerator& rhs);
+        TangentGenerator& operator=(const TangentGenerator& rhs);
+    };
+}
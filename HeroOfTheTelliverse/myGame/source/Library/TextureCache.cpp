@@ -0,0 +1,344 @@
+#include "TextureCache.h"
+#include "Game.h"
+#include "GameException.h"
+#include "ContentManifest.h"
+#include "DdsFile.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+#include "Utility.h"
+#include "DDSTextureLoader.h"
+#include <wincodec.h>
+#include <algorithm>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(TextureCache)
+
+    size_t DecodedImage::TextureSize() const
+    {
+        if (IsDds)
+        {
+            return (File != nullptr ? File->Size() : 0);
+        }
+
+        // Four bytes a texel plus a third again for a mip chain the device generates.
+        if (MipLevels.empty())
+        {
+            return Pixels.size() + Pixels.size() / 3;
+        }
+
+        size_t size = Pixels.size();
+        for (const std::vector<byte>& level : MipLevels)
+        {
+            size += level.size();
+        }
+
+        return size;
+    }
+
+    TextureCache::TextureCache(Game& game)
+        : mGame(game), mFilenames(), mTextures(), mStatistics()
+    {
+        ZeroMemory(&mStatistics, sizeof(mStatistics));
+    }
+
+    TextureCache::~TextureCache()
+    {
+        Clear();
+    }
+
+    std::wstring TextureCache::TextureKey(const std::wstring& filename)
+    {
+        return Utility::ToWideString(ContentManifest::NormalizePath(Utility::ToString(filename)));
+    }
+
+    std::wstring TextureCache::ResolveFilename(const std::wstring& filename) const
+    {
+        ContentManifest* manifest = (ContentManifest*)mGame.Services().GetService(ContentManifest::TypeIdClass());
+        if (manifest != nullptr)
+        {
+            std::wstring cookedFilename = manifest->ArtifactFilename(filename);
+            if (DdsFile::IsDdsFile(Utility::ToString(cookedFilename)))
+            {
+                return cookedFilename;
+            }
+        }
+
+        return filename;
+    }
+
+    void TextureCache::DecodeImage(const std::wstring& filename, DecodedImage& image)
+    {
+        image.IsDds = DdsFile::IsDdsFile(Utility::ToString(filename));
+        if (image.IsDds)
+        {
+            image.File.reset(new MappedFile(Utility::ToString(filename)));
+
+            DdsTextureDesc desc;
+            DdsFile::ReadHeader(image.File->Data(), image.File->Size(), desc);
+            image.Width = desc.Width;
+            image.Height = desc.Height;
+
+            // Hashing also faults the whole mapping in here, rather than on the render thread.
+            image.ContentHash = ContentManifest::Hash(image.File->Data(), image.File->Size());
+            return;
+        }
+
+        HRESULT coInitialize = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+        IWICImagingFactory* factory = nullptr;
+        IWICBitmapDecoder* decoder = nullptr;
+        IWICBitmapFrameDecode* frame = nullptr;
+        IWICFormatConverter* converter = nullptr;
+
+        HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+        if (SUCCEEDED(hr))
+        {
+            hr = factory->CreateDecoderFromFilename(filename.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = decoder->GetFrame(0, &frame);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = frame->GetSize(&image.Width, &image.Height);
+        }
+
+        if (SUCCEEDED(hr) && (image.Width == 0 || image.Height == 0 || image.Width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || image.Height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION))
+        {
+            hr = E_INVALIDARG;
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = factory->CreateFormatConverter(&converter);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            UINT rowPitch = image.Width * 4;
+            image.Pixels.resize(rowPitch * image.Height);
+            hr = converter->CopyPixels(nullptr, rowPitch, static_cast<UINT>(image.Pixels.size()), &image.Pixels[0]);
+        }
+
+        ReleaseObject(converter);
+        ReleaseObject(frame);
+        ReleaseObject(decoder);
+        ReleaseObject(factory);
+
+        if (SUCCEEDED(coInitialize))
+        {
+            CoUninitialize();
+        }
+
+        if (FAILED(hr))
+        {
+            throw GameException("Could not decode texture.", hr);
+        }
+
+        image.ContentHash = ContentManifest::Hash(&image.Width, sizeof(image.Width));
+        image.ContentHash = ContentManifest::Hash(&image.Height, sizeof(image.Height), image.ContentHash);
+        image.ContentHash = ContentManifest::Hash(&image.Pixels[0], image.Pixels.size(), image.ContentHash);
+    }
+
+    void TextureCache::GenerateMips(DecodedImage& image, ThreadPool* threadPool)
+    {
+        if (image.IsDds == false)
+        {
+            MipGenerator::Generate(&image.Pixels[0], image.Width, image.Height, MipFilterBox, true, image.MipLevels, threadPool);
+        }
+    }
+
+    ID3D11ShaderResourceView* TextureCache::GetTexture(const std::wstring& filename)
+    {
+        ID3D11ShaderResourceView* shaderResourceView = FindTexture(filename);
+        if (shaderResourceView != nullptr)
+        {
+            return shaderResourceView;
+        }
+
+        DecodedImage image;
+        DecodeImage(ResolveFilename(filename), image);
+        GenerateMips(image);
+
+        return AddTexture(filename, image);
+    }
+
+    ID3D11ShaderResourceView* TextureCache::FindTexture(const std::wstring& filename)
+    {
+        std::map<std::wstring, unsigned long long>::const_iterator it = mFilenames.find(TextureKey(filename));
+        if (it == mFilenames.end())
+        {
+            mStatistics.Misses++;
+            return nullptr;
+        }
+
+        mStatistics.Hits++;
+
+        ID3D11ShaderResourceView* shaderResourceView = mTextures.at(it->second).ShaderResourceView;
+        shaderResourceView->AddRef();
+
+        return shaderResourceView;
+    }
+
+    ID3D11ShaderResourceView* TextureCache::AddTexture(const std::wstring& filename, const DecodedImage& image)
+    {
+        std::map<unsigned long long, CachedTexture>::iterator it = mTextures.find(image.ContentHash);
+        if (it != mTextures.end())
+        {
+            mStatistics.ContentMatches++;
+        }
+        else
+        {
+            CachedTexture texture;
+            texture.ShaderResourceView = nullptr;
+            CreateTexture(image, &texture.ShaderResourceView);
+
+            texture.Size = image.TextureSize();
+
+            it = mTextures.insert(std::pair<unsigned long long, CachedTexture>(image.ContentHash, texture)).first;
+            mStatistics.TextureCount++;
+            mStatistics.Bytes += texture.Size;
+        }
+
+        if (mFilenames.insert(std::pair<std::wstring, unsigned long long>(TextureKey(filename), image.ContentHash)).second)
+        {
+            mStatistics.FilenameCount++;
+        }
+
+        it->second.ShaderResourceView->AddRef();
+        return it->second.ShaderResourceView;
+    }
+
+    void TextureCache::Trim()
+    {
+        for (std::map<unsigned long long, CachedTexture>::iterator it = mTextures.begin(); it != mTextures.end();)
+        {
+            ID3D11ShaderResourceView* shaderResourceView = it->second.ShaderResourceView;
+            shaderResourceView->AddRef();
+            if (shaderResourceView->Release() > 1)
+            {
+                ++it;
+                continue;
+            }
+
+            for (std::map<std::wstring, unsigned long long>::iterator filename = mFilenames.begin(); filename != mFilenames.end();)
+            {
+                if (filename->second == it->first)
+                {
+                    filename = mFilenames.erase(filename);
+                    mStatistics.FilenameCount--;
+                }
+                else
+                {
+                    ++filename;
+                }
+            }
+
+            mStatistics.TextureCount--;
+            mStatistics.Bytes -= it->second.Size;
+            shaderResourceView->Release();
+            it = mTextures.erase(it);
+        }
+    }
+
+    void TextureCache::Clear()
+    {
+        for (std::pair<const unsigned long long, CachedTexture>& texture : mTextures)
+        {
+            ReleaseObject(texture.second.ShaderResourceView);
+        }
+
+        mTextures.clear();
+        mFilenames.clear();
+        mStatistics.TextureCount = 0;
+        mStatistics.FilenameCount = 0;
+        mStatistics.Bytes = 0;
+    }
+
+    const TextureCacheStatistics& TextureCache::Statistics() const
+    {
+        return mStatistics;
+    }
+
+    void TextureCache::CreateTexture(const DecodedImage& image, ID3D11ShaderResourceView** shaderResourceView)
+    {
+        HRESULT hr;
+        if (image.IsDds)
+        {
+            // The subresources it creates the texture from point straight into the mapping.
+            if (FAILED(hr = DirectX::CreateDDSTextureFromMemory(mGame.Direct3DDevice(), image.File->Data(), image.File->Size(), nullptr, shaderResourceView)))
+            {
+                throw GameException("CreateDDSTextureFromMemory() failed.", hr);
+            }
+
+            return;
+        }
+
+        D3D11_TEXTURE2D_DESC textureDesc;
+        ZeroMemory(&textureDesc, sizeof(textureDesc));
+        textureDesc.Width = image.Width;
+        textureDesc.Height = image.Height;
+        textureDesc.ArraySize = 1;
+        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        textureDesc.SampleDesc.Count = 1;
+
+        // With the mip chain already built every level goes in as initial data; otherwise the
+        // device generates it from the top level.
+        bool generateMips = image.MipLevels.empty();
+        std::vector<D3D11_SUBRESOURCE_DATA> initialData;
+        if (generateMips)
+        {
+            textureDesc.MipLevels = 0;
+            textureDesc.Usage = D3D11_USAGE_DEFAULT;
+            textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+            textureDesc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+        }
+        else
+        {
+            textureDesc.MipLevels = static_cast<UINT>(image.MipLevels.size()) + 1;
+            textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+            textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+            initialData.resize(textureDesc.MipLevels);
+            for (UINT level = 0; level < textureDesc.MipLevels; level++)
+            {
+                const std::vector<byte>& pixels = (level == 0 ? image.Pixels : image.MipLevels[level - 1]);
+                initialData[level].pSysMem = &pixels[0];
+                initialData[level].SysMemPitch = std::max(image.Width >> level, 1U) * 4;
+                initialData[level].SysMemSlicePitch = 0;
+            }
+        }
+
+        ID3D11Texture2D* texture = nullptr;
+        if (FAILED(hr = mGame.Direct3DDevice()->CreateTexture2D(&textureDesc, (generateMips ? nullptr : &initialData[0]), &texture)))
+        {
+            throw GameException("ID3D11Device::CreateTexture2D() failed.", hr);
+        }
+
+        if (generateMips)
+        {
+            mGame.Direct3DDeviceContext()->UpdateSubresource(texture, 0, nullptr, &image.Pixels[0], image.Width * 4, 0);
+        }
+
+        hr = mGame.Direct3DDevice()->CreateShaderResourceView(texture, nullptr, shaderResourceView);
+        ReleaseObject(texture);
+        if (FAILED(hr))
+        {
+            throw GameException("ID3D11Device::CreateShaderResourceView() failed.", hr);
+        }
+
+        if (generateMips)
+        {
+            mGame.Direct3DDeviceContext()->GenerateMips(*shaderResourceView);
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class Game;
+
+    class MappedFile;
+    class ThreadPool;
+
+    // RGBA8 pixels decoded off the render thread, with a hash of their dimensions and contents.
+    // Cooked .dds files aren't decoded at all: the file is mapped and its headers checked, and the
+    // texture is created straight from the mapping, leaving Pixels empty.
+    struct DecodedImage
+    {
+        UINT Width;
+        UINT Height;
+        std::vector<byte> Pixels;
+        std::vector<std::vector<byte>> MipLevels; // Below Pixels, largest first; see GenerateMips().
+        std::shared_ptr<MappedFile> File;
+        unsigned long long ContentHash;
+        bool IsDds;
+
+        // GPU memory of the texture, mip chain included.
+        size_t TextureSize() const;
+    };
+
+    struct TextureCacheStatistics
+    {
+        UINT Hits;
+        UINT Misses;
+        UINT ContentMatches; // Misses whose pixels matched a texture already loaded under another name.
+        UINT TextureCount;
+        UINT FilenameCount;
+        unsigned long long Bytes; // GPU memory of every cached texture, mip chain included.
+    };
+
+    // Shader resource views shared per texture file. Filenames are looked up ignoring case, slash
+    // direction and "." / ".." segments, and files that decode to identical pixels share one texture.
+    // Like ModelCache buffers, every view handed out has already been AddRef'd, so callers release
+    // it exactly as if they had created it.
+    class TextureCache : public RTTI
+    {
+        RTTI_DECLARATIONS(TextureCache, RTTI)
+
+    public:
+        TextureCache(Game& game);
+        ~TextureCache();
+
+        static std::wstring TextureKey(const std::wstring& filename);
+
+        // The block-compressed .dds the content manifest lists for filename when it has been
+        // cooked and the source hasn't changed since, otherwise filename itself. Textures stay
+        // cached under the source name.
+        std::wstring ResolveFilename(const std::wstring& filename) const;
+
+        // Safe to call on any thread; throws GameException when the file can't be decoded.
+        static void DecodeImage(const std::wstring& filename, DecodedImage& image);
+
+        // Box-filters the rest of the mip chain on the CPU, treating colors as sRGB, so the texture
+        // is created with every level up front. Does nothing for .dds files, which carry their own.
+        static void GenerateMips(DecodedImage& image, ThreadPool* threadPool = nullptr);
+
+        // Loads and uploads synchronously on a miss.
+        ID3D11ShaderResourceView* GetTexture(const std::wstring& filename);
+
+        // Null (and a miss) when filename isn't cached.
+        ID3D11ShaderResourceView* FindTexture(const std::wstring& filename);
+
+        // Uploads image under filename unless a texture with the same contents already exists.
+        ID3D11ShaderResourceView* AddTexture(const std::wstring& filename, const DecodedImage& image);
+
+        // Drops textures that nobody outside the cache is holding on to.
+        void Trim();
+        void Clear();
+
+        const TextureCacheStatistics& Statistics() const;
+
+    private:
+        struct CachedTexture
+        {
+            ID3D11ShaderResourceView* ShaderResourceView;
+            unsigned long long Size;
+        };
+
+        TextureCache();
+        TextureCache(const TextureCache& rhs);
+        TextureCache& operator=(const TextureCache& rhs);
+
+        void CreateTexture(const DecodedImage& image, ID3D11ShaderResourceView** shaderResourceView);
+
+        Game& mGame;
+        std::map<std::wstring, unsigned long long> mFilenames;
+        std::map<unsigned long long, CachedTexture> mTextures;
+        TextureCacheStatistics mStatistics;
+    };
+}
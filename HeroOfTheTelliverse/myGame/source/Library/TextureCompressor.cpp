@@ -0,0 +1,542 @@
+#include "TextureCompressor.h"
+#include "GameException.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace Library
+{
+    namespace
+    {
+        const UINT BlockPixelCount = 16;
+        const UINT PowerIterations = 8;
+
+        // BC7 interpolation weights for 4-bit indices, out of 64.
+        const UINT IndexWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        // Packs fields least significant bit first, as every BC format lays them out.
+        class BitWriter
+        {
+        public:
+            BitWriter(byte* block, UINT size)
+                : mBlock(block), mPosition(0)
+            {
+                ZeroMemory(block, size);
+            }
+
+            void Write(UINT value, UINT bitCount)
+            {
+                for (UINT i = 0; i < bitCount; i++, mPosition++)
+                {
+                    if ((value >> i) & 1)
+                    {
+                        mBlock[mPosition / 8] |= static_cast<byte>(1 << (mPosition % 8));
+                    }
+                }
+            }
+
+        private:
+            byte* mBlock;
+            UINT mPosition;
+        };
+
+        // Colors are kept in 0..255 floats; alpha is zeroed when it isn't part of the fit.
+        void LoadColors(const byte rgba[64], bool includeAlpha, XMVECTOR colors[BlockPixelCount])
+        {
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                const byte* pixel = &rgba[i * 4];
+                colors[i] = XMVectorSet(pixel[0], pixel[1], pixel[2], (includeAlpha ? pixel[3] : 0.0f));
+            }
+        }
+
+        inline float DistanceSquared(FXMVECTOR first, FXMVECTOR second)
+        {
+            return XMVectorGetX(XMVector4LengthSq(XMVectorSubtract(first, second)));
+        }
+
+        XMVECTOR Mean(const XMVECTOR colors[BlockPixelCount])
+        {
+            XMVECTOR sum = XMVectorZero();
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                sum = XMVectorAdd(sum, colors[i]);
+            }
+
+            return XMVectorScale(sum, 1.0f / BlockPixelCount);
+        }
+
+        // Power iteration on the covariance matrix, applied implicitly as sum(d * dot(d, axis)).
+        XMVECTOR PrincipalAxis(const XMVECTOR colors[BlockPixelCount], FXMVECTOR mean)
+        {
+            XMVECTOR minimum = colors[0];
+            XMVECTOR maximum = colors[0];
+            for (UINT i = 1; i < BlockPixelCount; i++)
+            {
+                minimum = XMVectorMin(minimum, colors[i]);
+                maximum = XMVectorMax(maximum, colors[i]);
+            }
+
+            XMVECTOR axis = XMVectorSubtract(maximum, minimum);
+            for (UINT iteration = 0; iteration < PowerIterations; iteration++)
+            {
+                XMVECTOR next = XMVectorZero();
+                for (UINT i = 0; i < BlockPixelCount; i++)
+                {
+                    XMVECTOR offset = XMVectorSubtract(colors[i], mean);
+                    next = XMVectorMultiplyAdd(offset, XMVector4Dot(offset, axis), next);
+                }
+
+                float length = XMVectorGetX(XMVector4Length(next));
+                if (length <= FLT_EPSILON)
+                {
+                    break;
+                }
+
+                axis = XMVectorScale(next, 1.0f / length);
+            }
+
+            return XMVector4Normalize(axis);
+        }
+
+        // The extremes of the colors projected onto their principal axis.
+        void FitEndpoints(const XMVECTOR colors[BlockPixelCount], XMVECTOR& first, XMVECTOR& second)
+        {
+            XMVECTOR mean = Mean(colors);
+            XMVECTOR axis = PrincipalAxis(colors, mean);
+
+            float minimum = FLT_MAX;
+            float maximum = -FLT_MAX;
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                float projection = XMVectorGetX(XMVector4Dot(XMVectorSubtract(colors[i], mean), axis));
+                minimum = std::min(minimum, projection);
+                maximum = std::max(maximum, projection);
+            }
+
+            if (minimum > maximum)
+            {
+                minimum = maximum = 0.0f;
+            }
+
+            XMVECTOR low = XMVectorReplicate(0.0f);
+            XMVECTOR high = XMVectorReplicate(255.0f);
+            first = XMVectorClamp(XMVectorMultiplyAdd(axis, XMVectorReplicate(maximum), mean), low, high);
+            second = XMVectorClamp(XMVectorMultiplyAdd(axis, XMVectorReplicate(minimum), mean), low, high);
+        }
+
+        // Least-squares endpoints for fixed indices, where weights[i] is how much of first pixel i
+        // takes. Returns false when the indices don't pin both endpoints down.
+        bool RefineEndpoints(const XMVECTOR colors[BlockPixelCount], const float weights[BlockPixelCount], XMVECTOR& first, XMVECTOR& second)
+        {
+            float firstFirst = 0.0f;
+            float firstSecond = 0.0f;
+            float secondSecond = 0.0f;
+            XMVECTOR firstSum = XMVectorZero();
+            XMVECTOR secondSum = XMVectorZero();
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                float weight = weights[i];
+                float inverse = 1.0f - weight;
+                firstFirst += weight * weight;
+                firstSecond += weight * inverse;
+                secondSecond += inverse * inverse;
+                firstSum = XMVectorMultiplyAdd(colors[i], XMVectorReplicate(weight), firstSum);
+                secondSum = XMVectorMultiplyAdd(colors[i], XMVectorReplicate(inverse), secondSum);
+            }
+
+            float determinant = firstFirst * secondSecond - firstSecond * firstSecond;
+            if (fabsf(determinant) <= FLT_EPSILON)
+            {
+                return false;
+            }
+
+            XMVECTOR low = XMVectorReplicate(0.0f);
+            XMVECTOR high = XMVectorReplicate(255.0f);
+            float scale = 1.0f / determinant;
+            first = XMVectorClamp(XMVectorScale(XMVectorSubtract(XMVectorScale(firstSum, secondSecond), XMVectorScale(secondSum, firstSecond)), scale), low, high);
+            second = XMVectorClamp(XMVectorScale(XMVectorSubtract(XMVectorScale(secondSum, firstFirst), XMVectorScale(firstSum, firstSecond)), scale), low, high);
+
+            return true;
+        }
+
+        UINT NearestIndex(FXMVECTOR color, const XMVECTOR* palette, UINT paletteSize, float& error)
+        {
+            UINT nearest = 0;
+            error = FLT_MAX;
+            for (UINT i = 0; i < paletteSize; i++)
+            {
+                float distance = DistanceSquared(color, palette[i]);
+                if (distance < error)
+                {
+                    error = distance;
+                    nearest = i;
+                }
+            }
+
+            return nearest;
+        }
+
+        USHORT ToColor565(FXMVECTOR color)
+        {
+            XMFLOAT4 value;
+            XMStoreFloat4(&value, color);
+
+            UINT red = static_cast<UINT>(value.x * (31.0f / 255.0f) + 0.5f);
+            UINT green = static_cast<UINT>(value.y * (63.0f / 255.0f) + 0.5f);
+            UINT blue = static_cast<UINT>(value.z * (31.0f / 255.0f) + 0.5f);
+
+            return static_cast<USHORT>((red << 11) | (green << 5) | blue);
+        }
+
+        XMVECTOR FromColor565(USHORT color)
+        {
+            UINT red = (color >> 11) & 31;
+            UINT green = (color >> 5) & 63;
+            UINT blue = color & 31;
+
+            return XMVectorSet(static_cast<float>((red << 3) | (red >> 2)), static_cast<float>((green << 2) | (green >> 4)), static_cast<float>((blue << 3) | (blue >> 2)), 0.0f);
+        }
+
+        // Four-colour mode: first, second, then the two thirds in between.
+        const float ColorWeights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+        float EncodeColorIndices(const XMVECTOR colors[BlockPixelCount], USHORT first, USHORT second, UINT indices[BlockPixelCount])
+        {
+            XMVECTOR palette[4];
+            XMVECTOR firstColor = FromColor565(first);
+            XMVECTOR secondColor = FromColor565(second);
+            for (UINT i = 0; i < 4; i++)
+            {
+                palette[i] = XMVectorLerp(secondColor, firstColor, ColorWeights[i]);
+            }
+
+            float totalError = 0.0f;
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                float error;
+                indices[i] = NearestIndex(colors[i], palette, 4, error);
+                totalError += error;
+            }
+
+            return totalError;
+        }
+
+        void CompressColorBlock(const byte rgba[64], byte block[8])
+        {
+            XMVECTOR colors[BlockPixelCount];
+            LoadColors(rgba, false, colors);
+
+            XMVECTOR firstEndpoint;
+            XMVECTOR secondEndpoint;
+            FitEndpoints(colors, firstEndpoint, secondEndpoint);
+
+            USHORT first = ToColor565(firstEndpoint);
+            USHORT second = ToColor565(secondEndpoint);
+            UINT indices[BlockPixelCount];
+            float error = EncodeColorIndices(colors, first, second, indices);
+
+            float weights[BlockPixelCount];
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                weights[i] = ColorWeights[indices[i]];
+            }
+
+            if (RefineEndpoints(colors, weights, firstEndpoint, secondEndpoint))
+            {
+                USHORT refinedFirst = ToColor565(firstEndpoint);
+                USHORT refinedSecond = ToColor565(secondEndpoint);
+                UINT refinedIndices[BlockPixelCount];
+                if (EncodeColorIndices(colors, refinedFirst, refinedSecond, refinedIndices) < error)
+                {
+                    first = refinedFirst;
+                    second = refinedSecond;
+                    std::copy(refinedIndices, refinedIndices + BlockPixelCount, indices);
+                }
+            }
+
+            // Four-colour mode needs first > second; equal endpoints only ever need index 0.
+            if (first < second)
+            {
+                static const UINT swappedIndices[4] = { 1, 0, 3, 2 };
+                std::swap(first, second);
+                for (UINT& index : indices)
+                {
+                    index = swappedIndices[index];
+                }
+            }
+            else if (first == second)
+            {
+                std::fill(indices, indices + BlockPixelCount, 0);
+            }
+
+            BitWriter writer(block, 8);
+            writer.Write(first, 16);
+            writer.Write(second, 16);
+            for (UINT index : indices)
+            {
+                writer.Write(index, 2);
+            }
+        }
+
+        void CompressAlphaBlock(const byte rgba[64], byte block[8])
+        {
+            byte first = 0;
+            byte second = 255;
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                first = std::max(first, rgba[i * 4 + 3]);
+                second = std::min(second, rgba[i * 4 + 3]);
+            }
+
+            // Eight-level mode: first, second, then six steps in between.
+            float palette[8] = { first, second };
+            for (UINT i = 1; i < 7; i++)
+            {
+                palette[i + 1] = ((7 - i) * first + i * second) / 7.0f;
+            }
+
+            BitWriter writer(block, 8);
+            writer.Write(first, 8);
+            writer.Write(second, 8);
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                float alpha = rgba[i * 4 + 3];
+                UINT nearest = 0;
+                for (UINT j = 1; j < 8; j++)
+                {
+                    if (fabsf(palette[j] - alpha) < fabsf(palette[nearest] - alpha))
+                    {
+                        nearest = j;
+                    }
+                }
+
+                writer.Write(first == second ? 0 : nearest, 3);
+            }
+        }
+
+        // A 7-bit endpoint plus the p-bit shared by its channels, choosing the p-bit that lands closest.
+        void QuantizeEndpoint7(FXMVECTOR endpoint, UINT quantized[4], UINT& pBit)
+        {
+            XMFLOAT4 value;
+            XMStoreFloat4(&value, endpoint);
+            const float channels[4] = { value.x, value.y, value.z, value.w };
+
+            // Ties go to a set p-bit, the only way to reach 255 and keep opaque alpha exact.
+            const UINT candidates[2] = { 1, 0 };
+            float bestError = FLT_MAX;
+            for (UINT candidate : candidates)
+            {
+                UINT candidateQuantized[4];
+                float error = 0.0f;
+                for (UINT channel = 0; channel < 4; channel++)
+                {
+                    float level = (channels[channel] - candidate) / 2.0f + 0.5f;
+                    candidateQuantized[channel] = static_cast<UINT>(std::max(0.0f, std::min(127.0f, level)));
+                    float difference = static_cast<float>((candidateQuantized[channel] << 1) | candidate) - channels[channel];
+                    error += difference * difference;
+                }
+
+                if (error < bestError)
+                {
+                    bestError = error;
+                    pBit = candidate;
+                    std::copy(candidateQuantized, candidateQuantized + 4, quantized);
+                }
+            }
+        }
+
+        float EncodeMode6Indices(const XMVECTOR colors[BlockPixelCount], const UINT first[4], UINT firstPBit, const UINT second[4], UINT secondPBit, UINT indices[BlockPixelCount])
+        {
+            XMVECTOR palette[16];
+            for (UINT i = 0; i < 16; i++)
+            {
+                float entry[4];
+                for (UINT channel = 0; channel < 4; channel++)
+                {
+                    UINT firstValue = (first[channel] << 1) | firstPBit;
+                    UINT secondValue = (second[channel] << 1) | secondPBit;
+                    entry[channel] = static_cast<float>(((64 - IndexWeights4[i]) * firstValue + IndexWeights4[i] * secondValue + 32) >> 6);
+                }
+
+                palette[i] = XMVectorSet(entry[0], entry[1], entry[2], entry[3]);
+            }
+
+            float totalError = 0.0f;
+            for (UINT i = 0; i < BlockPixelCount; i++)
+            {
+                float error;
+                indices[i] = NearestIndex(colors[i], palette, 16, error);
+                totalError += error;
+            }
+
+            return totalError;
+        }
+    }
+
+    bool TextureCompressor::IsSupportedFormat(DXGI_FORMAT format)
+    {
+        return (format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC3_UNORM || format == DXGI_FORMAT_BC7_UNORM);
+    }
+
+    UINT TextureCompressor::BlockSize(DXGI_FORMAT format)
+    {
+        return (format == DXGI_FORMAT_BC1_UNORM ? 8 : 16);
+    }
+
+    DXGI_FORMAT TextureCompressor::ChooseFormat(const byte* rgba, UINT width, UINT height)
+    {
+        UINT pixelCount = width * height;
+        for (UINT i = 0; i < pixelCount; i++)
+        {
+            if (rgba[i * 4 + 3] != 255)
+            {
+                return DXGI_FORMAT_BC3_UNORM;
+            }
+        }
+
+        return DXGI_FORMAT_BC1_UNORM;
+    }
+
+    void TextureCompressor::Compress(const byte* rgba, UINT width, UINT height, DXGI_FORMAT format, std::vector<byte>& blocks, ThreadPool* threadPool)
+    {
+        if (IsSupportedFormat(format) == false)
+        {
+            throw GameException("Unsupported block compression format.");
+        }
+
+        UINT blocksWide = (width + 3) / 4;
+        UINT blocksHigh = (height + 3) / 4;
+        UINT blockSize = BlockSize(format);
+        blocks.resize(static_cast<size_t>(blocksWide) * blocksHigh * blockSize);
+
+        auto compressRow = [&](UINT blockY)
+        {
+            byte pixels[BlockPixelCount * 4];
+            for (UINT blockX = 0; blockX < blocksWide; blockX++)
+            {
+                for (UINT y = 0; y < 4; y++)
+                {
+                    UINT sourceY = std::min(blockY * 4 + y, height - 1);
+                    for (UINT x = 0; x < 4; x++)
+                    {
+                        UINT sourceX = std::min(blockX * 4 + x, width - 1);
+                        memcpy(&pixels[(y * 4 + x) * 4], &rgba[(static_cast<size_t>(sourceY) * width + sourceX) * 4], 4);
+                    }
+                }
+
+                byte* block = &blocks[(static_cast<size_t>(blockY) * blocksWide + blockX) * blockSize];
+                switch (format)
+                {
+                case DXGI_FORMAT_BC1_UNORM:
+                    CompressBlockBC1(pixels, block);
+                    break;
+
+                case DXGI_FORMAT_BC3_UNORM:
+                    CompressBlockBC3(pixels, block);
+                    break;
+
+                default:
+                    CompressBlockBC7(pixels, block);
+                    break;
+                }
+            }
+        };
+
+        if (threadPool != nullptr && blocksHigh > 1)
+        {
+            threadPool->ParallelFor(blocksHigh, compressRow);
+        }
+        else
+        {
+            for (UINT blockY = 0; blockY < blocksHigh; blockY++)
+            {
+                compressRow(blockY);
+            }
+        }
+    }
+
+    void TextureCompressor::CompressBlockBC1(const byte rgba[64], byte block[8])
+    {
+        CompressColorBlock(rgba, block);
+    }
+
+    void TextureCompressor::CompressBlockBC3(const byte rgba[64], byte block[16])
+    {
+        CompressAlphaBlock(rgba, block);
+        CompressColorBlock(rgba, block + 8);
+    }
+
+    void TextureCompressor::CompressBlockBC7(const byte rgba[64], byte block[16])
+    {
+        XMVECTOR colors[BlockPixelCount];
+        LoadColors(rgba, true, colors);
+
+        XMVECTOR firstEndpoint;
+        XMVECTOR secondEndpoint;
+        FitEndpoints(colors, firstEndpoint, secondEndpoint);
+
+        UINT first[4];
+        UINT second[4];
+        UINT firstPBit;
+        UINT secondPBit;
+        QuantizeEndpoint7(firstEndpoint, first, firstPBit);
+        QuantizeEndpoint7(secondEndpoint, second, secondPBit);
+
+        UINT indices[BlockPixelCount];
+        float error = EncodeMode6Indices(colors, first, firstPBit, second, secondPBit, indices);
+
+        float weights[BlockPixelCount];
+        for (UINT i = 0; i < BlockPixelCount; i++)
+        {
+            weights[i] = (64 - IndexWeights4[indices[i]]) / 64.0f;
+        }
+
+        if (RefineEndpoints(colors, weights, firstEndpoint, secondEndpoint))
+        {
+            UINT refinedFirst[4];
+            UINT refinedSecond[4];
+            UINT refinedFirstPBit;
+            UINT refinedSecondPBit;
+            QuantizeEndpoint7(firstEndpoint, refinedFirst, refinedFirstPBit);
+            QuantizeEndpoint7(secondEndpoint, refinedSecond, refinedSecondPBit);
+
+            UINT refinedIndices[BlockPixelCount];
+            if (EncodeMode6Indices(colors, refinedFirst, refinedFirstPBit, refinedSecond, refinedSecondPBit, refinedIndices) < error)
+            {
+                std::copy(refinedFirst, refinedFirst + 4, first);
+                std::copy(refinedSecond, refinedSecond + 4, second);
+                firstPBit = refinedFirstPBit;
+                secondPBit = refinedSecondPBit;
+                std::copy(refinedIndices, refinedIndices + BlockPixelCount, indices);
+            }
+        }
+
+        // The first pixel's index is stored without its top bit, so it must be below 8.
+        if (indices[0] >= 8)
+        {
+            std::swap_ranges(first, first + 4, second);
+            std::swap(firstPBit, secondPBit);
+            for (UINT& index : indices)
+            {
+                index = 15 - index;
+            }
+        }
+
+        BitWriter writer(block, 16);
+        writer.Write(1 << 6, 7);
+        for (UINT channel = 0; channel < 4; channel++)
+        {
+            writer.Write(first[channel], 7);
+            writer.Write(second[channel], 7);
+        }
+
+        writer.Write(firstPBit, 1);
+        writer.Write(secondPBit, 1);
+        for (UINT i = 0; i < BlockPixelCount; i++)
+        {
+            writer.Write(indices[i], (i == 0 ? 3 : 4));
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class ThreadPool;
+
+    // Block compression of RGBA8 images into BC1, BC3 and BC7 (mode 6 only: one subset with
+    // RGBA endpoints, which suits photographic textures). Endpoints are fitted along the block's
+    // principal axis and refined once by least squares.
+    class TextureCompressor
+    {
+    public:
+        static bool IsSupportedFormat(DXGI_FORMAT format);
+        static UINT BlockSize(DXGI_FORMAT format);
+
+        // BC1 when every pixel is opaque, BC3 otherwise.
+        static DXGI_FORMAT ChooseFormat(const byte* rgba, UINT width, UINT height);
+
+        // Compresses one level (rows of width * 4 bytes) into 4x4 blocks, row of blocks by row of
+        // blocks, one row per task on threadPool when one is given. Blocks past the right or bottom
+        // edge repeat the last column or row.
+        static void Compress(const byte* rgba, UINT width, UINT height, DXGI_FORMAT format, std::vector<byte>& blocks, ThreadPool* threadPool = nullptr);
+
+        static void CompressBlockBC1(const byte rgba[64], byte block[8]);
+        static void CompressBlockBC3(const byte rgba[64], byte block[16]);
+        static void CompressBlockBC7(const byte rgba[64], byte block[16]);
+
+    private:
+        TextureCompressor();
+        TextureCompressor(const TextureCompressor& rhs);
+        TextureCompressor& operator=(const TextureCompressor& rhs);
+    };
+}
@@ -0,0 +1,162 @@
+#include "ThreadPool.h"
+#include <climits>
+
+namespace Library
+{
+    RTTI_DEFINITIONS(ThreadPool)
+
+    const UINT ThreadPool::HardwareThreadCount = UINT_MAX;
+
+    namespace
+    {
+        struct ParallelForState
+        {
+            ParallelForState(UINT count, const std::function<void(UINT)>& body)
+                : Count(count), Body(&body), NextIndex(0), CompletedCount(0), Exception()
+            {
+            }
+
+            // Claims and runs indices until none are left. Body is only dereferenced after a
+            // successful claim, so late helpers never touch it once ParallelFor has returned.
+            void Run()
+            {
+                for (UINT index = NextIndex++; index < Count; index = NextIndex++)
+                {
+                    try
+                    {
+                        (*Body)(index);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(Mutex);
+                        if (Exception == nullptr)
+                        {
+                            Exception = std::current_exception();
+                        }
+                    }
+
+                    if (++CompletedCount == Count)
+                    {
+                        std::lock_guard<std::mutex> lock(Mutex);
+                        Finished.notify_all();
+                    }
+                }
+            }
+
+            const UINT Count;
+            const std::function<void(UINT)>* Body;
+            std::atomic<UINT> NextIndex;
+            std::atomic<UINT> CompletedCount;
+            std::exception_ptr Exception;
+            std::mutex Mutex;
+            std::condition_variable Finished;
+        };
+    }
+
+    ThreadPool::ThreadPool(UINT threadCount)
+        : mThreads(), mTasks(), mMutex(), mCondition(), mStopping(false)
+    {
+        if (threadCount == HardwareThreadCount)
+        {
+            UINT hardwareThreads = std::thread::hardware_concurrency();
+            threadCount = (hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+        }
+
+        mThreads.reserve(threadCount);
+        for (UINT i = 0; i < threadCount; i++)
+        {
+            mThreads.push_back(std::thread(&ThreadPool::WorkerThread, this));
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+
+        mCondition.notify_all();
+        for (std::thread& thread : mThreads)
+        {
+            thread.join();
+        }
+    }
+
+    UINT ThreadPool::ThreadCount() const
+    {
+        return static_cast<UINT>(mThreads.size());
+    }
+
+    std::future<void> ThreadPool::Enqueue(const std::function<void()>& task)
+    {
+        std::packaged_task<void()> packagedTask(task);
+        std::future<void> future = packagedTask.get_future();
+
+        if (mThreads.empty())
+        {
+            packagedTask();
+            return future;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.push_back(std::move(packagedTask));
+        }
+
+        mCondition.notify_one();
+        return future;
+    }
+
+    void ThreadPool::ParallelFor(UINT count, const std::function<void(UINT)>& body)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        std::shared_ptr<ParallelForState> state(new ParallelForState(count, body));
+
+        UINT helperCount = (ThreadCount() < count - 1 ? ThreadCount() : count - 1);
+        for (UINT i = 0; i < helperCount; i++)
+        {
+            Enqueue([state]() { state->Run(); });
+        }
+
+        // The caller works too, so progress never depends on a worker being free.
+        state->Run();
+
+        {
+            std::unique_lock<std::mutex> lock(state->Mutex);
+            state->Finished.wait(lock, [&state]() { return state->CompletedCount == state->Count; });
+        }
+
+        if (state->Exception != nullptr)
+        {
+            std::rethrow_exception(state->Exception);
+        }
+    }
+
+    void ThreadPool::WorkerThread()
+    {
+        for (;;)
+        {
+            std::packaged_task<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCondition.wait(lock, [this]() { return mStopping || mTasks.empty() == false; });
+
+                if (mStopping && mTasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(mTasks.front());
+                mTasks.pop_front();
+            }
+
+            task();
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Common.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace Library
+{
+    class ThreadPool : public RTTI
+    {
+        RTTI_DECLARATIONS(ThreadPool, RTTI)
+
+    public:
+        // HardwareThreadCount is one worker per hardware thread, minus the caller. A pool with no
+        // workers runs everything on the calling thread.
+        static const UINT HardwareThreadCount;
+
+        ThreadPool(UINT threadCount = HardwareThreadCount);
+        ~ThreadPool();
+
+        UINT ThreadCount() const;
+
+        std::future<void> Enqueue(const std::function<void()>& task);
+
+        // Runs body(0..count-1) across the workers and the calling thread and returns once
+        // every index has been processed. The first exception thrown by body is rethrown here.
+        void ParallelFor(UINT count, const std::function<void(UINT)>& body);
+
+    private:
+        ThreadPool(const ThreadPool& rhs);
+        ThreadPool& operator=(const ThreadPool& rhs);
+
+        void WorkerThread();
+
+        std::vector<std::thread> mThreads;
+        std::deque<std::packaged_task<void()>> mTasks;
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        bool mStopping;
+    };
+}
@@ -0,0 +1,851 @@
+#include "ThreeDSFile.h"
+#include "GameException.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "ModelMaterial.h"
+#include "ThreadPool.h"
+#include "Utility.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+
+namespace Library
+{
+    const std::string ThreeDSFile::Extension = ".3ds";
+    const std::string ThreeDSFile::DefaultMaterialName = "%%%DEFAULT";
+
+    namespace
+    {
+        const UINT ChunkHeaderSize = sizeof(USHORT) + sizeof(UINT);
+        const USHORT ChunkMain = 0x4D4D;
+        const USHORT ChunkEditor = 0x3D3D;
+        const USHORT ChunkObject = 0x4000;
+        const USHORT ChunkTriangleMesh = 0x4100;
+        const USHORT ChunkVertexList = 0x4110;
+        const USHORT ChunkFaceList = 0x4120;
+        const USHORT ChunkFaceMaterial = 0x4130;
+        const USHORT ChunkMappingCoordinates = 0x4140;
+        const USHORT ChunkSmoothingGroups = 0x4150;
+        const USHORT ChunkMeshMatrix = 0x4160;
+        const USHORT ChunkMaterial = 0xAFFF;
+        const USHORT ChunkMaterialName = 0xA000;
+        const USHORT ChunkDiffuseColor = 0xA020;
+        const USHORT ChunkMapFilename = 0xA300;
+        const USHORT ChunkColorFloat = 0x0010;
+        const USHORT ChunkColor24 = 0x0011;
+        const USHORT ChunkLinearColor24 = 0x0012;
+        const USHORT ChunkLinearColorFloat = 0x0013;
+        const USHORT ChunkKeyframer = 0xB000;
+        const USHORT ChunkObjectNode = 0xB002;
+        const USHORT ChunkNodeHeader = 0xB010;
+        const USHORT ChunkPivot = 0xB013;
+
+        const UINT NoMaterial = UINT_MAX;
+        const UINT FaceSize = 4 * sizeof(USHORT);
+
+        // assimp's defaults for materials without a diffuse color and for the one it adds.
+        const XMFLOAT3 MaterialDiffuse(0.6f, 0.6f, 0.6f);
+        const XMFLOAT3 DefaultMaterialDiffuse(0.3f, 0.3f, 0.3f);
+
+        struct MapChunk
+        {
+            USHORT Id;
+            TextureType Type;
+        };
+
+        // The map slots assimp turns into texture types Model has a place for.
+        const MapChunk MapChunks[] =
+        {
+            { 0xA200, TextureTypeDifffuse },
+            { 0xA204, TextureTypeSpecularMap },
+            { 0xA230, TextureTypeHeightmap },
+            { 0xA33C, TextureTypeSpecularPowerMap },
+            { 0xA33D, TextureTypeEmissive }
+        };
+
+        // The unread part of one chunk's payload. Nothing is read past End.
+        struct ChunkCursor
+        {
+            const byte* Current;
+            const byte* End;
+        };
+
+        struct StudioMaterial
+        {
+            std::string Name;
+            XMFLOAT3 Diffuse;
+            std::vector<std::pair<TextureType, std::string>> Textures;
+        };
+
+        // One triangle mesh. The arrays point into the mapped file and are unaligned.
+        struct StudioObject
+        {
+            std::string Name;
+            const byte* Positions;
+            UINT PositionCount;
+            const byte* TextureCoordinates;
+            UINT TextureCoordinateCount;
+            const byte* Faces;
+            UINT FaceCount;
+            const byte* SmoothingGroups;
+            std::vector<UINT> FaceMaterials;
+            XMFLOAT4X4 Matrix;
+        };
+
+        struct StudioScene
+        {
+            std::vector<StudioMaterial> Materials;
+            std::vector<StudioObject> Objects;
+            std::map<std::string, XMFLOAT3> Pivots;
+        };
+
+        struct StudioVertex
+        {
+            XMFLOAT3 Position;
+            XMFLOAT3 Normal;
+            XMFLOAT2 TextureCoordinate;
+
+            bool operator==(const StudioVertex& rhs) const
+            {
+                return (Position.x == rhs.Position.x && Position.y == rhs.Position.y && Position.z == rhs.Position.z &&
+                    Normal.x == rhs.Normal.x && Normal.y == rhs.Normal.y && Normal.z == rhs.Normal.z &&
+                    TextureCoordinate.x == rhs.TextureCoordinate.x && TextureCoordinate.y == rhs.TextureCoordinate.y);
+            }
+        };
+
+        // A finished mesh before it is handed to Model.
+        struct StudioMesh
+        {
+            UINT MaterialIndex;
+            bool HasTextureCoordinates;
+            std::vector<StudioVertex> Vertices;
+            std::vector<UINT> Indices;
+        };
+
+        struct PositionKey
+        {
+            XMFLOAT3 Value;
+
+            bool operator==(const PositionKey& rhs) const
+            {
+                return (Value.x == rhs.Value.x && Value.y == rhs.Value.y && Value.z == rhs.Value.z);
+            }
+        };
+
+        size_t HashFloats(const float* values, UINT count)
+        {
+            unsigned long long hash = 0xCBF29CE484222325ULL;
+            for (UINT i = 0; i < count; i++)
+            {
+                // Adding zero folds -0 into +0, which compare equal.
+                float value = values[i] + 0.0f;
+                UINT bits;
+                memcpy(&bits, &value, sizeof(bits));
+
+                hash = (hash ^ bits) * 0x9E3779B97F4A7C15ULL;
+            }
+
+            return static_cast<size_t>(hash ^ (hash >> 29));
+        }
+
+        struct StudioVertexHash
+        {
+            size_t operator()(const StudioVertex& vertex) const
+            {
+                const float values[] = { vertex.Position.x, vertex.Position.y, vertex.Position.z, vertex.Normal.x, vertex.Normal.y, vertex.Normal.z,
+                    vertex.TextureCoordinate.x, vertex.TextureCoordinate.y };
+
+                return HashFloats(values, _countof(values));
+            }
+        };
+
+        struct PositionKeyHash
+        {
+            size_t operator()(const PositionKey& key) const
+            {
+                return HashFloats(&key.Value.x, 3);
+            }
+        };
+
+        void ForEach(ThreadPool* threadPool, UINT count, const std::function<void(UINT)>& body)
+        {
+            if (threadPool != nullptr && count > 1)
+            {
+                threadPool->ParallelFor(count, body);
+            }
+            else
+            {
+                for (UINT i = 0; i < count; i++)
+                {
+                    body(i);
+                }
+            }
+        }
+
+        std::string ToLower(std::string text)
+        {
+            std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+            return text;
+        }
+
+        inline size_t Remaining(const ChunkCursor& cursor)
+        {
+            return static_cast<size_t>(cursor.End - cursor.Current);
+        }
+
+        const byte* ReadBytes(ChunkCursor& cursor, size_t size)
+        {
+            if (size > Remaining(cursor))
+            {
+                throw GameException("3DS chunk is truncated.");
+            }
+
+            const byte* bytes = cursor.Current;
+            cursor.Current += size;
+
+            return bytes;
+        }
+
+        template <typename T>
+        T ReadValue(ChunkCursor& cursor)
+        {
+            T value;
+            memcpy(&value, ReadBytes(cursor, sizeof(T)), sizeof(T));
+
+            return value;
+        }
+
+        std::string ReadName(ChunkCursor& cursor)
+        {
+            const void* terminator = (Remaining(cursor) > 0 ? memchr(cursor.Current, 0, Remaining(cursor)) : nullptr);
+            if (terminator == nullptr)
+            {
+                throw GameException("3DS name is not terminated.");
+            }
+
+            const char* begin = reinterpret_cast<const char*>(cursor.Current);
+            std::string name(begin, static_cast<const char*>(terminator));
+            cursor.Current += name.size() + 1;
+
+            return name;
+        }
+
+        // Steps to the next child chunk, whose length must fit in what is left of the parent.
+        // A tail shorter than a chunk header is padding and ends the walk.
+        bool NextChunk(ChunkCursor& cursor, USHORT& id, ChunkCursor& payload)
+        {
+            if (Remaining(cursor) < ChunkHeaderSize)
+            {
+                cursor.Current = cursor.End;
+                return false;
+            }
+
+            id = ReadValue<USHORT>(cursor);
+            UINT length = ReadValue<UINT>(cursor);
+            if (length < ChunkHeaderSize || length - ChunkHeaderSize > Remaining(cursor))
+            {
+                throw GameException("3DS chunk overruns its parent.");
+            }
+
+            payload.Current = cursor.Current;
+            payload.End = cursor.Current + (length - ChunkHeaderSize);
+            cursor.Current = payload.End;
+
+            return true;
+        }
+
+        XMFLOAT3 ReadColor(ChunkCursor chunk, const XMFLOAT3& defaultColor)
+        {
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                switch (id)
+                {
+                case ChunkColorFloat:
+                case ChunkLinearColorFloat:
+                    return ReadValue<XMFLOAT3>(payload);
+
+                case ChunkColor24:
+                case ChunkLinearColor24:
+                {
+                    const byte* color = ReadBytes(payload, 3);
+                    return XMFLOAT3(color[0] / 255.0f, color[1] / 255.0f, color[2] / 255.0f);
+                }
+
+                default:
+                    break;
+                }
+            }
+
+            return defaultColor;
+        }
+
+        std::string ReadMapFilename(ChunkCursor chunk)
+        {
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                if (id == ChunkMapFilename)
+                {
+                    return ReadName(payload);
+                }
+            }
+
+            return std::string();
+        }
+
+        void ReadMaterial(ChunkCursor chunk, StudioMaterial& material)
+        {
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                if (id == ChunkMaterialName)
+                {
+                    material.Name = ReadName(payload);
+                }
+                else if (id == ChunkDiffuseColor)
+                {
+                    material.Diffuse = ReadColor(payload, material.Diffuse);
+                }
+                else
+                {
+                    for (const MapChunk& map : MapChunks)
+                    {
+                        if (map.Id == id)
+                        {
+                            std::string filename = ReadMapFilename(payload);
+                            if (filename.empty() == false)
+                            {
+                                material.Textures.push_back(std::make_pair(map.Type, filename));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // Faces name their material, matched without case against the ones defined so far.
+        UINT FindMaterial(const std::vector<StudioMaterial>& materials, const std::string& name)
+        {
+            std::string lowerName = ToLower(name);
+            for (UINT i = 0; i < materials.size(); i++)
+            {
+                if (ToLower(materials[i].Name) == lowerName)
+                {
+                    return i;
+                }
+            }
+
+            return NoMaterial;
+        }
+
+        void ReadFaceList(ChunkCursor chunk, const std::vector<StudioMaterial>& materials, StudioObject& object)
+        {
+            object.FaceCount = ReadValue<USHORT>(chunk);
+            object.Faces = ReadBytes(chunk, object.FaceCount * FaceSize);
+            object.SmoothingGroups = nullptr;
+            object.FaceMaterials.assign(object.FaceCount, NoMaterial);
+
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                if (id == ChunkFaceMaterial)
+                {
+                    UINT material = FindMaterial(materials, ReadName(payload));
+                    UINT count = ReadValue<USHORT>(payload);
+                    const byte* faces = ReadBytes(payload, count * sizeof(USHORT));
+                    for (UINT i = 0; i < count; i++)
+                    {
+                        USHORT face;
+                        memcpy(&face, faces + i * sizeof(USHORT), sizeof(face));
+                        if (face < object.FaceCount)
+                        {
+                            object.FaceMaterials[face] = material;
+                        }
+                    }
+                }
+                else if (id == ChunkSmoothingGroups)
+                {
+                    object.SmoothingGroups = ReadBytes(payload, object.FaceCount * sizeof(UINT));
+                }
+            }
+        }
+
+        void ReadTriangleMesh(ChunkCursor chunk, const std::vector<StudioMaterial>& materials, StudioObject& object)
+        {
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                switch (id)
+                {
+                case ChunkVertexList:
+                    object.PositionCount = ReadValue<USHORT>(payload);
+                    object.Positions = ReadBytes(payload, object.PositionCount * sizeof(XMFLOAT3));
+                    break;
+
+                case ChunkMappingCoordinates:
+                    object.TextureCoordinateCount = ReadValue<USHORT>(payload);
+                    object.TextureCoordinates = ReadBytes(payload, object.TextureCoordinateCount * sizeof(XMFLOAT2));
+                    break;
+
+                case ChunkFaceList:
+                    ReadFaceList(payload, materials, object);
+                    break;
+
+                case ChunkMeshMatrix:
+                {
+                    // Three axes and an origin, each a row for DirectXMath.
+                    float m[12];
+                    memcpy(m, ReadBytes(payload, sizeof(m)), sizeof(m));
+                    object.Matrix = XMFLOAT4X4(m[0], m[1], m[2], 0.0f, m[3], m[4], m[5], 0.0f, m[6], m[7], m[8], 0.0f, m[9], m[10], m[11], 1.0f);
+                    break;
+                }
+
+                default:
+                    break;
+                }
+            }
+        }
+
+        void ReadObject(ChunkCursor chunk, StudioScene& scene)
+        {
+            std::string name = ReadName(chunk);
+
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                if (id == ChunkTriangleMesh)
+                {
+                    StudioObject object;
+                    object.Name = name;
+                    object.Positions = nullptr;
+                    object.PositionCount = 0;
+                    object.TextureCoordinates = nullptr;
+                    object.TextureCoordinateCount = 0;
+                    object.Faces = nullptr;
+                    object.FaceCount = 0;
+                    object.SmoothingGroups = nullptr;
+                    XMStoreFloat4x4(&object.Matrix, XMMatrixIdentity());
+
+                    ReadTriangleMesh(payload, scene.Materials, object);
+                    scene.Objects.push_back(std::move(object));
+                }
+            }
+        }
+
+        void ReadEditor(ChunkCursor chunk, StudioScene& scene)
+        {
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                if (id == ChunkMaterial)
+                {
+                    StudioMaterial material;
+                    material.Diffuse = MaterialDiffuse;
+                    ReadMaterial(payload, material);
+                    scene.Materials.push_back(material);
+                }
+                else if (id == ChunkObject)
+                {
+                    ReadObject(payload, scene);
+                }
+            }
+        }
+
+        // Only the object nodes' pivots matter here; the rest of the animation is ignored.
+        void ReadKeyframer(ChunkCursor chunk, StudioScene& scene)
+        {
+            USHORT id;
+            ChunkCursor payload;
+            while (NextChunk(chunk, id, payload))
+            {
+                if (id != ChunkObjectNode)
+                {
+                    continue;
+                }
+
+                std::string name;
+                XMFLOAT3 pivot(0.0f, 0.0f, 0.0f);
+
+                USHORT nodeId;
+                ChunkCursor nodePayload;
+                while (NextChunk(payload, nodeId, nodePayload))
+                {
+                    if (nodeId == ChunkNodeHeader)
+                    {
+                        name = ReadName(nodePayload);
+                    }
+                    else if (nodeId == ChunkPivot)
+                    {
+                        pivot = ReadValue<XMFLOAT3>(nodePayload);
+                    }
+                }
+
+                if (name.empty() == false)
+                {
+                    scene.Pivots.insert(std::make_pair(ToLower(name), pivot));
+                }
+            }
+        }
+
+        // Faces without a usable material go to the file's own default material if it has one
+        // (named like "default", grey and untextured), otherwise to one added at the end.
+        void ResolveDefaultMaterial(StudioScene& scene)
+        {
+            UINT materialCount = static_cast<UINT>(scene.Materials.size());
+            UINT defaultMaterial = materialCount;
+            for (UINT i = 0; i < materialCount; i++)
+            {
+                const StudioMaterial& material = scene.Materials[i];
+                if (ToLower(material.Name).find("default") != std::string::npos && material.Textures.empty() &&
+                    material.Diffuse.x == material.Diffuse.y && material.Diffuse.x == material.Diffuse.z)
+                {
+                    defaultMaterial = i;
+                }
+            }
+
+            bool defaultMaterialUsed = false;
+            for (StudioObject& object : scene.Objects)
+            {
+                for (UINT& material : object.FaceMaterials)
+                {
+                    if (material >= materialCount)
+                    {
+                        material = defaultMaterial;
+                        defaultMaterialUsed = true;
+                    }
+                }
+            }
+
+            if (defaultMaterialUsed && defaultMaterial == materialCount)
+            {
+                StudioMaterial material;
+                material.Name = ThreeDSFile::DefaultMaterialName;
+                material.Diffuse = DefaultMaterialDiffuse;
+                scene.Materials.push_back(material);
+            }
+        }
+
+        // Vertices are stored in world space. Objects the keyframer knows about are moved back
+        // into their own space around their pivot, mirrored if their matrix is.
+        void ReadPositions(const StudioObject& object, const StudioScene& scene, std::vector<XMFLOAT3>& positions)
+        {
+            positions.resize(object.PositionCount);
+
+            std::map<std::string, XMFLOAT3>::const_iterator pivot = scene.Pivots.find(ToLower(object.Name));
+            if (pivot == scene.Pivots.end())
+            {
+                memcpy(&positions[0], object.Positions, object.PositionCount * sizeof(XMFLOAT3));
+                return;
+            }
+
+            XMVECTOR determinant;
+            XMMATRIX transform = XMMatrixInverse(&determinant, XMLoadFloat4x4(&object.Matrix));
+            if (XMVectorGetX(determinant) < 0.0f)
+            {
+                transform *= XMMatrixScaling(-1.0f, 1.0f, 1.0f);
+            }
+
+            transform *= XMMatrixTranslation(-pivot->second.x, -pivot->second.y, -pivot->second.z);
+            XMVector3TransformCoordStream(&positions[0], sizeof(XMFLOAT3), reinterpret_cast<const XMFLOAT3*>(object.Positions), sizeof(XMFLOAT3), object.PositionCount, transform);
+        }
+
+        // Each corner gets the normalized sum of the (area weighted) normals of the faces at its
+        // position that share a smoothing group with its own face. Faces in no group stay flat.
+        void ComputeCornerNormals(const StudioObject& object, const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& corners, std::vector<XMFLOAT3>& cornerNormals)
+        {
+            UINT faceCount = object.FaceCount;
+            UINT cornerCount = faceCount * 3;
+
+            std::vector<XMFLOAT3> faceNormals(faceCount);
+            for (UINT face = 0; face < faceCount; face++)
+            {
+                XMVECTOR first = XMLoadFloat3(&positions[corners[face * 3]]);
+                XMVECTOR second = XMLoadFloat3(&positions[corners[face * 3 + 1]]);
+                XMVECTOR third = XMLoadFloat3(&positions[corners[face * 3 + 2]]);
+                XMStoreFloat3(&faceNormals[face], XMVector3Cross(XMVectorSubtract(second, first), XMVectorSubtract(third, first)));
+            }
+
+            std::vector<UINT> smoothingGroups(faceCount, 0);
+            if (object.SmoothingGroups != nullptr && faceCount > 0)
+            {
+                memcpy(&smoothingGroups[0], object.SmoothingGroups, faceCount * sizeof(UINT));
+            }
+
+            // Number the distinct positions; split vertices (at texture seams, say) share one.
+            std::vector<UINT> positionIds(positions.size());
+            std::unordered_map<PositionKey, UINT, PositionKeyHash> ids;
+            ids.reserve(positions.size());
+            for (UINT i = 0; i < positions.size(); i++)
+            {
+                PositionKey key = { positions[i] };
+                positionIds[i] = ids.insert(std::make_pair(key, static_cast<UINT>(ids.size()))).first->second;
+            }
+
+            // The faces around each position, stored contiguously.
+            std::vector<UINT> firstFaces(ids.size() + 1, 0);
+            for (UINT corner = 0; corner < cornerCount; corner++)
+            {
+                firstFaces[positionIds[corners[corner]] + 1]++;
+            }
+
+            for (UINT i = 1; i < firstFaces.size(); i++)
+            {
+                firstFaces[i] += firstFaces[i - 1];
+            }
+
+            std::vector<UINT> adjacentFaces(cornerCount);
+            std::vector<UINT> nextFaces(firstFaces.begin(), firstFaces.end() - 1);
+            for (UINT corner = 0; corner < cornerCount; corner++)
+            {
+                adjacentFaces[nextFaces[positionIds[corners[corner]]]++] = corner / 3;
+            }
+
+            cornerNormals.resize(cornerCount);
+            for (UINT corner = 0; corner < cornerCount; corner++)
+            {
+                UINT face = corner / 3;
+                UINT smoothingGroup = smoothingGroups[face];
+
+                XMVECTOR normal;
+                if (smoothingGroup == 0)
+                {
+                    normal = XMLoadFloat3(&faceNormals[face]);
+                }
+                else
+                {
+                    normal = XMVectorZero();
+
+                    UINT positionId = positionIds[corners[corner]];
+                    for (UINT i = firstFaces[positionId]; i < firstFaces[positionId + 1]; i++)
+                    {
+                        UINT adjacentFace = adjacentFaces[i];
+                        XMVECTOR mask = ((smoothingGroups[adjacentFace] & smoothingGroup) != 0 ? XMVectorTrueInt() : XMVectorFalseInt());
+                        normal = XMVectorAdd(normal, XMVectorAndInt(XMLoadFloat3(&faceNormals[adjacentFace]), mask));
+                    }
+                }
+
+                XMStoreFloat3(&cornerNormals[corner], XMVector3Normalize(normal));
+            }
+        }
+
+        // One mesh per material the object's faces use, in material order, as assimp splits them.
+        void BuildObjectMeshes(const StudioObject& object, const StudioScene& scene, bool flipUVs, std::vector<StudioMesh>& meshes)
+        {
+            if (object.FaceCount == 0)
+            {
+                return;
+            }
+
+            if (object.PositionCount == 0)
+            {
+                throw GameException("3DS object has faces but no vertices.");
+            }
+
+            std::vector<XMFLOAT3> positions;
+            ReadPositions(object, scene, positions);
+
+            // Out of range corners are clamped to the last vertex (and texture coordinate), as assimp does.
+            bool hasTextureCoordinates = (object.TextureCoordinateCount > 0);
+            UINT lastIndex = object.PositionCount - 1;
+            if (hasTextureCoordinates)
+            {
+                lastIndex = std::min(lastIndex, object.TextureCoordinateCount - 1);
+            }
+
+            std::vector<UINT> corners(object.FaceCount * 3);
+            for (UINT face = 0; face < object.FaceCount; face++)
+            {
+                USHORT indices[4];
+                memcpy(indices, object.Faces + face * FaceSize, sizeof(indices));
+                for (UINT i = 0; i < 3; i++)
+                {
+                    corners[face * 3 + i] = std::min(static_cast<UINT>(indices[i]), lastIndex);
+                }
+            }
+
+            std::vector<XMFLOAT3> cornerNormals;
+            ComputeCornerNormals(object, positions, corners, cornerNormals);
+
+            std::vector<std::vector<UINT>> materialFaces(scene.Materials.size());
+            for (UINT face = 0; face < object.FaceCount; face++)
+            {
+                materialFaces[object.FaceMaterials[face]].push_back(face);
+            }
+
+            for (UINT materialIndex = 0; materialIndex < materialFaces.size(); materialIndex++)
+            {
+                const std::vector<UINT>& faces = materialFaces[materialIndex];
+                if (faces.empty())
+                {
+                    continue;
+                }
+
+                meshes.push_back(StudioMesh());
+                StudioMesh& mesh = meshes.back();
+                mesh.MaterialIndex = materialIndex;
+                mesh.HasTextureCoordinates = hasTextureCoordinates;
+
+                // Vertices are numbered in order of first use, as JoinIdenticalVertices numbers them,
+                // and each triangle is written back to front.
+                std::unordered_map<StudioVertex, UINT, StudioVertexHash> vertexIndices;
+                vertexIndices.reserve(faces.size() * 3);
+                mesh.Indices.reserve(faces.size() * 3);
+                for (UINT face : faces)
+                {
+                    UINT faceVertices[3];
+                    for (UINT i = 0; i < 3; i++)
+                    {
+                        UINT corner = face * 3 + i;
+                        UINT index = corners[corner];
+
+                        StudioVertex vertex;
+                        vertex.Position = positions[index];
+                        vertex.Normal = cornerNormals[corner];
+                        vertex.TextureCoordinate = XMFLOAT2(0.0f, 0.0f);
+                        if (hasTextureCoordinates)
+                        {
+                            memcpy(&vertex.TextureCoordinate, object.TextureCoordinates + index * sizeof(XMFLOAT2), sizeof(XMFLOAT2));
+                            if (flipUVs)
+                            {
+                                vertex.TextureCoordinate.y = 1.0f - vertex.TextureCoordinate.y;
+                            }
+                        }
+
+                        std::pair<std::unordered_map<StudioVertex, UINT, StudioVertexHash>::iterator, bool> joined = vertexIndices.insert(std::make_pair(vertex, static_cast<UINT>(mesh.Vertices.size())));
+                        if (joined.second)
+                        {
+                            mesh.Vertices.push_back(vertex);
+                        }
+
+                        faceVertices[i] = joined.first->second;
+                    }
+
+                    mesh.Indices.push_back(faceVertices[2]);
+                    mesh.Indices.push_back(faceVertices[1]);
+                    mesh.Indices.push_back(faceVertices[0]);
+                }
+            }
+        }
+    }
+
+    bool ThreeDSFile::IsThreeDSFile(const std::string& filename)
+    {
+        if (filename.size() < Extension.size())
+        {
+            return false;
+        }
+
+        return (ToLower(filename.substr(filename.size() - Extension.size())) == Extension);
+    }
+
+    void ThreeDSFile::Read(Model& model, const std::string& filename, bool flipUVs, ThreadPool* threadPool)
+    {
+        MappedFile file(filename);
+        ChunkCursor cursor = { file.Data(), file.Data() + file.Size() };
+
+        USHORT id;
+        ChunkCursor main;
+        if (NextChunk(cursor, id, main) == false || id != ChunkMain)
+        {
+            throw GameException("File is not a 3DS file.");
+        }
+
+        StudioScene scene;
+        ChunkCursor payload;
+        while (NextChunk(main, id, payload))
+        {
+            if (id == ChunkEditor)
+            {
+                ReadEditor(payload, scene);
+            }
+            else if (id == ChunkKeyframer)
+            {
+                ReadKeyframer(payload, scene);
+            }
+        }
+
+        ResolveDefaultMaterial(scene);
+
+        std::vector<std::unique_ptr<ModelMaterial>> modelMaterials;
+        for (const StudioMaterial& material : scene.Materials)
+        {
+            ModelMaterial* modelMaterial = new ModelMaterial(model);
+            modelMaterials.push_back(std::unique_ptr<ModelMaterial>(modelMaterial));
+            modelMaterial->mName = material.Name;
+
+            for (const std::pair<TextureType, std::string>& texture : material.Textures)
+            {
+                std::map<TextureType, std::vector<std::wstring>*>::iterator textures = modelMaterial->mTextures.find(texture.first);
+                if (textures == modelMaterial->mTextures.end())
+                {
+                    textures = modelMaterial->mTextures.insert(std::make_pair(texture.first, new std::vector<std::wstring>())).first;
+                }
+
+                textures->second->push_back(Utility::ToWideString(texture.second));
+            }
+        }
+
+        std::vector<std::vector<std::unique_ptr<Mesh>>> objectMeshes(scene.Objects.size());
+        ForEach(threadPool, static_cast<UINT>(scene.Objects.size()), [&](UINT objectIndex)
+        {
+            const StudioObject& object = scene.Objects[objectIndex];
+            std::vector<StudioMesh> studioMeshes;
+            BuildObjectMeshes(object, scene, flipUVs, studioMeshes);
+
+            for (StudioMesh& studioMesh : studioMeshes)
+            {
+                Mesh* mesh = new Mesh(model, modelMaterials[studioMesh.MaterialIndex].get());
+                objectMeshes[objectIndex].push_back(std::unique_ptr<Mesh>(mesh));
+                mesh->mName = object.Name;
+
+                UINT vertexCount = static_cast<UINT>(studioMesh.Vertices.size());
+                MeshStreams& meshStreams = mesh->mStreams;
+                meshStreams.Allocate(vertexCount, true, false, (studioMesh.HasTextureCoordinates ? 1 : 0), 0);
+
+                ArraySpan<XMFLOAT3> meshPositions = meshStreams.Positions();
+                ArraySpan<XMFLOAT3> meshNormals = meshStreams.Normals();
+                for (UINT i = 0; i < vertexCount; i++)
+                {
+                    meshPositions[i] = studioMesh.Vertices[i].Position;
+                    meshNormals[i] = studioMesh.Vertices[i].Normal;
+                }
+
+                if (studioMesh.HasTextureCoordinates)
+                {
+                    ArraySpan<XMFLOAT3> meshTextureCoordinates = meshStreams.TextureCoordinates(0);
+                    for (UINT i = 0; i < vertexCount; i++)
+                    {
+                        const XMFLOAT2& textureCoordinate = studioMesh.Vertices[i].TextureCoordinate;
+                        meshTextureCoordinates[i] = XMFLOAT3(textureCoordinate.x, textureCoordinate.y, 0.0f);
+                    }
+                }
+
+                mesh->mIndices = std::move(studioMesh.Indices);
+                mesh->mFaceCount = static_cast<UINT>(mesh->mIndices.size() / 3);
+                MeshBounds::Compute(meshStreams.Positions(), mesh->mBounds);
+            }
+        });
+
+        for (std::unique_ptr<ModelMaterial>& material : modelMaterials)
+        {
+            model.mMaterials.push_back(material.release());
+        }
+
+        for (std::vector<std::unique_ptr<Mesh>>& meshes : objectMeshes)
+        {
+            for (std::unique_ptr<Mesh>& mesh : meshes)
+            {
+                model.mMeshes.push_back(mesh.release());
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Common.h"
+
+namespace Library
+{
+    class Model;
+    class ThreadPool;
+
+    // Reads 3D Studio (.3ds) files straight into a Model, following what assimp's 3DS importer
+    // produces with Model's import flags: the file's materials in order (plus a default one when
+    // faces have none), one mesh per object and material, normals built from smoothing groups,
+    // the winding flipped and identical vertices joined.
+    class ThreeDSFile
+    {
+    public:
+        static const std::string Extension;
+        static const std::string DefaultMaterialName;
+
+        static bool IsThreeDSFile(const std::string& filename);
+
+        // Every chunk is checked against its parent before it is read, and vertex data is read
+        // in place from the mapped file. Throws GameException for a malformed file, leaving the
+        // model untouched. Objects are converted on threadPool, when one is given.
+        static void Read(Model& model, const std::string& filename, bool flipUVs, ThreadPool* threadPool = nullptr);
+
+    private:
+        ThreeDSFile();
+        ThreeDSFile(const ThreeDSFile& rhs);
+        ThreeDSFile& operator=(const ThreeDSFile& rhs);
+    };
+}
@@ -111,6 +111,18 @@ namespace Library
 		return dest;
 	}
 
+	std::string Utility::ToString(const std::wstring& source)
+	{
+		std::string dest;
+		dest.reserve(source.size());
+		for (wchar_t character : source)
+		{
+			dest.push_back(static_cast<char>(character));
+		}
+
+		return dest;
+	}
+
 	void Utility::PathJoin(std::wstring& dest, const std::wstring& sourceDirectory, const std::wstring& sourceFile)
 	{
 		WCHAR buffer[MAX_PATH];
@@ -15,6 +15,7 @@ namespace Library
 		static void LoadBinaryFile(const std::wstring& filename, std::vector<char>& data);
 		static void ToWideString(const std::string& source, std::wstring& dest);
 		static std::wstring ToWideString(const std::string& source);
+		static std::string ToString(const std::wstring& source);
 		static void PathJoin(std::wstring& dest, const std::wstring& sourceDirectory, const std::wstring& sourceFile);
 		static void GetPathExtension(const std::wstring& source, std::wstring& dest);
 
@@ -0,0 +1,208 @@
+#include "VertexCompression.h"
+#include "Mesh.h"
+#include <cfloat>
+#include <cmath>
+
+namespace Library
+{
+    namespace
+    {
+        const float ShortNormMax = 32767.0f;
+
+        float SignNotZero(float value)
+        {
+            return (value >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        float AngleBetween(const XMFLOAT3& a, const XMFLOAT3& b)
+        {
+            XMVECTOR angle = XMVector3AngleBetweenNormals(XMVector3Normalize(XMLoadFloat3(&a)), XMVector3Normalize(XMLoadFloat3(&b)));
+            return XMConvertToDegrees(XMVectorGetX(angle));
+        }
+
+        float MaxDirectionError(ArraySpan<const XMFLOAT3> directions)
+        {
+            float maxError = 0.0f;
+            for (const XMFLOAT3& direction : directions)
+            {
+                XMFLOAT3 decoded = VertexCompression::DecodeDirection(VertexCompression::EncodeDirection(direction));
+                float error = AngleBetween(direction, decoded);
+                if (error > maxError)
+                {
+                    maxError = error;
+                }
+            }
+
+            return maxError;
+        }
+    }
+
+    VertexQuantization VertexCompression::ComputeQuantization(const Mesh& mesh)
+    {
+        if (mesh.Vertices().empty())
+        {
+            VertexQuantization quantization;
+            quantization.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+            quantization.Extents = XMFLOAT3(1.0f, 1.0f, 1.0f);
+            return quantization;
+        }
+
+        // The mesh's box is exactly the quantization volume.
+        return ComputeQuantization(mesh.Bounds().Box);
+    }
+
+    VertexQuantization VertexCompression::ComputeQuantization(const BoundingBox& box)
+    {
+        VertexQuantization quantization;
+        quantization.Center = box.Center;
+        quantization.Extents = box.Extents;
+
+        // A flat axis would otherwise divide by zero; any scale works since every vertex encodes to 0 on it.
+        quantization.Extents.x = (quantization.Extents.x > 0.0f ? quantization.Extents.x : 1.0f);
+        quantization.Extents.y = (quantization.Extents.y > 0.0f ? quantization.Extents.y : 1.0f);
+        quantization.Extents.z = (quantization.Extents.z > 0.0f ? quantization.Extents.z : 1.0f);
+
+        return quantization;
+    }
+
+    XMMATRIX VertexCompression::DequantizationMatrix(const VertexQuantization& quantization)
+    {
+        return XMMatrixScaling(quantization.Extents.x, quantization.Extents.y, quantization.Extents.z) *
+               XMMatrixTranslation(quantization.Center.x, quantization.Center.y, quantization.Center.z);
+    }
+
+    XMSHORTN4 VertexCompression::EncodePosition(const XMFLOAT3& position, const VertexQuantization& quantization)
+    {
+        // w is stored as 1.0 so the shader receives a ready-to-transform float4.
+        XMFLOAT4 normalized((position.x - quantization.Center.x) / quantization.Extents.x,
+                            (position.y - quantization.Center.y) / quantization.Extents.y,
+                            (position.z - quantization.Center.z) / quantization.Extents.z, 1.0f);
+
+        XMSHORTN4 encoded;
+        XMStoreShortN4(&encoded, XMLoadFloat4(&normalized));
+
+        return encoded;
+    }
+
+    XMFLOAT3 VertexCompression::DecodePosition(const XMSHORTN4& position, const VertexQuantization& quantization)
+    {
+        XMFLOAT4 normalized;
+        XMStoreFloat4(&normalized, XMLoadShortN4(&position));
+
+        return XMFLOAT3(quantization.Center.x + normalized.x * quantization.Extents.x,
+                        quantization.Center.y + normalized.y * quantization.Extents.y,
+                        quantization.Center.z + normalized.z * quantization.Extents.z);
+    }
+
+    XMSHORTN2 VertexCompression::EncodeDirection(const XMFLOAT3& direction)
+    {
+        // Octahedral mapping: project onto the L1 unit octahedron and fold the lower hemisphere over the upper.
+        float length = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+        if (length <= 0.0f)
+        {
+            return XMSHORTN2(0.0f, 1.0f);
+        }
+
+        float x = direction.x / length;
+        float y = direction.y / length;
+        if (direction.z < 0.0f)
+        {
+            float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+            float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+            x = foldedX;
+            y = foldedY;
+        }
+
+        // Plain rounding is not always the nearest direction once decoded, so try each neighbouring code.
+        float baseX = floorf(x * ShortNormMax);
+        float baseY = floorf(y * ShortNormMax);
+
+        XMSHORTN2 best(0.0f, 1.0f);
+        float bestDot = -FLT_MAX;
+        XMVECTOR target = XMVector3Normalize(XMLoadFloat3(&direction));
+        for (int i = 0; i < 4; i++)
+        {
+            float codeX = baseX + (i & 1);
+            float codeY = baseY + (i >> 1);
+            codeX = (codeX > ShortNormMax ? ShortNormMax : (codeX < -ShortNormMax ? -ShortNormMax : codeX));
+            codeY = (codeY > ShortNormMax ? ShortNormMax : (codeY < -ShortNormMax ? -ShortNormMax : codeY));
+
+            XMSHORTN2 candidate;
+            candidate.x = static_cast<int16_t>(codeX);
+            candidate.y = static_cast<int16_t>(codeY);
+
+            XMFLOAT3 decoded = DecodeDirection(candidate);
+            float dot = XMVectorGetX(XMVector3Dot(target, XMLoadFloat3(&decoded)));
+            if (dot > bestDot)
+            {
+                bestDot = dot;
+                best = candidate;
+            }
+        }
+
+        return best;
+    }
+
+    XMFLOAT3 VertexCompression::DecodeDirection(const XMSHORTN2& direction)
+    {
+        XMFLOAT2 encoded;
+        XMStoreFloat2(&encoded, XMLoadShortN2(&direction));
+
+        XMFLOAT3 decoded(encoded.x, encoded.y, 1.0f - fabsf(encoded.x) - fabsf(encoded.y));
+        float fold = (decoded.z < 0.0f ? -decoded.z : 0.0f);
+        decoded.x += (decoded.x >= 0.0f ? -fold : fold);
+        decoded.y += (decoded.y >= 0.0f ? -fold : fold);
+
+        XMStoreFloat3(&decoded, XMVector3Normalize(XMLoadFloat3(&decoded)));
+
+        return decoded;
+    }
+
+    XMHALF2 VertexCompression::EncodeTextureCoordinate(const XMFLOAT3& textureCoordinate)
+    {
+        return XMHALF2(textureCoordinate.x, textureCoordinate.y);
+    }
+
+    XMFLOAT2 VertexCompression::DecodeTextureCoordinate(const XMHALF2& textureCoordinate)
+    {
+        return XMFLOAT2(XMConvertHalfToFloat(textureCoordinate.x), XMConvertHalfToFloat(textureCoordinate.y));
+    }
+
+    VertexCompressionReport VertexCompression::Measure(const Mesh& mesh)
+    {
+        VertexCompressionReport report;
+        ZeroMemory(&report, sizeof(report));
+
+        ArraySpan<const XMFLOAT3> vertices = mesh.Vertices();
+        report.VertexCount = vertices.size();
+
+        VertexQuantization quantization = ComputeQuantization(mesh);
+        for (const XMFLOAT3& vertex : vertices)
+        {
+            XMFLOAT3 decoded = DecodePosition(EncodePosition(vertex, quantization), quantization);
+            float error = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&vertex), XMLoadFloat3(&decoded))));
+            if (error > report.MaxPositionError)
+            {
+                report.MaxPositionError = error;
+            }
+        }
+
+        report.MaxNormalError = MaxDirectionError(mesh.Normals());
+        report.MaxTangentError = MaxDirectionError(mesh.Tangents());
+
+        for (const ArraySpan<const XMFLOAT3>& textureCoordinates : mesh.TextureCoordinates())
+        {
+            for (const XMFLOAT3& textureCoordinate : textureCoordinates)
+            {
+                XMFLOAT2 decoded = DecodeTextureCoordinate(EncodeTextureCoordinate(textureCoordinate));
+                float error = fmaxf(fabsf(textureCoordinate.x - decoded.x), fabsf(textureCoordinate.y - decoded.y));
+                if (error > report.MaxTextureCoordinateError)
+                {
+                    report.MaxTextureCoordinateError = error;
+                }
+            }
+        }
+
+        return report;
+    }
+}
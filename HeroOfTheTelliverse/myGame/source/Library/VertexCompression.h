@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Common.h"
+#include <DirectXCollision.h>
+
+namespace Library
+{
+    class Mesh;
+
+    // Positions are stored relative to the mesh bounds: object = Center + Extents * snorm.
+    struct VertexQuantization
+    {
+        XMFLOAT3 Center;
+        XMFLOAT3 Extents;
+    };
+
+    struct VertexCompressionReport
+    {
+        UINT VertexCount;
+        float MaxPositionError;
+        float MaxNormalError;
+        float MaxTangentError;
+        float MaxTextureCoordinateError;
+    };
+
+    class VertexCompression
+    {
+    public:
+        static VertexQuantization ComputeQuantization(const Mesh& mesh);
+
+        // For meshes packed into one vertex buffer, which share a volume such as Model::Bounds().
+        static VertexQuantization ComputeQuantization(const BoundingBox& box);
+        static XMMATRIX DequantizationMatrix(const VertexQuantization& quantization);
+
+        static XMSHORTN4 EncodePosition(const XMFLOAT3& position, const VertexQuantization& quantization);
+        static XMFLOAT3 DecodePosition(const XMSHORTN4& position, const VertexQuantization& quantization);
+
+        static XMSHORTN2 EncodeDirection(const XMFLOAT3& direction);
+        static XMFLOAT3 DecodeDirection(const XMSHORTN2& direction);
+
+        static XMHALF2 EncodeTextureCoordinate(const XMFLOAT3& textureCoordinate);
+        static XMFLOAT2 DecodeTextureCoordinate(const XMHALF2& textureCoordinate);
+
+        static VertexCompressionReport Measure(const Mesh& mesh);
+
+    private:
+        VertexCompression();
+        VertexCompression(const VertexCompression& rhs);
+        VertexCompression& operator=(const VertexCompression& rhs);
+    };
+}